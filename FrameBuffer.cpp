@@ -1,14 +1,16 @@
 #include "FrameBuffer.h"
 
-FrameBuffer::FrameBuffer(ID3D12Device* device, UINT commonCount, UINT objectCount, UINT materialCount)
+FrameBuffer::FrameBuffer(ID3D12Device* device, UINT commonCount, UINT objectCount, UINT texTransformCount, UINT materialCount, UINT impostorCount)
 {
 	ThrowIfFailed(device->CreateCommandAllocator(
 		D3D12_COMMAND_LIST_TYPE_DIRECT,
 		IID_PPV_ARGS(CmdListAlloc.GetAddressOf())));
 
 	CommonCB = std::make_unique<UploadBuffer<CommonConstants>>(device, commonCount, true);
-	ObjectCB = std::make_unique<UploadBuffer<ObjectConstants>>(device, objectCount, true);
+	InstanceBuffer = std::make_unique<UploadBuffer<InstanceData>>(device, objectCount, false);
+	TexTransformBuffer = std::make_unique<UploadBuffer<TexTransformData>>(device, texTransformCount, false);
 	MaterialBuffer = std::make_unique<UploadBuffer<MaterialParameter>>(device, materialCount, false);
+	ImpostorBuffer = std::make_unique<UploadBuffer<UINT>>(device, impostorCount, false);
 }
 
 FrameBuffer::~FrameBuffer()
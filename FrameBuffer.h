@@ -3,16 +3,40 @@
 #include "./Helpers/d3dUtil.h"
 #include "./Helpers/MathHelper.h"
 #include "./Helpers/UploadBuffer.h"
+#include "./Rhi/Rhi.h"
 
-// pair to the cbuffer cbObject in the shader source(BasicShader.hlsl)
-struct ObjectConstants
+// pair to the StructuredBuffer<InstanceData> gInstances in the shader source(BasicShader.hlsl)
+// the affine world matrix is stored as 4 rows x 3 columns and read as row_major float4x3 in hlsl,
+// so no transpose is needed on the CPU and an object costs 52 bytes instead of a padded 256-byte constant buffer.
+struct InstanceData
 {
-	DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();			
-	DirectX::XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();	
-	UINT MaterialIndex;
-	UINT ObjPad0;
-	UINT ObjPad1;
-	UINT ObjPad2;
+	DirectX::XMFLOAT4X3 World = DirectX::XMFLOAT4X3(
+		1.0f, 0.0f, 0.0f,
+		0.0f, 1.0f, 0.0f,
+		0.0f, 0.0f, 1.0f,
+		0.0f, 0.0f, 0.0f);
+	UINT MaterialIndex = 0;
+};
+static_assert(sizeof(InstanceData) == 52, "InstanceData must match the stride of gInstances in BasicShader.hlsl");
+
+// pair to the StructuredBuffer<TexTransformData> gTexTransforms in the shader source(BasicShader.hlsl)
+// only texture transforms which differ from identity are stored, entry 0 is always the identity.
+struct TexTransformData
+{
+	DirectX::XMFLOAT4X3 TexTransform = DirectX::XMFLOAT4X3(
+		1.0f, 0.0f, 0.0f,
+		0.0f, 1.0f, 0.0f,
+		0.0f, 0.0f, 1.0f,
+		0.0f, 0.0f, 0.0f);
+};
+
+// pair to the cbuffer cbDraw (root constants) in the shader source(BasicShader.hlsl)
+struct DrawConstants
+{
+	DirectX::XMFLOAT3 PositionCenter = { 0.0f, 0.0f, 0.0f };	// bounds the positions of CompactVertex meshes are quantized in
+	UINT InstanceIndex = 0;
+	DirectX::XMFLOAT3 PositionExtent = { 1.0f, 1.0f, 1.0f };
+	UINT TexTransformIndex = 0;
 };
 
 // pair to the cbuffer cbCommon in the shader source(BasicShader.hlsl)
@@ -63,7 +87,7 @@ struct Vertex
 class FrameBuffer
 {
 public:
-	FrameBuffer(ID3D12Device* device, UINT commonCount, UINT objectCount, UINT materialCount);
+	FrameBuffer(ID3D12Device* device, UINT commonCount, UINT objectCount, UINT texTransformCount, UINT materialCount, UINT impostorCount);
 	FrameBuffer(const FrameBuffer& rhs) = delete;
 	FrameBuffer(FrameBuffer&& rhs) = delete;
 	FrameBuffer& operator=(const FrameBuffer& rhs) = delete;
@@ -73,9 +97,19 @@ public:
 	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CmdListAlloc;
 
 	std::unique_ptr<UploadBuffer<CommonConstants>> CommonCB = nullptr;
-	std::unique_ptr<UploadBuffer<ObjectConstants>> ObjectCB = nullptr;
+	std::unique_ptr<UploadBuffer<InstanceData>> InstanceBuffer = nullptr;
+	std::unique_ptr<UploadBuffer<TexTransformData>> TexTransformBuffer = nullptr;
 
 	std::unique_ptr<UploadBuffer<MaterialParameter>> MaterialBuffer = nullptr;
 
+	// gInstances indices of the bodies drawn as impostors this frame (StructuredBuffer<uint> gImpostors)
+	std::unique_ptr<UploadBuffer<UINT>> ImpostorBuffer = nullptr;
+
+	// draws of the static objects, recorded once and re-recorded only when the version of the
+	// static draw inputs moves past StaticBundleVersion.  One per frame buffer, so a bundle is never
+	// recorded while a frame still in flight executes it.
+	std::unique_ptr<RhiCommandList> StaticBundle;
+	UINT64 StaticBundleVersion = 0;
+
 	UINT64 Fence = 0;
 };
\ No newline at end of file
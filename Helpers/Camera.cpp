@@ -176,6 +176,13 @@ XMFLOAT4X4 Camera::GetProj4x4f()const
 	return mProj;
 }
 
+CullFrustum Camera::GetFrustum()const
+{
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, XMMatrixMultiply(GetView(), GetProj()));
+	return CullFrustum::FromViewProj(viewProj.m);
+}
+
 void Camera::Strafe(float d)
 {
 	// mPosition += d*mRight
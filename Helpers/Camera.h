@@ -12,6 +12,7 @@
 #define CAMERA_H
 
 #include "d3dUtil.h"
+#include "FrustumCulling.h"
 
 #define NO_BELOW_GROUND
 
@@ -63,6 +64,9 @@ public:
 	DirectX::XMFLOAT4X4 GetView4x4f()const;
 	DirectX::XMFLOAT4X4 GetProj4x4f()const;
 
+	// World space planes of the viewing frustum, for culling.
+	CullFrustum GetFrustum()const;
+
 	// Strafe/Walk the camera a distance d.
 	void Strafe(float d);
 	void Walk(float d);
@@ -0,0 +1,239 @@
+// CommandStateCache.h : filters redundant pipeline, input assembler and root bindings
+// before they reach the command list, and counts what was requested against what was issued.
+// Only depends on the RHI, so it runs unchanged on the D3D12, null and recording backends.
+// With a resource state tracker, its pending barriers are flushed in one batch before every draw.
+
+#pragma once
+
+#include "../Rhi/Rhi.h"
+#include "../Rhi/RhiStateTracker.h"
+#include <cassert>
+#include <cstring>
+
+struct CommandStateStats
+{
+	std::uint32_t Draws = 0;
+	std::uint32_t Requested = 0;		// state changes asked for by the caller (what an uncached recorder would issue)
+	std::uint32_t Issued = 0;		// state changes actually recorded into the command list
+	std::uint32_t Bundles = 0;
+};
+
+class CommandStateCache
+{
+public:
+	static const std::uint32_t MaxRootParameters = 16;
+	static const std::uint32_t MaxRootConstants = 8;
+
+	// start recording into cmdList, which was just reset with initialPso.  tracker, when given, tracks cmdList.
+	void Begin(RhiCommandList* cmdList, RhiPipelineState* initialPso, RhiResourceStateTracker* tracker = nullptr)
+	{
+		mCmdList = cmdList;
+		mTracker = tracker;
+		mPso = initialPso;
+		mRootSignature = nullptr;
+		mHasVertexBuffer = false;
+		mHasIndexBuffer = false;
+		mTopology = RhiPrimitiveTopology::Undefined;
+		InvalidateRootBindings();
+		mStats = CommandStateStats();
+	}
+
+	void SetPipelineState(RhiPipelineState* pso)
+	{
+		mStats.Requested++;
+		if (pso != mPso)
+		{
+			mCmdList->SetPipelineState(pso);
+			mPso = pso;
+			mStats.Issued++;
+		}
+	}
+
+	// changing the root signature invalidates every root binding.
+	void SetGraphicsRootSignature(RhiRootSignature* rootSignature)
+	{
+		mStats.Requested++;
+		if (rootSignature != mRootSignature)
+		{
+			mCmdList->SetGraphicsRootSignature(rootSignature);
+			mRootSignature = rootSignature;
+			InvalidateRootBindings();
+			mStats.Issued++;
+		}
+	}
+
+	void IASetVertexBuffer(const RhiVertexBufferView& view)
+	{
+		mStats.Requested++;
+		if (!mHasVertexBuffer || view.BufferLocation != mVertexBuffer.BufferLocation ||
+			view.SizeInBytes != mVertexBuffer.SizeInBytes || view.StrideInBytes != mVertexBuffer.StrideInBytes)
+		{
+			mCmdList->IASetVertexBuffers(0, 1, &view);
+			mVertexBuffer = view;
+			mHasVertexBuffer = true;
+			mStats.Issued++;
+		}
+	}
+
+	void IASetIndexBuffer(const RhiIndexBufferView& view)
+	{
+		mStats.Requested++;
+		if (!mHasIndexBuffer || view.BufferLocation != mIndexBuffer.BufferLocation ||
+			view.SizeInBytes != mIndexBuffer.SizeInBytes || view.Format != mIndexBuffer.Format)
+		{
+			mCmdList->IASetIndexBuffer(&view);
+			mIndexBuffer = view;
+			mHasIndexBuffer = true;
+			mStats.Issued++;
+		}
+	}
+
+	void IASetPrimitiveTopology(RhiPrimitiveTopology topology)
+	{
+		mStats.Requested++;
+		if (topology != mTopology)
+		{
+			mCmdList->IASetPrimitiveTopology(topology);
+			mTopology = topology;
+			mStats.Issued++;
+		}
+	}
+
+	void SetGraphicsRootConstantBufferView(std::uint32_t rootIndex, RhiGpuAddress address)
+	{
+		mStats.Requested++;
+		if (SetRootValue(rootIndex, address))
+		{
+			mCmdList->SetGraphicsRootConstantBufferView(rootIndex, address);
+			mStats.Issued++;
+		}
+	}
+
+	void SetGraphicsRootShaderResourceView(std::uint32_t rootIndex, RhiGpuAddress address)
+	{
+		mStats.Requested++;
+		if (SetRootValue(rootIndex, address))
+		{
+			mCmdList->SetGraphicsRootShaderResourceView(rootIndex, address);
+			mStats.Issued++;
+		}
+	}
+
+	void SetGraphicsRootDescriptorTable(std::uint32_t rootIndex, RhiGpuDescriptor baseDescriptor)
+	{
+		mStats.Requested++;
+		if (SetRootValue(rootIndex, baseDescriptor.Ptr))
+		{
+			mCmdList->SetGraphicsRootDescriptorTable(rootIndex, baseDescriptor);
+			mStats.Issued++;
+		}
+	}
+
+	// root constants are compared value by value (up to MaxRootConstants 32-bit values per parameter).
+	void SetGraphicsRoot32BitConstants(std::uint32_t rootIndex, std::uint32_t num32BitValues, const void* srcData, std::uint32_t destOffset)
+	{
+		assert(rootIndex < MaxRootParameters && destOffset + num32BitValues <= MaxRootConstants);
+
+		mStats.Requested++;
+		RootBinding& binding = mRoot[rootIndex];
+		const std::uint32_t* values = reinterpret_cast<const std::uint32_t*>(srcData);
+
+		bool changed = !binding.Valid;
+		for (std::uint32_t i = 0; i < num32BitValues && !changed; ++i)
+		{
+			changed = binding.Constants[destOffset + i] != values[i];
+		}
+
+		if (changed)
+		{
+			mCmdList->SetGraphicsRoot32BitConstants(rootIndex, num32BitValues, srcData, destOffset);
+			if (!binding.Valid)
+			{
+				memset(binding.Constants, 0, sizeof(binding.Constants));
+			}
+			memcpy(&binding.Constants[destOffset], values, num32BitValues * sizeof(std::uint32_t));
+			binding.Valid = true;
+			mStats.Issued++;
+		}
+	}
+
+	void DrawIndexedInstanced(std::uint32_t indexCountPerInstance, std::uint32_t instanceCount, std::uint32_t startIndexLocation,
+		int baseVertexLocation, std::uint32_t startInstanceLocation)
+	{
+		if (mTracker) mTracker->Flush();
+		mCmdList->DrawIndexedInstanced(indexCountPerInstance, instanceCount, startIndexLocation, baseVertexLocation, startInstanceLocation);
+		mStats.Draws++;
+	}
+
+	void DrawInstanced(std::uint32_t vertexCountPerInstance, std::uint32_t instanceCount, std::uint32_t startVertexLocation,
+		std::uint32_t startInstanceLocation)
+	{
+		if (mTracker) mTracker->Flush();
+		mCmdList->DrawInstanced(vertexCountPerInstance, instanceCount, startVertexLocation, startInstanceLocation);
+		mStats.Draws++;
+	}
+
+	// the pipeline, IA and root constant state a bundle sets stays bound in the calling list,
+	// so everything but the root signature is unknown afterwards.
+	void ExecuteBundle(RhiCommandList* bundle)
+	{
+		if (mTracker) mTracker->Flush();
+		mCmdList->ExecuteBundle(bundle);
+		mPso = nullptr;
+		mHasVertexBuffer = false;
+		mHasIndexBuffer = false;
+		mTopology = RhiPrimitiveTopology::Undefined;
+		InvalidateRootBindings();
+		mStats.Bundles++;
+	}
+
+	const CommandStateStats& Stats()const { return mStats; }
+
+private:
+	struct RootBinding
+	{
+		bool Valid = false;
+		std::uint64_t Value = 0;
+		std::uint32_t Constants[MaxRootConstants] = {};
+	};
+
+	bool SetRootValue(std::uint32_t rootIndex, std::uint64_t value)
+	{
+		assert(rootIndex < MaxRootParameters);
+
+		RootBinding& binding = mRoot[rootIndex];
+		if (binding.Valid && binding.Value == value)
+		{
+			return false;
+		}
+
+		binding.Valid = true;
+		binding.Value = value;
+		return true;
+	}
+
+	void InvalidateRootBindings()
+	{
+		for (auto& binding : mRoot)
+		{
+			binding.Valid = false;
+		}
+	}
+
+private:
+	RhiCommandList* mCmdList = nullptr;
+	RhiResourceStateTracker* mTracker = nullptr;
+
+	RhiPipelineState* mPso = nullptr;
+	RhiRootSignature* mRootSignature = nullptr;
+
+	bool mHasVertexBuffer = false;
+	bool mHasIndexBuffer = false;
+	RhiVertexBufferView mVertexBuffer;
+	RhiIndexBufferView mIndexBuffer;
+	RhiPrimitiveTopology mTopology = RhiPrimitiveTopology::Undefined;
+
+	RootBinding mRoot[MaxRootParameters];
+
+	CommandStateStats mStats;
+};
@@ -1283,6 +1283,11 @@ static HRESULT CreateD3DResources12(
 			texture = nullptr;
 			return hr;
 		}
+		else if (!cmdList)
+		{
+			// texture only, the caller uploads the subresources itself (LoadDDSTextureFromFile12).
+			return hr;
+		}
 		else
 		{
 			const UINT num2DSubresources = texDesc.DepthOrArraySize * texDesc.MipLevels;
@@ -1678,7 +1683,8 @@ static HRESULT CreateTextureFromDDS12(
 	_In_ size_t maxsize,
 	_In_ bool forceSRGB,
 	ComPtr<ID3D12Resource>& texture,
-	ComPtr<ID3D12Resource>& textureUploadHeap)
+	ComPtr<ID3D12Resource>& textureUploadHeap,
+	std::vector<D3D12_SUBRESOURCE_DATA>* subresources = nullptr)
 {
 	HRESULT hr = S_OK;
 
@@ -1870,6 +1876,11 @@ static HRESULT CreateTextureFromDDS12(
 			textureUploadHeap);
 	}
 
+	if (SUCCEEDED(hr) && subresources)
+	{
+		subresources->assign(initData.get(), initData.get() + (mipCount - skipMip) * arraySize);
+	}
+
 	return hr;
 }
 
@@ -2228,6 +2239,48 @@ HRESULT DirectX::CreateDDSTextureFromFile12(_In_ ID3D12Device* device,
 	return hr;
 }
 
+HRESULT DirectX::LoadDDSTextureFromFile12(_In_ ID3D12Device* device,
+	_In_z_ const wchar_t* szFileName,
+	_Out_ ComPtr<ID3D12Resource>& texture,
+	_Out_ std::unique_ptr<uint8_t[]>& ddsData,
+	_Out_ std::vector<D3D12_SUBRESOURCE_DATA>& subresources,
+	_In_ size_t maxsize,
+	_Out_opt_ DDS_ALPHA_MODE* alphaMode)
+{
+	texture = nullptr;
+	subresources.clear();
+	if (alphaMode)
+	{
+		*alphaMode = DDS_ALPHA_MODE_UNKNOWN;
+	}
+
+	if (!device || !szFileName)
+	{
+		return E_INVALIDARG;
+	}
+
+	DDS_HEADER* header = nullptr;
+	uint8_t* bitData = nullptr;
+	size_t bitSize = 0;
+
+	HRESULT hr = LoadTextureDataFromFile(szFileName, ddsData, &header, &bitData, &bitSize);
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	ComPtr<ID3D12Resource> noUploadHeap;
+	hr = CreateTextureFromDDS12(device, nullptr, header,
+		bitData, bitSize, maxsize, false, texture, noUploadHeap, &subresources);
+
+	if (SUCCEEDED(hr) && alphaMode)
+	{
+		*alphaMode = GetAlphaMode(header);
+	}
+
+	return hr;
+}
+
 _Use_decl_annotations_
 HRESULT DirectX::CreateDDSTextureFromFile( ID3D11Device* d3dDevice,
                                            ID3D11DeviceContext* d3dContext,
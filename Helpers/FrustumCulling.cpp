@@ -0,0 +1,227 @@
+// FrustumCulling.cpp
+
+#include "FrustumCulling.h"
+#include <cmath>
+#include <limits>
+
+namespace
+{
+	CullPlane NormalizedPlane(float a, float b, float c, float d)
+	{
+		float invLength = 1.0f / std::sqrt(a * a + b * b + c * c);
+
+		CullPlane plane;
+		plane.A = a * invLength;
+		plane.B = b * invLength;
+		plane.C = c * invLength;
+		plane.D = d * invLength;
+		return plane;
+	}
+
+	// appends base + k for every set bit k of mask.  Every lane is stored and the count only advances
+	// on the visible ones, so there is no branch per sphere; the stores stay below base + Lanes.
+	inline std::uint32_t AppendVisible(std::uint32_t* visible, std::uint32_t count, std::uint32_t base, unsigned mask)
+	{
+		for (std::uint32_t k = 0; k < SphereCullSet::Lanes; ++k)
+		{
+			visible[count] = base + k;
+			count += (mask >> k) & 1;
+		}
+		return count;
+	}
+
+	// the planes splatted across the lanes, and the mask of which of 8 spheres touch the frustum.
+#if FRUSTUM_CULL_AVX
+	struct PlaneLanes
+	{
+		__m256 A[6], B[6], C[6], D[6];
+
+		explicit PlaneLanes(const CullFrustum& frustum)
+		{
+			for (int p = 0; p < 6; ++p)
+			{
+				A[p] = _mm256_set1_ps(frustum.Planes[p].A);
+				B[p] = _mm256_set1_ps(frustum.Planes[p].B);
+				C[p] = _mm256_set1_ps(frustum.Planes[p].C);
+				D[p] = _mm256_set1_ps(frustum.Planes[p].D);
+			}
+		}
+	};
+
+	inline unsigned InsideMask(const PlaneLanes& planes, const float* xs, const float* ys, const float* zs, const float* rs)
+	{
+		__m256 x = _mm256_loadu_ps(xs);
+		__m256 y = _mm256_loadu_ps(ys);
+		__m256 z = _mm256_loadu_ps(zs);
+		__m256 negR = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(rs));
+
+		// inside every plane : distance >= -radius
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; ++p)
+		{
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planes.A[p], x), _mm256_mul_ps(planes.B[p], y)),
+				_mm256_add_ps(_mm256_mul_ps(planes.C[p], z), planes.D[p]));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negR, _CMP_GE_OQ));
+		}
+		return (unsigned)_mm256_movemask_ps(inside);
+	}
+#elif FRUSTUM_CULL_SSE
+	struct PlaneLanes
+	{
+		__m128 A[6], B[6], C[6], D[6];
+
+		explicit PlaneLanes(const CullFrustum& frustum)
+		{
+			for (int p = 0; p < 6; ++p)
+			{
+				A[p] = _mm_set1_ps(frustum.Planes[p].A);
+				B[p] = _mm_set1_ps(frustum.Planes[p].B);
+				C[p] = _mm_set1_ps(frustum.Planes[p].C);
+				D[p] = _mm_set1_ps(frustum.Planes[p].D);
+			}
+		}
+	};
+
+	inline unsigned InsideMask(const PlaneLanes& planes, const float* xs, const float* ys, const float* zs, const float* rs)
+	{
+		// the 8 spheres as two 4 wide halves, interleaved so both dependency chains are in flight.
+		__m128 x0 = _mm_loadu_ps(xs), x1 = _mm_loadu_ps(xs + 4);
+		__m128 y0 = _mm_loadu_ps(ys), y1 = _mm_loadu_ps(ys + 4);
+		__m128 z0 = _mm_loadu_ps(zs), z1 = _mm_loadu_ps(zs + 4);
+		__m128 negR0 = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(rs));
+		__m128 negR1 = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(rs + 4));
+
+		__m128 inside0 = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		__m128 inside1 = inside0;
+		for (int p = 0; p < 6; ++p)
+		{
+			__m128 distance0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes.A[p], x0), _mm_mul_ps(planes.B[p], y0)), _mm_add_ps(_mm_mul_ps(planes.C[p], z0), planes.D[p]));
+			__m128 distance1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes.A[p], x1), _mm_mul_ps(planes.B[p], y1)), _mm_add_ps(_mm_mul_ps(planes.C[p], z1), planes.D[p]));
+			inside0 = _mm_and_ps(inside0, _mm_cmpge_ps(distance0, negR0));
+			inside1 = _mm_and_ps(inside1, _mm_cmpge_ps(distance1, negR1));
+		}
+		return (unsigned)_mm_movemask_ps(inside0) | ((unsigned)_mm_movemask_ps(inside1) << 4);
+	}
+#else
+	struct PlaneLanes
+	{
+		const CullFrustum& Frustum;
+
+		explicit PlaneLanes(const CullFrustum& frustum) : Frustum(frustum) {}
+	};
+
+	inline unsigned InsideMask(const PlaneLanes& planes, const float* xs, const float* ys, const float* zs, const float* rs)
+	{
+		unsigned mask = 0;
+		for (std::uint32_t k = 0; k < SphereCullSet::Lanes; ++k)
+		{
+			bool inside = true;
+			for (const CullPlane& plane : planes.Frustum.Planes)
+			{
+				float distance = plane.A * xs[k] + plane.B * ys[k] + plane.C * zs[k] + plane.D;
+				inside = inside && distance >= -rs[k];
+			}
+			mask |= (unsigned)inside << k;
+		}
+		return mask;
+	}
+#endif
+
+	bool SphereInside(const CullFrustum& frustum, const SphereCullSet& spheres, std::size_t i)
+	{
+		bool inside = true;
+		for (const CullPlane& plane : frustum.Planes)
+		{
+			float distance = plane.A * spheres.X()[i] + plane.B * spheres.Y()[i] + plane.C * spheres.Z()[i] + plane.D;
+			inside = inside && distance >= -spheres.R()[i];
+		}
+		return inside;
+	}
+}
+
+CullFrustum CullFrustum::FromViewProj(const float m[4][4])
+{
+	// clip = (x, y, z, 1) * m : each plane is a sum or difference of two columns of m.
+	CullFrustum frustum;
+	frustum.Planes[0] = NormalizedPlane(m[0][3] + m[0][0], m[1][3] + m[1][0], m[2][3] + m[2][0], m[3][3] + m[3][0]);	// left   : -w <= x
+	frustum.Planes[1] = NormalizedPlane(m[0][3] - m[0][0], m[1][3] - m[1][0], m[2][3] - m[2][0], m[3][3] - m[3][0]);	// right  :  x <= w
+	frustum.Planes[2] = NormalizedPlane(m[0][3] + m[0][1], m[1][3] + m[1][1], m[2][3] + m[2][1], m[3][3] + m[3][1]);	// bottom : -w <= y
+	frustum.Planes[3] = NormalizedPlane(m[0][3] - m[0][1], m[1][3] - m[1][1], m[2][3] - m[2][1], m[3][3] - m[3][1]);	// top    :  y <= w
+	frustum.Planes[4] = NormalizedPlane(m[0][2], m[1][2], m[2][2], m[3][2]);											// near   :  0 <= z
+	frustum.Planes[5] = NormalizedPlane(m[0][3] - m[0][2], m[1][3] - m[1][2], m[2][3] - m[2][2], m[3][3] - m[3][2]);	// far    :  z <= w
+	return frustum;
+}
+
+void SphereCullSet::Resize(std::size_t count)
+{
+	// padding spheres have a hugely negative radius, no plane distance is ever above it.
+	std::size_t padded = (count + Lanes - 1) / Lanes * Lanes;
+	const float outside = -std::numeric_limits<float>::max();
+
+	mCount = count;
+	mX.assign(padded, 0.0f);
+	mY.assign(padded, 0.0f);
+	mZ.assign(padded, 0.0f);
+	mR.assign(padded, outside);
+}
+
+std::uint32_t CullSpheresScalar(const CullFrustum& frustum, const SphereCullSet& spheres, std::uint32_t* visible)
+{
+	std::uint32_t count = 0;
+	for (std::size_t i = 0; i < spheres.Size(); ++i)
+	{
+		if (SphereInside(frustum, spheres, i))
+		{
+			visible[count++] = (std::uint32_t)i;
+		}
+	}
+	return count;
+}
+
+std::uint32_t CullSpheres(const CullFrustum& frustum, const SphereCullSet& spheres, std::uint32_t* visible)
+{
+	const PlaneLanes planes(frustum);
+	std::uint32_t count = 0;
+	for (std::size_t i = 0; i < spheres.PaddedSize(); i += SphereCullSet::Lanes)
+	{
+		unsigned mask = InsideMask(planes, spheres.X() + i, spheres.Y() + i, spheres.Z() + i, spheres.R() + i);
+		count = AppendVisible(visible, count, (std::uint32_t)i, mask);
+	}
+	return count;
+}
+
+std::uint32_t CullSphereRange(const CullFrustum& frustum, const SphereCullSet& spheres, std::size_t first, std::size_t count, std::uint32_t* visible)
+{
+	const PlaneLanes planes(frustum);
+	const std::size_t end = first + count;
+	std::uint32_t found = 0;
+
+	// whole groups : found stays below the group's offset in the range, so the stores of all its lanes fit.
+	std::size_t i = first;
+	for (; i + SphereCullSet::Lanes <= end; i += SphereCullSet::Lanes)
+	{
+		unsigned mask = InsideMask(planes, spheres.X() + i, spheres.Y() + i, spheres.Z() + i, spheres.R() + i);
+		found = AppendVisible(visible, found, (std::uint32_t)i, mask);
+	}
+
+	// the rest, 8 wide while the padding of the set covers the group, stored lane by lane.
+	if (i < end)
+	{
+		unsigned mask = 0;
+		if (i + SphereCullSet::Lanes <= spheres.PaddedSize())
+		{
+			mask = InsideMask(planes, spheres.X() + i, spheres.Y() + i, spheres.Z() + i, spheres.R() + i);
+		}
+		else
+		{
+			for (std::size_t k = 0; i + k < end; ++k)
+				mask |= (unsigned)SphereInside(frustum, spheres, i + k) << k;
+		}
+		for (std::size_t k = 0; i + k < end; ++k)
+		{
+			visible[found] = (std::uint32_t)(i + k);
+			found += (mask >> k) & 1;
+		}
+	}
+	return found;
+}
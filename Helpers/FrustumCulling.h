@@ -0,0 +1,79 @@
+// FrustumCulling.h : tests bounding spheres against the six planes of a view frustum, 8 spheres at a time.
+//
+// The spheres are kept as structure of arrays (x, y, z, radius), padded to a multiple of 8 with spheres
+// that are always outside, so the kernel never needs a remainder loop.  Each iteration evaluates the six
+// plane distances of 8 spheres with AVX, or two 4 wide SSE halves, and appends the indices of the spheres
+// touching the frustum to a compact visible list.  Without SIMD it falls back to the same test in scalar code.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define FRUSTUM_CULL_AVX 1
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define FRUSTUM_CULL_SSE 1
+#endif
+
+// plane ax + by + cz + d = 0 with a unit normal pointing into the frustum.
+struct CullPlane
+{
+	float A = 0.0f;
+	float B = 0.0f;
+	float C = 0.0f;
+	float D = 0.0f;
+};
+
+struct CullFrustum
+{
+	CullPlane Planes[6];			// left, right, bottom, top, near, far
+
+	// planes of the frustum of a row vector view * projection matrix (D3D conventions, depth in [0, 1]).
+	static CullFrustum FromViewProj(const float viewProj[4][4]);
+};
+
+class SphereCullSet
+{
+public:
+	static const std::size_t Lanes = 8;
+
+	// count spheres, all outside until they are set.
+	void Resize(std::size_t count);
+	void Set(std::size_t i, float x, float y, float z, float radius)
+	{
+		mX[i] = x;
+		mY[i] = y;
+		mZ[i] = z;
+		mR[i] = radius;
+	}
+
+	std::size_t Size()const { return mCount; }
+	std::size_t PaddedSize()const { return mX.size(); }
+
+	const float* X()const { return mX.data(); }
+	const float* Y()const { return mY.data(); }
+	const float* Z()const { return mZ.data(); }
+	const float* R()const { return mR.data(); }
+
+private:
+	std::size_t mCount = 0;
+	std::vector<float> mX;
+	std::vector<float> mY;
+	std::vector<float> mZ;
+	std::vector<float> mR;
+};
+
+// writes the indices of the spheres intersecting the frustum, in increasing order, into visible and returns
+// how many there are.  visible has to hold PaddedSize() entries.
+std::uint32_t CullSpheres(const CullFrustum& frustum, const SphereCullSet& spheres, std::uint32_t* visible);
+
+// the same test on the spheres [first, first + count) of the set, for callers keeping groups of spheres
+// next to each other (SphereBvh leaves).  Writes their indices into visible, which has to hold count entries.
+std::uint32_t CullSphereRange(const CullFrustum& frustum, const SphereCullSet& spheres, std::size_t first, std::size_t count, std::uint32_t* visible);
+
+// the same test one sphere at a time, the reference the SIMD kernel is checked against.
+std::uint32_t CullSpheresScalar(const CullFrustum& frustum, const SphereCullSet& spheres, std::uint32_t* visible);
@@ -3,10 +3,28 @@
 //***************************************************************************************
 
 #include "GeometryGenerator.h"
+#include "MeshSubdivision.h"
 #include <algorithm>
 
 using namespace DirectX;
 
+// Calls fn(begin, end) over [0, count) in ranges of 16384, on the workers when there are enough of them.
+static void ForEachRange(WorkerPool* workers, std::uint32_t count, const std::function<void(std::uint32_t, std::uint32_t)>& fn)
+{
+	const std::uint32_t rangeSize = 16384;
+	std::uint32_t ranges = (count + rangeSize - 1) / rangeSize;
+	auto run = [&](std::uint32_t range) { fn(range * rangeSize, std::min(count, (range + 1) * rangeSize)); };
+	if(workers && workers->ThreadCount() > 1 && ranges > 1)
+	{
+		workers->Run(ranges, run);
+	}
+	else
+	{
+		for(std::uint32_t range = 0; range < ranges; ++range)
+			run(range);
+	}
+}
+
 GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float height, float depth, uint32 numSubdivisions)
 {
     MeshData meshData;
@@ -211,15 +229,8 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
     return meshData;
 }
  
-void GeometryGenerator::Subdivide(MeshData& meshData)
+void GeometryGenerator::Subdivide(MeshData& meshData, WorkerPool* workers)
 {
-	// Save a copy of the input geometry.
-	MeshData inputCopy = meshData;
-
-
-	meshData.Vertices.resize(0);
-	meshData.Indices32.resize(0);
-
 	//       v1
 	//       *
 	//      / \
@@ -230,48 +241,20 @@ void GeometryGenerator::Subdivide(MeshData& meshData)
 	// *-----*-----*
 	// v0    m2     v2
 
-	uint32 numTris = (uint32)inputCopy.Indices32.size()/3;
-	for(uint32 i = 0; i < numTris; ++i)
-	{
-		Vertex v0 = inputCopy.Vertices[ inputCopy.Indices32[i*3+0] ];
-		Vertex v1 = inputCopy.Vertices[ inputCopy.Indices32[i*3+1] ];
-		Vertex v2 = inputCopy.Vertices[ inputCopy.Indices32[i*3+2] ];
-
-		//
-		// Generate the midpoints.
-		//
-
-        Vertex m0 = MidPoint(v0, v1);
-        Vertex m1 = MidPoint(v1, v2);
-        Vertex m2 = MidPoint(v0, v2);
-
-		//
-		// Add new geometry.
-		//
-
-		meshData.Vertices.push_back(v0); // 0
-		meshData.Vertices.push_back(v1); // 1
-		meshData.Vertices.push_back(v2); // 2
-		meshData.Vertices.push_back(m0); // 3
-		meshData.Vertices.push_back(m1); // 4
-		meshData.Vertices.push_back(m2); // 5
- 
-		meshData.Indices32.push_back(i*6+0);
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+5);
+	// Triangles sharing an edge share its midpoint, which goes after the existing vertices.
+	std::vector<uint32> midpoints;
+	uint32 vertexCount = (uint32)meshData.Vertices.size();
+	SubdivideTriangles(meshData.Indices32, vertexCount, midpoints, workers);
 
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+4);
-		meshData.Indices32.push_back(i*6+5);
-
-		meshData.Indices32.push_back(i*6+5);
-		meshData.Indices32.push_back(i*6+4);
-		meshData.Indices32.push_back(i*6+2);
-
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+1);
-		meshData.Indices32.push_back(i*6+4);
-	}
+	uint32 midpointCount = (uint32)midpoints.size() / 2;
+	meshData.Vertices.resize(vertexCount + midpointCount);
+	ForEachRange(workers, midpointCount, [&](uint32 begin, uint32 end)
+	{
+		for(uint32 i = begin; i < end; ++i)
+		{
+			meshData.Vertices[vertexCount + i] = MidPoint(meshData.Vertices[midpoints[i*2]], meshData.Vertices[midpoints[i*2+1]]);
+		}
+	});
 }
 
 GeometryGenerator::Vertex GeometryGenerator::MidPoint(const Vertex& v0, const Vertex& v1)
@@ -304,12 +287,12 @@ GeometryGenerator::Vertex GeometryGenerator::MidPoint(const Vertex& v0, const Ve
     return v;
 }
 
-GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uint32 numSubdivisions)
+GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uint32 numSubdivisions, WorkerPool* workers)
 {
     MeshData meshData;
 
-	// Put a cap on the number of subdivisions.
-    numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
+	// Put a cap on the number of subdivisions, 8 gives 655362 vertices.
+    numSubdivisions = std::min<uint32>(numSubdivisions, 8u);
 
 	// Approximate a sphere by tessellating an icosahedron.
 
@@ -341,40 +324,43 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uin
 		meshData.Vertices[i].Position = pos[i];
 
 	for(uint32 i = 0; i < numSubdivisions; ++i)
-		Subdivide(meshData);
+		Subdivide(meshData, workers);
 
 	// Project vertices onto sphere and scale.
-	for(uint32 i = 0; i < meshData.Vertices.size(); ++i)
+	ForEachRange(workers, (uint32)meshData.Vertices.size(), [&](uint32 begin, uint32 end)
 	{
-		// Project onto unit sphere.
-		XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&meshData.Vertices[i].Position));
+		for(uint32 i = begin; i < end; ++i)
+		{
+			// Project onto unit sphere.
+			XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&meshData.Vertices[i].Position));
 
-		// Project onto sphere.
-		XMVECTOR p = radius*n;
+			// Project onto sphere.
+			XMVECTOR p = radius*n;
 
-		XMStoreFloat3(&meshData.Vertices[i].Position, p);
-		XMStoreFloat3(&meshData.Vertices[i].Normal, n);
+			XMStoreFloat3(&meshData.Vertices[i].Position, p);
+			XMStoreFloat3(&meshData.Vertices[i].Normal, n);
 
-		// Derive texture coordinates from spherical coordinates.
-        float theta = atan2f(meshData.Vertices[i].Position.z, meshData.Vertices[i].Position.x);
+			// Derive texture coordinates from spherical coordinates.
+	        float theta = atan2f(meshData.Vertices[i].Position.z, meshData.Vertices[i].Position.x);
 
-        // Put in [0, 2pi].
-        if(theta < 0.0f)
-            theta += XM_2PI;
+	        // Put in [0, 2pi].
+	        if(theta < 0.0f)
+	            theta += XM_2PI;
 
-		float phi = acosf(meshData.Vertices[i].Position.y / radius);
+			float phi = acosf(meshData.Vertices[i].Position.y / radius);
 
-		meshData.Vertices[i].TexC.x = theta/XM_2PI;
-		meshData.Vertices[i].TexC.y = phi/XM_PI;
+			meshData.Vertices[i].TexC.x = theta/XM_2PI;
+			meshData.Vertices[i].TexC.y = phi/XM_PI;
 
-		// Partial derivative of P with respect to theta
-		meshData.Vertices[i].TangentU.x = -radius*sinf(phi)*sinf(theta);
-		meshData.Vertices[i].TangentU.y = 0.0f;
-		meshData.Vertices[i].TangentU.z = +radius*sinf(phi)*cosf(theta);
+			// Partial derivative of P with respect to theta
+			meshData.Vertices[i].TangentU.x = -radius*sinf(phi)*sinf(theta);
+			meshData.Vertices[i].TangentU.y = 0.0f;
+			meshData.Vertices[i].TangentU.z = +radius*sinf(phi)*cosf(theta);
 
-		XMVECTOR T = XMLoadFloat3(&meshData.Vertices[i].TangentU);
-		XMStoreFloat3(&meshData.Vertices[i].TangentU, XMVector3Normalize(T));
-	}
+			XMVECTOR T = XMLoadFloat3(&meshData.Vertices[i].TangentU);
+			XMStoreFloat3(&meshData.Vertices[i].TangentU, XMVector3Normalize(T));
+		}
+	});
 
     return meshData;
 }
@@ -18,6 +18,8 @@
 #include <DirectXMath.h>
 #include <vector>
 
+class WorkerPool;
+
 class GeometryGenerator
 {
 public:
@@ -88,9 +90,10 @@ public:
 
 	///<summary>
 	/// Creates a geosphere centered at the origin with the given radius.  The
-	/// depth controls the level of tessellation.
+	/// depth controls the level of tessellation.  Large levels are split across
+	/// the workers when given.
 	///</summary>
-    MeshData CreateGeosphere(float radius, uint32 numSubdivisions);
+    MeshData CreateGeosphere(float radius, uint32 numSubdivisions, WorkerPool* workers = nullptr);
 
 	///<summary>
 	/// Creates a cylinder parallel to the y-axis, and centered about the origin.  
@@ -111,7 +114,7 @@ public:
     MeshData CreateQuad(float x, float y, float w, float h, float depth);
 
 private:
-	void Subdivide(MeshData& meshData);
+	void Subdivide(MeshData& meshData, WorkerPool* workers = nullptr);
     Vertex MidPoint(const Vertex& v0, const Vertex& v1);
     void BuildCylinderTopCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
     void BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
@@ -0,0 +1,123 @@
+// IndexPacking.cpp
+
+#include "IndexPacking.h"
+#include <algorithm>
+
+bool SplitIndices16(const std::vector<std::uint32_t>& indices, std::vector<std::uint16_t>& chunkIndices, std::vector<IndexRange>& chunks)
+{
+	chunkIndices.clear();
+	chunks.clear();
+	chunkIndices.reserve(indices.size());
+
+	// greedy : a chunk takes the next triangle as long as the vertices of both still fit one 16 bit span.
+	std::size_t chunkStart = 0;
+	std::uint32_t low = 0, high = 0;
+	auto closeChunk = [&](std::size_t end)
+	{
+		for (std::size_t i = chunkStart; i < end; ++i)
+		{
+			chunkIndices.push_back((std::uint16_t)(indices[i] - low));
+		}
+		chunks.push_back({ (std::uint32_t)chunkStart, (std::uint32_t)(end - chunkStart), (std::int32_t)low });
+		chunkStart = end;
+	};
+
+	for (std::size_t t = 0; t + 2 < indices.size(); t += 3)
+	{
+		std::uint32_t triangleLow = std::min(indices[t], std::min(indices[t + 1], indices[t + 2]));
+		std::uint32_t triangleHigh = std::max(indices[t], std::max(indices[t + 1], indices[t + 2]));
+		if (triangleHigh - triangleLow >= MaxIndices16Span)
+		{
+			chunkIndices.clear();
+			chunks.clear();
+			return false;
+		}
+
+		if (t == chunkStart)
+		{
+			low = triangleLow;
+			high = triangleHigh;
+		}
+		else if (std::max(high, triangleHigh) - std::min(low, triangleLow) < MaxIndices16Span)
+		{
+			low = std::min(low, triangleLow);
+			high = std::max(high, triangleHigh);
+		}
+		else
+		{
+			closeChunk(t);
+			low = triangleLow;
+			high = triangleHigh;
+		}
+	}
+	if (chunkStart < indices.size())
+	{
+		closeChunk(indices.size());
+	}
+	return true;
+}
+
+PackedIndices PackIndices(const std::vector<const std::vector<std::uint32_t>*>& meshes, const std::vector<std::uint32_t>& vertexCounts, bool prefer16Bit)
+{
+	PackedIndices packed;
+
+	// where each mesh lands, and whether any of them is out of reach of 16 bits.
+	std::uint32_t indexCount = 0;
+	std::int32_t baseVertex = 0;
+	bool fits16Bit = true;
+	for (std::size_t m = 0; m < meshes.size(); ++m)
+	{
+		const std::vector<std::uint32_t>& indices = *meshes[m];
+		packed.Meshes.push_back({ indexCount, (std::uint32_t)indices.size(), baseVertex });
+		indexCount += (std::uint32_t)indices.size();
+		baseVertex += (std::int32_t)vertexCounts[m];
+
+		std::uint32_t maxIndex = indices.empty() ? 0 : *std::max_element(indices.begin(), indices.end());
+		fits16Bit = fits16Bit && maxIndex < MaxIndices16Span;
+	}
+
+	// the oversize meshes are split, unless 32 bits are preferred or one of them can't be.
+	std::vector<std::vector<std::uint16_t>> split(meshes.size());
+	std::vector<std::vector<IndexRange>> splitChunks(meshes.size());
+	packed.Wide = !fits16Bit && !prefer16Bit;
+	for (std::size_t m = 0; m < meshes.size() && !fits16Bit && !packed.Wide; ++m)
+	{
+		const std::vector<std::uint32_t>& indices = *meshes[m];
+		bool oversize = std::any_of(indices.begin(), indices.end(), [](std::uint32_t index) { return index >= MaxIndices16Span; });
+		if (oversize && !SplitIndices16(indices, split[m], splitChunks[m]))
+		{
+			packed.Wide = true;
+		}
+	}
+
+	if (packed.Wide)
+	{
+		packed.Indices32.reserve(indexCount);
+		for (const auto* indices : meshes)
+		{
+			packed.Indices32.insert(packed.Indices32.end(), indices->begin(), indices->end());
+		}
+		return packed;
+	}
+
+	packed.Indices16.reserve(indexCount);
+	for (std::size_t m = 0; m < meshes.size(); ++m)
+	{
+		const IndexRange& mesh = packed.Meshes[m];
+		if (splitChunks[m].empty())
+		{
+			for (std::uint32_t index : *meshes[m])
+			{
+				packed.Indices16.push_back((std::uint16_t)index);
+			}
+			continue;
+		}
+
+		packed.Indices16.insert(packed.Indices16.end(), split[m].begin(), split[m].end());
+		for (const IndexRange& chunk : splitChunks[m])
+		{
+			packed.Chunks.push_back({ mesh.StartIndex + chunk.StartIndex, chunk.IndexCount, mesh.BaseVertex + chunk.BaseVertex });
+		}
+	}
+	return packed;
+}
@@ -0,0 +1,47 @@
+// IndexPacking.h : packs the 32 bit indices of the meshes sharing one vertex buffer into one index buffer,
+// 16 bit wide when that can address them.
+//
+// A mesh indexes its own vertices, its draws add the position of its first vertex as BaseVertexLocation, so
+// 16 bits only run out for a mesh of more than 65536 vertices, whatever the size of the whole buffer.  For
+// such a mesh PackIndices either
+//   - splits it into chunks of consecutive triangles whose vertices span 65536 at most, each drawn with its
+//     own BaseVertexLocation and indices relative to it (prefer16Bit, the default : half the index
+//     bandwidth for a few more draws), or
+//   - makes the whole buffer 32 bit.
+// A single triangle spanning more than 65536 vertices can't be chunked, its buffer falls back to 32 bit.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// the arguments of one DrawIndexedInstanced.
+struct IndexRange
+{
+	std::uint32_t StartIndex;
+	std::uint32_t IndexCount;
+	std::int32_t BaseVertex;
+};
+
+struct PackedIndices
+{
+	bool Wide = false;							// DXGI_FORMAT_R32_UINT in Indices32, else R16_UINT in Indices16
+	std::vector<std::uint16_t> Indices16;
+	std::vector<std::uint32_t> Indices32;
+	std::vector<IndexRange> Meshes;				// one per mesh, BaseVertex its first vertex
+	std::vector<IndexRange> Chunks;				// the pieces of the meshes that were split, in index order
+
+	const void* Data()const { return Wide ? (const void*)Indices32.data() : (const void*)Indices16.data(); }
+	std::size_t ByteSize()const { return Wide ? Indices32.size() * 4 : Indices16.size() * 2; }
+};
+
+const std::uint32_t MaxIndices16Span = 65536;		// vertices one 16 bit chunk can address
+
+// meshes[i] holds triangle list indices into its vertexCounts[i] vertices, which follow those of mesh i - 1.
+PackedIndices PackIndices(const std::vector<const std::vector<std::uint32_t>*>& meshes, const std::vector<std::uint32_t>& vertexCounts,
+	bool prefer16Bit = true);
+
+// splits one mesh into chunks addressable with 16 bits, relative to the mesh.  False when a triangle spans
+// too many vertices for any chunk.
+bool SplitIndices16(const std::vector<std::uint32_t>& indices, std::vector<std::uint16_t>& chunkIndices, std::vector<IndexRange>& chunks);
@@ -0,0 +1,278 @@
+// MeshCache.cpp
+
+#include "MeshCache.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	std::uint64_t Align(std::uint64_t offset)
+	{
+		return (offset + MeshCacheAlignment - 1) / MeshCacheAlignment * MeshCacheAlignment;
+	}
+
+	// where the tables go, the payloads follow from PayloadStart.
+	struct TableLayout
+	{
+		std::uint64_t Geometries;
+		std::uint64_t Submeshes;
+		std::uint64_t Chunks;
+		std::uint64_t PayloadStart;
+
+		TableLayout(std::uint64_t geometryCount, std::uint64_t submeshCount, std::uint64_t chunkCount)
+		{
+			Geometries = Align(sizeof(MeshCacheHeader));
+			Submeshes = Align(Geometries + geometryCount * sizeof(MeshCacheGeometry));
+			Chunks = Align(Submeshes + submeshCount * sizeof(MeshCacheSubmesh));
+			PayloadStart = Align(Chunks + chunkCount * sizeof(MeshCacheChunk));
+		}
+	};
+
+	bool Terminated(const char (&name)[32])
+	{
+		return std::memchr(name, 0, sizeof(name)) != nullptr;
+	}
+
+	void WritePadding(std::ofstream& fout, std::uint64_t& offset, std::uint64_t to)
+	{
+		static const char zeros[MeshCacheAlignment] = {};
+		fout.write(zeros, (std::streamsize)(to - offset));
+		offset = to;
+	}
+}
+
+std::uint64_t MeshCacheHash(const void* data, std::size_t size, std::uint64_t hash)
+{
+	const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+	for (std::size_t i = 0; i < size; ++i)
+	{
+		hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+	}
+	return hash;
+}
+
+bool WriteMeshCache(const std::string& filename, std::uint64_t key, const std::vector<MeshCacheEntry>& geometries)
+{
+	// the tables first, with every offset known before anything is written.
+	MeshCacheHeader header = {};
+	header.FileMagic = MeshCacheHeader::Magic;
+	header.FileVersion = MeshCacheHeader::Version;
+	header.Key = key;
+	header.GeometryCount = (std::uint32_t)geometries.size();
+
+	std::vector<MeshCacheGeometry> table;
+	std::vector<MeshCacheSubmesh> submeshes;
+	std::vector<MeshCacheChunk> chunks;
+	for (const MeshCacheEntry& entry : geometries)
+	{
+		MeshCacheGeometry geometry = entry.Geometry;
+		geometry.FirstSubmesh = (std::uint32_t)submeshes.size();
+		geometry.SubmeshCount = (std::uint32_t)entry.Submeshes.size();
+		geometry.FirstChunk = (std::uint32_t)chunks.size();
+		geometry.ChunkCount = (std::uint32_t)entry.Chunks.size();
+		submeshes.insert(submeshes.end(), entry.Submeshes.begin(), entry.Submeshes.end());
+		chunks.insert(chunks.end(), entry.Chunks.begin(), entry.Chunks.end());
+		table.push_back(geometry);
+	}
+	header.SubmeshCount = (std::uint32_t)submeshes.size();
+	header.ChunkCount = (std::uint32_t)chunks.size();
+
+	TableLayout layout(table.size(), submeshes.size(), chunks.size());
+	std::uint64_t payload = layout.PayloadStart;
+	for (MeshCacheGeometry& geometry : table)
+	{
+		geometry.VertexOffset = payload;
+		payload = Align(payload + geometry.VertexByteSize);
+		geometry.IndexOffset = payload;
+		payload = Align(payload + geometry.IndexByteSize);
+	}
+	header.FileSize = payload;
+
+	std::ofstream fout(filename, std::ios::binary | std::ios::trunc);
+	if (!fout)
+	{
+		return false;
+	}
+
+	std::uint64_t offset = 0;
+	fout.write((const char*)&header, sizeof(header));
+	offset += sizeof(header);
+
+	WritePadding(fout, offset, layout.Geometries);
+	fout.write((const char*)table.data(), (std::streamsize)(table.size() * sizeof(MeshCacheGeometry)));
+	offset += table.size() * sizeof(MeshCacheGeometry);
+
+	WritePadding(fout, offset, layout.Submeshes);
+	fout.write((const char*)submeshes.data(), (std::streamsize)(submeshes.size() * sizeof(MeshCacheSubmesh)));
+	offset += submeshes.size() * sizeof(MeshCacheSubmesh);
+
+	WritePadding(fout, offset, layout.Chunks);
+	fout.write((const char*)chunks.data(), (std::streamsize)(chunks.size() * sizeof(MeshCacheChunk)));
+	offset += chunks.size() * sizeof(MeshCacheChunk);
+
+	for (std::size_t i = 0; i < table.size(); ++i)
+	{
+		WritePadding(fout, offset, table[i].VertexOffset);
+		fout.write((const char*)geometries[i].Vertices, (std::streamsize)table[i].VertexByteSize);
+		offset += table[i].VertexByteSize;
+
+		WritePadding(fout, offset, table[i].IndexOffset);
+		fout.write((const char*)geometries[i].Indices, (std::streamsize)table[i].IndexByteSize);
+		offset += table[i].IndexByteSize;
+	}
+	WritePadding(fout, offset, header.FileSize);
+
+	fout.close();
+	if (!fout)
+	{
+		std::remove(filename.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool MeshCacheFile::Open(const std::string& filename, std::uint64_t key)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	LARGE_INTEGER size = {};
+	HANDLE mapping = nullptr;
+	if (GetFileSizeEx(file, &size) && size.QuadPart >= (LONGLONG)sizeof(MeshCacheHeader))
+	{
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	}
+	if (mapping)
+	{
+		mData = static_cast<const std::uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		mSize = mData ? (std::size_t)size.QuadPart : 0;
+		CloseHandle(mapping);
+	}
+	CloseHandle(file);
+#else
+	int file = open(filename.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		return false;
+	}
+	struct stat status = {};
+	if (fstat(file, &status) == 0 && status.st_size >= (off_t)sizeof(MeshCacheHeader))
+	{
+		void* view = mmap(nullptr, (std::size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (view != MAP_FAILED)
+		{
+			mData = static_cast<const std::uint8_t*>(view);
+			mSize = (std::size_t)status.st_size;
+		}
+	}
+	close(file);
+#endif
+
+	if (mData && !Validate(key))
+	{
+		Close();
+	}
+	return mData != nullptr;
+}
+
+void MeshCacheFile::Close()
+{
+	if (mData)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(mData);
+#else
+		munmap(const_cast<std::uint8_t*>(mData), mSize);
+#endif
+	}
+	mData = nullptr;
+	mSize = 0;
+}
+
+bool MeshCacheFile::Validate(std::uint64_t key)const
+{
+	const MeshCacheHeader& header = Header();
+	if (header.FileMagic != MeshCacheHeader::Magic || header.FileVersion != MeshCacheHeader::Version || header.Key != key ||
+		header.FileSize != mSize)
+	{
+		return false;
+	}
+
+	TableLayout layout(header.GeometryCount, header.SubmeshCount, header.ChunkCount);
+	if (layout.PayloadStart > mSize)
+	{
+		return false;
+	}
+
+	// every range inside the file and its tables, so a hit never reads out of bounds.
+	for (std::uint32_t i = 0; i < header.GeometryCount; ++i)
+	{
+		const MeshCacheGeometry& geometry = Geometries()[i];
+		if (!Terminated(geometry.Name) || (geometry.IndexBits != 16 && geometry.IndexBits != 32) ||
+			(std::uint64_t)geometry.FirstSubmesh + geometry.SubmeshCount > header.SubmeshCount ||
+			(std::uint64_t)geometry.FirstChunk + geometry.ChunkCount > header.ChunkCount ||
+			geometry.VertexOffset < layout.PayloadStart || geometry.VertexOffset > mSize || geometry.VertexByteSize > mSize - geometry.VertexOffset ||
+			geometry.IndexOffset < layout.PayloadStart || geometry.IndexOffset > mSize || geometry.IndexByteSize > mSize - geometry.IndexOffset)
+		{
+			return false;
+		}
+		const MeshCacheSubmesh* submeshes = Submeshes(geometry);
+		for (std::uint32_t s = 0; s < geometry.SubmeshCount; ++s)
+		{
+			if (!Terminated(submeshes[s].Name))
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+const MeshCacheGeometry* MeshCacheFile::Geometries()const
+{
+	return reinterpret_cast<const MeshCacheGeometry*>(mData + TableLayout(0, 0, 0).Geometries);
+}
+
+const MeshCacheGeometry* MeshCacheFile::FindGeometry(const std::string& name)const
+{
+	for (std::uint32_t i = 0; i < GeometryCount(); ++i)
+	{
+		if (name == Geometry(i).Name)
+		{
+			return &Geometry(i);
+		}
+	}
+	return nullptr;
+}
+
+const MeshCacheSubmesh* MeshCacheFile::Submeshes(const MeshCacheGeometry& geometry)const
+{
+	const MeshCacheHeader& header = Header();
+	TableLayout layout(header.GeometryCount, header.SubmeshCount, header.ChunkCount);
+	return reinterpret_cast<const MeshCacheSubmesh*>(mData + layout.Submeshes) + geometry.FirstSubmesh;
+}
+
+const MeshCacheChunk* MeshCacheFile::Chunks(const MeshCacheGeometry& geometry)const
+{
+	const MeshCacheHeader& header = Header();
+	TableLayout layout(header.GeometryCount, header.SubmeshCount, header.ChunkCount);
+	return reinterpret_cast<const MeshCacheChunk*>(mData + layout.Chunks) + geometry.FirstChunk;
+}
@@ -0,0 +1,123 @@
+// MeshCache.h : a versioned binary file of geometry ready for upload, so startup can skip generating it.
+//
+// file layout, little endian, every table and payload starting on a MeshCacheAlignment boundary :
+//   MeshCacheHeader | MeshCacheGeometry[GeometryCount] | MeshCacheSubmesh[SubmeshCount]
+//   | MeshCacheChunk[ChunkCount] | per geometry : vertex buffer, index buffer
+// A geometry is one vertex and one index buffer as BuildGeometry makes them, its submeshes and the 16 bit
+// chunks of those (IndexPacking.h) are ranges of its own tables.
+//
+// Key identifies what the file was generated from : a file with another key, another Version, or whose
+// size or tables don't match its header is a miss, and the caller generates the geometry and writes it
+// again.  MeshCacheFile maps the file read only and hands out pointers into the mapping, so a hit copies
+// the payloads from the page cache straight into upload memory.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+const std::uint32_t MeshCacheAlignment = 256;
+
+struct MeshCacheHeader
+{
+	static const std::uint32_t Magic = 0x4348534D;		// "MSHC"
+	static const std::uint32_t Version = 1;
+
+	std::uint32_t FileMagic;
+	std::uint32_t FileVersion;
+	std::uint64_t Key;
+	std::uint64_t FileSize;
+	std::uint32_t GeometryCount;
+	std::uint32_t SubmeshCount;
+	std::uint32_t ChunkCount;
+	std::uint32_t Pad;
+};
+
+const std::uint32_t MeshCacheCompactVertices = 1;		// MeshCacheGeometry::Flags : CompactVertex instead of Vertex
+
+struct MeshCacheGeometry
+{
+	char Name[32];
+	std::uint32_t VertexByteStride;
+	std::uint32_t IndexBits;			// 16 or 32
+	std::uint32_t Flags;
+	std::uint32_t FirstSubmesh;
+	std::uint32_t SubmeshCount;
+	std::uint32_t FirstChunk;
+	std::uint32_t ChunkCount;
+	std::uint32_t Pad;
+	std::uint64_t VertexOffset;			// byte offsets from the start of the file
+	std::uint64_t VertexByteSize;
+	std::uint64_t IndexOffset;
+	std::uint64_t IndexByteSize;
+};
+
+struct MeshCacheSubmesh
+{
+	char Name[32];
+	std::uint32_t IndexCount;
+	std::uint32_t StartIndex;
+	std::int32_t BaseVertex;
+	float Center[3];					// object space bounding box
+	float Extents[3];
+	std::uint32_t Pad;
+};
+
+struct MeshCacheChunk
+{
+	std::uint32_t IndexCount;
+	std::uint32_t StartIndex;
+	std::int32_t BaseVertex;
+};
+
+// FNV-1a, for building keys out of the settings the geometry depends on.
+const std::uint64_t MeshCacheHashSeed = 0xcbf29ce484222325ull;
+std::uint64_t MeshCacheHash(const void* data, std::size_t size, std::uint64_t hash = MeshCacheHashSeed);
+
+// one geometry to write.  Name, VertexByteStride, IndexBits, Flags, VertexByteSize and IndexByteSize are
+// the caller's, WriteMeshCache fills in the offsets and table ranges.
+struct MeshCacheEntry
+{
+	MeshCacheGeometry Geometry = {};
+	std::vector<MeshCacheSubmesh> Submeshes;
+	std::vector<MeshCacheChunk> Chunks;
+	const void* Vertices = nullptr;
+	const void* Indices = nullptr;
+};
+
+// returns false when the file could not be written, in which case none is left behind.
+bool WriteMeshCache(const std::string& filename, std::uint64_t key, const std::vector<MeshCacheEntry>& geometries);
+
+class MeshCacheFile
+{
+public:
+	MeshCacheFile() = default;
+	MeshCacheFile(const MeshCacheFile& rhs) = delete;
+	MeshCacheFile& operator=(const MeshCacheFile& rhs) = delete;
+	~MeshCacheFile() { Close(); }
+
+	// maps the file, false when it is missing, has another key or version, or is malformed.
+	bool Open(const std::string& filename, std::uint64_t key);
+	void Close();
+	bool IsOpen()const { return mData != nullptr; }
+
+	std::uint32_t GeometryCount()const { return Header().GeometryCount; }
+	const MeshCacheGeometry& Geometry(std::uint32_t i)const { return Geometries()[i]; }
+	const MeshCacheGeometry* FindGeometry(const std::string& name)const;
+
+	const MeshCacheSubmesh* Submeshes(const MeshCacheGeometry& geometry)const;
+	const MeshCacheChunk* Chunks(const MeshCacheGeometry& geometry)const;
+	const void* Vertices(const MeshCacheGeometry& geometry)const { return mData + geometry.VertexOffset; }
+	const void* Indices(const MeshCacheGeometry& geometry)const { return mData + geometry.IndexOffset; }
+
+private:
+	const MeshCacheHeader& Header()const { return *reinterpret_cast<const MeshCacheHeader*>(mData); }
+	const MeshCacheGeometry* Geometries()const;
+	bool Validate(std::uint64_t key)const;
+
+private:
+	const std::uint8_t* mData = nullptr;		// the view of the whole file, which outlives the handles that made it
+	std::size_t mSize = 0;
+};
@@ -0,0 +1,399 @@
+// MeshOptimizer.cpp
+
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// Forsyth's scoring, tuned for an LRU cache of 32 entries.
+	const int LruCacheSize = 32;
+	const float CacheDecayPower = 1.5f;
+	const float LastTriangleScore = 0.75f;
+	const float ValenceBoostScale = 2.0f;
+	const float ValenceBoostPower = 0.5f;
+
+	float VertexScore(int cachePosition, std::uint32_t remainingTriangles)
+	{
+		if (remainingTriangles == 0)
+		{
+			return -1.0f;		// nothing left to draw with this vertex
+		}
+
+		float score = 0.0f;
+		if (cachePosition >= 0)
+		{
+			if (cachePosition < 3)
+			{
+				// the vertices of the last triangle get a fixed score, so it isn't used again right away.
+				score = LastTriangleScore;
+			}
+			else
+			{
+				score = std::pow(1.0f - (cachePosition - 3) / float(LruCacheSize - 3), CacheDecayPower);
+			}
+		}
+
+		// favour vertices with few triangles left, so lone triangles don't get stranded.
+		return score + ValenceBoostScale * std::pow((float)remainingTriangles, -ValenceBoostPower);
+	}
+
+	// the triangles using each vertex, in one array.
+	struct Adjacency
+	{
+		std::vector<std::uint32_t> Counts;
+		std::vector<std::uint32_t> Offsets;
+		std::vector<std::uint32_t> Triangles;
+
+		Adjacency(const std::vector<std::uint32_t>& indices, std::size_t vertexCount)
+			: Counts(vertexCount, 0), Offsets(vertexCount, 0), Triangles(indices.size())
+		{
+			for (std::uint32_t index : indices)
+			{
+				++Counts[index];
+			}
+			std::uint32_t offset = 0;
+			for (std::size_t v = 0; v < vertexCount; ++v)
+			{
+				Offsets[v] = offset;
+				offset += Counts[v];
+			}
+
+			std::vector<std::uint32_t> filled(vertexCount, 0);
+			for (std::size_t i = 0; i < indices.size(); ++i)
+			{
+				std::uint32_t v = indices[i];
+				Triangles[Offsets[v] + filled[v]++] = (std::uint32_t)(i / 3);
+			}
+		}
+	};
+
+	// x, y, z of a vertex.
+	const float* Position(const float* positions, std::size_t stride, std::uint32_t vertex)
+	{
+		return reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + vertex * stride);
+	}
+
+	// FIFO cache simulation, one entry per vertex with the time it entered the cache.
+	class FifoCache
+	{
+	public:
+		FifoCache(std::size_t vertexCount, std::uint32_t size) : mSize(size), mEntered(vertexCount, 0) {}
+
+		// a fresh cache, without clearing the table.
+		void Flush() { mTime += mSize + 1; }
+
+		// true when the vertex had to be transformed.
+		bool Use(std::uint32_t vertex)
+		{
+			if (mEntered[vertex] != 0 && mTime - mEntered[vertex] < mSize)
+			{
+				return false;
+			}
+			mEntered[vertex] = ++mTime;
+			return true;
+		}
+
+	private:
+		std::uint32_t mSize;
+		std::vector<std::uint64_t> mEntered;
+		std::uint64_t mTime = mSize + 1;
+	};
+}
+
+VertexCacheStats AnalyzeVertexCache(const std::vector<std::uint32_t>& indices, std::size_t vertexCount, std::uint32_t cacheSize)
+{
+	VertexCacheStats stats;
+	FifoCache cache(vertexCount, cacheSize);
+	std::vector<char> referenced(vertexCount, 0);
+	std::size_t referencedCount = 0;
+	for (std::uint32_t index : indices)
+	{
+		stats.Transforms += cache.Use(index) ? 1 : 0;
+		referencedCount += referenced[index] ? 0 : 1;
+		referenced[index] = 1;
+	}
+
+	std::size_t triangleCount = indices.size() / 3;
+	stats.Acmr = triangleCount > 0 ? stats.Transforms / float(triangleCount) : 0.0f;
+	stats.Atvr = referencedCount > 0 ? stats.Transforms / float(referencedCount) : 0.0f;
+	return stats;
+}
+
+void OptimizeVertexCache(std::vector<std::uint32_t>& indices, std::size_t vertexCount)
+{
+	std::size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// Counts is the number of triangles still to draw with each vertex, its first Counts triangles are them.
+	Adjacency adjacency(indices, vertexCount);
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (std::size_t v = 0; v < vertexCount; ++v)
+	{
+		vertexScore[v] = VertexScore(-1, adjacency.Counts[v]);
+	}
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<char> emitted(triangleCount, 0);
+	for (std::size_t t = 0; t < triangleCount; ++t)
+	{
+		triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+	}
+
+	// the cache holds 3 more entries while the new triangle pushes the oldest ones out.
+	std::vector<std::uint32_t> cache, nextCache;
+	cache.reserve(LruCacheSize + 3);
+	nextCache.reserve(LruCacheSize + 3);
+
+	std::vector<std::uint32_t> optimized;
+	optimized.reserve(indices.size());
+
+	std::size_t best = std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin();
+	std::size_t deadEndCursor = 0;
+	for (std::size_t drawn = 0; drawn < triangleCount; ++drawn)
+	{
+		// nothing in the cache has triangles left : the next triangle in input order starts a new run.
+		if (best == triangleCount)
+		{
+			while (emitted[deadEndCursor])
+			{
+				++deadEndCursor;
+			}
+			best = deadEndCursor;
+		}
+
+		const std::uint32_t* triangle = &indices[best * 3];
+		optimized.insert(optimized.end(), triangle, triangle + 3);
+		emitted[best] = 1;
+
+		// take the triangle out of the lists of its vertices.
+		for (int k = 0; k < 3; ++k)
+		{
+			std::uint32_t v = triangle[k];
+			std::uint32_t* first = &adjacency.Triangles[adjacency.Offsets[v]];
+			std::uint32_t* last = first + adjacency.Counts[v] - 1;
+			std::swap(*std::find(first, last + 1, (std::uint32_t)best), *last);
+			--adjacency.Counts[v];
+		}
+
+		// the triangle's vertices move to the front of the cache, the others keep their order.
+		nextCache.assign(triangle, triangle + 3);
+		for (std::uint32_t v : cache)
+		{
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+			{
+				nextCache.push_back(v);
+			}
+		}
+		for (std::size_t i = 0; i < nextCache.size(); ++i)
+		{
+			cachePosition[nextCache[i]] = i < (std::size_t)LruCacheSize ? (int)i : -1;
+		}
+
+		// new scores for everything in the cache and what just left it, and the best triangle among them.
+		best = triangleCount;
+		float bestScore = -1.0f;
+		for (std::uint32_t v : nextCache)
+		{
+			float score = VertexScore(cachePosition[v], adjacency.Counts[v]);
+			float change = score - vertexScore[v];
+			vertexScore[v] = score;
+
+			const std::uint32_t* triangles = &adjacency.Triangles[adjacency.Offsets[v]];
+			for (std::uint32_t i = 0; i < adjacency.Counts[v]; ++i)
+			{
+				std::uint32_t t = triangles[i];
+				triangleScore[t] += change;
+				if (triangleScore[t] > bestScore)
+				{
+					bestScore = triangleScore[t];
+					best = t;
+				}
+			}
+		}
+
+		if (nextCache.size() > (std::size_t)LruCacheSize)
+		{
+			nextCache.resize(LruCacheSize);
+		}
+		cache.swap(nextCache);
+	}
+
+	indices.swap(optimized);
+}
+
+void OptimizeOverdraw(std::vector<std::uint32_t>& indices, const float* positions, std::size_t stride, std::size_t vertexCount,
+	float threshold)
+{
+	std::size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// hard boundaries : triangles whose three vertices all miss the cache start a new run.
+	std::vector<std::size_t> hardStarts;
+	FifoCache cache(vertexCount, VertexCacheSize);
+	for (std::size_t t = 0; t < triangleCount; ++t)
+	{
+		int misses = 0;
+		for (int k = 0; k < 3; ++k)
+		{
+			misses += cache.Use(indices[t * 3 + k]) ? 1 : 0;
+		}
+		if (t == 0 || misses == 3)
+		{
+			hardStarts.push_back(t);
+		}
+	}
+	hardStarts.push_back(triangleCount);
+
+	// soft boundaries : a run is cut again wherever the part since the last cut is already as cache
+	// efficient as the whole run, with the cache starting cold at the cut.
+	std::vector<std::size_t> clusterStarts;
+	for (std::size_t run = 0; run + 1 < hardStarts.size(); ++run)
+	{
+		std::size_t begin = hardStarts[run], end = hardStarts[run + 1];
+
+		cache.Flush();
+		std::uint32_t runMisses = 0;
+		for (std::size_t i = begin * 3; i < end * 3; ++i)
+		{
+			runMisses += cache.Use(indices[i]) ? 1 : 0;
+		}
+		float target = threshold * runMisses / float(end - begin);
+
+		cache.Flush();
+		clusterStarts.push_back(begin);
+		std::uint32_t misses = 0;
+		std::size_t clusterStart = begin;
+		for (std::size_t t = begin; t < end; ++t)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				misses += cache.Use(indices[t * 3 + k]) ? 1 : 0;
+			}
+			if (t + 1 < end && misses / float(t + 1 - clusterStart) <= target)
+			{
+				clusterStarts.push_back(t + 1);
+				clusterStart = t + 1;
+				misses = 0;
+				cache.Flush();
+			}
+		}
+	}
+	clusterStarts.push_back(triangleCount);
+
+	// the area weighted centroid of the mesh.
+	double meshCenter[3] = { 0.0, 0.0, 0.0 };
+	double meshArea = 0.0;
+	std::vector<float> triangleData(triangleCount * 7);		// centroid, area weighted normal, area
+	for (std::size_t t = 0; t < triangleCount; ++t)
+	{
+		const float* p0 = Position(positions, stride, indices[t * 3]);
+		const float* p1 = Position(positions, stride, indices[t * 3 + 1]);
+		const float* p2 = Position(positions, stride, indices[t * 3 + 2]);
+		float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+		float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+		float area = 0.5f * std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+		float* data = &triangleData[t * 7];
+		for (int k = 0; k < 3; ++k)
+		{
+			data[k] = (p0[k] + p1[k] + p2[k]) / 3.0f;
+			data[3 + k] = n[k];
+			meshCenter[k] += data[k] * area;
+		}
+		data[6] = area;
+		meshArea += area;
+	}
+	for (int k = 0; k < 3; ++k)
+	{
+		meshCenter[k] = meshArea > 0.0 ? meshCenter[k] / meshArea : 0.0;
+	}
+
+	// clusters far out along their own normal occlude the others from most directions, they go first.
+	std::size_t clusterCount = clusterStarts.size() - 1;
+	std::vector<float> sortKeys(clusterCount);
+	std::vector<std::uint32_t> order(clusterCount);
+	for (std::size_t c = 0; c < clusterCount; ++c)
+	{
+		double center[3] = { 0.0, 0.0, 0.0 }, normal[3] = { 0.0, 0.0, 0.0 };
+		double area = 0.0;
+		for (std::size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; ++t)
+		{
+			const float* data = &triangleData[t * 7];
+			for (int k = 0; k < 3; ++k)
+			{
+				center[k] += data[k] * data[6];
+				normal[k] += data[3 + k];
+			}
+			area += data[6];
+		}
+
+		double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		double key = 0.0;
+		for (int k = 0; k < 3 && area > 0.0 && length > 0.0; ++k)
+		{
+			key += (center[k] / area - meshCenter[k]) * normal[k] / length;
+		}
+		sortKeys[c] = (float)key;
+		order[c] = (std::uint32_t)c;
+	}
+	std::stable_sort(order.begin(), order.end(), [&sortKeys](std::uint32_t a, std::uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<std::uint32_t> sorted;
+	sorted.reserve(indices.size());
+	for (std::uint32_t c : order)
+	{
+		sorted.insert(sorted.end(), indices.begin() + clusterStarts[c] * 3, indices.begin() + clusterStarts[c + 1] * 3);
+	}
+	indices.swap(sorted);
+}
+
+std::vector<std::uint32_t> OptimizeVertexFetch(std::vector<std::uint32_t>& indices, std::size_t vertexCount)
+{
+	const std::uint32_t unused = ~0u;
+	std::vector<std::uint32_t> remap(vertexCount, unused);
+	std::uint32_t next = 0;
+	for (std::uint32_t& index : indices)
+	{
+		if (remap[index] == unused)
+		{
+			remap[index] = next++;
+		}
+		index = remap[index];
+	}
+	for (std::uint32_t& slot : remap)
+	{
+		if (slot == unused)
+		{
+			slot = next++;
+		}
+	}
+	return remap;
+}
+
+MeshOptimizeStats OptimizeMesh(std::vector<std::uint32_t>& indices, const float* positions, std::size_t stride,
+	std::size_t vertexCount, std::vector<std::uint32_t>& remap)
+{
+	MeshOptimizeStats stats;
+	stats.Before = AnalyzeVertexCache(indices, vertexCount);
+
+	// small meshes the cache already holds most of may do better in their own order.
+	std::vector<std::uint32_t> optimized = indices;
+	OptimizeVertexCache(optimized, vertexCount);
+	OptimizeOverdraw(optimized, positions, stride, vertexCount);
+	if (AnalyzeVertexCache(optimized, vertexCount).Transforms < stats.Before.Transforms)
+	{
+		indices.swap(optimized);
+	}
+	remap = OptimizeVertexFetch(indices, vertexCount);
+	stats.After = AnalyzeVertexCache(indices, vertexCount);
+	return stats;
+}
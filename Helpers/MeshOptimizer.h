@@ -0,0 +1,68 @@
+// MeshOptimizer.h : reorders indexed triangle lists for the GPU's post-transform vertex cache, for overdraw
+// and for vertex fetch locality.
+//
+// The stages run in this order, each keeping what the previous one gained :
+//   - OptimizeVertexCache orders the triangles with Forsyth's linear speed algorithm : a simulated LRU cache
+//     scores each vertex by its cache position and by how few triangles still use it, and the triangle with
+//     the best score among those touching the cache is emitted next,
+//   - OptimizeOverdraw cuts that order into clusters where the cache runs cold (Sander, Nehab and Barczak),
+//     and sorts the clusters so the ones facing out from the middle of the mesh are drawn first.  It is view
+//     independent, a cluster only moves as a whole, so the cache efficiency stays within the threshold,
+//   - OptimizeVertexFetch renumbers the vertices in the order the indices first use them.
+// None of them changes a triangle or its winding, only the order of the triangles and of the vertices.
+//
+// ACMR is the average number of vertex shader runs per triangle and ATVR per vertex, 1.0 being the best
+// possible, on a FIFO cache of VertexCacheSize entries.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct VertexCacheStats
+{
+	std::uint32_t Transforms = 0;	// vertex shader runs
+	float Acmr = 0.0f;				// transforms per triangle
+	float Atvr = 0.0f;				// transforms per vertex referenced by the indices
+};
+
+struct MeshOptimizeStats
+{
+	VertexCacheStats Before;
+	VertexCacheStats After;
+};
+
+const std::uint32_t VertexCacheSize = 16;
+
+VertexCacheStats AnalyzeVertexCache(const std::vector<std::uint32_t>& indices, std::size_t vertexCount,
+	std::uint32_t cacheSize = VertexCacheSize);
+
+// reorders the triangles of indices, a triangle list over vertexCount vertices.
+void OptimizeVertexCache(std::vector<std::uint32_t>& indices, std::size_t vertexCount);
+
+// reorders clusters of triangles of a vertex cache optimized list.  positions points at the x, y, z floats of
+// the first vertex, stride bytes apart.  A cluster ends wherever its own ACMR falls under threshold times the
+// ACMR of the run it is cut from, so the larger the threshold the finer the sort and the worse the cache.
+void OptimizeOverdraw(std::vector<std::uint32_t>& indices, const float* positions, std::size_t stride, std::size_t vertexCount,
+	float threshold = 1.05f);
+
+// renumbers the vertices in the order the indices first use them, unused ones last, and rewrites the indices.
+// Returns the new index of every vertex, vertices[remap[i]] = old vertices[i] with RemapVertices.
+std::vector<std::uint32_t> OptimizeVertexFetch(std::vector<std::uint32_t>& indices, std::size_t vertexCount);
+
+template<typename Vertex>
+void RemapVertices(std::vector<Vertex>& vertices, const std::vector<std::uint32_t>& remap)
+{
+	std::vector<Vertex> remapped(vertices.size());
+	for (std::size_t i = 0; i < vertices.size(); ++i)
+	{
+		remapped[remap[i]] = vertices[i];
+	}
+	vertices.swap(remapped);
+}
+
+// the three stages in a row, with the cache efficiency before and after.  The triangle order is only
+// changed when it transforms fewer vertices.  The vertices still have to be remapped with remap.
+MeshOptimizeStats OptimizeMesh(std::vector<std::uint32_t>& indices, const float* positions, std::size_t stride,
+	std::size_t vertexCount, std::vector<std::uint32_t>& remap);
@@ -0,0 +1,892 @@
+// MeshSimplifier.cpp
+
+#include "MeshSimplifier.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace
+{
+	const std::uint32_t None = ~0u;
+	const float EdgeWeight = 10.0f;			// planes across border and seam edges, against the area of the triangles
+	const float MinNormalCosine = 0.5f;		// a triangle's normal may turn this far in a collapse, no further
+	const float MinCornerCosine = 0.7f;		// a border or seam turning more than this at a vertex has a corner there
+
+	enum VertexKind : std::uint8_t
+	{
+		Manifold,
+		Border,
+		Seam,
+		Locked,
+	};
+
+	// the symmetric 4x4 matrix of a sum of squared distances to planes, and the area they were weighted by.
+	struct Quadric
+	{
+		double A2 = 0.0, AB = 0.0, AC = 0.0, AD = 0.0, B2 = 0.0, BC = 0.0, BD = 0.0, C2 = 0.0, CD = 0.0, D2 = 0.0;
+		double Weight = 0.0;
+
+		// in double, the distances of a fine mesh are lost in float's rounding of the sums.
+		void AddPlane(double a, double b, double c, double d, double weight)
+		{
+			A2 += weight * a * a; AB += weight * a * b; AC += weight * a * c; AD += weight * a * d;
+			B2 += weight * b * b; BC += weight * b * c; BD += weight * b * d;
+			C2 += weight * c * c; CD += weight * c * d;
+			D2 += weight * d * d;
+			Weight += weight;
+		}
+
+		void Add(const Quadric& q)
+		{
+			A2 += q.A2; AB += q.AB; AC += q.AC; AD += q.AD;
+			B2 += q.B2; BC += q.BC; BD += q.BD;
+			C2 += q.C2; CD += q.CD;
+			D2 += q.D2;
+			Weight += q.Weight;
+		}
+
+		// the weighted sum of the squared distances of p to the planes.
+		double Sum(const float* p)const
+		{
+			double x = p[0], y = p[1], z = p[2];
+			return A2 * x * x + B2 * y * y + C2 * z * z + D2 +
+				2.0 * (AB * x * y + AC * x * z + AD * x + BC * y * z + BD * y + CD * z);
+		}
+
+		// the mean squared distance of p to the planes.
+		float Error(const float* p)const
+		{
+			return (float)(std::max(Sum(p), 0.0) / std::max(Weight, 1e-30));
+		}
+	};
+
+	void Cross(const float* a, const float* b, float* out)
+	{
+		out[0] = a[1] * b[2] - a[2] * b[1];
+		out[1] = a[2] * b[0] - a[0] * b[2];
+		out[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	float Dot(const float* a, const float* b)
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	// everything the levels start from : welded positions, vertex kinds, triangles of each vertex and quadrics.
+	struct SharedMesh
+	{
+		std::size_t VertexCount = 0;
+		std::vector<float> Positions;				// x, y, z in the unit box
+		std::vector<std::uint32_t> Indices;			// the triangles that aren't degenerate
+		std::vector<std::uint32_t> Canonical;		// the first vertex at the same position
+		std::vector<std::uint32_t> Sibling;			// the next vertex at the same position, in a ring
+		std::vector<std::uint8_t> Kind;
+		std::vector<std::uint32_t> OpenOut;			// where the open edge leaving a border or seam vertex goes
+		std::vector<std::uint32_t> OpenIn;			// and where the one coming in comes from
+		std::vector<std::uint32_t> TriangleOffsets;	// the triangles of vertex v are VertexTriangles[TriangleOffsets[v]...[v + 1]]
+		std::vector<std::uint32_t> VertexTriangles;
+		std::vector<Quadric> Quadrics;				// by canonical vertex
+
+		const float* Position(std::uint32_t v)const { return &Positions[v * 3]; }
+
+		// whether some triangle of a has the edge a -> b.
+		bool HasEdge(std::uint32_t a, std::uint32_t b)const
+		{
+			for (std::uint32_t k = TriangleOffsets[a]; k < TriangleOffsets[a + 1]; ++k)
+			{
+				const std::uint32_t* corners = &Indices[VertexTriangles[k] * 3];
+				for (int c = 0; c < 3; ++c)
+				{
+					if (corners[c] == a && corners[(c + 1) % 3] == b)
+						return true;
+				}
+			}
+			return false;
+		}
+
+		// triangles with an edge from the position of a to the position of b, whatever their vertices.
+		std::uint32_t PositionEdgeCount(std::uint32_t a, std::uint32_t b)const
+		{
+			std::uint32_t count = 0;
+			std::uint32_t copy = a;
+			do
+			{
+				for (std::uint32_t k = TriangleOffsets[copy]; k < TriangleOffsets[copy + 1]; ++k)
+				{
+					const std::uint32_t* corners = &Indices[VertexTriangles[k] * 3];
+					for (int c = 0; c < 3; ++c)
+					{
+						if (corners[c] == copy && Canonical[corners[(c + 1) % 3]] == Canonical[b])
+							++count;
+					}
+				}
+				copy = Sibling[copy];
+			} while (copy != a);
+			return count;
+		}
+	};
+
+	SharedMesh PrepareMesh(const std::vector<std::uint32_t>& indices, const float* positions, std::size_t stride, std::size_t vertexCount)
+	{
+		SharedMesh mesh;
+		mesh.VertexCount = vertexCount;
+		auto source = [&](std::size_t v) { return (const float*)((const char*)positions + v * stride); };
+
+		// positions in the unit box, so errors don't depend on the mesh's size.
+		float lower[3] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+		float upper[3] = { -lower[0], -lower[1], -lower[2] };
+		for (std::size_t v = 0; v < vertexCount; ++v)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				lower[k] = std::min(lower[k], source(v)[k]);
+				upper[k] = std::max(upper[k], source(v)[k]);
+			}
+		}
+		float extent = std::max(std::max(upper[0] - lower[0], upper[1] - lower[1]), upper[2] - lower[2]);
+		float scale = extent > 0.0f ? 1.0f / extent : 1.0f;
+		mesh.Positions.resize(vertexCount * 3);
+		for (std::size_t v = 0; v < vertexCount; ++v)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				mesh.Positions[v * 3 + k] = (source(v)[k] - lower[k]) * scale;
+			}
+		}
+
+		for (std::size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			std::uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+			if (a != b && b != c && c != a)
+			{
+				mesh.Indices.insert(mesh.Indices.end(), { a, b, c });
+			}
+		}
+		const std::uint32_t triangleCount = (std::uint32_t)(mesh.Indices.size() / 3);
+
+		// welded on the exact source positions, each group of equal ones in a ring.
+		std::vector<std::uint32_t> order(vertexCount);
+		for (std::uint32_t v = 0; v < vertexCount; ++v)
+		{
+			order[v] = v;
+		}
+		std::sort(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b)
+		{
+			const float* pa = source(a);
+			const float* pb = source(b);
+			if (pa[0] != pb[0]) return pa[0] < pb[0];
+			if (pa[1] != pb[1]) return pa[1] < pb[1];
+			if (pa[2] != pb[2]) return pa[2] < pb[2];
+			return a < b;
+		});
+		mesh.Canonical.resize(vertexCount);
+		mesh.Sibling.resize(vertexCount);
+		std::vector<std::uint32_t> copies(vertexCount);
+		for (std::size_t first = 0, last; first < vertexCount; first = last)
+		{
+			const float* p = source(order[first]);
+			for (last = first + 1; last < vertexCount; ++last)
+			{
+				const float* q = source(order[last]);
+				if (p[0] != q[0] || p[1] != q[1] || p[2] != q[2])
+					break;
+			}
+			for (std::size_t i = first; i < last; ++i)
+			{
+				mesh.Canonical[order[i]] = order[first];
+				mesh.Sibling[order[i]] = order[i + 1 < last ? i + 1 : first];
+				copies[order[i]] = (std::uint32_t)(last - first);
+			}
+		}
+
+		mesh.TriangleOffsets.assign(vertexCount + 1, 0);
+		for (std::uint32_t index : mesh.Indices)
+		{
+			mesh.TriangleOffsets[index + 1]++;
+		}
+		for (std::size_t v = 0; v < vertexCount; ++v)
+		{
+			mesh.TriangleOffsets[v + 1] += mesh.TriangleOffsets[v];
+		}
+		mesh.VertexTriangles.resize(mesh.Indices.size());
+		std::vector<std::uint32_t> fill(mesh.TriangleOffsets.begin(), mesh.TriangleOffsets.end() - 1);
+		for (std::uint32_t t = 0; t < triangleCount; ++t)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				mesh.VertexTriangles[fill[mesh.Indices[t * 3 + c]]++] = t;
+			}
+		}
+
+		// the quadrics of the triangles' planes, and of planes across their open edges.  An edge is open when
+		// no triangle has it the other way round, a border when no triangle has it between the same positions
+		// either, a seam otherwise.  Positions with more than two triangles on an edge are locked.
+		mesh.Quadrics.assign(vertexCount, Quadric());
+		mesh.OpenOut.assign(vertexCount, None);
+		mesh.OpenIn.assign(vertexCount, None);
+		std::vector<std::uint8_t> outCount(vertexCount, 0), inCount(vertexCount, 0), outBorder(vertexCount, 0), inBorder(vertexCount, 0);
+		std::vector<std::uint8_t> locked(vertexCount, 0);
+		for (std::uint32_t t = 0; t < triangleCount; ++t)
+		{
+			const std::uint32_t* corners = &mesh.Indices[t * 3];
+			const float* p0 = mesh.Position(corners[0]);
+			float e1[3] = { mesh.Position(corners[1])[0] - p0[0], mesh.Position(corners[1])[1] - p0[1], mesh.Position(corners[1])[2] - p0[2] };
+			float e2[3] = { mesh.Position(corners[2])[0] - p0[0], mesh.Position(corners[2])[1] - p0[1], mesh.Position(corners[2])[2] - p0[2] };
+			float normal[3];
+			Cross(e1, e2, normal);
+			float length = std::sqrt(Dot(normal, normal));
+			if (length > 0.0f)
+			{
+				for (int k = 0; k < 3; ++k)
+					normal[k] /= length;
+				for (int c = 0; c < 3; ++c)
+					mesh.Quadrics[mesh.Canonical[corners[c]]].AddPlane(normal[0], normal[1], normal[2], -Dot(normal, p0), 0.5f * length);
+			}
+
+			for (int c = 0; c < 3; ++c)
+			{
+				std::uint32_t a = corners[c], b = corners[(c + 1) % 3];
+				std::uint32_t reversed = mesh.PositionEdgeCount(b, a);
+				if (reversed > 1 || mesh.PositionEdgeCount(a, b) > 1)
+				{
+					locked[a] = locked[b] = 1;
+				}
+				if (mesh.HasEdge(b, a))
+				{
+					continue;
+				}
+
+				outCount[a] = (std::uint8_t)std::min(outCount[a] + 1, 2);
+				inCount[b] = (std::uint8_t)std::min(inCount[b] + 1, 2);
+				mesh.OpenOut[a] = b;
+				mesh.OpenIn[b] = a;
+				outBorder[a] = inBorder[b] = reversed == 0;
+
+				if (length > 0.0f)
+				{
+					const float* pa = mesh.Position(a);
+					const float* pb = mesh.Position(b);
+					float edge[3] = { pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+					float across[3];
+					Cross(edge, normal, across);
+					float acrossLength = std::sqrt(Dot(across, across));
+					if (acrossLength > 0.0f)
+					{
+						for (int k = 0; k < 3; ++k)
+							across[k] /= acrossLength;
+						float weight = EdgeWeight * Dot(edge, edge);
+						float d = -Dot(across, pa);
+						mesh.Quadrics[mesh.Canonical[a]].AddPlane(across[0], across[1], across[2], d, weight);
+						mesh.Quadrics[mesh.Canonical[b]].AddPlane(across[0], across[1], across[2], d, weight);
+					}
+				}
+			}
+		}
+
+		mesh.Kind.assign(vertexCount, Locked);
+		for (std::size_t v = 0; v < vertexCount; ++v)
+		{
+			if (locked[v])
+				mesh.Kind[v] = Locked;
+			else if (outCount[v] == 0 && inCount[v] == 0)
+				mesh.Kind[v] = copies[v] == 1 ? Manifold : Locked;
+			else if (outCount[v] == 1 && inCount[v] == 1 && copies[v] == 1 && outBorder[v] && inBorder[v])
+				mesh.Kind[v] = Border;
+			else if (outCount[v] == 1 && inCount[v] == 1 && copies[v] == 2 && !outBorder[v] && !inBorder[v])
+				mesh.Kind[v] = Seam;
+		}
+		for (std::size_t v = 0; v < vertexCount; ++v)
+		{
+			if (mesh.Kind[v] != Border && mesh.Kind[v] != Seam)
+				continue;
+			const float* p = mesh.Position((std::uint32_t)v);
+			const float* in = mesh.Position(mesh.OpenIn[v]);
+			const float* out = mesh.Position(mesh.OpenOut[v]);
+			float before[3] = { p[0] - in[0], p[1] - in[1], p[2] - in[2] };
+			float after[3] = { out[0] - p[0], out[1] - p[1], out[2] - p[2] };
+			if (Dot(before, after) < MinCornerCosine * std::sqrt(Dot(before, before) * Dot(after, after)))
+				mesh.Kind[v] = Locked;
+		}
+		for (std::size_t v = 0; v < vertexCount; ++v)
+		{
+			if (mesh.Kind[v] == Seam && mesh.Kind[mesh.Sibling[v]] != Seam)
+				mesh.Kind[v] = Locked;
+		}
+		return mesh;
+	}
+
+	// a binary heap of vertices by the cost of their cheapest collapse, which can be changed in place.
+	class CollapseHeap
+	{
+	public:
+		explicit CollapseHeap(std::size_t vertexCount) : mPlace(vertexCount, None), mCost(vertexCount, 0.0f) {}
+
+		bool Empty()const { return mHeap.empty(); }
+		std::uint32_t Top()const { return mHeap[0]; }
+		float Cost(std::uint32_t v)const { return mCost[v]; }
+		bool Contains(std::uint32_t v)const { return mPlace[v] != None; }
+
+		void Update(std::uint32_t v, float cost)
+		{
+			mCost[v] = cost;
+			if (mPlace[v] == None)
+			{
+				mPlace[v] = (std::uint32_t)mHeap.size();
+				mHeap.push_back(v);
+			}
+			SiftDown(SiftUp(mPlace[v]));
+		}
+
+		void Remove(std::uint32_t v)
+		{
+			std::uint32_t place = mPlace[v];
+			if (place == None)
+				return;
+			mPlace[v] = None;
+			std::uint32_t last = mHeap.back();
+			mHeap.pop_back();
+			if (last != v)
+			{
+				mHeap[place] = last;
+				mPlace[last] = place;
+				SiftDown(SiftUp(place));
+			}
+		}
+
+	private:
+		std::uint32_t SiftUp(std::uint32_t place)
+		{
+			std::uint32_t v = mHeap[place];
+			while (place > 0 && mCost[mHeap[(place - 1) / 2]] > mCost[v])
+			{
+				mHeap[place] = mHeap[(place - 1) / 2];
+				mPlace[mHeap[place]] = place;
+				place = (place - 1) / 2;
+			}
+			mHeap[place] = v;
+			mPlace[v] = place;
+			return place;
+		}
+
+		void SiftDown(std::uint32_t place)
+		{
+			std::uint32_t v = mHeap[place];
+			std::uint32_t size = (std::uint32_t)mHeap.size();
+			for (;;)
+			{
+				std::uint32_t child = place * 2 + 1;
+				if (child >= size)
+					break;
+				if (child + 1 < size && mCost[mHeap[child + 1]] < mCost[mHeap[child]])
+					++child;
+				if (mCost[mHeap[child]] >= mCost[v])
+					break;
+				mHeap[place] = mHeap[child];
+				mPlace[mHeap[place]] = place;
+				place = child;
+			}
+			mHeap[place] = v;
+			mPlace[v] = place;
+		}
+
+	private:
+		std::vector<std::uint32_t> mHeap;
+		std::vector<std::uint32_t> mPlace;		// of every vertex in mHeap, None when it has no collapse
+		std::vector<float> mCost;
+	};
+
+	// the collapses of one level, on its own copy of what they change.
+	class Simplifier
+	{
+	public:
+		explicit Simplifier(const SharedMesh& mesh)
+			: mMesh(mesh), mIndices(mesh.Indices), mDead(mesh.Indices.size() / 3, 0), mRemoved(mesh.VertexCount, 0),
+			mTarget(mesh.VertexCount, None), mOpenOut(mesh.OpenOut), mOpenIn(mesh.OpenIn), mQuadrics(mesh.Quadrics),
+			mListOffset(mesh.TriangleOffsets.begin(), mesh.TriangleOffsets.end() - 1), mListCount(mesh.VertexCount),
+			mListCapacity(mesh.VertexCount), mLists(mesh.VertexTriangles), mHeap(mesh.VertexCount), mChecked(mesh.VertexCount, 0), mMark(mesh.VertexCount, 0), mSeen(mesh.VertexCount, 0)
+		{
+			for (std::size_t v = 0; v < mesh.VertexCount; ++v)
+			{
+				mListCount[v] = mListCapacity[v] = mesh.TriangleOffsets[v + 1] - mesh.TriangleOffsets[v];
+			}
+		}
+
+		// one run of collapses down to the last of targets, which go from the most triangles to the fewest.
+		// levels[i] gets the triangles left as soon as there are no more than targets[i], or those left when
+		// the next collapse would cost more than targetError.
+		void Run(const std::vector<std::size_t>& targets, float targetError, MeshLod* const* levels)
+		{
+			const std::size_t before = mIndices.size() / 3;
+			std::size_t live = before;
+			std::size_t collapses = 0;
+			std::size_t next = 0;
+			float largestCost = 0.0f;
+			const float costLimit = targetError * targetError;
+
+			auto snapshot = [&]()
+			{
+				MeshLod& level = *levels[next++];
+				level.Indices.clear();
+				level.Indices.reserve(live * 3);
+				for (std::size_t t = 0; t < mDead.size(); ++t)
+				{
+					if (!mDead[t])
+					{
+						level.Indices.insert(level.Indices.end(), &mIndices[t * 3], &mIndices[t * 3] + 3);
+					}
+				}
+				level.Stats.TrianglesBefore = before;
+				level.Stats.TrianglesAfter = live;
+				level.Stats.Collapses = collapses;
+				level.Stats.Error = std::sqrt(largestCost);
+			};
+
+			for (std::uint32_t v = 0; v < (std::uint32_t)mMesh.VertexCount; ++v)
+			{
+				UpdateCollapse(v);
+			}
+
+			for (;;)
+			{
+				while (next < targets.size() && live <= targets[next])
+				{
+					snapshot();
+				}
+				if (next == targets.size() || mHeap.Empty())
+				{
+					break;
+				}
+
+				std::uint32_t v0 = mHeap.Top();
+				float cost = mHeap.Cost(v0);
+				if (cost > costLimit)
+				{
+					break;
+				}
+				mHeap.Remove(v0);
+
+				// the heap only knows the cost : the shape is checked here, and when it doesn't hold, the
+				// cheapest collapse of v0 that keeps it goes back in the heap instead.
+				std::uint32_t v1 = mTarget[v0];
+				std::uint32_t s0, s1;
+				if (!Allowed(v0, v1, s0, s1) || !KeepsShape(v0, v1) || (s0 != None && !KeepsShape(s0, s1)))
+				{
+					UpdateCheckedCollapse(v0);
+					continue;
+				}
+
+				live -= Collapse(v0, v1);
+				if (s0 != None)
+				{
+					live -= Collapse(s0, s1);
+					mHeap.Remove(s0);
+				}
+				if (mMesh.Canonical[v0] != mMesh.Canonical[v1])
+				{
+					mQuadrics[mMesh.Canonical[v1]].Add(mQuadrics[mMesh.Canonical[v0]]);
+				}
+				largestCost = std::max(largestCost, cost);
+				collapses++;
+
+				// every vertex around the ones collapsed onto has other triangles or another quadric next to it.
+				UpdateAround(v1);
+				if (s1 != None)
+				{
+					UpdateAround(s1);
+				}
+			}
+
+			while (next < targets.size())
+			{
+				snapshot();
+			}
+		}
+
+	private:
+		template<typename Fn>
+		void ForEachTriangle(std::uint32_t v, Fn fn)const
+		{
+			for (std::uint32_t k = mListOffset[v]; k < mListOffset[v] + mListCount[v]; ++k)
+			{
+				if (!mDead[mLists[k]])
+					fn(mLists[k]);
+			}
+		}
+
+		bool Contains(std::uint32_t t, std::uint32_t v)const
+		{
+			return mIndices[t * 3] == v || mIndices[t * 3 + 1] == v || mIndices[t * 3 + 2] == v;
+		}
+
+		// whether v0 may move onto v1, and the sibling collapse that goes with it for a seam.
+		bool Allowed(std::uint32_t v0, std::uint32_t v1, std::uint32_t& s0, std::uint32_t& s1)const
+		{
+			s0 = s1 = None;
+			if (mRemoved[v0] || v1 == None || mRemoved[v1])
+				return false;
+
+			switch (mMesh.Kind[v0])
+			{
+			case Manifold:
+				return true;
+			case Border:
+				return v1 == mOpenOut[v0] || v1 == mOpenIn[v0];
+			case Seam:
+				if (v1 != mOpenOut[v0] && v1 != mOpenIn[v0])
+					return false;
+				s0 = mMesh.Sibling[v0];
+				if (mOpenOut[s0] != None && mMesh.Canonical[mOpenOut[s0]] == mMesh.Canonical[v1])
+					s1 = mOpenOut[s0];
+				else if (mOpenIn[s0] != None && mMesh.Canonical[mOpenIn[s0]] == mMesh.Canonical[v1])
+					s1 = mOpenIn[s0];
+				return !mRemoved[s0] && s1 != None && !mRemoved[s1];
+			default:
+				return false;
+			}
+		}
+
+		// no triangle of v0 turns over, and the edge has as many neighbours in common as triangles, so the
+		// collapse doesn't pinch two sheets together.
+		bool KeepsShape(std::uint32_t v0, std::uint32_t v1)
+		{
+			const float* p0 = mMesh.Position(v0);
+			const float* p1 = mMesh.Position(v1);
+			bool flips = false;
+			std::uint32_t shared = 0;
+			mRing.clear();
+			ForEachTriangle(v0, [&](std::uint32_t t)
+			{
+				const std::uint32_t* corners = &mIndices[t * 3];
+				int c = corners[0] == v0 ? 0 : (corners[1] == v0 ? 1 : 2);
+				std::uint32_t a = corners[(c + 1) % 3], b = corners[(c + 2) % 3];
+				mRing.push_back(a);
+				mRing.push_back(b);
+				if (a == v1 || b == v1)
+				{
+					shared++;
+					return;
+				}
+				const float* pa = mMesh.Position(a);
+				const float* pb = mMesh.Position(b);
+				float oldA[3] = { pa[0] - p0[0], pa[1] - p0[1], pa[2] - p0[2] }, oldB[3] = { pb[0] - p0[0], pb[1] - p0[1], pb[2] - p0[2] };
+				float newA[3] = { pa[0] - p1[0], pa[1] - p1[1], pa[2] - p1[2] }, newB[3] = { pb[0] - p1[0], pb[1] - p1[1], pb[2] - p1[2] };
+				float before[3], after[3];
+				Cross(oldA, oldB, before);
+				Cross(newA, newB, after);
+				if (Dot(before, after) < MinNormalCosine * std::sqrt(Dot(before, before) * Dot(after, after)))
+				{
+					flips = true;
+				}
+			});
+			if (flips)
+			{
+				return false;
+			}
+
+			// v1's neighbours marked, each of v0's counted once.
+			mMarkValue += 2;
+			ForEachTriangle(v1, [&](std::uint32_t t)
+			{
+				for (int c = 0; c < 3; ++c)
+					mMark[mIndices[t * 3 + c]] = mMarkValue;
+			});
+			std::uint32_t common = 0;
+			for (std::uint32_t neighbour : mRing)
+			{
+				if (neighbour != v1 && mMark[neighbour] == mMarkValue)
+				{
+					mMark[neighbour] = mMarkValue + 1;
+					++common;
+				}
+			}
+			return common <= shared;
+		}
+
+		// the combined quadric of v0 and v1 at v1, without adding them up.
+		float CollapseCost(std::uint32_t v0, std::uint32_t v1)const
+		{
+			const Quadric& q0 = mQuadrics[mMesh.Canonical[v0]];
+			if (mMesh.Canonical[v0] == mMesh.Canonical[v1])
+			{
+				return q0.Error(mMesh.Position(v1));
+			}
+			const Quadric& q1 = mQuadrics[mMesh.Canonical[v1]];
+			double sum = q0.Sum(mMesh.Position(v1)) + q1.Sum(mMesh.Position(v1));
+			return (float)(std::max(sum, 0.0) / std::max(q0.Weight + q1.Weight, 1e-30));
+		}
+
+		// every neighbour v0 is allowed to move onto, once.
+		template<typename Fn>
+		void ForEachAllowed(std::uint32_t v0, Fn fn)
+		{
+			mSeenValue++;
+			mSeen[v0] = mSeenValue;
+			ForEachTriangle(v0, [&](std::uint32_t t)
+			{
+				for (int c = 0; c < 3; ++c)
+				{
+					std::uint32_t v1 = mIndices[t * 3 + c], s0, s1;
+					if (mSeen[v1] != mSeenValue)
+					{
+						mSeen[v1] = mSeenValue;
+						if (Allowed(v0, v1, s0, s1))
+							fn(v1);
+					}
+				}
+			});
+		}
+
+		void SetCollapse(std::uint32_t v0, std::uint32_t v1, float cost)
+		{
+			mTarget[v0] = v1;
+			if (v1 == None)
+				mHeap.Remove(v0);
+			else
+				mHeap.Update(v0, cost);
+		}
+
+		// the cheapest allowed collapse of v0 into the heap.  Whether it keeps the shape is only checked when it
+		// comes out, most collapses are computed again before then.
+		void UpdateCollapse(std::uint32_t v0)
+		{
+			if (mRemoved[v0] || mMesh.Kind[v0] == Locked)
+			{
+				mHeap.Remove(v0);
+				return;
+			}
+
+			std::uint32_t best = None;
+			float bestCost = 0.0f;
+			mChecked[v0] = 0;
+			ForEachAllowed(v0, [&](std::uint32_t v1)
+			{
+				float cost = CollapseCost(v0, v1);
+				if (best == None || cost < bestCost || (cost == bestCost && v1 < best))
+				{
+					best = v1;
+					bestCost = cost;
+				}
+			});
+			SetCollapse(v0, best, bestCost);
+		}
+
+		// the cheapest collapse of v0 that keeps the shape, checked from the cheapest up until one does.
+		void UpdateCheckedCollapse(std::uint32_t v0)
+		{
+			if (mRemoved[v0] || mMesh.Kind[v0] == Locked)
+			{
+				mHeap.Remove(v0);
+				return;
+			}
+
+			mOptions.clear();
+			mChecked[v0] = 1;
+			ForEachAllowed(v0, [&](std::uint32_t v1)
+			{
+				mOptions.push_back({ CollapseCost(v0, v1), v1 });
+			});
+			while (!mOptions.empty())
+			{
+				std::size_t cheapest = std::min_element(mOptions.begin(), mOptions.end()) - mOptions.begin();
+				std::pair<float, std::uint32_t> option = mOptions[cheapest];
+				std::uint32_t s0, s1;
+				Allowed(v0, option.second, s0, s1);
+				if (KeepsShape(v0, option.second) && (s0 == None || KeepsShape(s0, s1)))
+				{
+					SetCollapse(v0, option.second, option.first);
+					return;
+				}
+				mOptions[cheapest] = mOptions.back();
+				mOptions.pop_back();
+			}
+			SetCollapse(v0, None, 0.0f);
+		}
+
+		void UpdateAround(std::uint32_t v)
+		{
+			mAround.clear();
+			mSeenValue++;
+			ForEachTriangle(v, [&](std::uint32_t t)
+			{
+				for (int c = 0; c < 3; ++c)
+				{
+					if (mSeen[mIndices[t * 3 + c]] != mSeenValue)
+					{
+						mSeen[mIndices[t * 3 + c]] = mSeenValue;
+						mAround.push_back(mIndices[t * 3 + c]);
+					}
+				}
+			});
+			for (std::uint32_t neighbour : mAround)
+			{
+				UpdateCollapseOnto(neighbour, v);
+			}
+		}
+
+		// v0's cheapest collapse once a neighbour has collapsed onto v, which changed the quadric of v and its
+		// copies and nothing else v0's collapses cost.  When v0 is inside the mesh, and its collapse in the heap
+		// is the cheapest of all, not one checked for shape, onto a vertex that is still there, alone at its
+		// position and not v, only the collapse onto v can have changed : one cost instead of one per neighbour.
+		void UpdateCollapseOnto(std::uint32_t v0, std::uint32_t v)
+		{
+			const std::uint32_t target = mTarget[v0];
+			if (v0 == v || mRemoved[v0] || mMesh.Kind[v0] != Manifold || mChecked[v0] || !mHeap.Contains(v0) || target == v ||
+				mRemoved[target] || mMesh.Sibling[target] != target)
+			{
+				UpdateCollapse(v0);
+				return;
+			}
+			float cost = CollapseCost(v0, v);
+			if (cost < mHeap.Cost(v0) || (cost == mHeap.Cost(v0) && v < target))
+			{
+				SetCollapse(v0, v, cost);
+			}
+		}
+
+		// moves v0 onto v1, returns the triangles that went.
+		std::size_t Collapse(std::uint32_t v0, std::uint32_t v1)
+		{
+			std::size_t killed = 0;
+			mMerged.clear();
+			ForEachTriangle(v1, [&](std::uint32_t t)
+			{
+				if (Contains(t, v0))
+				{
+					mDead[t] = 1;
+					killed++;
+				}
+				else
+				{
+					mMerged.push_back(t);
+				}
+			});
+			ForEachTriangle(v0, [&](std::uint32_t t)
+			{
+				std::uint32_t* corners = &mIndices[t * 3];
+				for (int c = 0; c < 3; ++c)
+				{
+					if (corners[c] == v0)
+						corners[c] = v1;
+				}
+				mMerged.push_back(t);
+			});
+
+			// v1's live triangles and v0's, in its own list if they fit, else at the end of the lists.
+			std::uint32_t count = (std::uint32_t)mMerged.size();
+			if (count > mListCapacity[v1])
+			{
+				mListOffset[v1] = (std::uint32_t)mLists.size();
+				mListCapacity[v1] = count * 2;
+				mLists.resize(mLists.size() + count * 2);
+			}
+			std::copy(mMerged.begin(), mMerged.end(), mLists.begin() + mListOffset[v1]);
+			mListCount[v1] = count;
+			mListCount[v0] = 0;
+			mRemoved[v0] = 1;
+
+			// the open edges of v0 now end at v1.
+			std::uint32_t in = mOpenIn[v0], out = mOpenOut[v0];
+			if (out == v1)
+			{
+				if (in != None && mOpenOut[in] == v0)
+					mOpenOut[in] = v1;
+				mOpenIn[v1] = in;
+			}
+			if (in == v1)
+			{
+				if (out != None && mOpenIn[out] == v0)
+					mOpenIn[out] = v1;
+				mOpenOut[v1] = out;
+			}
+			return killed;
+		}
+
+	private:
+		const SharedMesh& mMesh;
+		std::vector<std::uint32_t> mIndices;
+		std::vector<std::uint8_t> mDead;			// by triangle
+		std::vector<std::uint8_t> mRemoved;			// by vertex
+		std::vector<std::uint32_t> mTarget;			// the vertex of the cheapest collapse
+		std::vector<std::uint32_t> mOpenOut;
+		std::vector<std::uint32_t> mOpenIn;
+		std::vector<Quadric> mQuadrics;
+
+		// the triangles of every vertex, a range of mLists that moves to its end when it outgrows its capacity.
+		std::vector<std::uint32_t> mListOffset;
+		std::vector<std::uint32_t> mListCount;
+		std::vector<std::uint32_t> mListCapacity;
+		std::vector<std::uint32_t> mLists;
+
+		CollapseHeap mHeap;
+		std::vector<std::uint32_t> mRing, mAround, mMerged;
+		std::vector<std::pair<float, std::uint32_t>> mOptions;		// cost and target of the allowed collapses
+		std::vector<std::uint8_t> mChecked;		// by vertex, its collapse was the cheapest that keeps the shape
+		std::vector<std::uint32_t> mMark;		// by vertex, mMarkValue for the neighbours of a collapse's target
+		std::uint32_t mMarkValue = 0;
+		std::vector<std::uint32_t> mSeen;		// by vertex, mSeenValue once gathered
+		std::uint32_t mSeenValue = 0;
+	};
+}
+
+std::vector<std::uint32_t> SimplifyMesh(const std::vector<std::uint32_t>& indices, const float* positions, std::size_t stride,
+	std::size_t vertexCount, std::size_t targetTriangles, float targetError, MeshSimplifyStats* stats)
+{
+	SharedMesh mesh = PrepareMesh(indices, positions, stride, vertexCount);
+	MeshLod lod;
+	MeshLod* levels[] = { &lod };
+	Simplifier(mesh).Run({ targetTriangles }, targetError, levels);
+	if (stats)
+	{
+		*stats = lod.Stats;
+	}
+	return std::move(lod.Indices);
+}
+
+std::vector<MeshLod> BuildMeshLods(const std::vector<std::uint32_t>& indices, const float* positions, std::size_t stride,
+	std::size_t vertexCount, const std::vector<std::size_t>& targetTriangles, float targetError)
+{
+	SharedMesh mesh = PrepareMesh(indices, positions, stride, vertexCount);
+	std::vector<MeshLod> lods(targetTriangles.size());
+
+	// the run takes the targets from the most triangles to the fewest, the levels stay in the caller's order.
+	std::vector<std::size_t> order(targetTriangles.size());
+	for (std::size_t level = 0; level < order.size(); ++level)
+	{
+		order[level] = level;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return targetTriangles[a] > targetTriangles[b]; });
+	std::vector<std::size_t> targets(order.size());
+	std::vector<MeshLod*> levels(order.size());
+	for (std::size_t i = 0; i < order.size(); ++i)
+	{
+		targets[i] = targetTriangles[order[i]];
+		levels[i] = &lods[order[i]];
+	}
+
+	Simplifier(mesh).Run(targets, targetError, levels.data());
+	return lods;
+}
+
+std::vector<std::vector<MeshLod>> BuildMeshLods(const std::vector<MeshLodSource>& meshes, float targetError, WorkerPool* workers)
+{
+	std::vector<std::vector<MeshLod>> chains(meshes.size());
+	auto buildChain = [&](std::uint32_t m)
+	{
+		const MeshLodSource& source = meshes[m];
+		chains[m] = BuildMeshLods(*source.Indices, source.Positions, source.Stride, source.VertexCount, source.TargetTriangles, targetError);
+	};
+	if (workers)
+	{
+		workers->Run((std::uint32_t)meshes.size(), buildChain);
+	}
+	else
+	{
+		for (std::uint32_t m = 0; m < (std::uint32_t)meshes.size(); ++m)
+		{
+			buildChain(m);
+		}
+	}
+	return chains;
+}
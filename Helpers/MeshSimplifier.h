@@ -0,0 +1,67 @@
+// MeshSimplifier.h : levels of detail of an indexed triangle list by quadric error edge collapses (Garland
+// and Heckbert), for meshes GeometryGenerator can't simply make coarser.
+//
+// Every position sums the quadrics of the planes of its triangles, weighted by their area, so the quadric
+// gives the mean squared distance of a point to them.  A collapse moves one vertex onto a neighbour (a half
+// edge collapse, no vertex is created or moved), its cost is the combined quadric of both at the neighbour.
+// Each vertex keeps its cheapest collapse in a binary heap, the cheapest of all is done first and the costs
+// of the collapses around it computed again.  A collapse is left out when it flips or folds a triangle, or
+// would join two sheets of the surface; that is only checked when it comes out of the heap, and when it fails
+// the vertex goes back in with its cheapest collapse that passes.
+//
+// Vertices are welded by position to find what must not move :
+//   - a border vertex, on an edge with one triangle, only moves along the border, onto the next vertex of it,
+//   - a seam vertex, shared by two vertices with other attributes (a texture seam), only moves along the
+//     seam, and both of its vertices move together onto the two of the next position,
+//   - corners of borders or seams, and vertices shared by more than two, never move.
+// The edges of borders and seams add a plane across them to the quadrics, so they stay straight.
+//
+// The result indexes the same vertices, OptimizeMesh (MeshOptimizer.h) can then reorder it and drop the
+// unused ones.  Errors are relative to the largest side of the mesh's bounds.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class WorkerPool;
+
+struct MeshSimplifyStats
+{
+	std::size_t TrianglesBefore = 0;
+	std::size_t TrianglesAfter = 0;
+	std::size_t Collapses = 0;
+	float Error = 0.0f;				// largest error of a collapse done, as a distance relative to the mesh's size
+};
+
+struct MeshLod
+{
+	std::vector<std::uint32_t> Indices;
+	MeshSimplifyStats Stats;
+};
+
+// collapses edges of indices, a triangle list over vertexCount vertices, until at most targetTriangles are
+// left or the next collapse would cost more than targetError.  positions points at the x, y, z floats of
+// the first vertex, stride bytes apart.
+std::vector<std::uint32_t> SimplifyMesh(const std::vector<std::uint32_t>& indices, const float* positions, std::size_t stride,
+	std::size_t vertexCount, std::size_t targetTriangles, float targetError, MeshSimplifyStats* stats = nullptr);
+
+// a level for every entry of targetTriangles, from one run of collapses that copies the triangles out as it
+// gets to each target : a chain costs about what its coarsest level does on its own.
+std::vector<MeshLod> BuildMeshLods(const std::vector<std::uint32_t>& indices, const float* positions, std::size_t stride,
+	std::size_t vertexCount, const std::vector<std::size_t>& targetTriangles, float targetError);
+
+// a mesh and its targets for the overload below, as BuildMeshLods takes them.
+struct MeshLodSource
+{
+	const std::vector<std::uint32_t>* Indices;
+	const float* Positions;
+	std::size_t Stride;
+	std::size_t VertexCount;
+	std::vector<std::size_t> TargetTriangles;
+};
+
+// the chains of several meshes, one mesh per worker at a time.  The levels of one mesh build on each
+// other, so the parallelism is between meshes.
+std::vector<std::vector<MeshLod>> BuildMeshLods(const std::vector<MeshLodSource>& meshes, float targetError, WorkerPool* workers = nullptr);
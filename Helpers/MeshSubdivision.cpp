@@ -0,0 +1,194 @@
+// MeshSubdivision.cpp
+
+#include "MeshSubdivision.h"
+#include <algorithm>
+#include <atomic>
+
+namespace
+{
+	const std::uint32_t TriangleChunk = 16384;
+	const std::uint32_t ParallelThreshold = 2 * TriangleChunk;
+
+	// the key of an edge, the same both ways round.  0 marks an empty slot : a < b, so b is never 0.
+	std::uint64_t EdgeKey(std::uint32_t a, std::uint32_t b)
+	{
+		return a < b ? ((std::uint64_t)a << 32 | b) : ((std::uint64_t)b << 32 | a);
+	}
+
+	// an edge of the hash table, with 1 + the first triangle edge using it next to the key so a lookup
+	// touches one cache line.
+	struct EdgeSlot
+	{
+		std::atomic<std::uint64_t> Key;
+		std::atomic<std::uint32_t> Owner;
+	};
+
+	std::uint32_t HashSlot(std::uint64_t key, std::uint32_t shift)
+	{
+		return (std::uint32_t)((key * 0x9E3779B97F4A7C15ull) >> shift);
+	}
+
+	// an edge of the single threaded table, with the new vertex in place of the owner.
+	struct SerialEdgeSlot
+	{
+		std::uint64_t Key;
+		std::uint32_t Vertex;
+	};
+
+	// single threaded, the triangles come in order, so the triangle edge that inserts an edge is its owner and
+	// numbers its vertex on the spot : one pass that writes the four triangles as it goes.
+	void SubdivideSerial(std::vector<std::uint32_t>& indices, std::uint32_t vertexCount, std::vector<std::uint32_t>& midpoints,
+		std::uint32_t bits)
+	{
+		const std::uint32_t triangleCount = (std::uint32_t)(indices.size() / 3);
+		const std::uint32_t mask = (1u << bits) - 1;
+		const std::uint32_t shift = 64 - bits;
+		std::vector<SerialEdgeSlot> slots(mask + 1);
+
+		midpoints.clear();
+		midpoints.reserve((std::size_t)triangleCount * 3);		// a closed mesh has 3 / 2 edges per triangle
+		std::vector<std::uint32_t> subdivided((std::size_t)triangleCount * 12);
+		std::uint32_t next = vertexCount;
+		for (std::uint32_t t = 0; t < triangleCount; ++t)
+		{
+			const std::uint32_t v[3] = { indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2] };
+			std::uint32_t m[3];
+			for (int e = 0; e < 3; ++e)
+			{
+				std::uint32_t a = v[e], b = v[e == 2 ? 0 : e + 1];
+				std::uint64_t key = EdgeKey(a, b);
+				std::uint32_t slot = HashSlot(key, shift);
+				while (slots[slot].Key != 0 && slots[slot].Key != key)
+				{
+					slot = (slot + 1) & mask;
+				}
+				if (slots[slot].Key == 0)
+				{
+					slots[slot].Key = key;
+					slots[slot].Vertex = next++;
+					midpoints.push_back(a);
+					midpoints.push_back(b);
+				}
+				m[e] = slots[slot].Vertex;
+			}
+
+			const std::uint32_t children[12] = { v[0], m[0], m[2], m[0], m[1], m[2], m[2], m[1], v[2], m[0], v[1], m[1] };
+			std::copy(children, children + 12, &subdivided[(std::size_t)t * 12]);
+		}
+		indices.swap(subdivided);
+	}
+}
+
+void SubdivideTriangles(std::vector<std::uint32_t>& indices, std::uint32_t vertexCount, std::vector<std::uint32_t>& midpoints, WorkerPool* workers)
+{
+	const std::uint32_t triangleCount = (std::uint32_t)(indices.size() / 3);
+	const std::uint32_t chunks = (triangleCount + TriangleChunk - 1) / TriangleChunk;
+
+	// open addressing with linear probing, at least one slot per triangle edge so it never fills up.
+	std::uint32_t bits = 1;
+	while ((1ull << bits) < (std::uint64_t)triangleCount * 3)
+	{
+		++bits;
+	}
+	if (!workers || workers->ThreadCount() <= 1 || triangleCount < ParallelThreshold)
+	{
+		SubdivideSerial(indices, vertexCount, midpoints, bits);
+		return;
+	}
+	auto forEachChunk = [&](const std::function<void(std::uint32_t)>& fn) { workers->Run(chunks, fn); };
+
+	// threaded, the chunks race for the edges : find the owners, count and number them per chunk, then
+	// write the triangles, one pass each.
+	const std::uint32_t mask = (1u << bits) - 1;
+	const std::uint32_t shift = 64 - bits;
+	std::vector<EdgeSlot> slots(mask + 1);
+	std::vector<std::uint32_t> edgeOwners((std::size_t)triangleCount * 3);		// the slot of each triangle edge, then its owner
+
+	// every triangle edge finds or inserts its edge, and the first one in triangle order owns it.
+	forEachChunk([&](std::uint32_t chunk)
+	{
+		std::uint32_t end = std::min(triangleCount, (chunk + 1) * TriangleChunk);
+		for (std::uint32_t edge = chunk * TriangleChunk * 3; edge < end * 3; ++edge)
+		{
+			std::uint32_t t = edge / 3;
+			std::uint64_t key = EdgeKey(indices[edge], indices[t * 3 + (edge + 1) % 3]);
+			std::uint32_t slot = HashSlot(key, shift);
+			while (true)
+			{
+				std::uint64_t found = slots[slot].Key.load(std::memory_order_relaxed);
+				if (found == 0 && slots[slot].Key.compare_exchange_strong(found, key, std::memory_order_relaxed))
+				{
+					break;
+				}
+				if (found == key)
+				{
+					break;
+				}
+				slot = (slot + 1) & mask;
+			}
+			edgeOwners[edge] = slot;
+
+			std::uint32_t owner = slots[slot].Owner.load(std::memory_order_relaxed);
+			while ((owner == 0 || edge + 1 < owner) && !slots[slot].Owner.compare_exchange_weak(owner, edge + 1, std::memory_order_relaxed))
+			{
+			}
+		}
+	});
+
+	// from here on each triangle edge only needs its edge's owner, which replaces the slot.  The owners number
+	// the new vertices : count them per chunk, then hand out the ranges in chunk order.
+	std::vector<std::uint32_t> chunkFirst(chunks + 1, 0);
+	forEachChunk([&](std::uint32_t chunk)
+	{
+		std::uint32_t end = std::min(triangleCount, (chunk + 1) * TriangleChunk);
+		std::uint32_t owned = 0;
+		for (std::uint32_t edge = chunk * TriangleChunk * 3; edge < end * 3; ++edge)
+		{
+			edgeOwners[edge] = slots[edgeOwners[edge]].Owner.load(std::memory_order_relaxed) - 1;
+			owned += edgeOwners[edge] == edge ? 1 : 0;
+		}
+		chunkFirst[chunk + 1] = owned;
+	});
+	for (std::uint32_t chunk = 0; chunk < chunks; ++chunk)
+	{
+		chunkFirst[chunk + 1] += chunkFirst[chunk];
+	}
+
+	midpoints.resize((std::size_t)chunkFirst[chunks] * 2);
+	std::vector<std::uint32_t> edgeVertices((std::size_t)triangleCount * 3);		// the new vertex of each owning triangle edge
+	forEachChunk([&](std::uint32_t chunk)
+	{
+		std::uint32_t end = std::min(triangleCount, (chunk + 1) * TriangleChunk);
+		std::uint32_t next = chunkFirst[chunk];
+		for (std::uint32_t edge = chunk * TriangleChunk * 3; edge < end * 3; ++edge)
+		{
+			if (edgeOwners[edge] == edge)
+			{
+				std::uint32_t t = edge / 3;
+				midpoints[(std::size_t)next * 2] = indices[edge];
+				midpoints[(std::size_t)next * 2 + 1] = indices[t * 3 + (edge + 1) % 3];
+				edgeVertices[edge] = vertexCount + next++;
+			}
+		}
+	});
+
+	// the four triangles of every triangle.
+	std::vector<std::uint32_t> subdivided((std::size_t)triangleCount * 12);
+	forEachChunk([&](std::uint32_t chunk)
+	{
+		std::uint32_t end = std::min(triangleCount, (chunk + 1) * TriangleChunk);
+		for (std::uint32_t t = chunk * TriangleChunk; t < end; ++t)
+		{
+			std::uint32_t v0 = indices[t * 3], v1 = indices[t * 3 + 1], v2 = indices[t * 3 + 2];
+			std::uint32_t m[3];
+			for (int e = 0; e < 3; ++e)
+			{
+				m[e] = edgeVertices[edgeOwners[t * 3 + e]];
+			}
+
+			const std::uint32_t children[12] = { v0, m[0], m[2], m[0], m[1], m[2], m[2], m[1], v2, m[0], v1, m[1] };
+			std::copy(children, children + 12, &subdivided[(std::size_t)t * 12]);
+		}
+	});
+	indices.swap(subdivided);
+}
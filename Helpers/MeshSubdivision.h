@@ -0,0 +1,23 @@
+// MeshSubdivision.h : one level of midpoint subdivision of an indexed triangle list, keeping it indexed.
+//
+// Every triangle v0 v1 v2 becomes four, with the same winding :
+//   v0 m0 m2,  m0 m1 m2,  m2 m1 v2,  m0 v1 m1		(m0 on v0 v1, m1 on v1 v2, m2 on v2 v0)
+// Triangles sharing an edge share its midpoint : the edges go into a hash table keyed by their vertex pair,
+// and each edge gets one new vertex, numbered after the existing ones in the order the triangles first use
+// the edge.  A closed mesh stays closed, and a level adds one vertex per edge instead of six per triangle.
+//
+// Only the topology is handled here : the caller appends the new vertices itself, vertex vertexCount + i
+// splitting the edge midpoints[2i], midpoints[2i + 1].  Without workers it takes a single pass over the
+// triangles, faster than the copying subdivision it replaced.  Large meshes split the triangles into chunks
+// that run on a WorkerPool in four passes, about 1.6 times the work of the single one, so that only pays off
+// from two cores up; the result doesn't depend on how many threads took part.
+
+#pragma once
+
+#include "WorkerPool.h"
+
+#include <cstdint>
+#include <vector>
+
+void SubdivideTriangles(std::vector<std::uint32_t>& indices, std::uint32_t vertexCount, std::vector<std::uint32_t>& midpoints,
+	WorkerPool* workers = nullptr);
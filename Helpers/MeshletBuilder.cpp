@@ -0,0 +1,339 @@
+// MeshletBuilder.cpp
+
+#include "MeshletBuilder.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	const std::uint8_t NotInMeshlet = 0xff;
+
+	const float* Position(const float* positions, std::size_t stride, std::uint32_t vertex)
+	{
+		return reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + vertex * stride);
+	}
+
+	// bounding sphere and normal cone of one meshlet.
+	MeshletBounds ComputeBounds(const MeshletData& data, const Meshlet& meshlet, const float* positions, std::size_t stride)
+	{
+		MeshletBounds bounds = {};
+
+		// the sphere around the middle of the box, large enough for the farthest vertex.
+		float low[3] = { 1e30f, 1e30f, 1e30f }, high[3] = { -1e30f, -1e30f, -1e30f };
+		for (std::uint32_t i = 0; i < meshlet.VertexCount; ++i)
+		{
+			const float* p = Position(positions, stride, data.Vertices[meshlet.VertexOffset + i]);
+			for (int k = 0; k < 3; ++k)
+			{
+				low[k] = std::min(low[k], p[k]);
+				high[k] = std::max(high[k], p[k]);
+			}
+		}
+		for (int k = 0; k < 3; ++k)
+		{
+			bounds.Center[k] = 0.5f * (low[k] + high[k]);
+		}
+		float radius2 = 0.0f;
+		for (std::uint32_t i = 0; i < meshlet.VertexCount; ++i)
+		{
+			const float* p = Position(positions, stride, data.Vertices[meshlet.VertexOffset + i]);
+			float dx = p[0] - bounds.Center[0], dy = p[1] - bounds.Center[1], dz = p[2] - bounds.Center[2];
+			radius2 = std::max(radius2, dx * dx + dy * dy + dz * dz);
+		}
+		bounds.Radius = std::sqrt(radius2);
+
+		// unit triangle normals and a point on each plane, degenerate triangles don't rasterize and don't count.
+		std::vector<float> planes;
+		float axis[3] = { 0.0f, 0.0f, 0.0f };
+		for (std::uint32_t t = 0; t < meshlet.TriangleCount; ++t)
+		{
+			std::uint32_t triangle = data.Triangles[meshlet.TriangleOffset + t];
+			const float* p0 = Position(positions, stride, data.Vertices[meshlet.VertexOffset + MeshletData::Corner(triangle, 0)]);
+			const float* p1 = Position(positions, stride, data.Vertices[meshlet.VertexOffset + MeshletData::Corner(triangle, 1)]);
+			const float* p2 = Position(positions, stride, data.Vertices[meshlet.VertexOffset + MeshletData::Corner(triangle, 2)]);
+			float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			if (length == 0.0f)
+			{
+				continue;
+			}
+			for (int k = 0; k < 3; ++k)
+			{
+				planes.push_back(n[k] / length);
+				axis[k] += n[k] / length;
+			}
+			planes.insert(planes.end(), p0, p0 + 3);
+		}
+
+		// no cone : the axis is left at +y and the cutoff out of reach.
+		bounds.ConeAxis[1] = 1.0f;
+		bounds.ConeCutoff = 2.0f;
+		for (int k = 0; k < 3; ++k)
+		{
+			bounds.ConeApex[k] = bounds.Center[k];
+		}
+
+		float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+		if (planes.empty() || axisLength == 0.0f)
+		{
+			return bounds;
+		}
+		for (int k = 0; k < 3; ++k)
+		{
+			axis[k] /= axisLength;
+		}
+
+		float minDot = 1.0f;
+		for (std::size_t i = 0; i < planes.size(); i += 6)
+		{
+			minDot = std::min(minDot, planes[i] * axis[0] + planes[i + 1] * axis[1] + planes[i + 2] * axis[2]);
+		}
+		if (minDot <= 0.0f)
+		{
+			return bounds;
+		}
+
+		// the apex goes down the axis from the center until it is behind the plane of every triangle.
+		float apexDistance = 0.0f;
+		for (std::size_t i = 0; i < planes.size(); i += 6)
+		{
+			const float* normal = &planes[i];
+			const float* point = &planes[i + 3];
+			float centerDistance = (bounds.Center[0] - point[0]) * normal[0] + (bounds.Center[1] - point[1]) * normal[1] + (bounds.Center[2] - point[2]) * normal[2];
+			float axisDot = axis[0] * normal[0] + axis[1] * normal[1] + axis[2] * normal[2];
+			apexDistance = std::max(apexDistance, centerDistance / axisDot);
+		}
+
+		for (int k = 0; k < 3; ++k)
+		{
+			bounds.ConeApex[k] = bounds.Center[k] - axis[k] * apexDistance;
+			bounds.ConeAxis[k] = axis[k];
+		}
+
+		// views within 90 degrees less the half angle of the axis see every normal from behind.  The cutoff is
+		// rounded up a little so float error stays on the side of drawing.
+		bounds.ConeCutoff = std::min(std::sqrt(1.0f - minDot * minDot) + 1e-3f, 2.0f);
+		return bounds;
+	}
+}
+
+MeshletData BuildMeshlets(const std::vector<std::uint32_t>& indices, const float* positions, std::size_t stride, std::size_t vertexCount)
+{
+	MeshletData data;
+	std::size_t triangleCount = indices.size() / 3;
+
+	// the triangles using each vertex.
+	std::vector<std::uint32_t> offsets(vertexCount + 1, 0);
+	for (std::uint32_t index : indices)
+	{
+		++offsets[index + 1];
+	}
+	for (std::size_t v = 0; v < vertexCount; ++v)
+	{
+		offsets[v + 1] += offsets[v];
+	}
+	std::vector<std::uint32_t> adjacency(indices.size());
+	std::vector<std::uint32_t> filled(offsets.begin(), offsets.end() - 1);
+	for (std::size_t i = 0; i < indices.size(); ++i)
+	{
+		adjacency[filled[indices[i]]++] = (std::uint32_t)(i / 3);
+	}
+
+	std::vector<float> centroids(triangleCount * 3);
+	for (std::size_t t = 0; t < triangleCount; ++t)
+	{
+		for (int k = 0; k < 3; ++k)
+		{
+			const float* p = Position(positions, stride, indices[t * 3 + k]);
+			for (int c = 0; c < 3; ++c)
+			{
+				centroids[t * 3 + c] += p[c] / 3.0f;
+			}
+		}
+	}
+
+	std::vector<char> used(triangleCount, 0);
+	std::vector<std::uint8_t> local(vertexCount, NotInMeshlet);
+	std::vector<std::uint32_t> candidates;
+	std::size_t seed = 0;
+
+	while (true)
+	{
+		while (seed < triangleCount && used[seed])
+		{
+			++seed;
+		}
+		if (seed == triangleCount)
+		{
+			break;
+		}
+
+		Meshlet meshlet = { (std::uint32_t)data.Vertices.size(), (std::uint32_t)data.Triangles.size(), 0, 0 };
+		float center[3] = { 0.0f, 0.0f, 0.0f };
+		candidates.clear();
+
+		std::size_t next = seed;
+		while (true)
+		{
+			// add the triangle, its new vertices bring their triangles onto the border.
+			const std::uint32_t* triangle = &indices[next * 3];
+			std::uint32_t packed = 0;
+			for (int k = 0; k < 3; ++k)
+			{
+				std::uint32_t v = triangle[k];
+				if (local[v] == NotInMeshlet)
+				{
+					local[v] = (std::uint8_t)meshlet.VertexCount++;
+					data.Vertices.push_back(v);
+					for (std::uint32_t i = offsets[v]; i < offsets[v + 1]; ++i)
+					{
+						if (!used[adjacency[i]])
+						{
+							candidates.push_back(adjacency[i]);
+						}
+					}
+				}
+				packed |= (std::uint32_t)local[v] << (8 * k);
+			}
+			data.Triangles.push_back(packed);
+			used[next] = 1;
+			++meshlet.TriangleCount;
+
+			float weight = 1.0f / meshlet.TriangleCount;
+			for (int c = 0; c < 3; ++c)
+			{
+				center[c] += (centroids[next * 3 + c] - center[c]) * weight;
+			}
+
+			if (meshlet.TriangleCount == MeshletMaxTriangles)
+			{
+				break;
+			}
+
+			// the border triangle with the fewest new vertices that still fits, then the closest one.
+			std::size_t best = triangleCount;
+			std::uint32_t bestNew = 4;
+			float bestDistance = 0.0f;
+			std::size_t kept = 0;
+			for (std::uint32_t t : candidates)
+			{
+				if (used[t])
+				{
+					continue;
+				}
+				candidates[kept++] = t;
+
+				std::uint32_t newVertices = 0;
+				for (int k = 0; k < 3; ++k)
+				{
+					newVertices += local[indices[t * 3 + k]] == NotInMeshlet ? 1 : 0;
+				}
+				if (meshlet.VertexCount + newVertices > MeshletMaxVertices || newVertices > bestNew)
+				{
+					continue;
+				}
+
+				float dx = centroids[t * 3] - center[0], dy = centroids[t * 3 + 1] - center[1], dz = centroids[t * 3 + 2] - center[2];
+				float distance = dx * dx + dy * dy + dz * dz;
+				if (newVertices < bestNew || distance < bestDistance)
+				{
+					best = t;
+					bestNew = newVertices;
+					bestDistance = distance;
+				}
+			}
+			candidates.resize(kept);
+
+			// nothing left around the meshlet : carry on with the next triangle in index order if it fits, so
+			// meshes made of small islands still fill their meshlets.
+			if (best == triangleCount && candidates.empty())
+			{
+				while (seed < triangleCount && used[seed])
+				{
+					++seed;
+				}
+				if (seed < triangleCount)
+				{
+					std::uint32_t newVertices = 0;
+					for (int k = 0; k < 3; ++k)
+					{
+						newVertices += local[indices[seed * 3 + k]] == NotInMeshlet ? 1 : 0;
+					}
+					best = meshlet.VertexCount + newVertices <= MeshletMaxVertices ? seed : triangleCount;
+				}
+			}
+
+			if (best == triangleCount)
+			{
+				break;
+			}
+			next = best;
+		}
+
+		for (std::uint32_t i = 0; i < meshlet.VertexCount; ++i)
+		{
+			local[data.Vertices[meshlet.VertexOffset + i]] = NotInMeshlet;
+		}
+		data.Meshlets.push_back(meshlet);
+	}
+
+	data.Bounds.reserve(data.Meshlets.size());
+	for (const Meshlet& meshlet : data.Meshlets)
+	{
+		data.Bounds.push_back(ComputeBounds(data, meshlet, positions, stride));
+	}
+	return data;
+}
+
+MeshletStats AnalyzeMeshlets(const MeshletData& meshlets)
+{
+	MeshletStats stats;
+	stats.Meshlets = (std::uint32_t)meshlets.Meshlets.size();
+	if (stats.Meshlets == 0)
+	{
+		return stats;
+	}
+
+	stats.VertexFill = meshlets.Vertices.size() / float(stats.Meshlets * MeshletMaxVertices);
+	stats.TriangleFill = meshlets.Triangles.size() / float(stats.Meshlets * MeshletMaxTriangles);
+	for (const MeshletBounds& bounds : meshlets.Bounds)
+	{
+		stats.ConeCullable += bounds.ConeCutoff <= 1.0f ? 1 : 0;
+	}
+	return stats;
+}
+
+std::vector<std::uint8_t> PackMeshlets(const MeshletData& meshlets)
+{
+	auto align = [](std::uint32_t offset) { return (offset + 15) & ~15u; };
+
+	MeshletBlobHeader header;
+	header.MeshletCount = (std::uint32_t)meshlets.Meshlets.size();
+	header.VertexCount = (std::uint32_t)meshlets.Vertices.size();
+	header.TriangleCount = (std::uint32_t)meshlets.Triangles.size();
+	header.MeshletsOffset = align(sizeof(MeshletBlobHeader));
+	header.BoundsOffset = align(header.MeshletsOffset + header.MeshletCount * (std::uint32_t)sizeof(Meshlet));
+	header.VerticesOffset = align(header.BoundsOffset + header.MeshletCount * (std::uint32_t)sizeof(MeshletBounds));
+	header.TrianglesOffset = align(header.VerticesOffset + header.VertexCount * (std::uint32_t)sizeof(std::uint32_t));
+	header.ByteSize = align(header.TrianglesOffset + header.TriangleCount * (std::uint32_t)sizeof(std::uint32_t));
+
+	std::vector<std::uint8_t> blob(header.ByteSize, 0);
+	std::memcpy(blob.data(), &header, sizeof(header));
+	if (header.MeshletCount > 0)
+	{
+		std::memcpy(&blob[header.MeshletsOffset], meshlets.Meshlets.data(), header.MeshletCount * sizeof(Meshlet));
+		std::memcpy(&blob[header.BoundsOffset], meshlets.Bounds.data(), header.MeshletCount * sizeof(MeshletBounds));
+	}
+	if (header.VertexCount > 0)
+	{
+		std::memcpy(&blob[header.VerticesOffset], meshlets.Vertices.data(), header.VertexCount * sizeof(std::uint32_t));
+	}
+	if (header.TriangleCount > 0)
+	{
+		std::memcpy(&blob[header.TrianglesOffset], meshlets.Triangles.data(), header.TriangleCount * sizeof(std::uint32_t));
+	}
+	return blob;
+}
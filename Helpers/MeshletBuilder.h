@@ -0,0 +1,95 @@
+// MeshletBuilder.h : splits an indexed triangle list into meshlets for a mesh shader or compute culling path.
+//
+// A meshlet has at most MeshletMaxVertices vertices and MeshletMaxTriangles triangles.  It grows greedily
+// from the triangles bordering it : the one adding the fewest new vertices goes next, ties broken by the
+// distance of its centroid to the meshlet's, so meshlets stay round and fill up.  With an empty border the
+// next triangle left in index order goes in, a meshlet is closed once nothing fits any more and the next one
+// starts at the first triangle left (run OptimizeVertexCache first, that order already has locality).
+//
+// Each meshlet gets culling data :
+//   - a bounding sphere of its vertices,
+//   - a normal cone : every triangle normal lies within the cone's half angle of its axis.  The apex sits
+//     behind the plane of every triangle, so a camera for which
+//         dot(normalize(ConeApex - camera), ConeAxis) >= ConeCutoff
+//     sees all of them from the back.  ConeCutoff is above 1 when the normals spread over more than a half
+//     sphere and the cone can't cull.
+// Front faces follow GeometryGenerator : normal = cross(p1 - p0, p2 - p0) points out of the front.
+//
+// PackMeshlets lays everything out in one buffer for upload, see MeshletBlobHeader.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+const std::uint32_t MeshletMaxVertices = 64;
+const std::uint32_t MeshletMaxTriangles = 124;
+
+// 16 bytes, as read by a StructuredBuffer.
+struct Meshlet
+{
+	std::uint32_t VertexOffset;		// first entry in MeshletData::Vertices
+	std::uint32_t TriangleOffset;	// first entry in MeshletData::Triangles
+	std::uint32_t VertexCount;
+	std::uint32_t TriangleCount;
+};
+
+// 48 bytes, three float4.
+struct MeshletBounds
+{
+	float Center[3];
+	float Radius;
+	float ConeApex[3];
+	float ConeCutoff;				// sine of the normal cone's half angle, above 1 when culling is off
+	float ConeAxis[3];
+	float Pad;
+};
+static_assert(sizeof(Meshlet) == 16 && sizeof(MeshletBounds) == 48, "meshlet layouts are shared with the GPU");
+
+struct MeshletData
+{
+	std::vector<Meshlet> Meshlets;
+	std::vector<MeshletBounds> Bounds;				// one per meshlet
+	std::vector<std::uint32_t> Vertices;			// mesh vertex indices
+	std::vector<std::uint32_t> Triangles;			// three 8 bit meshlet vertex indices per triangle, bits 0-7, 8-15, 16-23
+
+	// meshlet vertex k of a triangle.
+	static std::uint32_t Corner(std::uint32_t triangle, int k) { return (triangle >> (8 * k)) & 0xff; }
+};
+
+struct MeshletStats
+{
+	std::uint32_t Meshlets = 0;
+	float VertexFill = 0.0f;		// average vertices per meshlet over MeshletMaxVertices
+	float TriangleFill = 0.0f;		// average triangles per meshlet over MeshletMaxTriangles
+	std::uint32_t ConeCullable = 0;	// meshlets whose normal cone can cull
+};
+
+// positions points at the x, y, z floats of the first vertex, stride bytes apart.
+MeshletData BuildMeshlets(const std::vector<std::uint32_t>& indices, const float* positions, std::size_t stride, std::size_t vertexCount);
+MeshletStats AnalyzeMeshlets(const MeshletData& meshlets);
+
+// true when every triangle of the meshlet faces away from a camera at cameraPosition.
+inline bool MeshletBackfacing(const MeshletBounds& bounds, const float cameraPosition[3])
+{
+	float d[3] = { bounds.ConeApex[0] - cameraPosition[0], bounds.ConeApex[1] - cameraPosition[1], bounds.ConeApex[2] - cameraPosition[2] };
+	float projection = d[0] * bounds.ConeAxis[0] + d[1] * bounds.ConeAxis[1] + d[2] * bounds.ConeAxis[2];
+	float length2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+	return projection >= 0.0f && projection * projection >= bounds.ConeCutoff * bounds.ConeCutoff * length2;
+}
+
+// the buffer PackMeshlets writes starts with this header, the arrays follow at 16 byte aligned byte offsets.
+struct MeshletBlobHeader
+{
+	std::uint32_t MeshletCount;
+	std::uint32_t VertexCount;
+	std::uint32_t TriangleCount;
+	std::uint32_t MeshletsOffset;	// Meshlet[MeshletCount]
+	std::uint32_t BoundsOffset;		// MeshletBounds[MeshletCount]
+	std::uint32_t VerticesOffset;	// uint32[VertexCount]
+	std::uint32_t TrianglesOffset;	// uint32[TriangleCount]
+	std::uint32_t ByteSize;
+};
+
+std::vector<std::uint8_t> PackMeshlets(const MeshletData& meshlets);
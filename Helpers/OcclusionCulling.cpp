@@ -0,0 +1,368 @@
+// OcclusionCulling.cpp
+
+#include "OcclusionCulling.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define OCCLUSION_CULL_AVX 1
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define OCCLUSION_CULL_SSE 1
+#endif
+
+namespace
+{
+	const std::uint32_t FullTile = 0xffffffffu;
+
+	// edge function a * x + b * y + c, positive inside a clockwise triangle (screen y goes down).
+	struct Edge
+	{
+		float A;
+		float B;
+		float C;
+	};
+
+	Edge MakeEdge(const float* from, const float* to)
+	{
+		Edge edge;
+		edge.A = from[1] - to[1];
+		edge.B = to[0] - from[0];
+		edge.C = -(edge.A * from[0] + edge.B * from[1]);
+		return edge;
+	}
+
+	// pixels of the tile at (x, y) whose centers are inside all three edges, bit row * TileWidth + column.
+	std::uint32_t TileCoverage(const Edge edges[3], float x, float y)
+	{
+		std::uint32_t coverage = 0;
+
+#if OCCLUSION_CULL_AVX
+		__m256 columns = _mm256_add_ps(_mm256_set1_ps(x), _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f));
+		__m256 edgeX[3];
+		for (int k = 0; k < 3; ++k)
+		{
+			edgeX[k] = _mm256_mul_ps(_mm256_set1_ps(edges[k].A), columns);
+		}
+
+		for (std::uint32_t row = 0; row < MaskedOcclusionBuffer::TileHeight; ++row)
+		{
+			float py = y + (float)row + 0.5f;
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (int k = 0; k < 3; ++k)
+			{
+				__m256 value = _mm256_add_ps(edgeX[k], _mm256_set1_ps(edges[k].B * py + edges[k].C));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(value, _mm256_setzero_ps(), _CMP_GE_OQ));
+			}
+			coverage |= (std::uint32_t)_mm256_movemask_ps(inside) << (row * MaskedOcclusionBuffer::TileWidth);
+		}
+#elif OCCLUSION_CULL_SSE
+		// the row as two 4 wide halves.
+		__m128 columns0 = _mm_add_ps(_mm_set1_ps(x), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f));
+		__m128 columns1 = _mm_add_ps(_mm_set1_ps(x), _mm_setr_ps(4.5f, 5.5f, 6.5f, 7.5f));
+		__m128 edgeX0[3], edgeX1[3];
+		for (int k = 0; k < 3; ++k)
+		{
+			__m128 a = _mm_set1_ps(edges[k].A);
+			edgeX0[k] = _mm_mul_ps(a, columns0);
+			edgeX1[k] = _mm_mul_ps(a, columns1);
+		}
+
+		for (std::uint32_t row = 0; row < MaskedOcclusionBuffer::TileHeight; ++row)
+		{
+			float py = y + (float)row + 0.5f;
+			__m128 inside0 = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			__m128 inside1 = inside0;
+			for (int k = 0; k < 3; ++k)
+			{
+				__m128 rowValue = _mm_set1_ps(edges[k].B * py + edges[k].C);
+				inside0 = _mm_and_ps(inside0, _mm_cmpge_ps(_mm_add_ps(edgeX0[k], rowValue), _mm_setzero_ps()));
+				inside1 = _mm_and_ps(inside1, _mm_cmpge_ps(_mm_add_ps(edgeX1[k], rowValue), _mm_setzero_ps()));
+			}
+			std::uint32_t bits = (std::uint32_t)_mm_movemask_ps(inside0) | ((std::uint32_t)_mm_movemask_ps(inside1) << 4);
+			coverage |= bits << (row * MaskedOcclusionBuffer::TileWidth);
+		}
+#else
+		for (std::uint32_t row = 0; row < MaskedOcclusionBuffer::TileHeight; ++row)
+		{
+			float py = y + (float)row + 0.5f;
+			for (std::uint32_t column = 0; column < MaskedOcclusionBuffer::TileWidth; ++column)
+			{
+				float px = x + (float)column + 0.5f;
+				bool inside = true;
+				for (int k = 0; k < 3; ++k)
+				{
+					inside = inside && edges[k].A * px + (edges[k].B * py + edges[k].C) >= 0.0f;
+				}
+				coverage |= (std::uint32_t)inside << (row * MaskedOcclusionBuffer::TileWidth + column);
+			}
+		}
+#endif
+
+		return coverage;
+	}
+}
+
+void MaskedOcclusionBuffer::Resize(std::uint32_t width, std::uint32_t height)
+{
+	mTilesX = (width + TileWidth - 1) / TileWidth;
+	mTilesY = (height + TileHeight - 1) / TileHeight;
+	mBlocksX = (mTilesX + BlockTiles - 1) / BlockTiles;
+	mBlocksY = (mTilesY + BlockTiles - 1) / BlockTiles;
+
+	mZ0.resize(mTilesX * mTilesY);
+	mZ1.resize(mTilesX * mTilesY);
+	mMask.resize(mTilesX * mTilesY);
+	mBlockZ.resize(mBlocksX * mBlocksY);
+	Clear();
+}
+
+void MaskedOcclusionBuffer::Clear()
+{
+	std::fill(mZ0.begin(), mZ0.end(), 1.0f);
+	std::fill(mZ1.begin(), mZ1.end(), 0.0f);
+	std::fill(mMask.begin(), mMask.end(), 0u);
+	std::fill(mBlockZ.begin(), mBlockZ.end(), 1.0f);
+	mStats = OcclusionStats();
+}
+
+void MaskedOcclusionBuffer::RenderMesh(const OccluderMesh& mesh, const float m[4][4])
+{
+	const float width = (float)Width();
+	const float height = (float)Height();
+
+	// screen space x, y (pixels, y down) and depth of every vertex, with its clip z for the near plane test.
+	std::size_t vertexCount = mesh.Positions.size() / 3;
+	mClip.resize(vertexCount * 4);
+	for (std::size_t i = 0; i < vertexCount; ++i)
+	{
+		const float* p = &mesh.Positions[i * 3];
+		float x = p[0] * m[0][0] + p[1] * m[1][0] + p[2] * m[2][0] + m[3][0];
+		float y = p[0] * m[0][1] + p[1] * m[1][1] + p[2] * m[2][1] + m[3][1];
+		float z = p[0] * m[0][2] + p[1] * m[1][2] + p[2] * m[2][2] + m[3][2];
+		float w = p[0] * m[0][3] + p[1] * m[1][3] + p[2] * m[2][3] + m[3][3];
+
+		float* out = &mClip[i * 4];
+		out[3] = z;
+		if (z >= 0.0f && w > 0.0f)
+		{
+			float invW = 1.0f / w;
+			out[0] = (x * invW * 0.5f + 0.5f) * width;
+			out[1] = (0.5f - y * invW * 0.5f) * height;
+			out[2] = z * invW;
+		}
+	}
+
+	std::size_t triangleCount = mesh.Indices.size() / 3;
+	mStats.Triangles += (std::uint32_t)triangleCount;
+	for (std::size_t t = 0; t < triangleCount; ++t)
+	{
+		const float* v0 = &mClip[mesh.Indices[t * 3 + 0] * 4];
+		const float* v1 = &mClip[mesh.Indices[t * 3 + 1] * 4];
+		const float* v2 = &mClip[mesh.Indices[t * 3 + 2] * 4];
+
+		// in front of the near plane : no clipping, the triangle is simply not used as an occluder.
+		if (v0[3] < 0.0f || v1[3] < 0.0f || v2[3] < 0.0f)
+		{
+			continue;
+		}
+		RenderTriangle(v0, v1, v2);
+	}
+}
+
+void MaskedOcclusionBuffer::RenderTriangle(const float* v0, const float* v1, const float* v2)
+{
+	// clockwise on screen is a positive area with y going down.
+	float area = (v1[0] - v0[0]) * (v2[1] - v0[1]) - (v1[1] - v0[1]) * (v2[0] - v0[0]);
+	if (!(area > 0.0f))
+	{
+		return;
+	}
+
+	float minX = std::min(v0[0], std::min(v1[0], v2[0]));
+	float maxX = std::max(v0[0], std::max(v1[0], v2[0]));
+	float minY = std::min(v0[1], std::min(v1[1], v2[1]));
+	float maxY = std::max(v0[1], std::max(v1[1], v2[1]));
+
+	// pixels whose centers can be inside the triangle.
+	// clamped as floats first, vertices close to the eye land far outside the screen.
+	int pixelX0 = (int)std::max(0.0f, std::ceil(minX - 0.5f));
+	int pixelX1 = (int)std::min((float)Width() - 1.0f, std::floor(maxX - 0.5f));
+	int pixelY0 = (int)std::max(0.0f, std::ceil(minY - 0.5f));
+	int pixelY1 = (int)std::min((float)Height() - 1.0f, std::floor(maxY - 0.5f));
+	if (pixelX0 > pixelX1 || pixelY0 > pixelY1)
+	{
+		return;
+	}
+	mStats.Rasterized++;
+
+	// depth plane z0 + dzdx * (x - x0) + dzdy * (y - y0), and the farthest depth the triangle reaches.
+	float dz1 = v1[2] - v0[2];
+	float dz2 = v2[2] - v0[2];
+	float dzdx = (dz1 * (v2[1] - v0[1]) - dz2 * (v1[1] - v0[1])) / area;
+	float dzdy = (dz2 * (v1[0] - v0[0]) - dz1 * (v2[0] - v0[0])) / area;
+	float farthest = std::max(v0[2], std::max(v1[2], v2[2]));
+
+	const Edge edges[3] = { MakeEdge(v0, v1), MakeEdge(v1, v2), MakeEdge(v2, v0) };
+
+	for (std::uint32_t tileY = pixelY0 / TileHeight; tileY <= (std::uint32_t)pixelY1 / TileHeight; ++tileY)
+	{
+		float y = (float)(tileY * TileHeight);
+		float rectY0 = std::max(y, minY) - v0[1];
+		float rectY1 = std::min(y + TileHeight, maxY) - v0[1];
+		float farthestY = std::max(dzdy * rectY0, dzdy * rectY1);
+
+		for (std::uint32_t tileX = pixelX0 / TileWidth; tileX <= (std::uint32_t)pixelX1 / TileWidth; ++tileX)
+		{
+			float x = (float)(tileX * TileWidth);
+			std::uint32_t coverage = TileCoverage(edges, x, y);
+			if (coverage == 0)
+			{
+				continue;
+			}
+
+			// the plane is farthest at a corner of the part of the bounding box inside the tile.
+			float rectX0 = std::max(x, minX) - v0[0];
+			float rectX1 = std::min(x + TileWidth, maxX) - v0[0];
+			float depth = v0[2] + std::max(dzdx * rectX0, dzdx * rectX1) + farthestY;
+
+			UpdateTile(tileY * mTilesX + tileX, coverage, std::min(depth, farthest));
+		}
+	}
+}
+
+void MaskedOcclusionBuffer::UpdateTile(std::uint32_t tile, std::uint32_t coverage, float depth)
+{
+	mStats.TileUpdates++;
+
+	float z0 = mZ0[tile];
+	if (depth >= z0)
+	{
+		return;		// behind the reference layer, it cannot bring it closer
+	}
+
+	float z1 = mZ1[tile];
+	std::uint32_t mask = mMask[tile];
+
+	// a triangle much closer than the working layer starts a new one, the old layer would hold it back.
+	if (mask != 0 && z1 - depth > z0 - z1)
+	{
+		z1 = 0.0f;
+		mask = 0;
+	}
+
+	z1 = std::max(z1, depth);
+	mask |= coverage;
+
+	// a full working layer becomes the reference.
+	if (mask == FullTile)
+	{
+		mZ0[tile] = std::min(z0, z1);
+		z1 = 0.0f;
+		mask = 0;
+	}
+
+	mZ1[tile] = z1;
+	mMask[tile] = mask;
+}
+
+void MaskedOcclusionBuffer::Finalize()
+{
+	for (std::uint32_t blockY = 0; blockY < mBlocksY; ++blockY)
+	{
+		for (std::uint32_t blockX = 0; blockX < mBlocksX; ++blockX)
+		{
+			std::uint32_t tileX1 = std::min(mTilesX, (blockX + 1) * BlockTiles);
+			std::uint32_t tileY1 = std::min(mTilesY, (blockY + 1) * BlockTiles);
+
+			float farthest = 0.0f;
+			for (std::uint32_t tileY = blockY * BlockTiles; tileY < tileY1; ++tileY)
+			{
+				for (std::uint32_t tileX = blockX * BlockTiles; tileX < tileX1; ++tileX)
+				{
+					farthest = std::max(farthest, mZ0[tileY * mTilesX + tileX]);
+				}
+			}
+			mBlockZ[blockY * mBlocksX + blockX] = farthest;
+		}
+	}
+}
+
+bool MaskedOcclusionBuffer::TestRect(float minX, float minY, float maxX, float maxY, float nearestDepth)const
+{
+	// every tile the rectangle touches, not only the pixel centers : the real render target has more pixels.
+	float x0 = (minX * 0.5f + 0.5f) * Width();
+	float x1 = (maxX * 0.5f + 0.5f) * Width();
+	float y0 = (0.5f - maxY * 0.5f) * Height();
+	float y1 = (0.5f - minY * 0.5f) * Height();
+	if (x1 < 0.0f || y1 < 0.0f || x0 > (float)Width() || y0 > (float)Height())
+	{
+		return false;
+	}
+
+	std::uint32_t tileX0 = (std::uint32_t)std::max(0.0f, x0) / TileWidth;
+	std::uint32_t tileY0 = (std::uint32_t)std::max(0.0f, y0) / TileHeight;
+	std::uint32_t tileX1 = std::min(mTilesX - 1, (std::uint32_t)std::min(x1, (float)Width()) / TileWidth);
+	std::uint32_t tileY1 = std::min(mTilesY - 1, (std::uint32_t)std::min(y1, (float)Height()) / TileHeight);
+
+	for (std::uint32_t blockY = tileY0 / BlockTiles; blockY <= tileY1 / BlockTiles; ++blockY)
+	{
+		for (std::uint32_t blockX = tileX0 / BlockTiles; blockX <= tileX1 / BlockTiles; ++blockX)
+		{
+			// the whole block is in front of the object.
+			if (nearestDepth > mBlockZ[blockY * mBlocksX + blockX])
+			{
+				continue;
+			}
+
+			std::uint32_t rowEnd = std::min(tileY1 + 1, (blockY + 1) * BlockTiles);
+			std::uint32_t columnEnd = std::min(tileX1 + 1, (blockX + 1) * BlockTiles);
+			for (std::uint32_t tileY = std::max(tileY0, blockY * BlockTiles); tileY < rowEnd; ++tileY)
+			{
+				for (std::uint32_t tileX = std::max(tileX0, blockX * BlockTiles); tileX < columnEnd; ++tileX)
+				{
+					if (nearestDepth <= mZ0[tileY * mTilesX + tileX])
+					{
+						return true;
+					}
+				}
+			}
+		}
+	}
+	return false;
+}
+
+bool MaskedOcclusionBuffer::TestAabb(const float boxMin[3], const float boxMax[3], const float m[4][4])const
+{
+	float minX = std::numeric_limits<float>::max(), minY = minX;
+	float maxX = -minX, maxY = -minX;
+	float nearest = 1.0f;
+
+	// the depth is monotonic in view z, so the box's nearest point is one of its corners.
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		float px = (corner & 1) ? boxMax[0] : boxMin[0];
+		float py = (corner & 2) ? boxMax[1] : boxMin[1];
+		float pz = (corner & 4) ? boxMax[2] : boxMin[2];
+
+		float x = px * m[0][0] + py * m[1][0] + pz * m[2][0] + m[3][0];
+		float y = px * m[0][1] + py * m[1][1] + pz * m[2][1] + m[3][1];
+		float z = px * m[0][2] + py * m[1][2] + pz * m[2][2] + m[3][2];
+		float w = px * m[0][3] + py * m[1][3] + pz * m[2][3] + m[3][3];
+		if (z < 0.0f || w <= 0.0f)
+		{
+			return true;
+		}
+
+		float invW = 1.0f / w;
+		minX = std::min(minX, x * invW);
+		maxX = std::max(maxX, x * invW);
+		minY = std::min(minY, y * invW);
+		maxY = std::max(maxY, y * invW);
+		nearest = std::min(nearest, z * invW);
+	}
+
+	return TestRect(minX, minY, maxX, maxY, nearest);
+}
@@ -0,0 +1,84 @@
+// OcclusionCulling.h : software occlusion culling with a masked hierarchical depth buffer.
+//
+// Large occluders are rasterized on the CPU into a small depth buffer made of 8 x 4 pixel tiles.  A tile
+// does not store per pixel depths : it keeps a reference depth that holds for the whole tile, plus a working
+// layer made of a 32 bit coverage mask and the farthest depth of the triangles merged into it.  Once the
+// working layer covers the whole tile it replaces the reference depth (masked occlusion culling, Andersson
+// et al.).  Coverage is computed one tile row per AVX register, or two SSE halves, with edge functions.
+// Finalize() keeps the farthest reference depth of every 4 x 4 tile block, so most occludee tests are
+// decided without touching the tiles.
+//
+// Depths follow D3D : 0 at the near plane, 1 at the far plane.  Everything is conservative, an object is
+// only reported occluded when every tile its screen rectangle touches is in front of it.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// an occluder at a coarse level of detail : object space positions (x, y, z per vertex) and three indices
+// per triangle, front faces clockwise.  It must lie inside the object it stands for.
+struct OccluderMesh
+{
+	std::vector<float> Positions;
+	std::vector<std::uint32_t> Indices;
+};
+
+struct OcclusionStats
+{
+	std::uint32_t Triangles = 0;		// submitted since the last Clear()
+	std::uint32_t Rasterized = 0;		// left after near plane, back face and screen rejection
+	std::uint32_t TileUpdates = 0;		// tiles a triangle covered part of
+};
+
+class MaskedOcclusionBuffer
+{
+public:
+	static const std::uint32_t TileWidth = 8;
+	static const std::uint32_t TileHeight = 4;
+	static const std::uint32_t BlockTiles = 4;		// coarse level : blocks of BlockTiles x BlockTiles tiles
+
+	// size in pixels, rounded up to whole tiles.  The buffer is cleared.
+	void Resize(std::uint32_t width, std::uint32_t height);
+	void Clear();
+
+	// rasterizes the front faces of mesh, transformed by a row vector model * view * projection matrix.
+	// Triangles crossing the near plane are skipped, which only makes the buffer less occluding.
+	void RenderMesh(const OccluderMesh& mesh, const float modelViewProj[4][4]);
+
+	// builds the coarse level, call it between rendering the occluders and testing.
+	void Finalize();
+
+	// false when the rectangle (normalized device coordinates, y up) is hidden everywhere behind depths
+	// closer than nearestDepth.
+	bool TestRect(float minX, float minY, float maxX, float maxY, float nearestDepth)const;
+
+	// false when the world space box is hidden.  Boxes reaching in front of the near plane are visible.
+	bool TestAabb(const float boxMin[3], const float boxMax[3], const float viewProj[4][4])const;
+
+	std::uint32_t Width()const { return mTilesX * TileWidth; }
+	std::uint32_t Height()const { return mTilesY * TileHeight; }
+
+	// depth every pixel of the tile is known to be in front of, 1 when nothing covers it.
+	float TileDepth(std::uint32_t tileX, std::uint32_t tileY)const { return mZ0[tileY * mTilesX + tileX]; }
+
+	const OcclusionStats& Stats()const { return mStats; }
+
+private:
+	void RenderTriangle(const float* v0, const float* v1, const float* v2);
+	void UpdateTile(std::uint32_t tile, std::uint32_t coverage, float depth);
+
+private:
+	std::uint32_t mTilesX = 0;
+	std::uint32_t mTilesY = 0;
+	std::uint32_t mBlocksX = 0;
+	std::uint32_t mBlocksY = 0;
+
+	std::vector<float> mZ0;				// reference layer of every tile
+	std::vector<float> mZ1;				// farthest depth of the working layer
+	std::vector<std::uint32_t> mMask;	// pixels of the working layer, bit row * TileWidth + column
+	std::vector<float> mBlockZ;			// farthest reference depth of every block
+
+	std::vector<float> mClip;			// RenderMesh's vertices, screen x, y, depth and clip z
+	OcclusionStats mStats;
+};
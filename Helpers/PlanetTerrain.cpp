@@ -0,0 +1,337 @@
+// PlanetTerrain.cpp
+
+#include "PlanetTerrain.h"
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+namespace
+{
+	const double HalfPi = 1.5707963267948966;
+	const double TwoPi = 6.283185307179586;
+
+	double CellWidth(std::uint32_t level)
+	{
+		return 1.0 / (double)(1u << level);
+	}
+
+	// (u, v) of a point of face past one of its edges, folded onto the face it went over.
+	void FoldOntoFace(std::uint32_t& face, double& u, double& v)
+	{
+		double normal[3], axisU[3], axisV[3];
+		CubeFaceAxes(face, normal, axisU, axisV);
+
+		double s = 2.0 * u - 1.0, t = 2.0 * v - 1.0;
+		double out[3];
+		double excess;
+		if (s < -1.0 || s > 1.0)
+		{
+			excess = std::fabs(s) - 1.0;
+			s = s < 0.0 ? -1.0 : 1.0;
+			for (int k = 0; k < 3; ++k)
+				out[k] = s * axisU[k];
+		}
+		else
+		{
+			excess = std::fabs(t) - 1.0;
+			t = t < 0.0 ? -1.0 : 1.0;
+			for (int k = 0; k < 3; ++k)
+				out[k] = t * axisV[k];
+		}
+
+		// on the edge, then down the other face by as much as it went past.
+		double point[3];
+		for (int k = 0; k < 3; ++k)
+		{
+			point[k] = (1.0 - excess) * normal[k] + s * axisU[k] + t * axisV[k];
+		}
+		for (std::uint32_t other = 0; other < 6; ++other)
+		{
+			double otherNormal[3], otherU[3], otherV[3];
+			CubeFaceAxes(other, otherNormal, otherU, otherV);
+			if (otherNormal[0] == out[0] && otherNormal[1] == out[1] && otherNormal[2] == out[2])
+			{
+				face = other;
+				u = 0.5 * (point[0] * otherU[0] + point[1] * otherU[1] + point[2] * otherU[2] + 1.0);
+				v = 0.5 * (point[0] * otherV[0] + point[1] * otherV[1] + point[2] * otherV[2] + 1.0);
+				return;
+			}
+		}
+	}
+}
+
+bool TerrainQuadtree::WantsSplit(const CubeQuadKey& key, const float eye[3], float& priority)const
+{
+	// a face spans a quarter of a great circle, its cells about as much of it as of the face.
+	double cell = CellWidth(key.Level);
+	double width = HalfPi * cell;
+	double center[3];
+	CubeFacePoint(key.Face, (key.X + 0.5) * cell, (key.Y + 0.5) * cell, center);
+
+	double dx = eye[0] - center[0], dy = eye[1] - center[1], dz = eye[2] - center[2];
+	double distance = std::sqrt(dx * dx + dy * dy + dz * dz) - 0.75 * width - mSettings.HeightScale;
+	distance = std::max(distance, 1e-9);
+	priority = (float)(width / distance);
+
+	double splitDistance = mSettings.SplitDistance;
+	if (mWasSplit.count(key.Packed()))
+	{
+		splitDistance /= mSettings.Hysteresis;
+	}
+	return key.Level < mSettings.MaxLevel && distance < splitDistance * width;
+}
+
+std::int32_t TerrainQuadtree::NeighbourLeaf(const CubeQuadKey& key, std::uint32_t edge)const
+{
+	// the centre of the cell of the same size across the edge, on whichever face it lies.
+	double cell = CellWidth(key.Level);
+	double u = (key.X + 0.5) * cell, v = (key.Y + 0.5) * cell;
+	u += edge == TerrainEdgeU0 ? -cell : (edge == TerrainEdgeU1 ? cell : 0.0);
+	v += edge == TerrainEdgeV0 ? -cell : (edge == TerrainEdgeV1 ? cell : 0.0);
+	std::uint32_t face = key.Face;
+	if (u < 0.0 || u > 1.0 || v < 0.0 || v > 1.0)
+	{
+		FoldOntoFace(face, u, v);
+	}
+
+	// down that face's tree to the leaf holding it, no deeper than key.
+	std::int32_t node = (std::int32_t)face;
+	while (mNodes[node].FirstChild >= 0 && mNodes[node].Key.Level < key.Level)
+	{
+		const CubeQuadKey& parent = mNodes[node].Key;
+		double childCells = (double)(2u << parent.Level);
+		std::uint32_t cx = (std::uint32_t)(u * childCells) - parent.X * 2;
+		std::uint32_t cy = (std::uint32_t)(v * childCells) - parent.Y * 2;
+		node = mNodes[node].FirstChild + (std::int32_t)(cy * 2 + cx);
+	}
+	return node;
+}
+
+void TerrainQuadtree::CollectForcedSplits(std::int32_t node, std::vector<std::int32_t>& forced, std::unordered_set<std::int32_t>& visited)const
+{
+	// the tree is balanced, a coarser neighbour is one level up, and needs its own coarser neighbours split first.
+	const CubeQuadKey key = mNodes[node].Key;
+	for (std::uint32_t edge = TerrainEdgeU0; edge <= TerrainEdgeV1; edge <<= 1)
+	{
+		std::int32_t neighbour = NeighbourLeaf(key, edge);
+		if (mNodes[neighbour].Key.Level < key.Level && visited.insert(neighbour).second)
+		{
+			CollectForcedSplits(neighbour, forced, visited);
+			forced.push_back(neighbour);
+		}
+	}
+}
+
+const std::vector<TerrainPatch>& TerrainQuadtree::Select(const float eye[3], std::uint32_t triangleBudget,
+	const std::function<bool(const CubeQuadKey&)>& dataReady)
+{
+	mStats = TerrainSelectStats();
+	mNodes.clear();
+	mSplit.clear();
+	const std::uint32_t maxPatches = std::max(triangleBudget / PatchTriangles(), 6u);
+
+	// the leaves to split, nearest for their width first.
+	std::priority_queue<std::pair<float, std::int32_t>> candidates;
+	for (std::uint32_t face = 0; face < 6; ++face)
+	{
+		Node root;
+		root.Key = { face, 0, 0, 0 };
+		mNodes.push_back(root);
+		float priority;
+		if (WantsSplit(root.Key, eye, priority))
+		{
+			candidates.push({ priority, (std::int32_t)face });
+		}
+	}
+
+	std::uint32_t leaves = 6;
+	std::vector<std::int32_t> splits;
+	std::unordered_set<std::int32_t> visited;
+	while (!candidates.empty() && leaves + 3 <= maxPatches)
+	{
+		std::int32_t node = candidates.top().second;
+		candidates.pop();
+		if (mNodes[node].FirstChild >= 0)
+		{
+			continue;		// already split for a finer neighbour
+		}
+
+		splits.clear();
+		visited.clear();
+		CollectForcedSplits(node, splits, visited);
+		splits.push_back(node);
+		if (leaves + 3 * (std::uint32_t)splits.size() > maxPatches)
+		{
+			mStats.BudgetLimited = true;
+			continue;
+		}
+
+		// every child's heights have to be there, the missing ones are queued by dataReady.
+		bool ready = true;
+		for (std::int32_t split : splits)
+		{
+			for (std::uint32_t child = 0; child < 4 && dataReady; ++child)
+			{
+				ready = dataReady(mNodes[split].Key.Child(child)) && ready;
+			}
+		}
+		if (!ready)
+		{
+			mStats.WaitingForData++;
+			continue;
+		}
+
+		for (std::int32_t split : splits)
+		{
+			CubeQuadKey key = mNodes[split].Key;
+			mNodes[split].FirstChild = (std::int32_t)mNodes.size();
+			for (std::uint32_t child = 0; child < 4; ++child)
+			{
+				Node childNode;
+				childNode.Key = key.Child(child);
+				mNodes.push_back(childNode);
+				float priority;
+				if (WantsSplit(childNode.Key, eye, priority))
+				{
+					candidates.push({ priority, (std::int32_t)mNodes.size() - 1 });
+				}
+			}
+			mSplit.insert(key.Packed());
+			leaves += 3;
+		}
+		mStats.Splits += (std::uint32_t)splits.size();
+		mStats.ForcedSplits += (std::uint32_t)splits.size() - 1;
+	}
+	mStats.BudgetLimited = mStats.BudgetLimited || !candidates.empty();
+
+	// the leaves, and which of their neighbours are coarser.
+	mPatches.clear();
+	for (const Node& node : mNodes)
+	{
+		if (node.FirstChild >= 0)
+		{
+			continue;
+		}
+		TerrainPatch patch = { node.Key, 0 };
+		for (std::uint32_t edge = TerrainEdgeU0; edge <= TerrainEdgeV1; edge <<= 1)
+		{
+			if (mNodes[NeighbourLeaf(node.Key, edge)].Key.Level < node.Key.Level)
+			{
+				patch.StitchMask |= edge;
+			}
+		}
+		mPatches.push_back(patch);
+		mStats.DeepestLevel = std::max(mStats.DeepestLevel, node.Key.Level);
+	}
+	mStats.Patches = (std::uint32_t)mPatches.size();
+	mStats.Triangles = mStats.Patches * PatchTriangles();
+
+	mWasSplit.swap(mSplit);
+	return mPatches;
+}
+
+void BuildTerrainPatch(const CubeQuadKey& key, const TerrainSettings& settings, const TerrainHeightTile& tile, TerrainVertex* vertices)
+{
+	// face and tile coordinates as an integer over a power of two, so any patch computes the same point
+	// and height for a vertex it shares with another.
+	const std::uint32_t gridSize = settings.GridSize;
+	const double segments = gridSize - 1;
+	const double faceScale = 1.0 / (segments * (double)(1u << key.Level));
+	const std::uint32_t shift = key.Level - tile.Key.Level;
+	const double tileScale = 1.0 / (double)(1u << shift);
+	const double tileX = (double)(key.X - (tile.Key.X << shift)) * segments;
+	const double tileY = (double)(key.Y - (tile.Key.Y << shift)) * segments;
+
+	// texture coordinates of the lat-long maps, unwrapped around the patch's centre.
+	double center[3];
+	CubeFacePoint(key.Face, (key.X + 0.5) / (double)(1u << key.Level), (key.Y + 0.5) / (double)(1u << key.Level), center);
+	double centerU = std::atan2(center[2], center[0]) / TwoPi;
+	centerU += centerU < 0.0 ? 1.0 : 0.0;
+
+	for (std::uint32_t j = 0; j < gridSize; ++j)
+	{
+		for (std::uint32_t i = 0; i < gridSize; ++i)
+		{
+			double point[3];
+			CubeFacePoint(key.Face, ((double)key.X * segments + i) * faceScale, ((double)key.Y * segments + j) * faceScale, point);
+			double radius = 1.0 + settings.HeightScale * tile.Sample(gridSize, (tileX + i) * tileScale, (tileY + j) * tileScale);
+
+			TerrainVertex& vertex = vertices[j * gridSize + i];
+			for (int k = 0; k < 3; ++k)
+			{
+				vertex.Position[k] = (float)(point[k] * radius);
+			}
+			double texU = std::atan2(point[2], point[0]) / TwoPi;
+			texU += texU - centerU > 0.5 ? -1.0 : (texU - centerU < -0.5 ? 1.0 : 0.0);
+			vertex.TexC[0] = (float)texU;
+			vertex.TexC[1] = (float)(std::acos(std::max(-1.0, std::min(1.0, point[1]))) / (0.5 * TwoPi));
+		}
+	}
+
+	// normals across the neighbouring vertices, one sided on the border.
+	for (std::uint32_t j = 0; j < gridSize; ++j)
+	{
+		for (std::uint32_t i = 0; i < gridSize; ++i)
+		{
+			const float* left = vertices[j * gridSize + (i > 0 ? i - 1 : i)].Position;
+			const float* right = vertices[j * gridSize + (i + 1 < gridSize ? i + 1 : i)].Position;
+			const float* down = vertices[(j > 0 ? j - 1 : j) * gridSize + i].Position;
+			const float* up = vertices[(j + 1 < gridSize ? j + 1 : j) * gridSize + i].Position;
+			float du[3] = { right[0] - left[0], right[1] - left[1], right[2] - left[2] };
+			float dv[3] = { up[0] - down[0], up[1] - down[1], up[2] - down[2] };
+			float n[3] = { du[1] * dv[2] - du[2] * dv[1], du[2] * dv[0] - du[0] * dv[2], du[0] * dv[1] - du[1] * dv[0] };
+			float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			float* normal = vertices[j * gridSize + i].Normal;
+			for (int k = 0; k < 3; ++k)
+			{
+				normal[k] = length > 0.0f ? n[k] / length : vertices[j * gridSize + i].Position[k];
+			}
+		}
+	}
+}
+
+TerrainStitchIndices BuildTerrainStitchIndices(std::uint32_t gridSize)
+{
+	TerrainStitchIndices stitch;
+	const std::uint32_t last = gridSize - 1;
+	for (std::uint32_t mask = 0; mask < 16; ++mask)
+	{
+		// the odd vertices of a coarser edge collapse onto the even one before them, the triangles that
+		// become degenerate are left out.
+		auto vertex = [&](std::uint32_t i, std::uint32_t j)
+		{
+			if (((mask & TerrainEdgeU0) && i == 0) || ((mask & TerrainEdgeU1) && i == last))
+				j &= ~1u;
+			if (((mask & TerrainEdgeV0) && j == 0) || ((mask & TerrainEdgeV1) && j == last))
+				i &= ~1u;
+			return (std::uint16_t)(j * gridSize + i);
+		};
+		auto triangle = [&](std::uint16_t a, std::uint16_t b, std::uint16_t c)
+		{
+			if (a != b && b != c && c != a)
+			{
+				stitch.Indices.insert(stitch.Indices.end(), { a, b, c });
+			}
+		};
+
+		stitch.Start[mask] = (std::uint32_t)stitch.Indices.size();
+		for (std::uint32_t j = 0; j < last; ++j)
+		{
+			for (std::uint32_t i = 0; i < last; ++i)
+			{
+				std::uint16_t a = vertex(i, j), b = vertex(i + 1, j), c = vertex(i, j + 1), d = vertex(i + 1, j + 1);
+				if (i + 1 == last && j + 1 == last && (mask & TerrainEdgeU1) && (mask & TerrainEdgeV1))
+				{
+					// b and c collapse away from each other there, the usual diagonal would be a sliver.
+					triangle(a, b, d);
+					triangle(a, d, c);
+					continue;
+				}
+				triangle(a, b, c);
+				triangle(c, b, d);
+			}
+		}
+		stitch.Count[mask] = (std::uint32_t)stitch.Indices.size() - stitch.Start[mask];
+	}
+	return stitch;
+}
@@ -0,0 +1,111 @@
+// PlanetTerrain.h : a planet's surface as six cube-face quadtrees of terrain patches, refined around the
+// camera within a triangle budget.
+//
+// TerrainQuadtree::Select starts every frame from the six faces and splits the patch the eye is the
+// closest to for its width first, as long as it is closer than SplitDistance widths (a patch split in the
+// previous frame stays split until the eye is Hysteresis farther), the heights of its children are
+// resident and the budget allows three more patches.  Splitting a patch first splits its coarser
+// neighbours, across the cube's edges too, so the levels of two patches sharing an edge differ by one at
+// most.  A patch next to a coarser one drops every odd vertex of that edge (StitchMask), and both sides
+// then share the same vertices there : the surface has no cracks and no T-junctions.
+//
+// Patches are GridSize x GridSize vertices, the TileSize of the heights (TerrainHeights.h), so the patch of
+// a cell takes its heights from that cell's tile as is, and a patch deeper than the height data interpolates
+// the tile of its deepest ancestor.  BuildTerrainStitchIndices makes the 16 index lists of a patch, one for
+// every combination of coarser edges.
+
+#pragma once
+
+#include "TerrainHeights.h"
+
+struct TerrainSettings
+{
+	std::uint32_t GridSize = 33;		// vertices along a patch side, 2^n + 1 and at most 129 for 16 bit indices
+	std::uint32_t MaxLevel = 14;		// deepest patches
+	float SplitDistance = 2.5f;			// a patch splits while the eye is closer than this many times its width
+	float Hysteresis = 0.85f;			// ...and merges back once farther than SplitDistance / Hysteresis widths
+	float HeightScale = 0.01f;			// heights in [-1, 1] times this, over the unit sphere
+};
+
+// the edges of a patch, along which its neighbour is coarser.
+const std::uint32_t TerrainEdgeU0 = 1;
+const std::uint32_t TerrainEdgeU1 = 2;
+const std::uint32_t TerrainEdgeV0 = 4;
+const std::uint32_t TerrainEdgeV1 = 8;
+
+struct TerrainPatch
+{
+	CubeQuadKey Key;
+	std::uint32_t StitchMask;			// TerrainEdge bits
+};
+
+struct TerrainSelectStats
+{
+	std::uint32_t Patches = 0;
+	std::uint32_t Triangles = 0;		// without the stitching, the budget bound
+	std::uint32_t Splits = 0;
+	std::uint32_t ForcedSplits = 0;		// splits of coarser neighbours
+	std::uint32_t WaitingForData = 0;	// splits put off until the heights of the children are resident
+	std::uint32_t DeepestLevel = 0;
+	bool BudgetLimited = false;			// a patch wanted to split and the budget had no room for it
+};
+
+class TerrainQuadtree
+{
+public:
+	explicit TerrainQuadtree(const TerrainSettings& settings = TerrainSettings()) : mSettings(settings) {}
+
+	// the patches to draw for eye, given in the planet's object space where it is the unit sphere.  The six
+	// faces are drawn whatever the budget.  dataReady(child) tells whether the heights of a patch are
+	// resident, and may queue them; nullptr when they always are.
+	const std::vector<TerrainPatch>& Select(const float eye[3], std::uint32_t triangleBudget,
+		const std::function<bool(const CubeQuadKey&)>& dataReady = nullptr);
+
+	const std::vector<TerrainPatch>& Patches()const { return mPatches; }
+	const TerrainSelectStats& Stats()const { return mStats; }
+	const TerrainSettings& Settings()const { return mSettings; }
+	std::uint32_t PatchTriangles()const { return 2 * (mSettings.GridSize - 1) * (mSettings.GridSize - 1); }
+
+	// the selected patch across edge of key, at key's level or coarser.
+	CubeQuadKey Neighbour(const CubeQuadKey& key, std::uint32_t edge)const { return mNodes[NeighbourLeaf(key, edge)].Key; }
+
+private:
+	struct Node
+	{
+		CubeQuadKey Key;
+		std::int32_t FirstChild = -1;	// the four children follow each other
+	};
+
+	bool WantsSplit(const CubeQuadKey& key, const float eye[3], float& priority)const;
+	std::int32_t NeighbourLeaf(const CubeQuadKey& key, std::uint32_t edge)const;
+	void CollectForcedSplits(std::int32_t node, std::vector<std::int32_t>& forced, std::unordered_set<std::int32_t>& visited)const;
+
+private:
+	TerrainSettings mSettings;
+	std::vector<Node> mNodes;
+	std::unordered_set<std::uint64_t> mSplit;			// keys split by this selection
+	std::unordered_set<std::uint64_t> mWasSplit;		// and by the previous one, for the hysteresis
+	std::vector<TerrainPatch> mPatches;
+	TerrainSelectStats mStats;
+};
+
+// the Vertex of SolarSystem.cpp.
+struct TerrainVertex
+{
+	float Position[3];
+	float Normal[3];
+	float TexC[2];
+};
+
+// GridSize x GridSize vertices of the patch of key, row by row, in the planet's object space.  tile is the
+// tile of key or of one of its ancestors.
+void BuildTerrainPatch(const CubeQuadKey& key, const TerrainSettings& settings, const TerrainHeightTile& tile, TerrainVertex* vertices);
+
+// the triangle lists of a patch for every StitchMask, one after the other.
+struct TerrainStitchIndices
+{
+	std::vector<std::uint16_t> Indices;
+	std::uint32_t Start[16];
+	std::uint32_t Count[16];
+};
+TerrainStitchIndices BuildTerrainStitchIndices(std::uint32_t gridSize);
@@ -0,0 +1,324 @@
+// RenderQueue.cpp
+
+#include "RenderQueue.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+using std::uint32_t;
+using std::uint64_t;
+
+namespace
+{
+	const std::size_t InsertionSortMax = 64;
+	const std::size_t CacheSortMax = 1 << 16;	// pairs whose LSD passes stay in the L2 cache with their scratch
+	const int SplitBits = 11;					// of the MSD split, 2048 buckets
+	const int DigitBits = 8;					// of the LSD passes
+	const int MaxDigits = (64 + DigitBits - 1) / DigitBits;
+
+	void InsertionSort(uint64_t* keys, uint32_t* values, std::size_t count)
+	{
+		for (std::size_t i = 1; i < count; ++i)
+		{
+			uint64_t key = keys[i];
+			uint32_t value = values[i];
+			std::size_t j = i;
+			for (; j > 0 && keys[j - 1] > key; --j)
+			{
+				keys[j] = keys[j - 1];
+				values[j] = values[j - 1];
+			}
+			keys[j] = key;
+			values[j] = value;
+		}
+	}
+
+	// the bits that differ between any two keys.
+	uint64_t VaryingBits(const uint64_t* keys, std::size_t count)
+	{
+		uint64_t varying = 0;
+		for (std::size_t i = 1; i < count; ++i)
+		{
+			varying |= keys[i] ^ keys[0];
+		}
+		return varying;
+	}
+
+	int HighestBit(uint64_t bits)
+	{
+		int bit = 63;
+		while (!(bits >> bit))
+			--bit;
+		return bit;
+	}
+
+	int LowestBit(uint64_t bits)
+	{
+		int bit = 0;
+		while (!((bits >> bit) & 1))
+			++bit;
+		return bit;
+	}
+
+	// the LSD digits of DigitBits covering the set bits of a varying mask, every digit starting at the lowest
+	// bit the previous one left, and their histograms.
+	struct LsdDigits
+	{
+		int Count = 0;
+		int Shifts[MaxDigits];
+		uint32_t Histogram[MaxDigits][1 << DigitBits];
+
+		explicit LsdDigits(uint64_t varying)
+		{
+			for (uint64_t left = varying; left != 0;)
+			{
+				int shift = LowestBit(left);
+				Shifts[Count++] = shift;
+				left = shift + DigitBits < 64 ? left & ~((1ull << (shift + DigitBits)) - 1) : 0;
+			}
+			std::memset(Histogram, 0, sizeof(Histogram[0]) * Count);
+		}
+
+		void Add(uint64_t key)
+		{
+			for (int d = 0; d < Count; ++d)
+			{
+				Histogram[d][(key >> Shifts[d]) & ((1 << DigitBits) - 1)]++;
+			}
+		}
+	};
+
+	// the passes of digits, whose histograms hold every key, moving values along with the keys when there
+	// are any.  Returns whether the result ended in scratchKeys/scratchValues.
+	bool LsdPasses(LsdDigits& digits, uint64_t* keys, uint32_t* values, std::size_t count, uint64_t* scratchKeys, uint32_t* scratchValues)
+	{
+		uint64_t* srcKeys = keys;
+		uint32_t* srcValues = values;
+		uint64_t* dstKeys = scratchKeys;
+		uint32_t* dstValues = scratchValues;
+		for (int d = 0; d < digits.Count; ++d)
+		{
+			const int shift = digits.Shifts[d];
+			uint32_t* counts = digits.Histogram[d];
+			uint32_t offset = 0;
+			for (int b = 0; b < (1 << DigitBits); ++b)
+			{
+				uint32_t c = counts[b];
+				counts[b] = offset;
+				offset += c;
+			}
+
+			if (values)
+			{
+				for (std::size_t i = 0; i < count; ++i)
+				{
+					uint64_t key = srcKeys[i];
+					uint32_t slot = counts[(key >> shift) & ((1 << DigitBits) - 1)]++;
+					dstKeys[slot] = key;
+					dstValues[slot] = srcValues[i];
+				}
+			}
+			else
+			{
+				for (std::size_t i = 0; i < count; ++i)
+				{
+					uint64_t key = srcKeys[i];
+					dstKeys[counts[(key >> shift) & ((1 << DigitBits) - 1)]++] = key;
+				}
+			}
+			std::swap(srcKeys, dstKeys);
+			std::swap(srcValues, dstValues);
+		}
+		return digits.Count % 2 != 0;
+	}
+
+	// when the span of varying bits and the position of a key in the range fit 64 bits together, sorts
+	// them packed in one word instead of a key and a value : two thirds of the bytes to move, one array.
+	// The bits outside the span are those of every key, so the keys come back from the packed words and
+	// the values from their positions.  Returns whether the result ended in scratchKeys/scratchValues.
+	bool LsdSort(uint64_t* keys, uint32_t* values, std::size_t count, uint64_t* scratchKeys, uint32_t* scratchValues, uint64_t varying)
+	{
+		const int low = LowestBit(varying);
+		const int spanBits = HighestBit(varying) - low + 1;
+		int positionBits = 1;
+		while (((std::size_t)1 << positionBits) < count)
+			++positionBits;
+		if (spanBits + positionBits > 64)
+		{
+			LsdDigits digits(varying);
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				digits.Add(keys[i]);
+			}
+			return LsdPasses(digits, keys, values, count, scratchKeys, scratchValues);
+		}
+
+		const uint64_t spanMask = spanBits < 64 ? (1ull << spanBits) - 1 : ~0ull;
+		const uint64_t fixed = keys[0] & ~(spanMask << low);
+		LsdDigits digits((varying >> low) << positionBits);
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			uint64_t word = (((keys[i] >> low) & spanMask) << positionBits) | i;
+			scratchKeys[i] = word;
+			digits.Add(word);
+		}
+
+		// keys is free once packed, the passes go back and forth between it and scratchKeys.
+		uint64_t* packed = LsdPasses(digits, scratchKeys, nullptr, count, keys, nullptr) ? keys : scratchKeys;
+		const uint64_t positionMask = (1ull << positionBits) - 1;
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			uint64_t word = packed[i];
+			scratchValues[i] = values[word & positionMask];
+			scratchKeys[i] = fixed | ((word >> positionBits) << low);
+		}
+		return true;
+	}
+
+	bool SortRange(uint64_t* keys, uint32_t* values, std::size_t count, uint64_t* scratchKeys, uint32_t* scratchValues, WorkerPool* workers);
+
+	// one MSD pass on the SplitBits below the highest varying bit into scratch, then every bucket sorted
+	// on its own while it is still in the cache.  The pass is split in chunks of keys on workers, each with
+	// its own histogram and its own slots in every bucket, so the order of equal keys is kept.  The result
+	// ends in keys/values.
+	void SplitSort(uint64_t* keys, uint32_t* values, std::size_t count, uint64_t* scratchKeys, uint32_t* scratchValues,
+		uint64_t varying, WorkerPool* workers)
+	{
+		const int shift = std::max(HighestBit(varying) - SplitBits + 1, 0);
+		const uint64_t mask = (1 << SplitBits) - 1;
+		const std::uint32_t buckets = 1 << SplitBits;
+		const bool parallel = workers && workers->ThreadCount() > 1 && count >= CacheSortMax * workers->ThreadCount();
+		const std::uint32_t chunks = parallel ? workers->ThreadCount() : 1;
+		const std::size_t chunkSize = (count + chunks - 1) / chunks;
+		auto forEachChunk = [&](const std::function<void(std::uint32_t)>& fn)
+		{
+			if (parallel)
+				workers->Run(chunks, fn);
+			else
+				fn(0);
+		};
+
+		std::vector<std::size_t> slots(chunks * buckets, 0);
+		forEachChunk([&](std::uint32_t c)
+		{
+			std::size_t* counts = &slots[c * buckets];
+			for (std::size_t i = c * chunkSize; i < std::min(count, (c + 1) * chunkSize); ++i)
+			{
+				counts[(keys[i] >> shift) & mask]++;
+			}
+		});
+
+		// bucket by bucket, the slots of every chunk one after the other.
+		std::vector<std::size_t> offsets(buckets + 1);
+		std::size_t offset = 0;
+		for (std::uint32_t b = 0; b < buckets; ++b)
+		{
+			offsets[b] = offset;
+			for (std::uint32_t c = 0; c < chunks; ++c)
+			{
+				std::size_t n = slots[c * buckets + b];
+				slots[c * buckets + b] = offset;
+				offset += n;
+			}
+		}
+		offsets[buckets] = offset;
+
+		forEachChunk([&](std::uint32_t c)
+		{
+			std::size_t* next = &slots[c * buckets];
+			for (std::size_t i = c * chunkSize; i < std::min(count, (c + 1) * chunkSize); ++i)
+			{
+				uint64_t key = keys[i];
+				std::size_t slot = next[(key >> shift) & mask]++;
+				scratchKeys[slot] = key;
+				scratchValues[slot] = values[i];
+			}
+		});
+
+		// the buckets sorted in scratch, with keys/values of the same range as their scratch.
+		auto sortBucket = [&](std::uint32_t b)
+		{
+			std::size_t first = offsets[b], bucketCount = offsets[b + 1] - first;
+			if (bucketCount == 0)
+				return;
+			if (!SortRange(scratchKeys + first, scratchValues + first, bucketCount, keys + first, values + first, nullptr))
+			{
+				std::memcpy(keys + first, scratchKeys + first, bucketCount * sizeof(uint64_t));
+				std::memcpy(values + first, scratchValues + first, bucketCount * sizeof(uint32_t));
+			}
+		};
+		if (parallel)
+		{
+			workers->Run(buckets, sortBucket);
+		}
+		else
+		{
+			for (std::uint32_t b = 0; b < buckets; ++b)
+			{
+				sortBucket(b);
+			}
+		}
+	}
+
+	// returns whether the result ended in scratchKeys/scratchValues rather than keys/values.
+	bool SortRange(uint64_t* keys, uint32_t* values, std::size_t count, uint64_t* scratchKeys, uint32_t* scratchValues, WorkerPool* workers)
+	{
+		// small queues are not worth the histogram setup.
+		if (count <= InsertionSortMax)
+		{
+			InsertionSort(keys, values, count);
+			return false;
+		}
+
+		uint64_t varying = VaryingBits(keys, count);
+		if (varying == 0)
+		{
+			return false;
+		}
+		if (count <= CacheSortMax)
+		{
+			return LsdSort(keys, values, count, scratchKeys, scratchValues, varying);
+		}
+		SplitSort(keys, values, count, scratchKeys, scratchValues, varying, workers);
+		return false;
+	}
+}
+
+void RadixSortKeys(uint64_t* keys, uint32_t* values, std::size_t count, uint64_t* scratchKeys, uint32_t* scratchValues, WorkerPool* workers)
+{
+	if (SortRange(keys, values, count, scratchKeys, scratchValues, workers))
+	{
+		std::memcpy(keys, scratchKeys, count * sizeof(uint64_t));
+		std::memcpy(values, scratchValues, count * sizeof(uint32_t));
+	}
+}
+
+void RenderQueue::Clear()
+{
+	mKeys.clear();
+	mItems.clear();
+}
+
+void RenderQueue::Reserve(std::size_t count)
+{
+	mKeys.reserve(count);
+	mItems.reserve(count);
+}
+
+void RenderQueue::Push(uint64_t key, uint32_t item)
+{
+	mKeys.push_back(key);
+	mItems.push_back(item);
+}
+
+void RenderQueue::Sort(WorkerPool* workers)
+{
+	if (mScratchKeys.size() < mKeys.size())
+	{
+		mScratchKeys.resize(mKeys.size());
+		mScratchItems.resize(mKeys.size());
+	}
+
+	RadixSortKeys(mKeys.data(), mItems.data(), mKeys.size(), mScratchKeys.data(), mScratchItems.data(), workers);
+}
@@ -0,0 +1,94 @@
+// RenderQueue.h : 64-bit draw sort keys and a radix sorted queue of draws.
+//
+// A sort key packs, from the most significant bits down,
+//   pass(4) | pso(8) | geometry(12) | material(12) | depth(28)
+// so that sorting the keys groups draws by pass, then by pipeline state, then by the
+// vertex/index buffers and the material, and finally orders them front to back.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class WorkerPool;
+
+class DrawSortKey
+{
+public:
+	static const int PassBits = 4;
+	static const int PsoBits = 8;
+	static const int GeometryBits = 12;
+	static const int MaterialBits = 12;
+	static const int DepthBits = 28;
+
+	static const int DepthShift = 0;
+	static const int MaterialShift = DepthShift + DepthBits;
+	static const int GeometryShift = MaterialShift + MaterialBits;
+	static const int PsoShift = GeometryShift + GeometryBits;
+	static const int PassShift = PsoShift + PsoBits;
+
+	static std::uint64_t Make(std::uint32_t pass, std::uint32_t pso, std::uint32_t geometry, std::uint32_t material, std::uint32_t depth)
+	{
+		return (Field(pass, PassBits) << PassShift) |
+			(Field(pso, PsoBits) << PsoShift) |
+			(Field(geometry, GeometryBits) << GeometryShift) |
+			(Field(material, MaterialBits) << MaterialShift) |
+			(Field(depth, DepthBits) << DepthShift);
+	}
+
+	// map a view space depth in [0, farZ] to the depth field, nearer draws get smaller keys.
+	static std::uint32_t QuantizeDepth(float viewDepth, float farZ)
+	{
+		const float maxDepth = (float)((1u << DepthBits) - 1);
+		float t = viewDepth / farZ;
+		t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+		return (std::uint32_t)(t * maxDepth);
+	}
+
+	static std::uint32_t Pass(std::uint64_t key) { return (std::uint32_t)Extract(key, PassShift, PassBits); }
+	static std::uint32_t Pso(std::uint64_t key) { return (std::uint32_t)Extract(key, PsoShift, PsoBits); }
+	static std::uint32_t Geometry(std::uint64_t key) { return (std::uint32_t)Extract(key, GeometryShift, GeometryBits); }
+	static std::uint32_t Material(std::uint64_t key) { return (std::uint32_t)Extract(key, MaterialShift, MaterialBits); }
+	static std::uint32_t Depth(std::uint64_t key) { return (std::uint32_t)Extract(key, DepthShift, DepthBits); }
+
+private:
+	static std::uint64_t Field(std::uint32_t value, int bits)
+	{
+		return (std::uint64_t)value & ((1ull << bits) - 1);
+	}
+
+	static std::uint64_t Extract(std::uint64_t key, int shift, int bits)
+	{
+		return (key >> shift) & ((1ull << bits) - 1);
+	}
+};
+
+// Sort (key, value) pairs by key, stable.  Only the bits that differ between keys are sorted on, which
+// is most of the time far fewer than 64 since the upper fields take few distinct values.  A large queue
+// is first split on its 11 highest varying bits into buckets that fit the cache, on workers when there
+// are enough of them, then every bucket is finished with LSD passes of 8 bits, its keys packed with their
+// positions into single words when they fit.  The scratch arrays must hold count elements; the result
+// always ends up in keys/values.
+void RadixSortKeys(std::uint64_t* keys, std::uint32_t* values, std::size_t count,
+	std::uint64_t* scratchKeys, std::uint32_t* scratchValues, WorkerPool* workers = nullptr);
+
+class RenderQueue
+{
+public:
+	void Clear();
+	void Reserve(std::size_t count);
+	void Push(std::uint64_t key, std::uint32_t item);
+	void Sort(WorkerPool* workers = nullptr);
+
+	std::size_t Size()const { return mKeys.size(); }
+	bool Empty()const { return mKeys.empty(); }
+	std::uint64_t Key(std::size_t i)const { return mKeys[i]; }
+	std::uint32_t Item(std::size_t i)const { return mItems[i]; }
+
+private:
+	std::vector<std::uint64_t> mKeys;
+	std::vector<std::uint32_t> mItems;		// index of the draw the key belongs to
+
+	std::vector<std::uint64_t> mScratchKeys;
+	std::vector<std::uint32_t> mScratchItems;
+};
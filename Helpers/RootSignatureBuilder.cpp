@@ -0,0 +1,303 @@
+// RootSignatureBuilder.cpp
+
+#include "RootSignatureBuilder.h"
+#include <stdexcept>
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	D3D12_ROOT_DESCRIPTOR_FLAGS RootDescriptorFlags(RootDataUsage usage)
+	{
+		switch (usage)
+		{
+		case RootDataUsage::Static:		return D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC;
+		case RootDataUsage::Volatile:	return D3D12_ROOT_DESCRIPTOR_FLAG_DATA_VOLATILE;
+		default:						return D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE;
+		}
+	}
+
+	D3D12_DESCRIPTOR_RANGE_FLAGS RangeFlags(D3D12_DESCRIPTOR_RANGE_TYPE rangeType, RootDataUsage usage)
+	{
+		// sampler ranges carry no data flags, only their descriptors can be volatile.
+		if (rangeType == D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER)
+		{
+			return usage == RootDataUsage::Volatile ? D3D12_DESCRIPTOR_RANGE_FLAG_DESCRIPTORS_VOLATILE : D3D12_DESCRIPTOR_RANGE_FLAG_NONE;
+		}
+
+		switch (usage)
+		{
+		case RootDataUsage::Static:		return D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC;
+		case RootDataUsage::Volatile:	return D3D12_DESCRIPTOR_RANGE_FLAG_DESCRIPTORS_VOLATILE | D3D12_DESCRIPTOR_RANGE_FLAG_DATA_VOLATILE;
+		default:						return D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE;
+		}
+	}
+
+	template<typename T>
+	void AppendBytes(std::string& key, const T& value)
+	{
+		key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+}
+
+// ---------- builder ----------
+
+RootSignatureBuilder& RootSignatureBuilder::Constants(const std::string& name, UINT num32BitValues, UINT shaderRegister, UINT registerSpace,
+	D3D12_SHADER_VISIBILITY visibility)
+{
+	return Add({ name, D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS, D3D12_DESCRIPTOR_RANGE_TYPE_CBV, num32BitValues, shaderRegister, registerSpace,
+		RootDataUsage::Volatile, visibility });
+}
+
+RootSignatureBuilder& RootSignatureBuilder::ConstantBuffer(const std::string& name, UINT shaderRegister, UINT registerSpace,
+	RootDataUsage usage, D3D12_SHADER_VISIBILITY visibility)
+{
+	return Add({ name, D3D12_ROOT_PARAMETER_TYPE_CBV, D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, shaderRegister, registerSpace, usage, visibility });
+}
+
+RootSignatureBuilder& RootSignatureBuilder::ShaderResource(const std::string& name, UINT shaderRegister, UINT registerSpace,
+	RootDataUsage usage, D3D12_SHADER_VISIBILITY visibility)
+{
+	return Add({ name, D3D12_ROOT_PARAMETER_TYPE_SRV, D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, shaderRegister, registerSpace, usage, visibility });
+}
+
+RootSignatureBuilder& RootSignatureBuilder::Table(const std::string& name, D3D12_DESCRIPTOR_RANGE_TYPE rangeType, UINT count, UINT baseShaderRegister,
+	UINT registerSpace, RootDataUsage usage, D3D12_SHADER_VISIBILITY visibility)
+{
+	assert(count > 0);
+	return Add({ name, D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE, rangeType, count, baseShaderRegister, registerSpace, usage, visibility });
+}
+
+RootSignatureBuilder& RootSignatureBuilder::StaticSamplers(const D3D12_STATIC_SAMPLER_DESC* samplers, UINT count)
+{
+	mStaticSamplers.assign(samplers, samplers + count);
+	return *this;
+}
+
+RootSignatureBuilder& RootSignatureBuilder::Flags(D3D12_ROOT_SIGNATURE_FLAGS flags)
+{
+	mFlags = flags;
+	return *this;
+}
+
+RootSignatureBuilder& RootSignatureBuilder::Add(const Binding& binding)
+{
+	for (const auto& existing : mBindings)
+	{
+		assert(existing.Name != binding.Name);
+	}
+	mBindings.push_back(binding);
+	return *this;
+}
+
+const RootSignatureBuilder::Binding& RootSignatureBuilder::Find(const std::string& name)const
+{
+	for (const auto& binding : mBindings)
+	{
+		if (binding.Name == name)
+		{
+			return binding;
+		}
+	}
+	throw std::out_of_range("no root binding named " + name);
+}
+
+UINT RootSignatureBuilder::Index(const std::string& name)const
+{
+	return (UINT)(&Find(name) - mBindings.data());
+}
+
+UINT RootSignatureBuilder::Count(const std::string& name)const
+{
+	return Find(name).Count;
+}
+
+std::string RootSignatureBuilder::LayoutKey()const
+{
+	// every field that ends up in the serialized root signature, names excluded.
+	std::string key;
+	key.reserve(mBindings.size() * 32 + mStaticSamplers.size() * sizeof(D3D12_STATIC_SAMPLER_DESC) + 8);
+
+	AppendBytes(key, mFlags);
+	AppendBytes(key, (UINT)mBindings.size());
+	for (const auto& binding : mBindings)
+	{
+		AppendBytes(key, binding.Type);
+		AppendBytes(key, binding.RangeType);
+		AppendBytes(key, binding.Count);
+		AppendBytes(key, binding.ShaderRegister);
+		AppendBytes(key, binding.RegisterSpace);
+		AppendBytes(key, binding.Usage);
+		AppendBytes(key, binding.Visibility);
+	}
+	for (const auto& sampler : mStaticSamplers)
+	{
+		AppendBytes(key, sampler);
+	}
+	return key;
+}
+
+UINT64 RootSignatureBuilder::Hash()const
+{
+	// 64-bit FNV-1a
+	UINT64 hash = 14695981039346656037ull;
+	for (char c : LayoutKey())
+	{
+		hash ^= (unsigned char)c;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+ComPtr<ID3DBlob> RootSignatureBuilder::Serialize(D3D_ROOT_SIGNATURE_VERSION highestVersion)const
+{
+	ComPtr<ID3DBlob> serializedRootSig = nullptr;
+	ComPtr<ID3DBlob> errorBlob = nullptr;		// for error-checking
+	HRESULT hr = S_OK;
+
+	if (highestVersion >= D3D_ROOT_SIGNATURE_VERSION_1_1)
+	{
+		// one range per table, sized up front so the parameters can point into it.
+		std::vector<D3D12_DESCRIPTOR_RANGE1> ranges(mBindings.size());
+		std::vector<D3D12_ROOT_PARAMETER1> parameters(mBindings.size());
+
+		for (size_t i = 0; i < mBindings.size(); ++i)
+		{
+			const Binding& binding = mBindings[i];
+			D3D12_ROOT_PARAMETER1& parameter = parameters[i];
+			parameter.ParameterType = binding.Type;
+			parameter.ShaderVisibility = binding.Visibility;
+
+			switch (binding.Type)
+			{
+			case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
+				parameter.Constants.ShaderRegister = binding.ShaderRegister;
+				parameter.Constants.RegisterSpace = binding.RegisterSpace;
+				parameter.Constants.Num32BitValues = binding.Count;
+				break;
+
+			case D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE:
+				ranges[i].RangeType = binding.RangeType;
+				ranges[i].NumDescriptors = binding.Count;
+				ranges[i].BaseShaderRegister = binding.ShaderRegister;
+				ranges[i].RegisterSpace = binding.RegisterSpace;
+				ranges[i].Flags = RangeFlags(binding.RangeType, binding.Usage);
+				ranges[i].OffsetInDescriptorsFromTableStart = 0;
+				parameter.DescriptorTable.NumDescriptorRanges = 1;
+				parameter.DescriptorTable.pDescriptorRanges = &ranges[i];
+				break;
+
+			default:
+				parameter.Descriptor.ShaderRegister = binding.ShaderRegister;
+				parameter.Descriptor.RegisterSpace = binding.RegisterSpace;
+				parameter.Descriptor.Flags = RootDescriptorFlags(binding.Usage);
+				break;
+			}
+		}
+
+		D3D12_VERSIONED_ROOT_SIGNATURE_DESC rootSigDesc = {};
+		rootSigDesc.Version = D3D_ROOT_SIGNATURE_VERSION_1_1;
+		rootSigDesc.Desc_1_1.NumParameters = (UINT)parameters.size();
+		rootSigDesc.Desc_1_1.pParameters = parameters.data();
+		rootSigDesc.Desc_1_1.NumStaticSamplers = (UINT)mStaticSamplers.size();
+		rootSigDesc.Desc_1_1.pStaticSamplers = mStaticSamplers.data();
+		rootSigDesc.Desc_1_1.Flags = mFlags;
+
+		hr = D3D12SerializeVersionedRootSignature(&rootSigDesc, serializedRootSig.GetAddressOf(), errorBlob.GetAddressOf());
+	}
+	else
+	{
+		// version 1.0 : the same layout, without the usage flags.
+		std::vector<D3D12_DESCRIPTOR_RANGE> ranges(mBindings.size());
+		std::vector<D3D12_ROOT_PARAMETER> parameters(mBindings.size());
+
+		for (size_t i = 0; i < mBindings.size(); ++i)
+		{
+			const Binding& binding = mBindings[i];
+			D3D12_ROOT_PARAMETER& parameter = parameters[i];
+			parameter.ParameterType = binding.Type;
+			parameter.ShaderVisibility = binding.Visibility;
+
+			switch (binding.Type)
+			{
+			case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
+				parameter.Constants.ShaderRegister = binding.ShaderRegister;
+				parameter.Constants.RegisterSpace = binding.RegisterSpace;
+				parameter.Constants.Num32BitValues = binding.Count;
+				break;
+
+			case D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE:
+				ranges[i].RangeType = binding.RangeType;
+				ranges[i].NumDescriptors = binding.Count;
+				ranges[i].BaseShaderRegister = binding.ShaderRegister;
+				ranges[i].RegisterSpace = binding.RegisterSpace;
+				ranges[i].OffsetInDescriptorsFromTableStart = 0;
+				parameter.DescriptorTable.NumDescriptorRanges = 1;
+				parameter.DescriptorTable.pDescriptorRanges = &ranges[i];
+				break;
+
+			default:
+				parameter.Descriptor.ShaderRegister = binding.ShaderRegister;
+				parameter.Descriptor.RegisterSpace = binding.RegisterSpace;
+				break;
+			}
+		}
+
+		D3D12_ROOT_SIGNATURE_DESC rootSigDesc = {};
+		rootSigDesc.NumParameters = (UINT)parameters.size();
+		rootSigDesc.pParameters = parameters.data();
+		rootSigDesc.NumStaticSamplers = (UINT)mStaticSamplers.size();
+		rootSigDesc.pStaticSamplers = mStaticSamplers.data();
+		rootSigDesc.Flags = mFlags;
+
+		hr = D3D12SerializeRootSignature(&rootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1, serializedRootSig.GetAddressOf(), errorBlob.GetAddressOf());
+	}
+
+	// show error message if any of them has come up.
+	if (errorBlob != nullptr)
+	{
+		::OutputDebugStringA((char*)errorBlob->GetBufferPointer());
+	}
+	ThrowIfFailed(hr);
+
+	return serializedRootSig;
+}
+
+// ---------- cache ----------
+
+RootSignatureCache::RootSignatureCache(ID3D12Device* device) : mDevice(device)
+{
+	D3D12_FEATURE_DATA_ROOT_SIGNATURE feature = {};
+	feature.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_1;
+	if (SUCCEEDED(mDevice->CheckFeatureSupport(D3D12_FEATURE_ROOT_SIGNATURE, &feature, sizeof(feature))))
+	{
+		mVersion = feature.HighestVersion;
+	}
+}
+
+ComPtr<ID3D12RootSignature> RootSignatureCache::Get(const RootSignatureBuilder& builder)
+{
+	UINT64 hash = builder.Hash();
+
+	// a hash match is confirmed against the whole layout.
+	auto range = mEntries.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		if (it->second.Layout.SameLayout(builder))
+		{
+			mStats.Reused++;
+			return it->second.RootSignature;
+		}
+	}
+
+	Entry entry = { builder, builder.Serialize(mVersion), nullptr };
+	ThrowIfFailed(mDevice->CreateRootSignature(
+		0,
+		entry.Serialized->GetBufferPointer(),
+		entry.Serialized->GetBufferSize(),
+		IID_PPV_ARGS(entry.RootSignature.GetAddressOf())));
+
+	mStats.Created++;
+	mEntries.emplace(hash, entry);
+	return entry.RootSignature;
+}
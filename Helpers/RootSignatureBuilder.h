@@ -0,0 +1,109 @@
+// RootSignatureBuilder.h : builds root signatures from the bindings a shader declares.
+//
+// Each binding is declared once with its name, register, space, visibility and how its data changes,
+// and the builder lays out one root parameter per binding in declaration order.  The layout is emitted
+// as a version 1.1 root signature whose descriptor and data flags follow the declared usage, which lets
+// the driver skip copying descriptors or reloading data it knows to be static.  Devices limited to
+// version 1.0 get the same layout without the flags.
+//
+// RootSignatureCache keeps the root signatures created so far keyed by a hash of their layout, so
+// building the same layout twice serializes and creates it only once.  Not thread safe.
+
+#pragma once
+
+#include "d3dUtil.h"
+#include <unordered_map>
+
+// how the data behind a binding changes, from the most to the least the driver can rely on.
+enum class RootDataUsage
+{
+	Static,					// written before the binding is set and unchanged until the GPU is done with the list
+	StaticAtExecute,		// may change between recording and execution, not while the list executes
+	Volatile,				// data and, for tables, descriptors may change while the list executes
+};
+
+class RootSignatureBuilder
+{
+public:
+	// bindings, each one becomes the next root parameter.
+	RootSignatureBuilder& Constants(const std::string& name, UINT num32BitValues, UINT shaderRegister, UINT registerSpace = 0,
+		D3D12_SHADER_VISIBILITY visibility = D3D12_SHADER_VISIBILITY_ALL);
+	RootSignatureBuilder& ConstantBuffer(const std::string& name, UINT shaderRegister, UINT registerSpace = 0,
+		RootDataUsage usage = RootDataUsage::StaticAtExecute, D3D12_SHADER_VISIBILITY visibility = D3D12_SHADER_VISIBILITY_ALL);
+	RootSignatureBuilder& ShaderResource(const std::string& name, UINT shaderRegister, UINT registerSpace = 0,
+		RootDataUsage usage = RootDataUsage::StaticAtExecute, D3D12_SHADER_VISIBILITY visibility = D3D12_SHADER_VISIBILITY_ALL);
+
+	// a descriptor table with one range of count descriptors, e.g. Texture2D gMaps[count] : register(t0).
+	RootSignatureBuilder& Table(const std::string& name, D3D12_DESCRIPTOR_RANGE_TYPE rangeType, UINT count, UINT baseShaderRegister,
+		UINT registerSpace = 0, RootDataUsage usage = RootDataUsage::StaticAtExecute, D3D12_SHADER_VISIBILITY visibility = D3D12_SHADER_VISIBILITY_ALL);
+
+	RootSignatureBuilder& StaticSamplers(const D3D12_STATIC_SAMPLER_DESC* samplers, UINT count);
+	RootSignatureBuilder& Flags(D3D12_ROOT_SIGNATURE_FLAGS flags);
+
+	// root parameter index of a binding, and the number of descriptors or 32-bit values it holds.
+	UINT Index(const std::string& name)const;
+	UINT Count(const std::string& name)const;
+	UINT ParameterCount()const { return (UINT)mBindings.size(); }
+
+	// hash of the layout, equal layouts give equal hashes whatever the binding names.
+	UINT64 Hash()const;
+	bool SameLayout(const RootSignatureBuilder& rhs)const { return LayoutKey() == rhs.LayoutKey(); }
+
+	// serialized root signature, version 1.1 unless highestVersion is 1.0.
+	Microsoft::WRL::ComPtr<ID3DBlob> Serialize(D3D_ROOT_SIGNATURE_VERSION highestVersion = D3D_ROOT_SIGNATURE_VERSION_1_1)const;
+
+private:
+	struct Binding
+	{
+		std::string Name;
+		D3D12_ROOT_PARAMETER_TYPE Type;
+		D3D12_DESCRIPTOR_RANGE_TYPE RangeType;		// tables only
+		UINT Count;									// descriptors of a table, 32-bit values of constants, 1 otherwise
+		UINT ShaderRegister;
+		UINT RegisterSpace;
+		RootDataUsage Usage;
+		D3D12_SHADER_VISIBILITY Visibility;
+	};
+
+	RootSignatureBuilder& Add(const Binding& binding);
+	const Binding& Find(const std::string& name)const;
+	std::string LayoutKey()const;
+
+private:
+	std::vector<Binding> mBindings;
+	std::vector<D3D12_STATIC_SAMPLER_DESC> mStaticSamplers;
+	D3D12_ROOT_SIGNATURE_FLAGS mFlags = D3D12_ROOT_SIGNATURE_FLAG_NONE;
+};
+
+struct RootSignatureCacheStats
+{
+	UINT Created = 0;		// layouts serialized and created
+	UINT Reused = 0;		// requests served from the cache
+};
+
+class RootSignatureCache
+{
+public:
+	// queries the highest root signature version the device supports.
+	explicit RootSignatureCache(ID3D12Device* device);
+	RootSignatureCache(const RootSignatureCache& rhs) = delete;
+	RootSignatureCache& operator=(const RootSignatureCache& rhs) = delete;
+
+	Microsoft::WRL::ComPtr<ID3D12RootSignature> Get(const RootSignatureBuilder& builder);
+
+	D3D_ROOT_SIGNATURE_VERSION Version()const { return mVersion; }
+	const RootSignatureCacheStats& Stats()const { return mStats; }
+
+private:
+	struct Entry
+	{
+		RootSignatureBuilder Layout;
+		Microsoft::WRL::ComPtr<ID3DBlob> Serialized;
+		Microsoft::WRL::ComPtr<ID3D12RootSignature> RootSignature;
+	};
+
+	ID3D12Device* mDevice = nullptr;
+	D3D_ROOT_SIGNATURE_VERSION mVersion = D3D_ROOT_SIGNATURE_VERSION_1_0;
+	std::unordered_multimap<UINT64, Entry> mEntries;
+	RootSignatureCacheStats mStats;
+};
@@ -0,0 +1,849 @@
+// SphereBvh.cpp
+
+#include "SphereBvh.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+namespace
+{
+	const std::uint32_t NoSplit = ~0u;
+	const std::uint32_t ParallelThreshold = 8192;		// objects below which building or refitting on one thread is faster
+	const std::uint32_t GatherChunk = 16384;
+	const int BinCount = 16;
+
+	struct Bounds
+	{
+		float Min[3] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+		float Max[3] = { -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() };
+
+		void Grow(const float min[3], const float max[3])
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				Min[k] = std::min(Min[k], min[k]);
+				Max[k] = std::max(Max[k], max[k]);
+			}
+		}
+		void Grow(const float point[3]) { Grow(point, point); }
+
+		float Area()const
+		{
+			float dx = Max[0] - Min[0], dy = Max[1] - Min[1], dz = Max[2] - Min[2];
+			return dx < 0.0f ? 0.0f : 2.0f * (dx * dy + dy * dz + dz * dx);
+		}
+	};
+
+	inline float NodeArea(const BvhNode& node)
+	{
+		float dx = node.Max[0] - node.Min[0], dy = node.Max[1] - node.Min[1], dz = node.Max[2] - node.Min[2];
+		return 2.0f * (dx * dy + dy * dz + dz * dx);
+	}
+
+	inline void SphereBounds(const float* sphere, float min[3], float max[3])
+	{
+		for (int k = 0; k < 3; ++k)
+		{
+			min[k] = sphere[k] - sphere[3];
+			max[k] = sphere[k] + sphere[3];
+		}
+	}
+
+	double MicrosecondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+}
+
+// per-object data the build partitions on, indexed by object.
+struct SphereBvh::BuildContext
+{
+	std::vector<float> Centroids;			// 3 per object
+	std::vector<float> Boxes;				// min xyz, max xyz per object
+	std::vector<std::uint32_t>* Order;
+	std::vector<Subtree> Subtrees;			// ranges left to the workers
+};
+
+// ---------- build ----------
+
+SphereBvh::~SphereBvh()
+{
+	JoinBackgroundBuild();
+}
+
+void SphereBvh::Build(const SphereCullSet& spheres)
+{
+	JoinBackgroundBuild();
+	mBackgroundResult.reset();
+
+	BuildResult result;
+	BuildTree(spheres, true, result);
+	if (mNodeCount != 0)
+	{
+		mStats.Rebuilds++;
+	}
+	Adopt(result, spheres);
+}
+
+void SphereBvh::BuildTree(const SphereCullSet& spheres, bool onWorkers, BuildResult& result)const
+{
+	auto buildStart = std::chrono::high_resolution_clock::now();
+
+	// large trees are split into subtrees the refits run on the workers, whether or not the build does.
+	const std::uint32_t count = (std::uint32_t)spheres.Size();
+	const bool split = mWorkers && mWorkers->ThreadCount() > 1 && count >= ParallelThreshold;
+	const bool parallel = split && onWorkers;
+
+	result.Order.resize(count);
+	std::iota(result.Order.begin(), result.Order.end(), 0u);
+	result.Nodes.clear();
+	result.Subtrees.clear();
+	result.TopEnd = 0;
+
+	if (count == 0)
+	{
+		result.Microseconds = MicrosecondsSince(buildStart);
+		return;
+	}
+
+	BuildContext context;
+	context.Order = &result.Order;
+	context.Centroids.resize((std::size_t)count * 3);
+	context.Boxes.resize((std::size_t)count * 6);
+
+	auto prepare = [&](std::uint32_t chunk)
+	{
+		std::uint32_t end = std::min(count, (chunk + 1) * GatherChunk);
+		for (std::uint32_t i = chunk * GatherChunk; i < end; ++i)
+		{
+			float sphere[4] = { spheres.X()[i], spheres.Y()[i], spheres.Z()[i], spheres.R()[i] };
+			std::memcpy(&context.Centroids[(std::size_t)i * 3], sphere, 3 * sizeof(float));
+			SphereBounds(sphere, &context.Boxes[(std::size_t)i * 6], &context.Boxes[(std::size_t)i * 6 + 3]);
+		}
+	};
+	std::uint32_t chunks = (count + GatherChunk - 1) / GatherChunk;
+	if (parallel)
+	{
+		mWorkers->Run(chunks, prepare);
+	}
+	else
+	{
+		for (std::uint32_t chunk = 0; chunk < chunks; ++chunk)
+			prepare(chunk);
+	}
+
+	// node 0 is the root and node 1 is unused, so every pair of siblings starts on an even index.
+	std::vector<BvhNode>& nodes = result.Nodes;
+	nodes.reserve((std::size_t)count * 2 + 2);
+	nodes.resize(2);
+	nodes[1] = BvhNode();
+
+	// the top levels are built here, down to about four subtrees per thread, and the subtrees after them.
+	std::uint32_t splitDepth = NoSplit;
+	if (split)
+	{
+		splitDepth = 0;
+		while ((1u << splitDepth) < mWorkers->ThreadCount() * 4)
+		{
+			splitDepth++;
+		}
+	}
+	BuildRange(context, nodes, 0, 0, count, 0, splitDepth);
+	result.TopEnd = (std::uint32_t)nodes.size();
+
+	if (!context.Subtrees.empty())
+	{
+		std::vector<std::vector<BvhNode>> subtreeNodes(context.Subtrees.size());
+		auto buildSubtree = [&](std::uint32_t task)
+		{
+			const Subtree& subtree = context.Subtrees[task];
+			std::vector<BvhNode>& local = subtreeNodes[task];
+			local.reserve((std::size_t)subtree.Count * 2 + 2);
+			local.resize(2);
+			BuildRange(context, local, 0, subtree.First, subtree.Count, subtree.Depth, NoSplit);
+		};
+		if (parallel)
+		{
+			mWorkers->Run((std::uint32_t)context.Subtrees.size(), buildSubtree);
+		}
+		else
+		{
+			for (std::uint32_t task = 0; task < (std::uint32_t)context.Subtrees.size(); ++task)
+				buildSubtree(task);
+		}
+
+		// append each subtree after the top nodes, its local root replaces the placeholder it hangs from.
+		for (std::size_t task = 0; task < context.Subtrees.size(); ++task)
+		{
+			Subtree& subtree = context.Subtrees[task];
+			const std::vector<BvhNode>& local = subtreeNodes[task];
+			std::uint32_t offset = (std::uint32_t)nodes.size();
+
+			auto remap = [offset](BvhNode node)
+			{
+				if (node.Count == 0)
+				{
+					node.LeftFirst = node.LeftFirst - 2 + offset;
+				}
+				return node;
+			};
+
+			nodes[subtree.Parent] = remap(local[0]);
+			for (std::size_t i = 2; i < local.size(); ++i)
+			{
+				nodes.push_back(remap(local[i]));
+			}
+			subtree.NodeBegin = offset;
+			subtree.NodeEnd = (std::uint32_t)nodes.size();
+		}
+		result.Subtrees = context.Subtrees;
+	}
+
+	result.Microseconds = MicrosecondsSince(buildStart);
+}
+
+void SphereBvh::Adopt(BuildResult& result, const SphereCullSet& spheres)
+{
+	const std::uint32_t count = (std::uint32_t)result.Order.size();
+	mOrder.swap(result.Order);
+	mSubtrees.swap(result.Subtrees);
+	mTopEnd = result.TopEnd;
+
+	SphereBvhStats stats;
+	stats.Refits = mStats.Refits;
+	stats.Rebuilds = mStats.Rebuilds;
+	stats.BackgroundRebuilds = mStats.BackgroundRebuilds;
+	stats.BuildMicroseconds = result.Microseconds;
+	stats.RefitMicroseconds = mStats.RefitMicroseconds;
+
+	// flattened into 64 byte aligned storage, sibling pairs each fill one cache line.
+	mNodeCount = (std::uint32_t)result.Nodes.size();
+	mNodeStorage.resize((std::size_t)mNodeCount * sizeof(BvhNode) + 64);
+	unsigned char* base = mNodeStorage.data();
+	mNodes = reinterpret_cast<BvhNode*>(base + ((64 - ((std::uintptr_t)base & 63)) & 63));
+	if (mNodeCount == 0)
+	{
+		mSlots.Resize(0);
+		mStats = stats;
+		return;
+	}
+	std::memcpy(mNodes, result.Nodes.data(), (std::size_t)mNodeCount * sizeof(BvhNode));
+
+	mSlots.Resize(count);
+	Gather(spheres, 0, count);
+
+	// depth, leaves and surface area cost of the new tree.
+	float cost = 0.0f;
+	std::uint32_t stack[2 * MaxDepth + 4][2];
+	std::uint32_t stackSize = 0;
+	stack[stackSize][0] = 0;
+	stack[stackSize++][1] = 1;
+	while (stackSize > 0)
+	{
+		--stackSize;
+		const BvhNode& node = mNodes[stack[stackSize][0]];
+		std::uint32_t depth = stack[stackSize][1];
+		stats.Depth = std::max(stats.Depth, depth);
+
+		if (node.Count > 0)
+		{
+			stats.Leaves++;
+			cost += LeafCost(node);
+			continue;
+		}
+		cost += NodeArea(node);
+		stack[stackSize][0] = node.LeftFirst;
+		stack[stackSize++][1] = depth + 1;
+		stack[stackSize][0] = node.LeftFirst + 1;
+		stack[stackSize++][1] = depth + 1;
+	}
+
+	float rootArea = NodeArea(mNodes[0]);
+	stats.Nodes = mNodeCount - 1;
+	stats.BuildCost = stats.Cost = rootArea > 0.0f ? cost / rootArea : 0.0f;
+	mStats = stats;
+}
+
+void SphereBvh::StartBackgroundBuild(const SphereCullSet& spheres)
+{
+	// the spheres keep moving while the tree is built : the builder works on a copy of them, and the tree is
+	// refitted to where they are once it replaces the current one.
+	mBackgroundResult = std::make_unique<BuildResult>();
+	mBuilt.store(false, std::memory_order_relaxed);
+	BuildResult* result = mBackgroundResult.get();
+	mBuilder = std::thread([this, result](const SphereCullSet& snapshot)
+	{
+		BuildTree(snapshot, false, *result);
+		mBuilt.store(true, std::memory_order_release);
+	}, spheres);
+}
+
+void SphereBvh::JoinBackgroundBuild()
+{
+	if (mBuilder.joinable())
+	{
+		mBuilder.join();
+	}
+}
+
+void SphereBvh::BuildRange(BuildContext& context, std::vector<BvhNode>& nodes, std::uint32_t nodeIndex, std::uint32_t first,
+	std::uint32_t count, std::uint32_t depth, std::uint32_t splitDepth)const
+{
+	std::uint32_t* order = context.Order->data();
+
+	Bounds bounds;
+	Bounds centroidBounds;
+	for (std::uint32_t i = first; i < first + count; ++i)
+	{
+		const float* box = &context.Boxes[(std::size_t)order[i] * 6];
+		bounds.Grow(box, box + 3);
+		centroidBounds.Grow(&context.Centroids[(std::size_t)order[i] * 3]);
+	}
+
+	BvhNode node;
+	std::memcpy(node.Min, bounds.Min, sizeof(node.Min));
+	std::memcpy(node.Max, bounds.Max, sizeof(node.Max));
+	node.LeftFirst = first;
+	node.Count = count;
+
+	// under mBruteForceMax objects the whole tree is one leaf.
+	if (count <= MaxLeafSize || depth + 1 >= MaxDepth || (depth == 0 && count < mBruteForceMax))
+	{
+		nodes[nodeIndex] = node;
+		return;
+	}
+
+	// the rest of this range is built by a worker, the node only reserves its place.
+	if (depth == splitDepth)
+	{
+		node.LeftFirst = 0;
+		node.Count = 0;
+		nodes[nodeIndex] = node;
+		context.Subtrees.push_back({ nodeIndex, first, count, 0, 0, depth });
+		return;
+	}
+
+	// split along the longest axis of the centroids, at the bin boundary with the lowest surface area cost.
+	int axis = 0;
+	float extent[3];
+	for (int k = 0; k < 3; ++k)
+	{
+		extent[k] = centroidBounds.Max[k] - centroidBounds.Min[k];
+		if (extent[k] > extent[axis])
+		{
+			axis = k;
+		}
+	}
+
+	std::uint32_t* begin = order + first;
+	std::uint32_t* end = order + first + count;
+	std::uint32_t* middle = nullptr;
+
+	if (extent[axis] > 0.0f)
+	{
+		Bounds binBounds[BinCount];
+		std::uint32_t binCounts[BinCount] = {};
+		float scale = BinCount / extent[axis];
+		float origin = centroidBounds.Min[axis];
+
+		auto binOf = [&](std::uint32_t object)
+		{
+			int bin = (int)((context.Centroids[(std::size_t)object * 3 + axis] - origin) * scale);
+			return std::min(bin, BinCount - 1);
+		};
+
+		for (std::uint32_t* it = begin; it != end; ++it)
+		{
+			int bin = binOf(*it);
+			const float* box = &context.Boxes[(std::size_t)*it * 6];
+			binBounds[bin].Grow(box, box + 3);
+			binCounts[bin]++;
+		}
+
+		// cost of splitting after bin i : area(left) * count(left) + area(right) * count(right)
+		float rightArea[BinCount];
+		std::uint32_t rightCount[BinCount];
+		Bounds accumulated;
+		std::uint32_t accumulatedCount = 0;
+		for (int i = BinCount - 1; i > 0; --i)
+		{
+			accumulated.Grow(binBounds[i].Min, binBounds[i].Max);
+			accumulatedCount += binCounts[i];
+			rightArea[i] = accumulated.Area();
+			rightCount[i] = accumulatedCount;
+		}
+
+		float bestCost = std::numeric_limits<float>::max();
+		int bestSplit = -1;
+		accumulated = Bounds();
+		accumulatedCount = 0;
+		for (int i = 1; i < BinCount; ++i)
+		{
+			accumulated.Grow(binBounds[i - 1].Min, binBounds[i - 1].Max);
+			accumulatedCount += binCounts[i - 1];
+			if (accumulatedCount == 0 || rightCount[i] == 0)
+			{
+				continue;
+			}
+
+			float cost = accumulated.Area() * accumulatedCount + rightArea[i] * rightCount[i];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestSplit = i;
+			}
+		}
+
+		// a small range is left as one leaf when testing all its objects is cheaper than traversing a split.
+		float leafCost = bounds.Area() * count;
+		if (bestSplit > 0 && count <= 4 * MaxLeafSize && bounds.Area() + bestCost >= leafCost)
+		{
+			nodes[nodeIndex] = node;
+			return;
+		}
+
+		if (bestSplit > 0)
+		{
+			middle = std::partition(begin, end, [&](std::uint32_t object) { return binOf(object) < bestSplit; });
+		}
+	}
+
+	// coincident centroids : halve the range.
+	if (middle == nullptr || middle == begin || middle == end)
+	{
+		middle = begin + count / 2;
+	}
+
+	std::uint32_t child = (std::uint32_t)nodes.size();
+	nodes.resize(child + 2);
+	node.LeftFirst = child;
+	node.Count = 0;
+	nodes[nodeIndex] = node;
+
+	std::uint32_t leftCount = (std::uint32_t)(middle - begin);
+	BuildRange(context, nodes, child, first, leftCount, depth + 1, splitDepth);
+	BuildRange(context, nodes, child + 1, first + leftCount, count - leftCount, depth + 1, splitDepth);
+}
+
+// ---------- refit ----------
+
+void SphereBvh::Gather(const SphereCullSet& spheres, std::uint32_t first, std::uint32_t count)
+{
+	for (std::uint32_t slot = first; slot < first + count; ++slot)
+	{
+		std::uint32_t object = mOrder[slot];
+		mSlots.Set(slot, spheres.X()[object], spheres.Y()[object], spheres.Z()[object], spheres.R()[object]);
+	}
+}
+
+float SphereBvh::LeafCost(const BvhNode& node)const
+{
+	return NodeArea(node) * node.Count;
+}
+
+float SphereBvh::RefitNodes(std::uint32_t begin, std::uint32_t end)
+{
+	// children always come after their parent, so walking backwards refits them first.
+	float cost = 0.0f;
+	for (std::uint32_t i = end; i-- > begin;)
+	{
+		if (i == 1)
+		{
+			continue;		// the unused node next to the root
+		}
+
+		BvhNode& node = mNodes[i];
+		if (node.Count > 0)
+		{
+			Bounds bounds;
+			for (std::uint32_t slot = node.LeftFirst; slot < node.LeftFirst + node.Count; ++slot)
+			{
+				float sphere[4] = { mSlots.X()[slot], mSlots.Y()[slot], mSlots.Z()[slot], mSlots.R()[slot] };
+				float min[3], max[3];
+				SphereBounds(sphere, min, max);
+				bounds.Grow(min, max);
+			}
+			std::memcpy(node.Min, bounds.Min, sizeof(node.Min));
+			std::memcpy(node.Max, bounds.Max, sizeof(node.Max));
+			cost += LeafCost(node);
+		}
+		else
+		{
+			const BvhNode& left = mNodes[node.LeftFirst];
+			const BvhNode& right = mNodes[node.LeftFirst + 1];
+			for (int k = 0; k < 3; ++k)
+			{
+				node.Min[k] = std::min(left.Min[k], right.Min[k]);
+				node.Max[k] = std::max(left.Max[k], right.Max[k]);
+			}
+			cost += NodeArea(node);
+		}
+	}
+	return cost;
+}
+
+bool SphereBvh::Update(const SphereCullSet& spheres)
+{
+	if (mNodeCount == 0 || spheres.Size() != mOrder.size())
+	{
+		Build(spheres);
+		return true;
+	}
+
+	// a background build is done : its tree replaces this one and is refitted to this frame's positions.
+	bool replaced = false;
+	if (mBuilder.joinable() && mBuilt.load(std::memory_order_acquire))
+	{
+		JoinBackgroundBuild();
+		mStats.Rebuilds++;
+		mStats.BackgroundRebuilds++;
+		Adopt(*mBackgroundResult, spheres);
+		mBackgroundResult.reset();
+		replaced = true;
+	}
+
+	auto refitStart = std::chrono::high_resolution_clock::now();
+
+	// every subtree covers its own objects and nodes : they are gathered and refitted on the workers,
+	// then the top nodes above them.
+	float cost = 0.0f;
+	if (!mSubtrees.empty())
+	{
+		std::vector<float> subtreeCosts(mSubtrees.size());
+		mWorkers->Run((std::uint32_t)mSubtrees.size(), [&](std::uint32_t task)
+		{
+			const Subtree& subtree = mSubtrees[task];
+			Gather(spheres, subtree.First, subtree.Count);
+			subtreeCosts[task] = RefitNodes(subtree.NodeBegin, subtree.NodeEnd);
+		});
+		for (float subtreeCost : subtreeCosts)
+		{
+			cost += subtreeCost;
+		}
+
+		// the subtree roots are among the top nodes, their objects are gathered already.
+		for (std::uint32_t i = mTopEnd; i-- > 0;)
+		{
+			if (i != 1 && mNodes[i].Count > 0)
+			{
+				Gather(spheres, mNodes[i].LeftFirst, mNodes[i].Count);
+			}
+		}
+		cost += RefitNodes(0, mTopEnd);
+	}
+	else
+	{
+		Gather(spheres, 0, (std::uint32_t)mOrder.size());
+		cost = RefitNodes(0, mNodeCount);
+	}
+
+	float rootArea = NodeArea(mNodes[0]);
+	mStats.Cost = rootArea > 0.0f ? cost / rootArea : 0.0f;
+	mStats.Refits++;
+	mStats.RefitMicroseconds = MicrosecondsSince(refitStart);
+
+	// the orbits have stretched the tree too far from what a build would give.
+	if (replaced)
+	{
+		mStats.BuildCost = mStats.Cost;
+	}
+	else if (mStats.Cost > mRebuildThreshold * mStats.BuildCost && !mBuilder.joinable())
+	{
+		StartBackgroundBuild(spheres);
+	}
+	return replaced;
+}
+
+void SphereBvh::NodeRange(std::uint32_t nodeIndex, std::uint32_t& first, std::uint32_t& end)const
+{
+	// the left children down from the node lead to its first object, the right ones to its last.
+	const BvhNode* node = &mNodes[nodeIndex];
+	while (node->Count == 0)
+	{
+		node = &mNodes[node->LeftFirst];
+	}
+	first = node->LeftFirst;
+
+	node = &mNodes[nodeIndex];
+	while (node->Count == 0)
+	{
+		node = &mNodes[node->LeftFirst + 1];
+	}
+	end = node->LeftFirst + node->Count;
+}
+
+// ---------- queries ----------
+
+std::uint32_t SphereBvh::QueryFrustum(const CullFrustum& frustum, std::uint32_t* objects)const
+{
+	return FrustumNodes(frustum, nullptr, objects);
+}
+
+std::uint32_t SphereBvh::QueryFrustum(const CullFrustum& frustum, const BoxTest& boxVisible, std::uint32_t* objects)const
+{
+	return FrustumNodes(frustum, &boxVisible, objects);
+}
+
+std::uint32_t SphereBvh::FrustumNodes(const CullFrustum& frustum, const BoxTest* boxVisible, std::uint32_t* objects)const
+{
+	if (mNodeCount == 0)
+	{
+		return 0;
+	}
+
+	// each stack entry carries the planes its node still straddles, planes a node is inside of are
+	// never tested again below it.
+	std::uint32_t stack[MaxDepth + 2][2];
+	std::uint32_t stackSize = 0;
+	std::uint32_t found = 0;
+
+	stack[stackSize][0] = 0;
+	stack[stackSize++][1] = 0x3f;
+	while (stackSize > 0)
+	{
+		--stackSize;
+		const std::uint32_t nodeIndex = stack[stackSize][0];
+		const BvhNode& node = mNodes[nodeIndex];
+		std::uint32_t planes = stack[stackSize][1];
+
+		bool outside = false;
+		for (int p = 0; p < 6 && !outside; ++p)
+		{
+			if ((planes & (1u << p)) == 0)
+			{
+				continue;
+			}
+
+			// corners of the box farthest along and against the plane normal
+			const CullPlane& plane = frustum.Planes[p];
+			float farDistance = plane.A * (plane.A >= 0.0f ? node.Max[0] : node.Min[0]) + plane.B * (plane.B >= 0.0f ? node.Max[1] : node.Min[1]) +
+				plane.C * (plane.C >= 0.0f ? node.Max[2] : node.Min[2]) + plane.D;
+			float nearDistance = plane.A * (plane.A >= 0.0f ? node.Min[0] : node.Max[0]) + plane.B * (plane.B >= 0.0f ? node.Min[1] : node.Max[1]) +
+				plane.C * (plane.C >= 0.0f ? node.Min[2] : node.Max[2]) + plane.D;
+
+			outside = farDistance < 0.0f;
+			if (nearDistance >= 0.0f)
+			{
+				planes &= ~(1u << p);
+			}
+		}
+		if (outside)
+		{
+			continue;
+		}
+
+		// inside every plane : all the objects below, with no further test.  The traversal goes left first,
+		// through increasing slots, so found never passes the slots visited and objects holds them.  With a
+		// box test it goes on down to the leaves, without testing planes.
+		if (planes == 0 && !boxVisible)
+		{
+			std::uint32_t first, end;
+			NodeRange(nodeIndex, first, end);
+			std::memcpy(objects + found, &mOrder[first], (end - first) * sizeof(std::uint32_t));
+			found += end - first;
+			continue;
+		}
+
+		// a node the box test hides hides everything below it, whose boxes are inside its own.
+		if (boxVisible && !(*boxVisible)(node.Min, node.Max))
+		{
+			continue;
+		}
+
+		if (node.Count == 0)
+		{
+			stack[stackSize][0] = node.LeftFirst + 1;
+			stack[stackSize++][1] = planes;
+			stack[stackSize][0] = node.LeftFirst;
+			stack[stackSize++][1] = planes;
+			continue;
+		}
+
+		// the slots of the leaf 8 at a time, the visible ones turned into object indices.
+		std::uint32_t hits;
+		if (planes == 0)
+		{
+			hits = node.Count;
+			std::iota(objects + found, objects + found + hits, node.LeftFirst);
+		}
+		else
+		{
+			hits = CullSphereRange(frustum, mSlots, node.LeftFirst, node.Count, objects + found);
+		}
+		std::uint32_t kept = found;
+		for (std::uint32_t i = found; i < found + hits; ++i)
+		{
+			const std::uint32_t slot = objects[i];
+			if (boxVisible)
+			{
+				const float r = mSlots.R()[slot];
+				const float boxMin[3] = { mSlots.X()[slot] - r, mSlots.Y()[slot] - r, mSlots.Z()[slot] - r };
+				const float boxMax[3] = { mSlots.X()[slot] + r, mSlots.Y()[slot] + r, mSlots.Z()[slot] + r };
+				if (!(*boxVisible)(boxMin, boxMax))
+				{
+					continue;
+				}
+			}
+			objects[kept++] = mOrder[slot];
+		}
+		found = kept;
+	}
+	return found;
+}
+
+std::uint32_t SphereBvh::QuerySphere(float x, float y, float z, float radius, std::uint32_t* objects)const
+{
+	if (mNodeCount == 0)
+	{
+		return 0;
+	}
+
+	const float center[3] = { x, y, z };
+	std::uint32_t stack[MaxDepth + 2];
+	std::uint32_t stackSize = 0;
+	std::uint32_t found = 0;
+
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const BvhNode& node = mNodes[stack[--stackSize]];
+
+		// squared distance from the center to the box
+		float distanceSq = 0.0f;
+		for (int k = 0; k < 3; ++k)
+		{
+			float d = std::max(std::max(node.Min[k] - center[k], center[k] - node.Max[k]), 0.0f);
+			distanceSq += d * d;
+		}
+		if (distanceSq > radius * radius)
+		{
+			continue;
+		}
+
+		if (node.Count == 0)
+		{
+			stack[stackSize++] = node.LeftFirst + 1;
+			stack[stackSize++] = node.LeftFirst;
+			continue;
+		}
+
+		for (std::uint32_t slot = node.LeftFirst; slot < node.LeftFirst + node.Count; ++slot)
+		{
+			float dx = mSlots.X()[slot] - x, dy = mSlots.Y()[slot] - y, dz = mSlots.Z()[slot] - z;
+			float reach = mSlots.R()[slot] + radius;
+			if (dx * dx + dy * dy + dz * dz <= reach * reach)
+			{
+				objects[found++] = mOrder[slot];
+			}
+		}
+	}
+	return found;
+}
+
+bool SphereBvh::Raycast(const float origin[3], const float direction[3], float maxT, std::uint32_t& object, float& t)const
+{
+	if (mNodeCount == 0)
+	{
+		return false;
+	}
+
+	float invDirection[3];
+	for (int k = 0; k < 3; ++k)
+	{
+		invDirection[k] = direction[k] != 0.0f ? 1.0f / direction[k] : std::numeric_limits<float>::max();
+	}
+
+	// entry distance of the ray into a box, or maxT + 1 when it misses within [0, best].
+	auto enter = [&](const BvhNode& node, float best)
+	{
+		float tMin = 0.0f;
+		float tMax = best;
+		for (int k = 0; k < 3; ++k)
+		{
+			float t0 = (node.Min[k] - origin[k]) * invDirection[k];
+			float t1 = (node.Max[k] - origin[k]) * invDirection[k];
+			tMin = std::max(tMin, std::min(t0, t1));
+			tMax = std::min(tMax, std::max(t0, t1));
+		}
+		return tMin <= tMax ? tMin : std::numeric_limits<float>::max();
+	};
+
+	const float a = direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2];
+	float best = maxT;
+	bool hit = false;
+
+	std::uint32_t stack[MaxDepth + 2];
+	std::uint32_t stackSize = 0;
+	if (enter(mNodes[0], best) != std::numeric_limits<float>::max())
+	{
+		stack[stackSize++] = 0;
+	}
+
+	while (stackSize > 0)
+	{
+		const BvhNode& node = mNodes[stack[--stackSize]];
+
+		if (node.Count == 0)
+		{
+			// nearer child first, children the ray misses or reaches beyond the best hit are skipped.
+			float tLeft = enter(mNodes[node.LeftFirst], best);
+			float tRight = enter(mNodes[node.LeftFirst + 1], best);
+			std::uint32_t nearChild = node.LeftFirst, farChild = node.LeftFirst + 1;
+			if (tRight < tLeft)
+			{
+				std::swap(tLeft, tRight);
+				std::swap(nearChild, farChild);
+			}
+			if (tRight != std::numeric_limits<float>::max())
+			{
+				stack[stackSize++] = farChild;
+			}
+			if (tLeft != std::numeric_limits<float>::max())
+			{
+				stack[stackSize++] = nearChild;
+			}
+			continue;
+		}
+
+		for (std::uint32_t slot = node.LeftFirst; slot < node.LeftFirst + node.Count; ++slot)
+		{
+			const float sphere[4] = { mSlots.X()[slot], mSlots.Y()[slot], mSlots.Z()[slot], mSlots.R()[slot] };
+			float oc[3] = { origin[0] - sphere[0], origin[1] - sphere[1], origin[2] - sphere[2] };
+			float b = oc[0] * direction[0] + oc[1] * direction[1] + oc[2] * direction[2];
+			float c = oc[0] * oc[0] + oc[1] * oc[1] + oc[2] * oc[2] - sphere[3] * sphere[3];
+			float discriminant = b * b - a * c;
+			if (discriminant < 0.0f)
+			{
+				continue;
+			}
+
+			// a ray starting inside the sphere hits it at 0.
+			float root = std::sqrt(discriminant);
+			float tHit = (-b - root) / a;
+			if (tHit < 0.0f)
+			{
+				if ((-b + root) / a < 0.0f)
+				{
+					continue;
+				}
+				tHit = 0.0f;
+			}
+
+			if (tHit <= best)
+			{
+				best = tHit;
+				object = mOrder[slot];
+				hit = true;
+			}
+		}
+	}
+
+	if (hit)
+	{
+		t = best;
+	}
+	return hit;
+}
@@ -0,0 +1,151 @@
+// SphereBvh.h : bounding volume hierarchy over bounding spheres, for culling and picking queries.
+//
+// Built top down with a binned surface area heuristic.  Nodes are 32 bytes and stored flattened in one
+// 64 byte aligned array; the two children of a node are allocated next to each other, so a traversal step
+// loads both of them with a single cache line.  Every node covers a contiguous range of the objects, which
+// are kept in that order next to the leaves that reference them, as a SphereCullSet : leaves of up to
+// MaxLeafSize objects are tested 8 at a time by the frustum culling kernel, and a node found inside the
+// whole frustum hands over its range without testing anything below it.  Under DefaultBruteForceMax objects
+// (SetBruteForceMax) the tree is a single leaf, which makes the frustum query the brute force kernel.
+//
+// When the objects move, Update refits the node bounds bottom up instead of building again.  Once the
+// refitted tree's surface area cost has grown past RebuildThreshold times the cost it had right after its
+// last build, a new tree is built on a thread of its own from a copy of the spheres, and the old one is
+// refitted and queried until Update finds the new one done and swaps it in.  Large builds and refits on
+// the calling thread split the tree into subtrees that run on a WorkerPool.
+//
+// Queries return the indices the objects have in the SphereCullSet the tree was built from.
+
+#pragma once
+
+#include "FrustumCulling.h"
+#include "WorkerPool.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+
+struct BvhNode
+{
+	float Min[3];
+	std::uint32_t LeftFirst;		// first child when Count is 0 (the second one follows it), else first object
+	float Max[3];
+	std::uint32_t Count;			// objects of a leaf, 0 for an inner node
+};
+static_assert(sizeof(BvhNode) == 32, "two BvhNodes have to share a cache line");
+
+struct SphereBvhStats
+{
+	std::uint32_t Nodes = 0;
+	std::uint32_t Leaves = 0;
+	std::uint32_t Depth = 0;
+	float BuildCost = 0.0f;			// surface area cost right after the last build
+	float Cost = 0.0f;				// surface area cost now
+	std::uint32_t Refits = 0;
+	std::uint32_t Rebuilds = 0;		// on the calling thread and in the background
+	std::uint32_t BackgroundRebuilds = 0;
+	double BuildMicroseconds = 0.0;	// last build, wherever it ran
+	double RefitMicroseconds = 0.0;	// last refit
+};
+
+class SphereBvh
+{
+public:
+	static const std::uint32_t MaxLeafSize = 16;
+	static const std::uint32_t MaxDepth = 48;
+	// BvhBench's sweep from 1k to 1M objects, single threaded : the tree's frustum query is about as fast as
+	// the brute force kernel at 32k objects, 1.5 to 2 times slower under 16k and faster from 64k on.
+	static const std::uint32_t DefaultBruteForceMax = 32768;
+
+	// workers, when given, run the build and refit of large trees.
+	explicit SphereBvh(WorkerPool* workers = nullptr) : mWorkers(workers) {}
+	SphereBvh(const SphereBvh& rhs) = delete;
+	SphereBvh& operator=(const SphereBvh& rhs) = delete;
+	~SphereBvh();
+
+	// builds on the calling thread, dropping a background build in flight.
+	void Build(const SphereCullSet& spheres);
+
+	// refit to the spheres' new positions, swapping in a finished background build first.  Starts a background
+	// build when the tree got too loose, builds right away when the object count changed.
+	// returns true when the tree was replaced.
+	bool Update(const SphereCullSet& spheres);
+
+	void SetRebuildThreshold(float costRatio) { mRebuildThreshold = costRatio; }
+	void SetBruteForceMax(std::uint32_t count) { mBruteForceMax = count; }	// takes effect at the next build
+
+	// indices of the objects intersecting the frustum / the sphere, written into objects which has to hold
+	// ObjectCount() entries.  Returns how many there are, in no particular order.
+	std::uint32_t QueryFrustum(const CullFrustum& frustum, std::uint32_t* objects)const;
+
+	// false when nothing inside the world space box can be seen, an occlusion test.
+	using BoxTest = std::function<bool(const float boxMin[3], const float boxMax[3])>;
+
+	// the frustum query with the boxes of the objects found also passing boxVisible.  Every node the frustum
+	// reaches is tested as a whole first, what is below it only when it passes.
+	std::uint32_t QueryFrustum(const CullFrustum& frustum, const BoxTest& boxVisible, std::uint32_t* objects)const;
+	std::uint32_t QuerySphere(float x, float y, float z, float radius, std::uint32_t* objects)const;
+
+	// closest object hit by the ray origin + t * direction, 0 <= t <= maxT.
+	bool Raycast(const float origin[3], const float direction[3], float maxT, std::uint32_t& object, float& t)const;
+
+	std::uint32_t ObjectCount()const { return (std::uint32_t)mOrder.size(); }
+	const BvhNode* Nodes()const { return mNodes; }
+	const SphereBvhStats& Stats()const { return mStats; }
+
+private:
+	struct Subtree
+	{
+		std::uint32_t Parent;		// node of the top tree the subtree hangs from
+		std::uint32_t First;		// objects it covers
+		std::uint32_t Count;
+		std::uint32_t NodeBegin;	// nodes it occupies in the final array, Parent not included
+		std::uint32_t NodeEnd;
+		std::uint32_t Depth;
+	};
+
+	struct BuildContext;
+
+	// a built tree, before it replaces the current one.
+	struct BuildResult
+	{
+		std::vector<BvhNode> Nodes;
+		std::vector<std::uint32_t> Order;
+		std::vector<Subtree> Subtrees;
+		std::uint32_t TopEnd = 0;
+		double Microseconds = 0.0;
+	};
+
+	void BuildTree(const SphereCullSet& spheres, bool onWorkers, BuildResult& result)const;
+	void BuildRange(BuildContext& context, std::vector<BvhNode>& nodes, std::uint32_t nodeIndex, std::uint32_t first,
+		std::uint32_t count, std::uint32_t depth, std::uint32_t splitDepth)const;
+	void Adopt(BuildResult& result, const SphereCullSet& spheres);
+	void StartBackgroundBuild(const SphereCullSet& spheres);
+	void JoinBackgroundBuild();
+	void Gather(const SphereCullSet& spheres, std::uint32_t first, std::uint32_t count);
+	float RefitNodes(std::uint32_t begin, std::uint32_t end);
+	float LeafCost(const BvhNode& node)const;
+	void NodeRange(std::uint32_t nodeIndex, std::uint32_t& first, std::uint32_t& end)const;
+	std::uint32_t FrustumNodes(const CullFrustum& frustum, const BoxTest* boxVisible, std::uint32_t* objects)const;
+
+private:
+	WorkerPool* mWorkers = nullptr;
+	float mRebuildThreshold = 1.5f;
+	std::uint32_t mBruteForceMax = DefaultBruteForceMax;
+
+	std::vector<unsigned char> mNodeStorage;	// mNodes, 64 byte aligned inside it
+	BvhNode* mNodes = nullptr;
+	std::uint32_t mNodeCount = 0;
+	std::uint32_t mTopEnd = 0;					// nodes [0, mTopEnd) are refitted after the subtrees
+	std::vector<Subtree> mSubtrees;
+
+	std::vector<std::uint32_t> mOrder;			// object index of each slot, leaves reference slots
+	SphereCullSet mSlots;						// sphere of each slot
+
+	// the background build, its result is only touched by the builder until mBuilt is set.
+	std::thread mBuilder;
+	std::atomic<bool> mBuilt{ false };
+	std::unique_ptr<BuildResult> mBackgroundResult;
+
+	SphereBvhStats mStats;
+};
@@ -0,0 +1,93 @@
+// SphereImpostor.cpp
+
+#include "SphereImpostor.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	const float Pi = 3.14159265f;
+
+	// slopes (c / z) of the two lines through the eye tangent to the circle of the sphere projected on the
+	// (axis, z) plane.  They solve (c - m z)^2 = r^2 (1 + m^2).
+	void TangentSlopes(float c, float z, float radius, float& low, float& high)
+	{
+		float t = std::sqrt(std::max(c * c + z * z - radius * radius, 0.0f));
+		float denominator = z * z - radius * radius;
+		low = (c * z - radius * t) / denominator;
+		high = (c * z + radius * t) / denominator;
+	}
+}
+
+ImpostorQuad SphereImpostorQuad(const float centerV[3], float radius, const ImpostorProjection& projection)
+{
+	ImpostorQuad quad;
+	float nearest = centerV[2] - radius;
+	if (nearest <= projection.NearZ)
+	{
+		return quad;
+	}
+
+	float low, high;
+	TangentSlopes(centerV[0], centerV[2], radius, low, high);
+	quad.MinX = low * projection.P00;
+	quad.MaxX = high * projection.P00;
+	TangentSlopes(centerV[1], centerV[2], radius, low, high);
+	quad.MinY = low * projection.P11;
+	quad.MaxY = high * projection.P11;
+	quad.Depth = projection.Depth(nearest);
+	return quad;
+}
+
+bool SphereImpostorHit(float ndcX, float ndcY, const float centerV[3], float radius, const ImpostorProjection& projection,
+	ImpostorHit& hit)
+{
+	// the ray t * d, d the unit direction towards the view space point at z = 1 under the pixel.  The distance
+	// from the center to the ray comes from the perpendicular vector itself rather than from |c|^2 - tca^2,
+	// which cancels badly for small spheres far away.
+	float d[3] = { ndcX / projection.P00, ndcY / projection.P11, 1.0f };
+	float length = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+	for (int k = 0; k < 3; ++k)
+	{
+		d[k] /= length;
+	}
+
+	float tca = d[0] * centerV[0] + d[1] * centerV[1] + d[2] * centerV[2];
+	float centerDistance2 = centerV[0] * centerV[0] + centerV[1] * centerV[1] + centerV[2] * centerV[2];
+	float rayDistance2 = 0.0f;
+	for (int k = 0; k < 3; ++k)
+	{
+		float perpendicular = centerV[k] - tca * d[k];
+		rayDistance2 += perpendicular * perpendicular;
+	}
+	float halfChord2 = radius * radius - rayDistance2;
+	if (halfChord2 < 0.0f || centerDistance2 <= radius * radius)
+	{
+		return false;
+	}
+
+	float t = tca - std::sqrt(halfChord2);
+	for (int k = 0; k < 3; ++k)
+	{
+		hit.PositionV[k] = t * d[k];
+		hit.NormalV[k] = (hit.PositionV[k] - centerV[k]) / radius;
+	}
+	if (hit.PositionV[2] < projection.NearZ)
+	{
+		return false;
+	}
+
+	hit.Depth = projection.Depth(hit.PositionV[2]);
+	return true;
+}
+
+void SphereTexCoord(const float normalL[3], float& u, float& v)
+{
+	float theta = std::atan2(normalL[2], normalL[0]);
+	if (theta < 0.0f)
+	{
+		theta += 2.0f * Pi;
+	}
+	u = theta / (2.0f * Pi);
+	v = std::acos(std::min(1.0f, std::max(-1.0f, normalL[1]))) / Pi;
+}
@@ -0,0 +1,52 @@
+// SphereImpostor.h : the math of the ray traced sphere impostors (ImpostorVS / ImpostorPS in
+// Shaders/BasicShader.hlsl), on the CPU so it can be checked headlessly.  The two have to stay in step.
+//
+// A sphere is drawn as one screen aligned quad bounding its projection.  The pixel shader casts the view ray
+// of every pixel at the sphere; the closest hit gives the depth written to SV_Depth, the normal and the
+// texture coordinates, so the silhouette is exact at any distance for four vertices per sphere.
+//
+// View space is D3D's : x right, y up, looking down +z.  The projection has no off-center terms, a view space
+// point (x, y, z) lands at ndc (x * P00 / z, y * P11 / z) with depth P22 + P32 / z.
+
+#pragma once
+
+struct ImpostorProjection
+{
+	float P00 = 1.0f;
+	float P11 = 1.0f;
+	float P22 = 1.0f;
+	float P32 = 0.0f;
+	float NearZ = 1.0f;
+
+	float Depth(float viewZ)const { return P22 + P32 / viewZ; }
+};
+
+// ndc rectangle of the quad and its depth.
+struct ImpostorQuad
+{
+	float MinX = -1.0f;
+	float MinY = -1.0f;
+	float MaxX = 1.0f;
+	float MaxY = 1.0f;
+	float Depth = 0.0f;
+};
+
+// the rectangle bounding the projection of the sphere, at the depth of its nearest point.  A sphere
+// reaching in front of the near plane gets the whole screen at depth 0.
+ImpostorQuad SphereImpostorQuad(const float centerV[3], float radius, const ImpostorProjection& projection);
+
+struct ImpostorHit
+{
+	float PositionV[3];
+	float NormalV[3];		// unit length
+	float Depth;			// ndc depth, the value written to SV_Depth
+};
+
+// closest hit of the view ray through the ndc point.  False when the ray misses, when the eye is inside the
+// sphere, or when the hit lies in front of the near plane.
+bool SphereImpostorHit(float ndcX, float ndcY, const float centerV[3], float radius, const ImpostorProjection& projection,
+	ImpostorHit& hit);
+
+// texture coordinates GeometryGenerator::CreateSphere gives the point of the unit sphere with this object
+// space normal : u = longitude / 2 pi measured from +x towards +z, v = colatitude / pi from +y.
+void SphereTexCoord(const float normalL[3], float& u, float& v);
@@ -0,0 +1,32 @@
+// StagingRing.cpp
+
+#include "StagingRing.h"
+
+bool StagingRing::Allocate(std::uint64_t size, std::uint64_t alignment, std::uint64_t& ringOffset)
+{
+	std::uint64_t offset = (mHead + alignment - 1) / alignment * alignment;
+
+	// an allocation never wraps around the end of the ring.
+	ringOffset = offset % mSize;
+	if (ringOffset + size > mSize)
+	{
+		offset += mSize - ringOffset;
+		ringOffset = 0;
+	}
+
+	if (offset + size - mTail > mSize)
+	{
+		if (!Empty())
+		{
+			return false;
+		}
+
+		// nothing is in use : the next lap starts here, whatever the alignment and wrap padding were.
+		offset = (mHead + mSize - 1) / mSize * mSize;
+		mTail = offset;
+		ringOffset = 0;
+	}
+
+	mHead = offset + size;
+	return true;
+}
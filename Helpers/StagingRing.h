@@ -0,0 +1,34 @@
+// StagingRing.h : the space bookkeeping of UploadManager's staging ring.
+//
+// Head and tail grow monotonically and offsets in the ring are taken modulo its size.  An allocation
+// never wraps around the end of the ring : when it does not fit before the end it starts at the next
+// lap.  Callers record Head() with every batch of allocations and hand it to Retire once the batch is
+// done.  An empty ring restarts at the beginning of the next lap, so anything up to the ring's size
+// always fits in it.
+
+#pragma once
+
+#include <cstdint>
+
+class StagingRing
+{
+public:
+	explicit StagingRing(std::uint64_t size) : mSize(size) {}
+
+	// reserves size bytes (at most Size()) aligned to alignment, which has to divide Size().  Returns false
+	// when the allocated space does not leave room for it; an empty ring always does.
+	bool Allocate(std::uint64_t size, std::uint64_t alignment, std::uint64_t& ringOffset);
+
+	// frees everything allocated before the head was at end.
+	void Retire(std::uint64_t end) { mTail = end > mTail ? end : mTail; }
+
+	std::uint64_t Size()const { return mSize; }
+	std::uint64_t Head()const { return mHead; }
+	std::uint64_t Tail()const { return mTail; }
+	bool Empty()const { return mHead == mTail; }
+
+private:
+	std::uint64_t mSize = 0;
+	std::uint64_t mHead = 0;
+	std::uint64_t mTail = 0;
+};
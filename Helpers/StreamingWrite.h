@@ -0,0 +1,99 @@
+// StreamingWrite.h : write-combine friendly writes into mapped upload heap memory.
+//
+// Upload heaps are mapped write-combined : reads from them are uncached and partial cache lines are flushed
+// one burst at a time, so the fastest way in is a stream of full, aligned, write-only lines.
+// StreamingCopy moves a contiguous run with non-temporal 16 byte stores, and MappedSpan lets a kernel
+// store its results straight into the mapped memory instead of building them on the stack first.
+// Neither ever reads back from the destination.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define STREAMING_WRITE_SSE2 1
+#endif
+
+// copies size bytes into write-combined memory.  The destination is aligned with a regular head copy,
+// the bulk goes out in 64 byte groups of non-temporal stores, and a fence makes them visible before
+// the caller submits the GPU work reading them.
+inline void StreamingCopy(void* dst, const void* src, std::size_t size)
+{
+#if STREAMING_WRITE_SSE2
+	std::uint8_t* d = static_cast<std::uint8_t*>(dst);
+	const std::uint8_t* s = static_cast<const std::uint8_t*>(src);
+
+	if (size < 64)
+	{
+		std::memcpy(d, s, size);
+		return;
+	}
+
+	std::size_t head = (16 - ((std::uintptr_t)d & 15)) & 15;
+	std::memcpy(d, s, head);
+	d += head;
+	s += head;
+	size -= head;
+
+	for (; size >= 64; size -= 64, d += 64, s += 64)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*)(s + 0));
+		__m128i b = _mm_loadu_si128((const __m128i*)(s + 16));
+		__m128i c = _mm_loadu_si128((const __m128i*)(s + 32));
+		__m128i e = _mm_loadu_si128((const __m128i*)(s + 48));
+		_mm_stream_si128((__m128i*)(d + 0), a);
+		_mm_stream_si128((__m128i*)(d + 16), b);
+		_mm_stream_si128((__m128i*)(d + 32), c);
+		_mm_stream_si128((__m128i*)(d + 48), e);
+	}
+	for (; size >= 16; size -= 16, d += 16, s += 16)
+	{
+		_mm_stream_si128((__m128i*)d, _mm_loadu_si128((const __m128i*)s));
+	}
+	std::memcpy(d, s, size);
+
+	_mm_sfence();
+#else
+	std::memcpy(dst, src, size);
+#endif
+}
+
+// write-only view of count elements of a mapped buffer, stride bytes apart (constant buffer elements are padded).
+// Store whole members in increasing address order and never read through it : every read is an uncached fetch.
+template<typename T>
+class MappedSpan
+{
+public:
+	MappedSpan() = default;
+	MappedSpan(std::uint8_t* data, std::uint32_t count, std::uint32_t stride) : mData(data), mCount(count), mStride(stride) {}
+
+	T& operator[](std::uint32_t i)const { return *reinterpret_cast<T*>(mData + (std::size_t)i * mStride); }
+
+	std::uint32_t Count()const { return mCount; }
+	std::uint32_t Stride()const { return mStride; }
+	bool Contiguous()const { return mStride == sizeof(T); }
+
+	// bulk copy of count elements starting at first, returns the number of bytes written.
+	std::uint64_t Write(std::uint32_t first, const T* src, std::uint32_t count)const
+	{
+		if (Contiguous())
+		{
+			StreamingCopy(mData + (std::size_t)first * mStride, src, sizeof(T) * count);
+		}
+		else
+		{
+			for (std::uint32_t i = 0; i < count; ++i)
+				StreamingCopy(mData + (std::size_t)(first + i) * mStride, &src[i], sizeof(T));
+		}
+
+		return (std::uint64_t)sizeof(T) * count;
+	}
+
+private:
+	std::uint8_t* mData = nullptr;
+	std::uint32_t mCount = 0;
+	std::uint32_t mStride = 0;
+};
@@ -0,0 +1,419 @@
+// TerrainHeights.cpp
+
+#include "TerrainHeights.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+namespace
+{
+	const double FaceAxes[6][3][3] =
+	{
+		{ { 1, 0, 0 }, { 0, 0, -1 }, { 0, 1, 0 } },
+		{ { -1, 0, 0 }, { 0, 0, 1 }, { 0, 1, 0 } },
+		{ { 0, 1, 0 }, { 1, 0, 0 }, { 0, 0, -1 } },
+		{ { 0, -1, 0 }, { 1, 0, 0 }, { 0, 0, 1 } },
+		{ { 0, 0, 1 }, { 1, 0, 0 }, { 0, 1, 0 } },
+		{ { 0, 0, -1 }, { -1, 0, 0 }, { 0, 1, 0 } },
+	};
+
+	std::uint64_t TileBytes(std::uint32_t tileSize)
+	{
+		return (std::uint64_t)tileSize * tileSize * sizeof(std::int16_t);
+	}
+
+	// value noise on the integer lattice, smoothly interpolated.
+	double LatticeValue(std::int32_t x, std::int32_t y, std::int32_t z)
+	{
+		std::uint32_t hash = (std::uint32_t)x * 0x8da6b343u ^ (std::uint32_t)y * 0xd8163841u ^ (std::uint32_t)z * 0xcb1ab31fu;
+		hash ^= hash >> 15;
+		hash *= 0x2c1b3c6du;
+		hash ^= hash >> 12;
+		return hash / 2147483647.5 - 1.0;
+	}
+
+	double ValueNoise(double x, double y, double z)
+	{
+		double fx = std::floor(x), fy = std::floor(y), fz = std::floor(z);
+		std::int32_t ix = (std::int32_t)fx, iy = (std::int32_t)fy, iz = (std::int32_t)fz;
+		double tx = x - fx, ty = y - fy, tz = z - fz;
+		tx = tx * tx * (3.0 - 2.0 * tx);
+		ty = ty * ty * (3.0 - 2.0 * ty);
+		tz = tz * tz * (3.0 - 2.0 * tz);
+
+		double values[2][2];
+		for (int dz = 0; dz < 2; ++dz)
+		{
+			for (int dy = 0; dy < 2; ++dy)
+			{
+				double a = LatticeValue(ix, iy + dy, iz + dz), b = LatticeValue(ix + 1, iy + dy, iz + dz);
+				values[dz][dy] = a + (b - a) * tx;
+			}
+		}
+		double near = values[0][0] + (values[0][1] - values[0][0]) * ty;
+		double far = values[1][0] + (values[1][1] - values[1][0]) * ty;
+		return near + (far - near) * tz;
+	}
+}
+
+void CubeFaceAxes(std::uint32_t face, double normal[3], double u[3], double v[3])
+{
+	for (int k = 0; k < 3; ++k)
+	{
+		normal[k] = FaceAxes[face][0][k];
+		u[k] = FaceAxes[face][1][k];
+		v[k] = FaceAxes[face][2][k];
+	}
+}
+
+void CubeFacePoint(std::uint32_t face, double u, double v, double point[3])
+{
+	// on the cube, then moved onto the sphere with x' = x sqrt(1 - y²/2 - z²/2 + y²z²/3) and its permutations.
+	const double (&axes)[3][3] = FaceAxes[face];
+	double s = 2.0 * u - 1.0, t = 2.0 * v - 1.0;
+	double cube[3];
+	for (int k = 0; k < 3; ++k)
+	{
+		cube[k] = axes[0][k] + s * axes[1][k] + t * axes[2][k];
+	}
+	double xx = cube[0] * cube[0], yy = cube[1] * cube[1], zz = cube[2] * cube[2];
+	point[0] = cube[0] * std::sqrt(1.0 - 0.5 * yy - 0.5 * zz + yy * zz / 3.0);
+	point[1] = cube[1] * std::sqrt(1.0 - 0.5 * zz - 0.5 * xx + zz * xx / 3.0);
+	point[2] = cube[2] * std::sqrt(1.0 - 0.5 * xx - 0.5 * yy + xx * yy / 3.0);
+}
+
+std::uint64_t TerrainTileOffset(std::uint32_t tileSize, const CubeQuadKey& key)
+{
+	// the tiles of the coarser levels, 6 x 4^level each, then those before key in its own level.
+	std::uint64_t coarserTiles = 6 * (((std::uint64_t)1 << (2 * key.Level)) - 1) / 3;
+	std::uint64_t side = (std::uint64_t)1 << key.Level;
+	std::uint64_t index = coarserTiles + (key.Face * side + key.Y) * side + key.X;
+	return sizeof(TerrainHeightHeader) + index * TileBytes(tileSize);
+}
+
+bool WriteTerrainHeights(const std::string& filename, std::uint32_t tileSize, std::uint32_t levelCount,
+	const std::function<float(const double point[3])>& height, WorkerPool* workers)
+{
+	std::ofstream fout(filename, std::ios::binary | std::ios::trunc);
+	if (!fout)
+	{
+		return false;
+	}
+	TerrainHeightHeader header = { TerrainHeightHeader::Magic, TerrainHeightHeader::Version, tileSize, levelCount };
+	fout.write((const char*)&header, sizeof(header));
+
+	// a level at a time, its tiles sampled in parallel.
+	std::vector<std::int16_t> heights;
+	for (std::uint32_t level = 0; level < levelCount && fout; ++level)
+	{
+		std::uint32_t side = 1u << level;
+		std::uint32_t tileCount = 6 * side * side;
+		std::size_t samples = (std::size_t)tileSize * tileSize;
+		heights.resize(tileCount * samples);
+
+		auto sampleTile = [&](std::uint32_t tile)
+		{
+			CubeQuadKey key = { tile / (side * side), level, tile % side, tile / side % side };
+			double scale = 1.0 / ((double)(tileSize - 1) * side);
+			std::int16_t* out = &heights[tile * samples];
+			for (std::uint32_t j = 0; j < tileSize; ++j)
+			{
+				for (std::uint32_t i = 0; i < tileSize; ++i)
+				{
+					double point[3];
+					CubeFacePoint(key.Face, (key.X * (tileSize - 1) + i) * scale, (key.Y * (tileSize - 1) + j) * scale, point);
+					float h = std::max(-1.0f, std::min(1.0f, height(point)));
+					*out++ = (std::int16_t)std::lround(h * 32767.0f);
+				}
+			}
+		};
+		if (workers)
+		{
+			workers->Run(tileCount, sampleTile);
+		}
+		else
+		{
+			for (std::uint32_t tile = 0; tile < tileCount; ++tile)
+			{
+				sampleTile(tile);
+			}
+		}
+		fout.write((const char*)heights.data(), (std::streamsize)(heights.size() * sizeof(std::int16_t)));
+	}
+
+	fout.close();
+	if (!fout)
+	{
+		std::remove(filename.c_str());
+		return false;
+	}
+	return true;
+}
+
+float TerrainNoiseHeight(const double point[3])
+{
+	// six octaves, continents at the lowest frequency and hills at the highest.
+	double sum = 0.0, amplitude = 1.0, frequency = 1.5, total = 0.0;
+	for (int octave = 0; octave < 6; ++octave)
+	{
+		sum += amplitude * ValueNoise(point[0] * frequency + 17.0, point[1] * frequency + 31.0, point[2] * frequency + 47.0);
+		total += amplitude;
+		amplitude *= 0.5;
+		frequency *= 2.0;
+	}
+	return (float)(sum / total);
+}
+
+float TerrainHeightTile::Sample(std::uint32_t tileSize, double u, double v)const
+{
+	// the last cell takes the samples on the far border, so those are met with a weight of exactly 1.
+	std::uint32_t i = std::min((std::uint32_t)u, tileSize - 2);
+	std::uint32_t j = std::min((std::uint32_t)v, tileSize - 2);
+	double fu = u - i, fv = v - j;
+	const std::int16_t* row = &Heights[(std::size_t)j * tileSize + i];
+	double near = row[0] * (1.0 - fu) + row[1] * fu;
+	double far = row[tileSize] * (1.0 - fu) + row[tileSize + 1] * fu;
+	return (float)((near * (1.0 - fv) + far * fv) / 32767.0);
+}
+
+TerrainHeightStreamer::TerrainHeightStreamer(unsigned loaderCount, std::size_t capacity)
+	: mCapacity(capacity), mLoaderCount(std::max(loaderCount, 1u))
+{
+}
+
+TerrainHeightStreamer::~TerrainHeightStreamer()
+{
+	Stop();
+}
+
+void TerrainHeightStreamer::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStop = true;
+	}
+	mWake.notify_all();
+	for (auto& loader : mLoaders)
+	{
+		loader.join();
+	}
+	mLoaders.clear();
+
+	mStop = false;
+	mQueue.clear();
+	mFinished.clear();
+	mResident.clear();
+	mPending.clear();
+	mWanted.clear();
+	mTileSize = 0;
+	mLevelCount = 0;
+}
+
+bool TerrainHeightStreamer::Open(const std::string& filename)
+{
+	Stop();
+
+	std::ifstream fin(filename, std::ios::binary);
+	TerrainHeightHeader header = {};
+	if (!fin.read((char*)&header, sizeof(header)) || header.FileMagic != TerrainHeightHeader::Magic ||
+		header.FileVersion != TerrainHeightHeader::Version || header.TileSize < 3 || header.TileSize > 257 ||
+		((header.TileSize - 1) & (header.TileSize - 2)) != 0 || header.LevelCount == 0 || header.LevelCount > 16)
+	{
+		return false;
+	}
+	fin.seekg(0, std::ios::end);
+	if ((std::uint64_t)fin.tellg() != TerrainTileOffset(header.TileSize, CubeQuadKey{ 0, header.LevelCount, 0, 0 }))
+	{
+		return false;
+	}
+
+	mFilename = filename;
+	mTileSize = header.TileSize;
+	for (std::uint32_t face = 0; face < 6; ++face)
+	{
+		auto tile = std::make_unique<TerrainHeightTile>();
+		tile->Key = { face, 0, 0, 0 };
+		if (!ReadTile(fin, *tile))
+		{
+			mResident.clear();
+			mTileSize = 0;
+			return false;
+		}
+		mResident[tile->Key.Packed()] = std::move(tile);
+	}
+	mLevelCount = header.LevelCount;
+	mLoaded = 6;
+	mEvicted = 0;
+
+	for (unsigned i = 0; i < mLoaderCount; ++i)
+	{
+		mLoaders.emplace_back(&TerrainHeightStreamer::LoaderLoop, this);
+	}
+	return true;
+}
+
+bool TerrainHeightStreamer::ReadTile(std::ifstream& file, TerrainHeightTile& tile)const
+{
+	tile.Heights.resize((std::size_t)mTileSize * mTileSize);
+	file.clear();
+	file.seekg((std::streamoff)TerrainTileOffset(mTileSize, tile.Key));
+	if (!file.read((char*)tile.Heights.data(), (std::streamsize)TileBytes(mTileSize)))
+	{
+		tile.Heights.clear();
+		return false;
+	}
+	return true;
+}
+
+void TerrainHeightStreamer::LoaderLoop()
+{
+	std::ifstream file(mFilename, std::ios::binary);
+	for (;;)
+	{
+		auto tile = std::make_unique<TerrainHeightTile>();
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWake.wait(lock, [this]() { return mStop || !mQueue.empty(); });
+			if (mStop)
+			{
+				return;
+			}
+			tile->Key = mQueue.front();
+			mQueue.pop_front();
+			mReading++;
+		}
+
+		// a tile that can't be read comes back empty, and is requested again if still needed.
+		ReadTile(file, *tile);
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		mFinished.push_back(std::move(tile));
+		mReading--;
+		mIdle.notify_all();
+	}
+}
+
+const TerrainHeightTile* TerrainHeightStreamer::Find(const CubeQuadKey& key)const
+{
+	auto it = mResident.find(key.Packed());
+	return it != mResident.end() ? it->second.get() : nullptr;
+}
+
+const TerrainHeightTile* TerrainHeightStreamer::Request(const CubeQuadKey& key)
+{
+	if (key.Level >= mLevelCount)
+	{
+		return nullptr;
+	}
+	auto it = mResident.find(key.Packed());
+	if (it != mResident.end())
+	{
+		it->second->LastUsed = mUpdates;
+		return it->second.get();
+	}
+
+	mWanted.insert(key.Packed());
+	if (mPending.insert(key.Packed()).second)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mQueue.push_back(key);
+		}
+		mWake.notify_one();
+	}
+	return nullptr;
+}
+
+const TerrainHeightTile* TerrainHeightStreamer::Covering(const CubeQuadKey& key)
+{
+	for (std::uint32_t level = std::min(key.Level, mLevelCount - 1);; --level)
+	{
+		auto it = mResident.find(key.Ancestor(level).Packed());
+		if (it != mResident.end())
+		{
+			it->second->LastUsed = mUpdates;
+			return it->second.get();
+		}
+	}
+}
+
+void TerrainHeightStreamer::Update()
+{
+	mUpdates++;
+
+	// the loaded tiles, and the queued ones nobody asked for since the last update are dropped.
+	std::vector<std::unique_ptr<TerrainHeightTile>> finished;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		finished.swap(mFinished);
+		auto dropped = std::stable_partition(mQueue.begin(), mQueue.end(),
+			[this](const CubeQuadKey& key) { return mWanted.count(key.Packed()) != 0; });
+		for (auto it = dropped; it != mQueue.end(); ++it)
+		{
+			mPending.erase(it->Packed());
+		}
+		mQueue.erase(dropped, mQueue.end());
+	}
+	mWanted.clear();
+
+	for (auto& tile : finished)
+	{
+		mPending.erase(tile->Key.Packed());
+		if (!tile->Heights.empty())
+		{
+			tile->LastUsed = mUpdates;
+			mResident[tile->Key.Packed()] = std::move(tile);
+			mLoaded++;
+		}
+	}
+
+	// past the capacity, the least recently used tiles go, level 0 never does.
+	if (mResident.size() <= mCapacity)
+	{
+		return;
+	}
+	std::vector<std::pair<std::uint64_t, std::uint64_t>> candidates;
+	for (const auto& resident : mResident)
+	{
+		if (resident.second->Key.Level > 0)
+		{
+			candidates.push_back({ resident.second->LastUsed, resident.first });
+		}
+	}
+	std::size_t evictCount = std::min(mResident.size() - mCapacity, candidates.size());
+	if (evictCount == 0)
+	{
+		return;
+	}
+	std::nth_element(candidates.begin(), candidates.begin() + (evictCount - 1), candidates.end());
+	for (std::size_t i = 0; i < evictCount; ++i)
+	{
+		mResident.erase(candidates[i].second);
+	}
+	mEvicted += evictCount;
+}
+
+void TerrainHeightStreamer::WaitIdle()
+{
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mIdle.wait(lock, [this]() { return mQueue.empty() && mReading == 0; });
+	}
+	for (std::uint64_t key : mPending)
+	{
+		mWanted.insert(key);
+	}
+	Update();
+}
+
+TerrainStreamStats TerrainHeightStreamer::Stats()const
+{
+	TerrainStreamStats stats;
+	stats.Resident = (std::uint32_t)mResident.size();
+	stats.Pending = (std::uint32_t)mPending.size();
+	stats.Loaded = mLoaded;
+	stats.Evicted = mEvicted;
+	return stats;
+}
@@ -0,0 +1,159 @@
+// TerrainHeights.h : the heights of a planet's surface as tiles of a cube-face quadtree, in a file read by
+// loader threads.
+//
+// The planet is a cube whose six faces are projected onto the unit sphere (CubeFacePoint).  Every face is
+// a quadtree, a CubeQuadKey names one of its cells : face, level, and column and row among the 2^level x
+// 2^level cells of that level.  The tile of a cell holds TileSize x TileSize heights sampled on its corners
+// and every (TileSize - 1)th of its width, so neighbouring tiles share their border samples and a tile's
+// even samples are those of its parent.  Cells are dyadic fractions of a face, their sample points are
+// computed exactly from either face of a cube edge and get the same heights on both.
+//
+// file layout, little endian : TerrainHeightHeader, then every tile of level 0, 1, ... LevelCount - 1,
+// within a level face by face, row by row, each TileSize x TileSize int16 heights in [-32767, 32767].
+//
+// TerrainHeightStreamer serves the tiles to one thread.  Request queues the tiles not resident yet for its
+// loader threads, Update makes the loaded ones resident at a point of the caller's choosing (once per frame)
+// and evicts the least recently used past its capacity.  Level 0 is loaded by Open and always resident, so
+// Covering finds a tile for every cell.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class WorkerPool;
+
+struct CubeQuadKey
+{
+	static const std::uint32_t MaxLevel = 24;
+
+	std::uint32_t Face = 0;			// +X, -X, +Y, -Y, +Z, -Z
+	std::uint32_t Level = 0;
+	std::uint32_t X = 0;			// column and row in [0, 2^Level)
+	std::uint32_t Y = 0;
+
+	// face 3 bits, level 5 bits, row and column 24 bits each.
+	std::uint64_t Packed()const { return (std::uint64_t)Face << 61 | (std::uint64_t)Level << 56 | (std::uint64_t)Y << 24 | X; }
+
+	CubeQuadKey Parent()const { return { Face, Level - 1, X >> 1, Y >> 1 }; }
+	CubeQuadKey Child(std::uint32_t i)const { return { Face, Level + 1, X * 2 + (i & 1), Y * 2 + (i >> 1) }; }
+	CubeQuadKey Ancestor(std::uint32_t level)const { return { Face, level, X >> (Level - level), Y >> (Level - level) }; }
+
+	bool operator==(const CubeQuadKey& rhs)const { return Packed() == rhs.Packed(); }
+};
+
+// the axes of a face : outward normal, then the directions u and v grow in, Normal = U x V.
+void CubeFaceAxes(std::uint32_t face, double normal[3], double u[3], double v[3]);
+
+// the point of face at (u, v) in [0, 1]², projected onto the unit sphere so cells keep similar areas.
+void CubeFacePoint(std::uint32_t face, double u, double v, double point[3]);
+
+struct TerrainHeightHeader
+{
+	static const std::uint32_t Magic = 0x54474848;		// "HHGT"
+	static const std::uint32_t Version = 1;
+
+	std::uint32_t FileMagic;
+	std::uint32_t FileVersion;
+	std::uint32_t TileSize;			// samples along a side, 2^n + 1
+	std::uint32_t LevelCount;
+};
+
+std::uint64_t TerrainTileOffset(std::uint32_t tileSize, const CubeQuadKey& key);
+
+// samples height(point on the unit sphere), in [-1, 1], into every tile of levelCount levels.
+bool WriteTerrainHeights(const std::string& filename, std::uint32_t tileSize, std::uint32_t levelCount,
+	const std::function<float(const double point[3])>& height, WorkerPool* workers = nullptr);
+
+// fractal noise over the sphere, the sample's stand-in for measured elevation data.
+float TerrainNoiseHeight(const double point[3]);
+
+struct TerrainHeightTile
+{
+	CubeQuadKey Key;
+	std::vector<std::int16_t> Heights;		// TileSize x TileSize, row by row
+	std::uint64_t LastUsed = 0;				// Update count when it was last requested
+
+	// the height at (u, v) in sample units of the tile, bilinear between the samples around it.
+	float Sample(std::uint32_t tileSize, double u, double v)const;
+};
+
+struct TerrainStreamStats
+{
+	std::uint32_t Resident = 0;
+	std::uint32_t Pending = 0;			// requested and not resident yet
+	std::uint64_t Loaded = 0;			// tiles read since Open
+	std::uint64_t Evicted = 0;
+};
+
+class TerrainHeightStreamer
+{
+public:
+	explicit TerrainHeightStreamer(unsigned loaderCount = 2, std::size_t capacity = 2048);
+	TerrainHeightStreamer(const TerrainHeightStreamer& rhs) = delete;
+	TerrainHeightStreamer& operator=(const TerrainHeightStreamer& rhs) = delete;
+	~TerrainHeightStreamer();
+
+	// reads the header and level 0, false when the file is missing or malformed.
+	bool Open(const std::string& filename);
+	bool IsOpen()const { return mLevelCount != 0; }
+
+	std::uint32_t TileSize()const { return mTileSize; }
+	std::uint32_t LevelCount()const { return mLevelCount; }
+
+	// the resident tile of key, or nullptr.  Request also queues the load of a missing tile and marks a
+	// resident one used.  Tiles stay valid until the next Update.
+	const TerrainHeightTile* Find(const CubeQuadKey& key)const;
+	const TerrainHeightTile* Request(const CubeQuadKey& key);
+
+	// the finest resident tile covering key's cell, level 0 at worst.
+	const TerrainHeightTile* Covering(const CubeQuadKey& key);
+
+	void Update();
+
+	// blocks until nothing is queued or being read, then makes it resident.  For tools.
+	void WaitIdle();
+
+	TerrainStreamStats Stats()const;
+
+private:
+	void LoaderLoop();
+	bool ReadTile(std::ifstream& file, TerrainHeightTile& tile)const;
+	void Stop();
+
+private:
+	std::string mFilename;
+	std::uint32_t mTileSize = 0;
+	std::uint32_t mLevelCount = 0;
+	std::size_t mCapacity;
+	std::uint64_t mUpdates = 0;
+
+	// owned by the calling thread.
+	std::unordered_map<std::uint64_t, std::unique_ptr<TerrainHeightTile>> mResident;
+	std::unordered_set<std::uint64_t> mPending;
+	std::unordered_set<std::uint64_t> mWanted;		// requested since the last Update, the rest of the queue is dropped
+	std::uint64_t mLoaded = 0;
+	std::uint64_t mEvicted = 0;
+
+	// shared with the loaders.
+	std::vector<std::thread> mLoaders;
+	unsigned mLoaderCount;
+	mutable std::mutex mMutex;
+	std::condition_variable mWake;			// a tile was queued, or the loaders are stopping
+	std::condition_variable mIdle;			// a loader finished a tile
+	std::deque<CubeQuadKey> mQueue;
+	std::vector<std::unique_ptr<TerrainHeightTile>> mFinished;
+	unsigned mReading = 0;
+	bool mStop = false;
+};
@@ -0,0 +1,56 @@
+// TripleBuffer.h : lock-free handoff of whole values from one producer thread to one consumer thread.
+//
+// Three copies of T : the producer owns one, the consumer owns one and the third sits in between.
+// Publish swaps the producer's copy with the middle one and Acquire swaps the middle one with the
+// consumer's, both with a single atomic exchange, so neither side ever waits for the other and the
+// consumer always gets the newest published value.  A value is never written while it is being read.
+// The copies are reused, containers inside T keep their capacity from one value to the next.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+template<typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() = default;
+	TripleBuffer(const TripleBuffer& rhs) = delete;
+	TripleBuffer& operator=(const TripleBuffer& rhs) = delete;
+
+	// producer side : fill WriteBuffer(), then Publish() it.
+	T& WriteBuffer() { return mBuffers[mWrite]; }
+	void Publish()
+	{
+		std::uint32_t previous = mMiddle.exchange(mWrite | FreshBit, std::memory_order_acq_rel);
+		mWrite = previous & IndexMask;
+	}
+
+	// true while the last published value has not been acquired yet.
+	bool Pending()const { return (mMiddle.load(std::memory_order_acquire) & FreshBit) != 0; }
+
+	// consumer side : returns false when nothing was published since the last call, ReadBuffer() then
+	// still holds the previous value.
+	bool Acquire()
+	{
+		if (!Pending())
+		{
+			return false;
+		}
+
+		std::uint32_t previous = mMiddle.exchange(mRead, std::memory_order_acq_rel);
+		mRead = previous & IndexMask;
+		return true;
+	}
+	const T& ReadBuffer()const { return mBuffers[mRead]; }
+
+private:
+	static const std::uint32_t IndexMask = 0x3;
+	static const std::uint32_t FreshBit = 0x4;
+
+	T mBuffers[3];
+	std::uint32_t mWrite = 0;						// owned by the producer
+	std::uint32_t mRead = 1;						// owned by the consumer
+	std::atomic<std::uint32_t> mMiddle{ 2 };		// index of the middle copy, FreshBit once published
+};
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "d3dUtil.h"
+#include "StreamingWrite.h"
 
 template<typename T>
 class UploadBuffer
@@ -29,6 +30,8 @@ public:
             mElementByteSize = sizeof(T);
         }
 
+        mElementCount = elementCount;
+
         ThrowIfFailed(device->CreateCommittedResource(
             &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
             D3D12_HEAP_FLAG_NONE,  
@@ -63,10 +66,25 @@ public:
         memcpy(&mMappedData[elementIndex*mElementByteSize], &data, sizeof(T));
     }
 
+    // Copy a contiguous run of elements with streaming stores, one run without constant buffer padding.
+    // Returns the number of bytes written into the upload heap.
+    UINT64 CopyData(int firstIndex, const T* data, UINT count)
+    {
+        return Span(0, mElementCount).Write(firstIndex, data, count);
+    }
+
+    // Write-only view of elements [firstIndex, firstIndex + count) for kernels storing their results in place.
+    // The memory is write-combined, see StreamingWrite.h.
+    MappedSpan<T> Span(int firstIndex, UINT count)const
+    {
+        return MappedSpan<T>(&mMappedData[firstIndex*mElementByteSize], count, mElementByteSize);
+    }
+
 private:
     Microsoft::WRL::ComPtr<ID3D12Resource> mUploadBuffer;
     BYTE* mMappedData = nullptr;
 
     UINT mElementByteSize = 0;
+    UINT mElementCount = 0;
     bool mIsConstantBuffer = false;
 };
\ No newline at end of file
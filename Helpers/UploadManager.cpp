@@ -0,0 +1,256 @@
+// UploadManager.cpp
+
+#include "UploadManager.h"
+
+using Microsoft::WRL::ComPtr;
+
+UploadManager::UploadManager(ID3D12Device* device, UINT64 stagingSize)
+	: mDevice(device), mStagingSize(stagingSize), mRing(stagingSize)
+{
+	D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+	queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+	queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+	ThrowIfFailed(mDevice->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&mCopyQueue)));
+
+	ComPtr<ID3D12CommandAllocator> allocator;
+	ThrowIfFailed(mDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(&allocator)));
+	ThrowIfFailed(mDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COPY, allocator.Get(), nullptr, IID_PPV_ARGS(&mCmdList)));
+	ThrowIfFailed(mCmdList->Close());
+	mFreeAllocators.push_back(allocator);
+
+	ThrowIfFailed(mDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&mFence)));
+	mFenceEvent = CreateEventEx(nullptr, nullptr, false, EVENT_ALL_ACCESS);
+
+	ThrowIfFailed(mDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(mStagingSize),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&mStaging)));
+
+	// stays mapped for the lifetime of the manager, the CPU only ever writes to it.
+	ThrowIfFailed(mStaging->Map(0, nullptr, reinterpret_cast<void**>(&mStagingData)));
+}
+
+UploadManager::~UploadManager()
+{
+	// the copy queue may still read from the staging ring.
+	Wait(Submit());
+
+	mStaging->Unmap(0, nullptr);
+	CloseHandle(mFenceEvent);
+}
+
+ComPtr<ID3D12Resource> UploadManager::CreateBuffer(const void* data, UINT64 byteSize)
+{
+	ComPtr<ID3D12Resource> buffer;
+	ThrowIfFailed(mDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(byteSize),
+		D3D12_RESOURCE_STATE_COMMON,
+		nullptr,
+		IID_PPV_ARGS(buffer.GetAddressOf())));
+
+	UploadBuffer(buffer.Get(), 0, data, byteSize);
+
+	return buffer;
+}
+
+void UploadManager::UploadBuffer(ID3D12Resource* dst, UINT64 dstOffset, const void* data, UINT64 byteSize)
+{
+	ID3D12Resource* staging = nullptr;
+	BYTE* cpuAddress = nullptr;
+	UINT64 offset = AllocateStaging(byteSize, 16, &staging, &cpuAddress);
+
+	memcpy(cpuAddress, data, (size_t)byteSize);
+
+	if (!mBatchOpen)
+	{
+		OpenBatch();
+	}
+	mCmdList->CopyBufferRegion(dst, dstOffset, staging, offset, byteSize);
+
+	mBytesUploaded += byteSize;
+}
+
+HRESULT UploadManager::CreateDDSTexture(const wchar_t* filename, ComPtr<ID3D12Resource>& texture)
+{
+	std::unique_ptr<uint8_t[]> ddsData;
+	std::vector<D3D12_SUBRESOURCE_DATA> subresources;
+
+	HRESULT hr = DirectX::LoadDDSTextureFromFile12(mDevice.Get(), filename, texture, ddsData, subresources);
+	if (SUCCEEDED(hr))
+	{
+		// the subresources are copied into the staging ring right away, ddsData can go afterwards.
+		UploadTexture(texture.Get(), 0, (UINT)subresources.size(), subresources.data());
+	}
+
+	return hr;
+}
+
+void UploadManager::UploadTexture(ID3D12Resource* dst, UINT firstSubresource, UINT numSubresources, const D3D12_SUBRESOURCE_DATA* subresources)
+{
+	D3D12_RESOURCE_DESC desc = dst->GetDesc();
+
+	std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> layouts(numSubresources);
+	std::vector<UINT> numRows(numSubresources);
+	std::vector<UINT64> rowSizes(numSubresources);
+	UINT64 totalBytes = 0;
+	mDevice->GetCopyableFootprints(&desc, firstSubresource, numSubresources, 0,
+		layouts.data(), numRows.data(), rowSizes.data(), &totalBytes);
+
+	ID3D12Resource* staging = nullptr;
+	BYTE* cpuAddress = nullptr;
+	UINT64 offset = AllocateStaging(totalBytes, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, &staging, &cpuAddress);
+
+	// rows are copied to the pitch the copy engine expects.
+	for (UINT i = 0; i < numSubresources; ++i)
+	{
+		D3D12_MEMCPY_DEST dest;
+		dest.pData = cpuAddress + layouts[i].Offset;
+		dest.RowPitch = layouts[i].Footprint.RowPitch;
+		dest.SlicePitch = (SIZE_T)layouts[i].Footprint.RowPitch * numRows[i];
+		MemcpySubresource(&dest, &subresources[i], (SIZE_T)rowSizes[i], numRows[i], layouts[i].Footprint.Depth);
+
+		layouts[i].Offset += offset;
+	}
+
+	if (!mBatchOpen)
+	{
+		OpenBatch();
+	}
+	for (UINT i = 0; i < numSubresources; ++i)
+	{
+		CD3DX12_TEXTURE_COPY_LOCATION dstLocation(dst, firstSubresource + i);
+		CD3DX12_TEXTURE_COPY_LOCATION srcLocation(staging, layouts[i]);
+		mCmdList->CopyTextureRegion(&dstLocation, 0, 0, 0, &srcLocation, nullptr);
+	}
+
+	mBytesUploaded += totalBytes;
+}
+
+UINT64 UploadManager::Submit()
+{
+	if (!mBatchOpen)
+	{
+		return mLastFenceValue;
+	}
+
+	ThrowIfFailed(mCmdList->Close());
+	ID3D12CommandList* cmdsLists[] = { mCmdList.Get() };
+	mCopyQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+
+	mLastFenceValue++;
+	ThrowIfFailed(mCopyQueue->Signal(mFence.Get(), mLastFenceValue));
+
+	mOpenBatch.FenceValue = mLastFenceValue;
+	mOpenBatch.StagingEnd = mRing.Head();
+	mInFlight.push_back(std::move(mOpenBatch));
+	mOpenBatch = Batch();
+	mBatchOpen = false;
+	mBatchesSubmitted++;
+
+	return mLastFenceValue;
+}
+
+void UploadManager::Wait(UINT64 fenceValue)
+{
+	if (mFence->GetCompletedValue() < fenceValue)
+	{
+		ThrowIfFailed(mFence->SetEventOnCompletion(fenceValue, mFenceEvent));
+		WaitForSingleObject(mFenceEvent, INFINITE);
+	}
+	RetireCompletedBatches();
+}
+
+void UploadManager::WaitOnQueue(ID3D12CommandQueue* queue, UINT64 fenceValue)
+{
+	ThrowIfFailed(queue->Wait(mFence.Get(), fenceValue));
+}
+
+UINT64 UploadManager::AllocateStaging(UINT64 size, UINT64 alignment, ID3D12Resource** resource, BYTE** cpuAddress)
+{
+	// too large for the ring : a dedicated upload buffer, released with its batch.
+	if (size > mStagingSize)
+	{
+		if (!mBatchOpen)
+		{
+			OpenBatch();
+		}
+
+		ComPtr<ID3D12Resource> staging;
+		ThrowIfFailed(mDevice->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+			D3D12_HEAP_FLAG_NONE,
+			&CD3DX12_RESOURCE_DESC::Buffer(size),
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(staging.GetAddressOf())));
+
+		ThrowIfFailed(staging->Map(0, nullptr, reinterpret_cast<void**>(cpuAddress)));
+		*resource = staging.Get();
+		mOpenBatch.OversizeStaging.push_back(staging);
+		return 0;
+	}
+
+	for (;;)
+	{
+		UINT64 ringOffset = 0;
+		if (mRing.Allocate(size, alignment, ringOffset))
+		{
+			*resource = mStaging.Get();
+			*cpuAddress = mStagingData + ringOffset;
+			return ringOffset;
+		}
+
+		// the ring is full : wait for the oldest batch, or submit the open one if it holds all the space.
+		// Either frees space, and once everything is retired the ring is empty and the allocation fits.
+		assert(!mRing.Empty());
+		if (!mInFlight.empty())
+		{
+			Wait(mInFlight.front().FenceValue);
+		}
+		else
+		{
+			assert(mBatchOpen);
+			Wait(Submit());
+		}
+	}
+}
+
+void UploadManager::OpenBatch()
+{
+	RetireCompletedBatches();
+
+	ComPtr<ID3D12CommandAllocator> allocator;
+	if (!mFreeAllocators.empty())
+	{
+		allocator = mFreeAllocators.back();
+		mFreeAllocators.pop_back();
+	}
+	else
+	{
+		ThrowIfFailed(mDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(&allocator)));
+	}
+
+	// allocators come back to the pool only after their batch has completed.
+	ThrowIfFailed(allocator->Reset());
+	ThrowIfFailed(mCmdList->Reset(allocator.Get(), nullptr));
+
+	mOpenBatch.Allocator = allocator;
+	mBatchOpen = true;
+}
+
+void UploadManager::RetireCompletedBatches()
+{
+	UINT64 completed = mFence->GetCompletedValue();
+
+	while (!mInFlight.empty() && mInFlight.front().FenceValue <= completed)
+	{
+		mRing.Retire(mInFlight.front().StagingEnd);
+		mFreeAllocators.push_back(mInFlight.front().Allocator);
+		mInFlight.pop_front();
+	}
+}
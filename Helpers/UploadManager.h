@@ -0,0 +1,83 @@
+// UploadManager.h : uploads buffers and textures into default heap resources on a dedicated copy queue.
+//
+// Source data is written into a persistently mapped staging ring and the copies are recorded into the
+// open batch.  Submit() closes the batch, executes it on the copy queue and signals the batch's fence value.
+// The staging space and command allocator of a batch are recycled once that value has completed, so the
+// graphics queue and the main thread never wait for uploads unless they ask to.
+//
+// Resources are created in the COMMON state and only used as copy destinations on the copy queue
+// (implicit promotion), so they decay back to COMMON when their batch completes and get promoted to their
+// read state on first use by the graphics queue.  That queue has to wait for the batch first (WaitOnQueue).
+// Not thread safe, call it from one thread.
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "StagingRing.h"
+#include <deque>
+
+class UploadManager
+{
+public:
+	static const UINT64 DefaultStagingSize = 32ull * 1024 * 1024;
+
+	UploadManager(ID3D12Device* device, UINT64 stagingSize = DefaultStagingSize);
+	UploadManager(const UploadManager& rhs) = delete;
+	UploadManager& operator=(const UploadManager& rhs) = delete;
+	~UploadManager();
+
+	// creates a default heap buffer and queues the copy of data into it.
+	Microsoft::WRL::ComPtr<ID3D12Resource> CreateBuffer(const void* data, UINT64 byteSize);
+	void UploadBuffer(ID3D12Resource* dst, UINT64 dstOffset, const void* data, UINT64 byteSize);
+
+	// loads a DDS file, creates its texture and queues the copy of every subresource.
+	HRESULT CreateDDSTexture(const wchar_t* filename, Microsoft::WRL::ComPtr<ID3D12Resource>& texture);
+	void UploadTexture(ID3D12Resource* dst, UINT firstSubresource, UINT numSubresources, const D3D12_SUBRESOURCE_DATA* subresources);
+
+	// closes and submits the open batch.  Returns the fence value its completion signals,
+	// or the value of the last batch when nothing was queued since.
+	UINT64 Submit();
+
+	bool IsComplete(UINT64 fenceValue)const { return mFence->GetCompletedValue() >= fenceValue; }
+	void Wait(UINT64 fenceValue);									// blocks the calling thread
+	void WaitOnQueue(ID3D12CommandQueue* queue, UINT64 fenceValue);	// queue waits on the GPU, the CPU does not block
+
+	UINT64 BytesUploaded()const { return mBytesUploaded; }
+	UINT BatchesSubmitted()const { return mBatchesSubmitted; }
+
+private:
+	struct Batch
+	{
+		Microsoft::WRL::ComPtr<ID3D12CommandAllocator> Allocator;
+		UINT64 FenceValue = 0;
+		UINT64 StagingEnd = 0;		// staging ring head when the batch was submitted
+		std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> OversizeStaging;	// uploads larger than the ring
+	};
+
+	// returns the offset of the allocation in *resource, mapped at *cpuAddress.
+	UINT64 AllocateStaging(UINT64 size, UINT64 alignment, ID3D12Resource** resource, BYTE** cpuAddress);
+	void OpenBatch();
+	void RetireCompletedBatches();
+
+private:
+	Microsoft::WRL::ComPtr<ID3D12Device> mDevice;
+	Microsoft::WRL::ComPtr<ID3D12CommandQueue> mCopyQueue;
+	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> mCmdList;
+	Microsoft::WRL::ComPtr<ID3D12Fence> mFence;
+	HANDLE mFenceEvent = nullptr;
+	UINT64 mLastFenceValue = 0;
+
+	// staging ring, the space in it is accounted by mRing.
+	Microsoft::WRL::ComPtr<ID3D12Resource> mStaging;
+	BYTE* mStagingData = nullptr;
+	UINT64 mStagingSize = 0;
+	StagingRing mRing;
+
+	bool mBatchOpen = false;
+	Batch mOpenBatch;
+	std::deque<Batch> mInFlight;
+	std::vector<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>> mFreeAllocators;
+
+	UINT64 mBytesUploaded = 0;
+	UINT mBatchesSubmitted = 0;
+};
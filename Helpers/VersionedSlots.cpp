@@ -0,0 +1,138 @@
+// VersionedSlots.cpp
+
+#include "VersionedSlots.h"
+#include <algorithm>
+#include <cassert>
+
+using std::uint32_t;
+using std::uint64_t;
+
+VersionedSlots::VersionedSlots(uint32_t elementCount, uint32_t slotCount)
+{
+	Reset(elementCount, slotCount);
+}
+
+void VersionedSlots::Reset(uint32_t elementCount, uint32_t slotCount)
+{
+	mVersion = 0;
+	mSyncedVersion = 0;
+	mElementVersions.assign(elementCount, 0);
+	mSlotVersions.assign(slotCount, 0);
+	mChangeLog.clear();
+	mStaleRanges.clear();
+
+	if (elementCount > 0)
+	{
+		MarkAllDirty();
+	}
+}
+
+uint64_t VersionedSlots::MarkDirty(uint32_t first, uint32_t count)
+{
+	assert(first + count <= mElementVersions.size());
+
+	if (count == 0)
+	{
+		return mVersion;
+	}
+
+	++mVersion;
+	for (uint32_t i = first; i < first + count; ++i)
+	{
+		mElementVersions[i] = mVersion;
+	}
+
+	// extend the latest change when it is contiguous with this one and no slot has seen it yet,
+	// so that updating a run of neighbouring elements costs a single log entry.
+	if (!mChangeLog.empty())
+	{
+		Change& last = mChangeLog.back();
+		if (last.Version > mSyncedVersion && last.First + last.Count == first)
+		{
+			last.Count += count;
+			last.Version = mVersion;
+			return mVersion;
+		}
+	}
+
+	mChangeLog.push_back({ mVersion, first, count });
+
+	return mVersion;
+}
+
+uint64_t VersionedSlots::MarkAllDirty()
+{
+	return MarkDirty(0, (uint32_t)mElementVersions.size());
+}
+
+const std::vector<VersionedSlots::Range>& VersionedSlots::Sync(uint32_t slot)
+{
+	assert(slot < mSlotVersions.size());
+
+	mStaleRanges.clear();
+
+	// the change log is ordered by version, so everything after the first entry newer than
+	// the version the slot holds is stale.
+	const uint64_t held = mSlotVersions[slot];
+	auto firstStale = std::upper_bound(mChangeLog.begin(), mChangeLog.end(), held,
+		[](uint64_t version, const Change& change) { return version < change.Version; });
+
+	for (auto it = firstStale; it != mChangeLog.end(); ++it)
+	{
+		mStaleRanges.push_back({ it->First, it->Count });
+	}
+
+	// coalesce overlapping and adjacent ranges into contiguous copies.
+	if (mStaleRanges.size() > 1)
+	{
+		std::sort(mStaleRanges.begin(), mStaleRanges.end(),
+			[](const Range& a, const Range& b) { return a.First < b.First; });
+
+		size_t merged = 0;
+		for (size_t i = 1; i < mStaleRanges.size(); ++i)
+		{
+			Range& back = mStaleRanges[merged];
+			const Range& next = mStaleRanges[i];
+			if (next.First <= back.First + back.Count)
+			{
+				back.Count = std::max(back.First + back.Count, next.First + next.Count) - back.First;
+			}
+			else
+			{
+				mStaleRanges[++merged] = next;
+			}
+		}
+		mStaleRanges.resize(merged + 1);
+	}
+
+	mSlotVersions[slot] = mVersion;
+	mSyncedVersion = mVersion;
+
+	// drop the changes every slot already holds.
+	const uint64_t oldest = *std::min_element(mSlotVersions.begin(), mSlotVersions.end());
+	auto firstNeeded = std::upper_bound(mChangeLog.begin(), mChangeLog.end(), oldest,
+		[](uint64_t version, const Change& change) { return version < change.Version; });
+	mChangeLog.erase(mChangeLog.begin(), firstNeeded);
+
+	return mStaleRanges;
+}
+
+uint64_t VersionedSlots::ElementVersion(uint32_t index)const
+{
+	return mElementVersions[index];
+}
+
+uint64_t VersionedSlots::SlotVersion(uint32_t slot)const
+{
+	return mSlotVersions[slot];
+}
+
+uint64_t VersionedSlots::CurrentVersion()const
+{
+	return mVersion;
+}
+
+uint32_t VersionedSlots::ElementCount()const
+{
+	return (uint32_t)mElementVersions.size();
+}
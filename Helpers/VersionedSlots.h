@@ -0,0 +1,57 @@
+// VersionedSlots.h : version based change tracking for data mirrored into per-frame upload buffers.
+//
+// Every element (an object, a material, ...) carries a version that is bumped whenever it changes,
+// and every frame slot remembers the newest version it already holds.  Syncing a slot hands back
+// only the elements newer than that version, merged into sorted contiguous ranges, so the amount
+// of data rewritten each frame scales with the number of changes rather than with the scene size.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class VersionedSlots
+{
+public:
+	struct Range
+	{
+		std::uint32_t First = 0;
+		std::uint32_t Count = 0;
+	};
+
+public:
+	VersionedSlots() = default;
+	VersionedSlots(std::uint32_t elementCount, std::uint32_t slotCount);
+
+	// (re)size the tracker, every element starts out dirty for every slot.
+	void Reset(std::uint32_t elementCount, std::uint32_t slotCount);
+
+	// mark the elements [first, first + count) as changed and return the version they now carry.
+	std::uint64_t MarkDirty(std::uint32_t first, std::uint32_t count = 1);
+	std::uint64_t MarkAllDirty();
+
+	// collect the elements the given slot holds an older version of, as coalesced ranges,
+	// and record that the slot is up to date.  The returned ranges stay valid until the next call.
+	const std::vector<Range>& Sync(std::uint32_t slot);
+
+	std::uint64_t ElementVersion(std::uint32_t index)const;
+	std::uint64_t SlotVersion(std::uint32_t slot)const;
+	std::uint64_t CurrentVersion()const;
+	std::uint32_t ElementCount()const;
+
+private:
+	struct Change
+	{
+		std::uint64_t Version;
+		std::uint32_t First;
+		std::uint32_t Count;
+	};
+
+	std::uint64_t mVersion = 0;						// newest version handed out
+	std::uint64_t mSyncedVersion = 0;				// newest version any slot has been synced to
+
+	std::vector<std::uint64_t> mElementVersions;	// version carried by each element
+	std::vector<std::uint64_t> mSlotVersions;		// version held by each frame slot
+	std::vector<Change> mChangeLog;					// changes not yet seen by every slot, ordered by version
+	std::vector<Range> mStaleRanges;
+};
@@ -0,0 +1,118 @@
+// VertexQuantization.cpp
+
+#include "VertexQuantization.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	const float SnormMax = 32767.0f;
+	const float UnormMax = 65535.0f;
+
+	std::int16_t ToSnorm(float value)
+	{
+		return (std::int16_t)std::lround(std::min(1.0f, std::max(-1.0f, value)) * SnormMax);
+	}
+
+	// the way the input assembler reads SNORM : -32768 and -32767 both give -1.
+	float FromSnorm(std::int16_t value)
+	{
+		return std::max(value / SnormMax, -1.0f);
+	}
+
+	float SignNotZero(float value)
+	{
+		return value >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	// decode of unquantized octahedral coordinates, the formula the shader runs.
+	void Unfold(float x, float y, float normal[3])
+	{
+		float z = 1.0f - std::fabs(x) - std::fabs(y);
+		if (z < 0.0f)
+		{
+			float foldedX = (1.0f - std::fabs(y)) * SignNotZero(x);
+			float foldedY = (1.0f - std::fabs(x)) * SignNotZero(y);
+			x = foldedX;
+			y = foldedY;
+		}
+		float length = std::sqrt(x * x + y * y + z * z);
+		normal[0] = x / length;
+		normal[1] = y / length;
+		normal[2] = z / length;
+	}
+}
+
+void OctahedralEncode(const float normal[3], std::int16_t encoded[2])
+{
+	float l1 = std::fabs(normal[0]) + std::fabs(normal[1]) + std::fabs(normal[2]);
+	float x = normal[0] / l1;
+	float y = normal[1] / l1;
+	if (normal[2] < 0.0f)
+	{
+		float foldedX = (1.0f - std::fabs(y)) * SignNotZero(x);
+		float foldedY = (1.0f - std::fabs(x)) * SignNotZero(y);
+		x = foldedX;
+		y = foldedY;
+	}
+
+	// rounding each coordinate on its own isn't always the closest code, try the four around the point.
+	float bestDot = -2.0f;
+	float baseX = std::floor(std::min(1.0f, std::max(-1.0f, x)) * SnormMax);
+	float baseY = std::floor(std::min(1.0f, std::max(-1.0f, y)) * SnormMax);
+	for (int i = 0; i < 4; ++i)
+	{
+		std::int16_t code[2] =
+		{
+			(std::int16_t)std::min(SnormMax, baseX + (i & 1)),
+			(std::int16_t)std::min(SnormMax, baseY + (i >> 1))
+		};
+		float decoded[3];
+		OctahedralDecode(code, decoded);
+		float dot = decoded[0] * normal[0] + decoded[1] * normal[1] + decoded[2] * normal[2];
+		if (dot > bestDot)
+		{
+			bestDot = dot;
+			encoded[0] = code[0];
+			encoded[1] = code[1];
+		}
+	}
+}
+
+void OctahedralDecode(const std::int16_t encoded[2], float normal[3])
+{
+	Unfold(FromSnorm(encoded[0]), FromSnorm(encoded[1]), normal);
+}
+
+CompactVertex EncodeVertex(const float position[3], const float normal[3], const float texC[2], const QuantizationBounds& bounds)
+{
+	CompactVertex vertex;
+	for (int k = 0; k < 3; ++k)
+	{
+		// a flat axis (the plane's y) has nothing to encode.
+		float extent = bounds.Extent[k];
+		vertex.Position[k] = extent > 0.0f ? ToSnorm((position[k] - bounds.Center[k]) / extent) : 0;
+	}
+	vertex.Position[3] = 0;
+
+	OctahedralEncode(normal, vertex.Normal);
+
+	for (int k = 0; k < 2; ++k)
+	{
+		vertex.TexC[k] = (std::uint16_t)std::lround(std::min(1.0f, std::max(0.0f, texC[k])) * UnormMax);
+	}
+	return vertex;
+}
+
+void DecodeVertex(const CompactVertex& vertex, const QuantizationBounds& bounds, float position[3], float normal[3], float texC[2])
+{
+	for (int k = 0; k < 3; ++k)
+	{
+		position[k] = bounds.Center[k] + bounds.Extent[k] * FromSnorm(vertex.Position[k]);
+	}
+	OctahedralDecode(vertex.Normal, normal);
+	for (int k = 0; k < 2; ++k)
+	{
+		texC[k] = vertex.TexC[k] / UnormMax;
+	}
+}
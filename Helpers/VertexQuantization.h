@@ -0,0 +1,38 @@
+// VertexQuantization.h : a 16 byte vertex for meshes that don't need full float precision, half the size of
+// the 32 byte Vertex of FrameBuffer.h.
+//
+//   - the position is 3 x 16 bit SNORM inside the bounds of its mesh, center + extent * q, so the error is
+//     at most half a step of extent / 32767 per axis.  The fourth component is padding, there is no 3 x 16
+//     bit vertex format,
+//   - the normal is octahedral encoded in 2 x 16 bit SNORM : the unit sphere folded onto the octahedron
+//     |x| + |y| + |z| = 1, whose lower half is unfolded over the corners of the square.  The encoder
+//     keeps whichever of the four nearest codes decodes closest to the normal,
+//   - the texture coordinates are 2 x 16 bit UNORM, clamped to [0, 1] : meshes whose coordinates wrap
+//     outside of it need the full Vertex.
+// CompactVS in Shaders/BasicShader.hlsl decodes it with the same formulas, the bounds coming from cbDraw.
+
+#pragma once
+
+#include <cstdint>
+
+struct CompactVertex
+{
+	std::int16_t Position[4];		// DXGI_FORMAT_R16G16B16A16_SNORM, w unused
+	std::int16_t Normal[2];			// DXGI_FORMAT_R16G16_SNORM
+	std::uint16_t TexC[2];			// DXGI_FORMAT_R16G16_UNORM
+};
+static_assert(sizeof(CompactVertex) == 16, "CompactVertex has to stay half of Vertex");
+
+// the box positions are quantized in, the center and half size of the mesh bounds.
+struct QuantizationBounds
+{
+	float Center[3] = { 0.0f, 0.0f, 0.0f };
+	float Extent[3] = { 1.0f, 1.0f, 1.0f };
+};
+
+CompactVertex EncodeVertex(const float position[3], const float normal[3], const float texC[2], const QuantizationBounds& bounds);
+void DecodeVertex(const CompactVertex& vertex, const QuantizationBounds& bounds, float position[3], float normal[3], float texC[2]);
+
+// the two octahedral SNORM values of a unit normal, and back to a unit normal.
+void OctahedralEncode(const float normal[3], std::int16_t encoded[2]);
+void OctahedralDecode(const std::int16_t encoded[2], float normal[3]);
@@ -0,0 +1,100 @@
+// WorkerPool.cpp
+
+#include "WorkerPool.h"
+
+unsigned WorkerPool::DefaultWorkerCount()
+{
+	unsigned hardwareThreads = std::thread::hardware_concurrency();
+	return hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+}
+
+WorkerPool::WorkerPool(unsigned workerCount)
+{
+	mWorkers.reserve(workerCount);
+	for (unsigned i = 0; i < workerCount; ++i)
+	{
+		mWorkers.emplace_back(&WorkerPool::WorkerLoop, this);
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStop = true;
+	}
+	mWake.notify_all();
+
+	for (auto& worker : mWorkers)
+	{
+		worker.join();
+	}
+}
+
+void WorkerPool::Run(std::uint32_t taskCount, const std::function<void(std::uint32_t)>& fn)
+{
+	if (taskCount == 0)
+	{
+		return;
+	}
+
+	// a single task or no workers : nothing to hand out.
+	if (taskCount == 1 || mWorkers.empty())
+	{
+		for (std::uint32_t task = 0; task < taskCount; ++task)
+		{
+			fn(task);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mFn = &fn;
+		mTaskCount = taskCount;
+		mNextTask = 0;
+		mBusy = (unsigned)mWorkers.size();
+		mGeneration++;
+	}
+	mWake.notify_all();
+
+	RunTasks();
+
+	// fn and the task counter stay in use until every worker has left the loop.
+	std::unique_lock<std::mutex> lock(mMutex);
+	mDone.wait(lock, [this]() { return mBusy == 0; });
+	mFn = nullptr;
+}
+
+void WorkerPool::RunTasks()
+{
+	for (std::uint32_t task = mNextTask.fetch_add(1); task < mTaskCount; task = mNextTask.fetch_add(1))
+	{
+		(*mFn)(task);
+	}
+}
+
+void WorkerPool::WorkerLoop()
+{
+	std::uint64_t seenGeneration = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWake.wait(lock, [&]() { return mStop || mGeneration != seenGeneration; });
+			if (mStop)
+			{
+				return;
+			}
+			seenGeneration = mGeneration;
+		}
+
+		RunTasks();
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (--mBusy == 0)
+		{
+			mDone.notify_one();
+		}
+	}
+}
@@ -0,0 +1,51 @@
+// WorkerPool.h : a fixed set of worker threads running the tasks of one parallel loop at a time.
+//
+// Run(taskCount, fn) calls fn(task) for every task in [0, taskCount) and returns once all of them are done.
+// The calling thread takes tasks as well, so a pool of zero workers simply runs the loop inline.  Tasks are
+// handed out through an atomic counter, so uneven tasks balance themselves.  Run is meant to be called from
+// one thread at a time; fn must not call Run on the same pool.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkerPool
+{
+public:
+	// workerCount threads besides the caller, by default one less than the hardware threads.
+	explicit WorkerPool(unsigned workerCount = DefaultWorkerCount());
+	WorkerPool(const WorkerPool& rhs) = delete;
+	WorkerPool& operator=(const WorkerPool& rhs) = delete;
+	~WorkerPool();
+
+	void Run(std::uint32_t taskCount, const std::function<void(std::uint32_t)>& fn);
+
+	// threads taking part in Run, the caller included.
+	unsigned ThreadCount()const { return (unsigned)mWorkers.size() + 1; }
+
+	static unsigned DefaultWorkerCount();
+
+private:
+	void WorkerLoop();
+	void RunTasks();
+
+private:
+	std::vector<std::thread> mWorkers;
+
+	std::mutex mMutex;
+	std::condition_variable mWake;			// a loop was posted, or the pool is shutting down
+	std::condition_variable mDone;			// the last busy worker left the current loop
+	std::uint64_t mGeneration = 0;			// bumped by every Run
+	unsigned mBusy = 0;						// workers still inside the current loop
+	bool mStop = false;
+
+	const std::function<void(std::uint32_t)>* mFn = nullptr;
+	std::uint32_t mTaskCount = 0;
+	std::atomic<std::uint32_t> mNextTask{ 0 };
+};
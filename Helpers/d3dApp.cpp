@@ -75,35 +75,92 @@ int D3DApp::Run()
  
 	mTimer.Reset();
 
-	while(msg.message != WM_QUIT)
+	if (mSimulationThreadEnabled)
 	{
-		// If there are Window messages then process them.
-		if(PeekMessage( &msg, 0, 0, 0, PM_REMOVE ))
-		{
-            TranslateMessage( &msg );
-            DispatchMessage( &msg );
-		}
-		// Otherwise, do animation/game stuff.
-		else
-        {	
-			mTimer.Tick();
+		mSimulationStop = false;
+		mSimulationThread = std::thread(&D3DApp::SimulationLoop, this);
+	}
 
-			if( !mAppPaused )
+	try
+	{
+		while(msg.message != WM_QUIT)
+		{
+			// If there are Window messages then process them.
+			if(PeekMessage( &msg, 0, 0, 0, PM_REMOVE ))
 			{
-				CalculateFrameStats();
-				Update(mTimer);	
-                Draw(mTimer);
+				TranslateMessage( &msg );
+				DispatchMessage( &msg );
 			}
+			// Otherwise, do animation/game stuff.
 			else
-			{
-				Sleep(100);
+			{	
+				mTimer.Tick();
+				mSimulationPaused = mAppPaused;
+
+				if( !mAppPaused )
+				{
+					CalculateFrameStats();
+					if (!mSimulationThreadEnabled)
+					{
+						Simulate(mTimer);
+					}
+					Update(mTimer);	
+					Draw(mTimer);
+				}
+				else
+				{
+					Sleep(100);
+				}
 			}
-        }
-    }
+		}
+	}
+	catch (...)
+	{
+		StopSimulationThread();
+		throw;
+	}
+
+	StopSimulationThread();
 
 	return (int)msg.wParam;
 }
 
+void D3DApp::SimulationLoop()
+{
+	GameTimer timer;
+	timer.Reset();
+
+	while (!mSimulationStop)
+	{
+		if (mSimulationPaused)
+		{
+			timer.Stop();
+			Sleep(10);
+			continue;
+		}
+
+		// the derived class paces the stage, e.g. until the render stage took its last result.
+		if (!SimulationReady())
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		timer.Start();
+		timer.Tick();
+		Simulate(timer);
+	}
+}
+
+void D3DApp::StopSimulationThread()
+{
+	if (mSimulationThread.joinable())
+	{
+		mSimulationStop = true;
+		mSimulationThread.join();
+	}
+}
+
 bool D3DApp::Initialize()
 {
 	if(!InitMainWindow())
@@ -147,12 +204,14 @@ void D3DApp::OnResize()
 	// Flush before changing any resources.
 	FlushCommandQueue();
 
-    ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr));
-
 	// Release the previous resources we will be recreating.
 	for (int i = 0; i < SwapChainBufferCount; ++i)
+	{
 		mSwapChainBuffer[i].Reset();
+		mRhiSwapChainBuffer[i].reset();
+	}
     mDepthStencilBuffer.Reset();
+	mRhiDepthStencilBuffer.reset();
 	
 	// Resize the swap chain.
     ThrowIfFailed(mSwapChain->ResizeBuffers(
@@ -169,6 +228,7 @@ void D3DApp::OnResize()
 		ThrowIfFailed(mSwapChain->GetBuffer(i, IID_PPV_ARGS(&mSwapChainBuffer[i])));
 		md3dDevice->CreateRenderTargetView(mSwapChainBuffer[i].Get(), nullptr, rtvHeapHandle);
 		rtvHeapHandle.Offset(1, mRtvDescriptorSize);
+		mRhiSwapChainBuffer[i] = mRhiDevice->WrapTexture(mSwapChainBuffer[i].Get());
 	}
 
     // Create the depth/stencil buffer and view.
@@ -211,18 +271,16 @@ void D3DApp::OnResize()
 	dsvDesc.Format = mDepthStencilFormat;
 	dsvDesc.Texture2D.MipSlice = 0;
     md3dDevice->CreateDepthStencilView(mDepthStencilBuffer.Get(), &dsvDesc, DepthStencilView());
+	mRhiDepthStencilBuffer = mRhiDevice->WrapTexture(mDepthStencilBuffer.Get());
 
-    // Transition the resource from its initial state to be used as a depth buffer.
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mDepthStencilBuffer.Get(),
-		D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_DEPTH_WRITE));
-	
-    // Execute the resize commands.
-    ThrowIfFailed(mCommandList->Close());
-    ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
-    mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
-
-	// Wait until resize is complete.
-	FlushCommandQueue();
+	// the new buffers start out presentable and common.  The depth buffer is no longer transitioned here :
+	// the first frame's tracker moves it to DEPTH_WRITE in the same batch as its back buffer barrier.
+	mResourceStates.Clear();
+	for (int i = 0; i < SwapChainBufferCount; ++i)
+	{
+		mResourceStates.Register(mRhiSwapChainBuffer[i].get(), RhiResourceState::Present);
+	}
+	mResourceStates.Register(mRhiDepthStencilBuffer.get(), RhiResourceState::Common);
 
 	// Update the viewport transform to cover the client area.
 	mScreenViewport.TopLeftX = 0;
@@ -365,6 +423,8 @@ LRESULT D3DApp::MsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
         }
         else if((int)wParam == VK_F2)
             Set4xMsaaState(!m4xMsaaState);
+        else
+            OnKeyUp(wParam);
 
         return 0;
 	}
@@ -501,6 +561,10 @@ void D3DApp::CreateCommandObjects()
 	// to the command list we will Reset it, and it needs to be closed before 
 	// calling Reset.
 	mCommandList->Close();
+
+	mRhiDevice = std::make_unique<D3D12RhiDevice>(md3dDevice.Get(), mCommandQueue.Get());
+	mRhiCommandList = mRhiDevice->WrapCommandList(mCommandList.Get());
+	mRhiCommandList->SetAllocator(mDirectCmdListAlloc.Get());
 }
 
 void D3DApp::CreateSwapChain()
@@ -561,6 +625,11 @@ ID3D12Resource* D3DApp::CurrentBackBuffer()const
 	return mSwapChainBuffer[mCurrBackBuffer].Get();
 }
 
+RhiTexture* D3DApp::CurrentBackBufferRhi()const
+{
+	return mRhiSwapChainBuffer[mCurrBackBuffer].get();
+}
+
 D3D12_CPU_DESCRIPTOR_HANDLE D3DApp::CurrentBackBufferView()const
 {
 	return CD3DX12_CPU_DESCRIPTOR_HANDLE(
@@ -596,7 +665,8 @@ void D3DApp::CalculateFrameStats()
 
         wstring windowText = mMainWndCaption +
             L"    fps: " + fpsStr +
-            L"   mspf: " + mspfStr;
+            L"   mspf: " + mspfStr +
+            FrameStatsText();
 
         SetWindowText(mhMainWnd, windowText.c_str());
 		
@@ -11,6 +11,10 @@
 
 #include "d3dUtil.h"
 #include "GameTimer.h"
+#include "../Rhi/RhiD3D12.h"
+#include "../Rhi/RhiStateTracker.h"
+#include <atomic>
+#include <thread>
 
 // Link necessary d3d12 libraries.
 #pragma comment(lib,"d3dcompiler.lib")
@@ -48,10 +52,16 @@ protected:
 	virtual void Update(const GameTimer& gt)=0;
     virtual void Draw(const GameTimer& gt)=0;
 
+	// simulation stage.  With mSimulationThreadEnabled it runs on its own thread with its own timer, concurrently
+	// with Update/Draw, whenever SimulationReady() says so; otherwise on the main thread right before Update.
+	virtual void Simulate(const GameTimer& gt){ }
+	virtual bool SimulationReady(){ return true; }
+
 	// Convenience overrides for handling mouse input.
 	virtual void OnMouseDown(WPARAM btnState, int x, int y){ }
 	virtual void OnMouseUp(WPARAM btnState, int x, int y)  { }
 	virtual void OnMouseMove(WPARAM btnState, int x, int y){ }
+	virtual void OnKeyUp(WPARAM key){ }
 
 protected:
 
@@ -63,10 +73,15 @@ protected:
 	void FlushCommandQueue();
 
 	ID3D12Resource* CurrentBackBuffer()const;
+	RhiTexture* CurrentBackBufferRhi()const;
 	D3D12_CPU_DESCRIPTOR_HANDLE CurrentBackBufferView()const;
 	D3D12_CPU_DESCRIPTOR_HANDLE DepthStencilView()const;
 
 	void CalculateFrameStats();
+	virtual std::wstring FrameStatsText()const { return L""; }	// extra telemetry appended to the window caption
+
+	void SimulationLoop();			// body of the simulation thread
+	void StopSimulationThread();
 
     void LogAdapters();
     void LogAdapterOutputs(IDXGIAdapter* adapter);
@@ -110,6 +125,16 @@ protected:
     Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mRtvHeap;
     Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mDsvHeap;
 
+	// the same objects seen through the rendering hardware interface (Rhi/Rhi.h).
+	std::unique_ptr<D3D12RhiDevice> mRhiDevice;
+	std::unique_ptr<D3D12RhiCommandList> mRhiCommandList;		// wraps mCommandList
+	std::unique_ptr<RhiTexture> mRhiSwapChainBuffer[SwapChainBufferCount];
+	std::unique_ptr<RhiTexture> mRhiDepthStencilBuffer;
+
+	// state of the swap chain and depth buffers between command lists, and the barriers of mRhiCommandList.
+	RhiResourceStateRegistry mResourceStates;
+	RhiResourceStateTracker mRhiCommandListStates{ &mResourceStates };
+
     D3D12_VIEWPORT mScreenViewport; 
     D3D12_RECT mScissorRect;
 
@@ -124,5 +149,11 @@ protected:
     DXGI_FORMAT mDepthStencilFormat = DXGI_FORMAT_D24_UNORM_S8_UINT;
 	int mClientWidth = 1280;
 	int mClientHeight = 720;
+	bool mSimulationThreadEnabled = false;		// run Simulate() on its own thread, see Simulate()
+
+private:
+	std::thread mSimulationThread;
+	std::atomic<bool> mSimulationStop{ false };
+	std::atomic<bool> mSimulationPaused{ false };	// mirrors mAppPaused for the simulation thread
 };
 
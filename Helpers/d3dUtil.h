@@ -184,12 +184,17 @@ struct MeshGeometry
 	UINT VertexBufferByteSize = 0;
 	DXGI_FORMAT IndexFormat = DXGI_FORMAT_R16_UINT;
 	UINT IndexBufferByteSize = 0;
+	bool CompactVertices = false;		// CompactVertex (VertexQuantization.h) instead of Vertex, drawn with CompactVS
 
 	// A MeshGeometry may store multiple geometries in one vertex/index buffer.
 	// Use this container to define the Submesh geometries so we can draw
 	// the Submeshes individually.
 	std::unordered_map<std::string, SubmeshGeometry> DrawArgs;
 
+	// Submeshes too large for 16 bit indices are split into pieces with their own
+	// base vertex, sorted by StartIndexLocation.  A draw of such a submesh draws its pieces.
+	std::vector<SubmeshGeometry> IndexChunks;
+
 	D3D12_VERTEX_BUFFER_VIEW VertexBufferView()const
 	{
 		D3D12_VERTEX_BUFFER_VIEW vbv;
@@ -256,12 +261,9 @@ struct Material
 	// Index into SRV heap for normal texture.
 	int NormalSrvHeapIndex = -1;
 
-	// Dirty flag indicating the material has changed and we need to update the constant buffer.
-	// Because we have a material constant buffer for each FrameResource, we have to apply the
-	// update to each FrameResource.  Thus, when we modify a material we should set 
-	// NumFramesDirty = gNumFrameResources so that each frame resource gets the update.
-	//int NumFramesDirty = gNumFrameResources;
-    int NumFramesDirty = gNumFrameBuffers;
+	// Changes are tracked by version (VersionedSlots.h) rather than a per-material dirty counter:
+	// after modifying a material, mark its MatCBIndex dirty so that every frame buffer still
+	// holding an older version gets the update.
 
 	// Material constant buffer data used for shading.
 	DirectX::XMFLOAT4 DiffuseAlbedo = { 1.0f, 1.0f, 1.0f, 1.0f };
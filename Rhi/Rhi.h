@@ -0,0 +1,368 @@
+// Rhi.h : thin rendering hardware interface (device, queue, command list, buffer, texture, descriptor).
+//
+// Rendering code records through these interfaces instead of calling ID3D12GraphicsCommandList directly,
+// so the same submission code runs against the D3D12 backend (RhiD3D12.h), the null backend (RhiNull.h)
+// or the recording backend (RhiRecording.h).
+// This header only depends on the C++ standard library.  Enum values and the layouts of the view
+// structs are chosen to match their D3D12 counterparts, so the D3D12 backend can pass them straight through.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+typedef std::uint64_t RhiGpuAddress;
+
+static const std::uint32_t RhiAllSubresources = 0xffffffff;
+
+// matches D3D12_COMMAND_LIST_TYPE
+enum class RhiQueueType : std::uint32_t
+{
+	Direct = 0,
+	Bundle = 1,
+	Compute = 2,
+	Copy = 3,
+};
+
+// matches D3D12_HEAP_TYPE
+enum class RhiHeapType : std::uint32_t
+{
+	Default = 1,
+	Upload = 2,
+	Readback = 3,
+};
+
+// matches D3D12_RESOURCE_STATES
+enum class RhiResourceState : std::uint32_t
+{
+	Common = 0,
+	VertexAndConstantBuffer = 0x1,
+	IndexBuffer = 0x2,
+	RenderTarget = 0x4,
+	UnorderedAccess = 0x8,
+	DepthWrite = 0x10,
+	DepthRead = 0x20,
+	NonPixelShaderResource = 0x40,
+	PixelShaderResource = 0x80,
+	CopyDest = 0x400,
+	CopySource = 0x800,
+	GenericRead = 0x1 | 0x2 | 0x40 | 0x80 | 0x200 | 0x800,
+	Present = 0,
+};
+
+inline RhiResourceState operator|(RhiResourceState a, RhiResourceState b)
+{
+	return (RhiResourceState)((std::uint32_t)a | (std::uint32_t)b);
+}
+
+// matches D3D12_RESOURCE_BARRIER_FLAGS
+enum class RhiBarrierFlags : std::uint32_t
+{
+	None = 0,
+	BeginOnly = 0x1,
+	EndOnly = 0x2,
+};
+
+// matches D3D12_DESCRIPTOR_HEAP_TYPE
+enum class RhiDescriptorHeapType : std::uint32_t
+{
+	CbvSrvUav = 0,
+	Sampler = 1,
+	Rtv = 2,
+	Dsv = 3,
+};
+
+// matches D3D_PRIMITIVE_TOPOLOGY
+enum class RhiPrimitiveTopology : std::uint32_t
+{
+	Undefined = 0,
+	PointList = 1,
+	LineList = 2,
+	LineStrip = 3,
+	TriangleList = 4,
+	TriangleStrip = 5,
+};
+
+// the subset of DXGI_FORMAT used by this application, same values.
+enum class RhiFormat : std::uint32_t
+{
+	Unknown = 0,
+	R32G32B32A32Float = 2,
+	R32G32B32Float = 6,
+	R16G16B16A16Unorm = 11,
+	R32G32Float = 16,
+	R8G8B8A8Unorm = 28,
+	R16G16Unorm = 35,
+	R32Uint = 42,
+	R24G8Typeless = 44,
+	D24UnormS8Uint = 45,
+	R16Uint = 57,
+};
+
+// matches D3D12_CLEAR_FLAGS
+enum class RhiClearFlags : std::uint32_t
+{
+	Depth = 0x1,
+	Stencil = 0x2,
+	DepthStencil = 0x3,
+};
+
+// layout of D3D12_CPU_DESCRIPTOR_HANDLE / D3D12_GPU_DESCRIPTOR_HANDLE on 64-bit builds.
+struct RhiCpuDescriptor
+{
+	std::uint64_t Ptr = 0;
+};
+
+struct RhiGpuDescriptor
+{
+	std::uint64_t Ptr = 0;
+};
+
+// layout of D3D12_VERTEX_BUFFER_VIEW
+struct RhiVertexBufferView
+{
+	RhiGpuAddress BufferLocation = 0;
+	std::uint32_t SizeInBytes = 0;
+	std::uint32_t StrideInBytes = 0;
+};
+
+// layout of D3D12_INDEX_BUFFER_VIEW
+struct RhiIndexBufferView
+{
+	RhiGpuAddress BufferLocation = 0;
+	std::uint32_t SizeInBytes = 0;
+	RhiFormat Format = RhiFormat::R16Uint;
+};
+
+// layout of D3D12_VIEWPORT
+struct RhiViewport
+{
+	float TopLeftX = 0.0f;
+	float TopLeftY = 0.0f;
+	float Width = 0.0f;
+	float Height = 0.0f;
+	float MinDepth = 0.0f;
+	float MaxDepth = 1.0f;
+};
+
+// layout of D3D12_RECT
+struct RhiRect
+{
+	std::int32_t Left = 0;
+	std::int32_t Top = 0;
+	std::int32_t Right = 0;
+	std::int32_t Bottom = 0;
+};
+
+struct RhiBufferDesc
+{
+	std::uint64_t ByteSize = 0;
+	RhiHeapType Heap = RhiHeapType::Default;
+	RhiResourceState InitialState = RhiResourceState::Common;
+};
+
+struct RhiTextureDesc
+{
+	std::uint32_t Width = 0;
+	std::uint32_t Height = 0;
+	std::uint16_t ArraySize = 1;
+	std::uint16_t MipLevels = 1;
+	RhiFormat Format = RhiFormat::Unknown;
+	RhiResourceState InitialState = RhiResourceState::Common;
+};
+
+// ---------- objects ----------
+
+// Every object gets a small id from its device, which is how the recording backend refers to it.
+class RhiObject
+{
+public:
+	RhiObject(const RhiObject& rhs) = delete;
+	RhiObject& operator=(const RhiObject& rhs) = delete;
+	virtual ~RhiObject() = default;
+
+	std::uint32_t Id()const { return mId; }
+
+	// backend object behind this one (ID3D12Resource*, ID3D12PipelineState*, ... for D3D12), nullptr otherwise.
+	virtual void* NativeHandle()const { return nullptr; }
+
+protected:
+	explicit RhiObject(std::uint32_t id) : mId(id) {}
+
+private:
+	std::uint32_t mId = 0;
+};
+
+class RhiResource : public RhiObject
+{
+public:
+	virtual RhiGpuAddress GpuAddress()const = 0;
+	virtual std::uint32_t SubresourceCount()const = 0;
+
+protected:
+	explicit RhiResource(std::uint32_t id) : RhiObject(id) {}
+};
+
+class RhiBuffer : public RhiResource
+{
+public:
+	virtual std::uint64_t ByteSize()const = 0;
+
+	// upload/readback buffers only.
+	virtual void* Map() = 0;
+	virtual void Unmap() = 0;
+
+	virtual std::uint32_t SubresourceCount()const override { return 1; }
+
+protected:
+	explicit RhiBuffer(std::uint32_t id) : RhiResource(id) {}
+};
+
+class RhiTexture : public RhiResource
+{
+public:
+	virtual const RhiTextureDesc& Desc()const = 0;
+
+	virtual RhiGpuAddress GpuAddress()const override { return 0; }
+	virtual std::uint32_t SubresourceCount()const override { return (std::uint32_t)Desc().ArraySize * Desc().MipLevels; }
+
+protected:
+	explicit RhiTexture(std::uint32_t id) : RhiResource(id) {}
+};
+
+class RhiPipelineState : public RhiObject
+{
+protected:
+	explicit RhiPipelineState(std::uint32_t id) : RhiObject(id) {}
+};
+
+class RhiRootSignature : public RhiObject
+{
+protected:
+	explicit RhiRootSignature(std::uint32_t id) : RhiObject(id) {}
+};
+
+class RhiDescriptorHeap : public RhiObject
+{
+public:
+	virtual RhiDescriptorHeapType Type()const = 0;
+	virtual std::uint32_t Count()const = 0;
+	virtual std::uint32_t DescriptorSize()const = 0;
+	virtual RhiCpuDescriptor CpuStart()const = 0;
+	virtual RhiGpuDescriptor GpuStart()const = 0;		// zero for heaps which are not shader visible
+
+	RhiCpuDescriptor CpuHandle(std::uint32_t index)const
+	{
+		RhiCpuDescriptor handle = CpuStart();
+		handle.Ptr += (std::uint64_t)index * DescriptorSize();
+		return handle;
+	}
+
+	RhiGpuDescriptor GpuHandle(std::uint32_t index)const
+	{
+		RhiGpuDescriptor handle = GpuStart();
+		handle.Ptr += (std::uint64_t)index * DescriptorSize();
+		return handle;
+	}
+
+protected:
+	explicit RhiDescriptorHeap(std::uint32_t id) : RhiObject(id) {}
+};
+
+struct RhiTransitionBarrier
+{
+	RhiResource* Resource = nullptr;
+	std::uint32_t Subresource = RhiAllSubresources;
+	RhiResourceState Before = RhiResourceState::Common;
+	RhiResourceState After = RhiResourceState::Common;
+	RhiBarrierFlags Flags = RhiBarrierFlags::None;
+};
+
+// ---------- command recording ----------
+
+class RhiCommandList : public RhiObject
+{
+public:
+	virtual RhiQueueType Type()const = 0;
+
+	// Begin opens the list for recording with the given initial pipeline state, End closes it.
+	virtual void Begin(RhiPipelineState* initialState) = 0;
+	virtual void End() = 0;
+
+	virtual void ResourceBarrier(std::uint32_t count, const RhiTransitionBarrier* barriers) = 0;
+
+	virtual void ClearRenderTargetView(RhiCpuDescriptor rtv, const float color[4]) = 0;
+	virtual void ClearDepthStencilView(RhiCpuDescriptor dsv, RhiClearFlags flags, float depth, std::uint8_t stencil) = 0;
+	virtual void OMSetRenderTargets(std::uint32_t count, const RhiCpuDescriptor* rtvs, const RhiCpuDescriptor* dsv) = 0;
+	virtual void RSSetViewports(std::uint32_t count, const RhiViewport* viewports) = 0;
+	virtual void RSSetScissorRects(std::uint32_t count, const RhiRect* rects) = 0;
+
+	virtual void SetDescriptorHeaps(std::uint32_t count, RhiDescriptorHeap* const* heaps) = 0;
+	virtual void SetPipelineState(RhiPipelineState* pso) = 0;
+	virtual void SetGraphicsRootSignature(RhiRootSignature* rootSignature) = 0;
+	virtual void SetGraphicsRootConstantBufferView(std::uint32_t rootIndex, RhiGpuAddress address) = 0;
+	virtual void SetGraphicsRootShaderResourceView(std::uint32_t rootIndex, RhiGpuAddress address) = 0;
+	virtual void SetGraphicsRootDescriptorTable(std::uint32_t rootIndex, RhiGpuDescriptor baseDescriptor) = 0;
+	virtual void SetGraphicsRoot32BitConstants(std::uint32_t rootIndex, std::uint32_t num32BitValues, const void* data, std::uint32_t destOffset) = 0;
+
+	virtual void IASetVertexBuffers(std::uint32_t startSlot, std::uint32_t count, const RhiVertexBufferView* views) = 0;
+	virtual void IASetIndexBuffer(const RhiIndexBufferView* view) = 0;
+	virtual void IASetPrimitiveTopology(RhiPrimitiveTopology topology) = 0;
+
+	virtual void DrawInstanced(std::uint32_t vertexCountPerInstance, std::uint32_t instanceCount,
+		std::uint32_t startVertexLocation, std::uint32_t startInstanceLocation) = 0;
+	virtual void DrawIndexedInstanced(std::uint32_t indexCountPerInstance, std::uint32_t instanceCount,
+		std::uint32_t startIndexLocation, std::int32_t baseVertexLocation, std::uint32_t startInstanceLocation) = 0;
+
+	virtual void CopyBufferRegion(RhiBuffer* dst, std::uint64_t dstOffset, RhiBuffer* src, std::uint64_t srcOffset, std::uint64_t numBytes) = 0;
+
+	// replays a bundle, a list created for RhiQueueType::Bundle and recorded once.  The bundle inherits the root
+	// bindings and descriptor heaps of this list, the pipeline, IA and root constant state it sets stays bound afterwards.
+	virtual void ExecuteBundle(RhiCommandList* bundle) = 0;
+
+protected:
+	explicit RhiCommandList(std::uint32_t id) : RhiObject(id) {}
+};
+
+class RhiCommandQueue
+{
+public:
+	RhiCommandQueue() = default;
+	RhiCommandQueue(const RhiCommandQueue& rhs) = delete;
+	RhiCommandQueue& operator=(const RhiCommandQueue& rhs) = delete;
+	virtual ~RhiCommandQueue() = default;
+
+	virtual RhiQueueType Type()const = 0;
+
+	virtual void ExecuteCommandLists(std::uint32_t count, RhiCommandList* const* lists) = 0;
+
+	// fence of the queue : Signal returns the value which marks everything submitted so far.
+	virtual std::uint64_t Signal() = 0;
+	virtual std::uint64_t CompletedValue() = 0;
+	virtual void WaitForValue(std::uint64_t value) = 0;		// blocks the calling thread
+};
+
+class RhiDevice
+{
+public:
+	RhiDevice() = default;
+	RhiDevice(const RhiDevice& rhs) = delete;
+	RhiDevice& operator=(const RhiDevice& rhs) = delete;
+	virtual ~RhiDevice() = default;
+
+	virtual std::unique_ptr<RhiBuffer> CreateBuffer(const RhiBufferDesc& desc) = 0;
+	virtual std::unique_ptr<RhiTexture> CreateTexture(const RhiTextureDesc& desc) = 0;
+	virtual std::unique_ptr<RhiDescriptorHeap> CreateDescriptorHeap(RhiDescriptorHeapType type, std::uint32_t count, bool shaderVisible) = 0;
+	virtual std::unique_ptr<RhiCommandList> CreateCommandList(RhiQueueType type) = 0;
+
+	// writes a default shader resource view of the resource into the descriptor.
+	virtual void CreateShaderResourceView(RhiResource* resource, RhiCpuDescriptor descriptor) = 0;
+
+	virtual RhiCommandQueue* Queue(RhiQueueType type) = 0;
+
+protected:
+	std::uint32_t NextObjectId() { return ++mLastObjectId; }
+
+private:
+	std::uint32_t mLastObjectId = 0;
+};
@@ -0,0 +1,383 @@
+// RhiCapture.cpp
+
+#include "RhiCapture.h"
+#include <cstring>
+#include <fstream>
+
+// ---------- capture ----------
+
+void RhiCapture::Clear()
+{
+	mData.clear();
+	mFrameOffsets.clear();
+}
+
+void RhiCapture::AddFrame(const std::uint8_t* stream, std::size_t size)
+{
+	mFrameOffsets.push_back(mData.size());
+	mData.insert(mData.end(), stream, stream + size);
+}
+
+std::size_t RhiCapture::FrameSize(std::uint32_t frame)const
+{
+	std::size_t end = frame + 1 < mFrameOffsets.size() ? mFrameOffsets[frame + 1] : mData.size();
+	return end - mFrameOffsets[frame];
+}
+
+bool RhiCapture::Save(const std::string& filename)const
+{
+	std::ofstream fout(filename, std::ios::binary);
+	if (!fout)
+	{
+		return false;
+	}
+
+	std::uint32_t header[3] = { Magic, Version, FrameCount() };
+	fout.write((const char*)header, sizeof(header));
+
+	for (std::uint32_t i = 0; i < FrameCount(); ++i)
+	{
+		std::uint32_t size = (std::uint32_t)FrameSize(i);
+		fout.write((const char*)&size, sizeof(size));
+		fout.write((const char*)FrameData(i), size);
+	}
+
+	return (bool)fout;
+}
+
+bool RhiCapture::Load(const std::string& filename)
+{
+	Clear();
+
+	std::ifstream fin(filename, std::ios::binary);
+	if (!fin)
+	{
+		return false;
+	}
+
+	// the counts of a damaged file are checked against what is left of it before anything is allocated.
+	fin.seekg(0, std::ios::end);
+	const std::uint64_t fileSize = (std::uint64_t)fin.tellg();
+	fin.seekg(0, std::ios::beg);
+
+	std::uint32_t header[3] = {};
+	fin.read((char*)header, sizeof(header));
+	if (!fin || header[0] != Magic || header[1] != Version)
+	{
+		return false;
+	}
+
+	std::uint64_t remaining = fileSize - sizeof(header);
+	if ((std::uint64_t)header[2] * sizeof(std::uint32_t) > remaining)
+	{
+		return false;
+	}
+	mData.reserve((std::size_t)remaining);
+	mFrameOffsets.reserve(header[2]);
+
+	for (std::uint32_t i = 0; i < header[2]; ++i)
+	{
+		std::uint32_t size = 0;
+		if (remaining < sizeof(size) || !fin.read((char*)&size, sizeof(size)) || size > remaining - sizeof(size))
+		{
+			Clear();
+			return false;
+		}
+		remaining -= sizeof(size) + size;
+
+		mFrameOffsets.push_back(mData.size());
+		mData.resize(mData.size() + size);
+		fin.read((char*)mData.data() + mFrameOffsets.back(), size);
+
+		if (!fin)
+		{
+			Clear();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// ---------- object table ----------
+
+void RhiObjectTable::Register(RhiObject* object)
+{
+	if (object->Id() >= mObjects.size())
+	{
+		mObjects.resize(object->Id() + 1, nullptr);
+	}
+	mObjects[object->Id()] = object;
+}
+
+// ---------- replay ----------
+
+// bounds checked reader over one stream; after a failed read every further read fails too.
+struct StreamReader
+{
+	const std::uint8_t* Cursor;
+	const std::uint8_t* End;
+	bool Ok = true;
+
+	bool Read(void* dst, std::size_t size)
+	{
+		if (!Ok || (std::size_t)(End - Cursor) < size)
+		{
+			Ok = false;
+			return false;
+		}
+		std::memcpy(dst, Cursor, size);
+		Cursor += size;
+		return true;
+	}
+
+	std::uint8_t U8() { std::uint8_t v = 0; Read(&v, 1); return v; }
+	std::uint32_t U32() { std::uint32_t v = 0; Read(&v, 4); return v; }
+	std::uint64_t U64() { std::uint64_t v = 0; Read(&v, 8); return v; }
+	float F32() { float v = 0.0f; Read(&v, 4); return v; }
+};
+
+template <typename T>
+static T* Resolve(StreamReader& in, const RhiObjectTable* objects)
+{
+	std::uint32_t id = in.U32();
+	if (id == 0 || objects == nullptr)
+	{
+		return nullptr;
+	}
+
+	T* object = dynamic_cast<T*>(objects->Find(id));
+	if (object == nullptr)
+	{
+		in.Ok = false;
+	}
+	return object;
+}
+
+bool RhiReplayer::Replay(const std::uint8_t* data, std::size_t size, RhiCommandList* target, const RhiObjectTable* objects)
+{
+	StreamReader in;
+	in.Cursor = data;
+	in.End = data + size;
+
+	while (in.Ok && in.Cursor < in.End)
+	{
+		RhiCommandOp op = (RhiCommandOp)in.U8();
+
+		switch (op)
+		{
+		case RhiCommandOp::Begin:
+		{
+			RhiPipelineState* pso = Resolve<RhiPipelineState>(in, objects);
+			if (in.Ok) target->Begin(pso);
+			break;
+		}
+		case RhiCommandOp::End:
+			target->End();
+			break;
+
+		case RhiCommandOp::ResourceBarrier:
+		{
+			// 17 bytes per barrier, a larger count can only come from a corrupt stream.
+			std::uint32_t count = in.U32();
+			if (count > (std::size_t)(in.End - in.Cursor) / 17)
+			{
+				in.Ok = false;
+				break;
+			}
+			mBarriers.resize(count);
+			for (std::uint32_t i = 0; i < count && in.Ok; ++i)
+			{
+				RhiTransitionBarrier& b = mBarriers[i];
+				b.Resource = Resolve<RhiResource>(in, objects);
+				b.Subresource = in.U32();
+				b.Before = (RhiResourceState)in.U32();
+				b.After = (RhiResourceState)in.U32();
+				b.Flags = (RhiBarrierFlags)in.U8();
+			}
+			if (in.Ok) target->ResourceBarrier(count, mBarriers.data());
+			break;
+		}
+		case RhiCommandOp::ClearRenderTargetView:
+		{
+			RhiCpuDescriptor rtv;
+			rtv.Ptr = in.U64();
+			float color[4];
+			in.Read(color, sizeof(color));
+			if (in.Ok) target->ClearRenderTargetView(rtv, color);
+			break;
+		}
+		case RhiCommandOp::ClearDepthStencilView:
+		{
+			RhiCpuDescriptor dsv;
+			dsv.Ptr = in.U64();
+			RhiClearFlags flags = (RhiClearFlags)in.U8();
+			float depth = in.F32();
+			std::uint8_t stencil = in.U8();
+			if (in.Ok) target->ClearDepthStencilView(dsv, flags, depth, stencil);
+			break;
+		}
+		case RhiCommandOp::OMSetRenderTargets:
+		{
+			std::uint32_t count = in.U8();
+			mDescriptors.resize(count + 1);
+			for (std::uint32_t i = 0; i <= count; ++i)
+			{
+				mDescriptors[i].Ptr = in.U64();
+			}
+			const RhiCpuDescriptor* dsv = mDescriptors[count].Ptr != 0 ? &mDescriptors[count] : nullptr;
+			if (in.Ok) target->OMSetRenderTargets(count, mDescriptors.data(), dsv);
+			break;
+		}
+		case RhiCommandOp::RSSetViewports:
+		{
+			std::uint32_t count = in.U8();
+			mViewports.resize(count);
+			in.Read(mViewports.data(), count * sizeof(RhiViewport));
+			if (in.Ok) target->RSSetViewports(count, mViewports.data());
+			break;
+		}
+		case RhiCommandOp::RSSetScissorRects:
+		{
+			std::uint32_t count = in.U8();
+			mRects.resize(count);
+			in.Read(mRects.data(), count * sizeof(RhiRect));
+			if (in.Ok) target->RSSetScissorRects(count, mRects.data());
+			break;
+		}
+		case RhiCommandOp::SetDescriptorHeaps:
+		{
+			std::uint32_t count = in.U8();
+			mHeaps.resize(count);
+			for (std::uint32_t i = 0; i < count; ++i)
+			{
+				mHeaps[i] = Resolve<RhiDescriptorHeap>(in, objects);
+			}
+			if (in.Ok) target->SetDescriptorHeaps(count, mHeaps.data());
+			break;
+		}
+		case RhiCommandOp::SetPipelineState:
+		{
+			RhiPipelineState* pso = Resolve<RhiPipelineState>(in, objects);
+			if (in.Ok) target->SetPipelineState(pso);
+			break;
+		}
+		case RhiCommandOp::SetGraphicsRootSignature:
+		{
+			RhiRootSignature* rootSignature = Resolve<RhiRootSignature>(in, objects);
+			if (in.Ok) target->SetGraphicsRootSignature(rootSignature);
+			break;
+		}
+		case RhiCommandOp::SetGraphicsRootConstantBufferView:
+		{
+			std::uint32_t rootIndex = in.U8();
+			RhiGpuAddress address = in.U64();
+			if (in.Ok) target->SetGraphicsRootConstantBufferView(rootIndex, address);
+			break;
+		}
+		case RhiCommandOp::SetGraphicsRootShaderResourceView:
+		{
+			std::uint32_t rootIndex = in.U8();
+			RhiGpuAddress address = in.U64();
+			if (in.Ok) target->SetGraphicsRootShaderResourceView(rootIndex, address);
+			break;
+		}
+		case RhiCommandOp::SetGraphicsRootDescriptorTable:
+		{
+			std::uint32_t rootIndex = in.U8();
+			RhiGpuDescriptor descriptor;
+			descriptor.Ptr = in.U64();
+			if (in.Ok) target->SetGraphicsRootDescriptorTable(rootIndex, descriptor);
+			break;
+		}
+		case RhiCommandOp::SetGraphicsRoot32BitConstants:
+		{
+			std::uint32_t rootIndex = in.U8();
+			std::uint32_t count = in.U8();
+			std::uint32_t destOffset = in.U8();
+			mConstants.resize(count);
+			in.Read(mConstants.data(), count * sizeof(std::uint32_t));
+			if (in.Ok) target->SetGraphicsRoot32BitConstants(rootIndex, count, mConstants.data(), destOffset);
+			break;
+		}
+		case RhiCommandOp::IASetVertexBuffers:
+		{
+			std::uint32_t startSlot = in.U8();
+			std::uint32_t count = in.U8();
+			mVertexBuffers.resize(count);
+			for (std::uint32_t i = 0; i < count; ++i)
+			{
+				mVertexBuffers[i].BufferLocation = in.U64();
+				mVertexBuffers[i].SizeInBytes = in.U32();
+				mVertexBuffers[i].StrideInBytes = in.U32();
+			}
+			if (in.Ok) target->IASetVertexBuffers(startSlot, count, mVertexBuffers.data());
+			break;
+		}
+		case RhiCommandOp::IASetIndexBuffer:
+		{
+			RhiIndexBufferView view;
+			view.BufferLocation = in.U64();
+			view.SizeInBytes = in.U32();
+			view.Format = (RhiFormat)in.U32();
+			if (in.Ok) target->IASetIndexBuffer(view.BufferLocation != 0 ? &view : nullptr);
+			break;
+		}
+		case RhiCommandOp::IASetPrimitiveTopology:
+		{
+			RhiPrimitiveTopology topology = (RhiPrimitiveTopology)in.U8();
+			if (in.Ok) target->IASetPrimitiveTopology(topology);
+			break;
+		}
+		case RhiCommandOp::DrawInstanced:
+		{
+			std::uint32_t args[4];
+			in.Read(args, sizeof(args));
+			if (in.Ok)
+			{
+				target->DrawInstanced(args[0], args[1], args[2], args[3]);
+				mStats.Draws++;
+			}
+			break;
+		}
+		case RhiCommandOp::DrawIndexedInstanced:
+		{
+			std::uint32_t args[5];
+			in.Read(args, sizeof(args));
+			if (in.Ok)
+			{
+				target->DrawIndexedInstanced(args[0], args[1], args[2], (std::int32_t)args[3], args[4]);
+				mStats.Draws++;
+			}
+			break;
+		}
+		case RhiCommandOp::CopyBufferRegion:
+		{
+			RhiBuffer* dst = Resolve<RhiBuffer>(in, objects);
+			std::uint64_t dstOffset = in.U64();
+			RhiBuffer* src = Resolve<RhiBuffer>(in, objects);
+			std::uint64_t srcOffset = in.U64();
+			std::uint64_t numBytes = in.U64();
+			if (in.Ok) target->CopyBufferRegion(dst, dstOffset, src, srcOffset, numBytes);
+			break;
+		}
+		case RhiCommandOp::ExecuteBundle:
+		{
+			RhiCommandList* bundle = Resolve<RhiCommandList>(in, objects);
+			if (in.Ok) target->ExecuteBundle(bundle);
+			break;
+		}
+		default:
+			in.Ok = false;
+			break;
+		}
+
+		if (in.Ok)
+		{
+			mStats.Commands++;
+		}
+	}
+
+	mStats.Bytes += (std::uint64_t)(in.Cursor - data);
+	return in.Ok;
+}
@@ -0,0 +1,81 @@
+// RhiCapture.h : multi-frame captures of the command stream (RhiRecording.h) and their replay.
+//
+// capture file layout, little endian :
+//   magic 'RHIC' | version | frame count | per frame : stream byte size (u32) followed by the stream
+//
+// The stream keeps GPU virtual addresses and descriptor handles as they were recorded, so replaying it
+// against a device is only meaningful in the process which captured it, while its resources are alive.
+// Replaying into a NullRhiCommandList (RhiNull.h) measures the decode cost alone and works anywhere.
+
+#pragma once
+
+#include "RhiRecording.h"
+#include <string>
+#include <vector>
+
+class RhiCapture
+{
+public:
+	static const std::uint32_t Magic = 0x43494852;		// "RHIC"
+	static const std::uint32_t Version = 1;
+
+	void Clear();
+	void AddFrame(const std::uint8_t* stream, std::size_t size);
+
+	std::uint32_t FrameCount()const { return (std::uint32_t)mFrameOffsets.size(); }
+	const std::uint8_t* FrameData(std::uint32_t frame)const { return mData.data() + mFrameOffsets[frame]; }
+	std::size_t FrameSize(std::uint32_t frame)const;
+	std::size_t ByteSize()const { return mData.size(); }
+
+	// both return false when the file could not be opened or is not a capture of this version.
+	bool Save(const std::string& filename)const;
+	bool Load(const std::string& filename);
+
+private:
+	std::vector<std::uint8_t> mData;			// streams of all the frames back to back
+	std::vector<std::size_t> mFrameOffsets;
+};
+
+// resolves the object ids found in a stream, indexed by RhiObject::Id.
+class RhiObjectTable
+{
+public:
+	void Clear() { mObjects.clear(); }
+	void Register(RhiObject* object);
+	RhiObject* Find(std::uint32_t id)const { return id < mObjects.size() ? mObjects[id] : nullptr; }
+
+private:
+	std::vector<RhiObject*> mObjects;
+};
+
+struct RhiReplayStats
+{
+	std::uint64_t Commands = 0;
+	std::uint64_t Draws = 0;
+	std::uint64_t Bytes = 0;
+};
+
+// Decodes a stream and issues every command on target.  Without an object table every object
+// reference is replayed as null, which only makes sense for sinks ignoring them like the null backend.
+class RhiReplayer
+{
+public:
+	// returns false on a truncated or malformed stream or an object missing from the table;
+	// the commands decoded before the error have been issued.
+	bool Replay(const std::uint8_t* data, std::size_t size, RhiCommandList* target, const RhiObjectTable* objects = nullptr);
+
+	const RhiReplayStats& Stats()const { return mStats; }
+	void ResetStats() { mStats = RhiReplayStats(); }
+
+private:
+	RhiReplayStats mStats;
+
+	// scratch arrays reused across commands
+	std::vector<RhiTransitionBarrier> mBarriers;
+	std::vector<RhiCpuDescriptor> mDescriptors;
+	std::vector<RhiDescriptorHeap*> mHeaps;
+	std::vector<RhiVertexBufferView> mVertexBuffers;
+	std::vector<RhiViewport> mViewports;
+	std::vector<RhiRect> mRects;
+	std::vector<std::uint32_t> mConstants;
+};
@@ -0,0 +1,456 @@
+// RhiD3D12.cpp
+
+#include "RhiD3D12.h"
+
+using Microsoft::WRL::ComPtr;
+
+// ---------- objects ----------
+
+class D3D12RhiBuffer : public RhiBuffer
+{
+public:
+	D3D12RhiBuffer(std::uint32_t id, ID3D12Resource* resource) : RhiBuffer(id), mResource(resource) {}
+
+	virtual void* NativeHandle()const override { return mResource.Get(); }
+	virtual RhiGpuAddress GpuAddress()const override { return mResource->GetGPUVirtualAddress(); }
+	virtual std::uint64_t ByteSize()const override { return mResource->GetDesc().Width; }
+
+	virtual void* Map() override
+	{
+		void* data = nullptr;
+		ThrowIfFailed(mResource->Map(0, nullptr, &data));
+		return data;
+	}
+
+	virtual void Unmap() override { mResource->Unmap(0, nullptr); }
+
+private:
+	ComPtr<ID3D12Resource> mResource;
+};
+
+class D3D12RhiTexture : public RhiTexture
+{
+public:
+	D3D12RhiTexture(std::uint32_t id, ID3D12Resource* resource) : RhiTexture(id), mResource(resource)
+	{
+		D3D12_RESOURCE_DESC desc = resource->GetDesc();
+		mDesc.Width = (std::uint32_t)desc.Width;
+		mDesc.Height = desc.Height;
+		mDesc.ArraySize = desc.DepthOrArraySize;
+		mDesc.MipLevels = desc.MipLevels;
+		mDesc.Format = (RhiFormat)desc.Format;
+	}
+
+	virtual void* NativeHandle()const override { return mResource.Get(); }
+	virtual const RhiTextureDesc& Desc()const override { return mDesc; }
+
+private:
+	ComPtr<ID3D12Resource> mResource;
+	RhiTextureDesc mDesc;
+};
+
+class D3D12RhiPipelineState : public RhiPipelineState
+{
+public:
+	D3D12RhiPipelineState(std::uint32_t id, ID3D12PipelineState* pso) : RhiPipelineState(id), mPso(pso) {}
+	virtual void* NativeHandle()const override { return mPso.Get(); }
+
+private:
+	ComPtr<ID3D12PipelineState> mPso;
+};
+
+class D3D12RhiRootSignature : public RhiRootSignature
+{
+public:
+	D3D12RhiRootSignature(std::uint32_t id, ID3D12RootSignature* rootSignature) : RhiRootSignature(id), mRootSignature(rootSignature) {}
+	virtual void* NativeHandle()const override { return mRootSignature.Get(); }
+
+private:
+	ComPtr<ID3D12RootSignature> mRootSignature;
+};
+
+class D3D12RhiDescriptorHeap : public RhiDescriptorHeap
+{
+public:
+	D3D12RhiDescriptorHeap(std::uint32_t id, ID3D12Device* device, ID3D12DescriptorHeap* heap) : RhiDescriptorHeap(id), mHeap(heap)
+	{
+		D3D12_DESCRIPTOR_HEAP_DESC desc = heap->GetDesc();
+		mType = (RhiDescriptorHeapType)desc.Type;
+		mCount = desc.NumDescriptors;
+		mDescriptorSize = device->GetDescriptorHandleIncrementSize(desc.Type);
+		mCpuStart = ToRhi(heap->GetCPUDescriptorHandleForHeapStart());
+		if (desc.Flags & D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE)
+		{
+			mGpuStart = ToRhi(heap->GetGPUDescriptorHandleForHeapStart());
+		}
+	}
+
+	virtual void* NativeHandle()const override { return mHeap.Get(); }
+	virtual RhiDescriptorHeapType Type()const override { return mType; }
+	virtual std::uint32_t Count()const override { return mCount; }
+	virtual std::uint32_t DescriptorSize()const override { return mDescriptorSize; }
+	virtual RhiCpuDescriptor CpuStart()const override { return mCpuStart; }
+	virtual RhiGpuDescriptor GpuStart()const override { return mGpuStart; }
+
+private:
+	ComPtr<ID3D12DescriptorHeap> mHeap;
+	RhiDescriptorHeapType mType;
+	std::uint32_t mCount = 0;
+	std::uint32_t mDescriptorSize = 0;
+	RhiCpuDescriptor mCpuStart;
+	RhiGpuDescriptor mGpuStart;
+};
+
+template <typename T>
+static T* Native(const RhiObject* object)
+{
+	return object ? static_cast<T*>(object->NativeHandle()) : nullptr;
+}
+
+// ---------- queue ----------
+
+D3D12RhiCommandQueue::D3D12RhiCommandQueue(ID3D12Device* device, ID3D12CommandQueue* queue, RhiQueueType type)
+	: mQueue(queue), mType(type)
+{
+	ThrowIfFailed(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&mFence)));
+	mFenceEvent = CreateEventEx(nullptr, nullptr, false, EVENT_ALL_ACCESS);
+}
+
+D3D12RhiCommandQueue::~D3D12RhiCommandQueue()
+{
+	if (mFenceEvent)
+	{
+		CloseHandle(mFenceEvent);
+	}
+}
+
+void D3D12RhiCommandQueue::ExecuteCommandLists(std::uint32_t count, RhiCommandList* const* lists)
+{
+	ID3D12CommandList* cmdLists[16];
+	assert(count <= _countof(cmdLists));
+
+	for (std::uint32_t i = 0; i < count; ++i)
+	{
+		cmdLists[i] = Native<ID3D12GraphicsCommandList>(lists[i]);
+	}
+	mQueue->ExecuteCommandLists(count, cmdLists);
+}
+
+std::uint64_t D3D12RhiCommandQueue::Signal()
+{
+	mFenceValue++;
+	ThrowIfFailed(mQueue->Signal(mFence.Get(), mFenceValue));
+	return mFenceValue;
+}
+
+std::uint64_t D3D12RhiCommandQueue::CompletedValue()
+{
+	return mFence->GetCompletedValue();
+}
+
+void D3D12RhiCommandQueue::WaitForValue(std::uint64_t value)
+{
+	if (mFence->GetCompletedValue() < value)
+	{
+		ThrowIfFailed(mFence->SetEventOnCompletion(value, mFenceEvent));
+		WaitForSingleObject(mFenceEvent, INFINITE);
+	}
+}
+
+// ---------- command list ----------
+
+D3D12RhiCommandList::D3D12RhiCommandList(std::uint32_t id, ID3D12GraphicsCommandList* cmdList, ID3D12CommandAllocator* allocator, RhiQueueType type)
+	: RhiCommandList(id), mCmdList(cmdList), mAllocator(allocator), mType(type)
+{
+}
+
+void D3D12RhiCommandList::Begin(RhiPipelineState* initialState)
+{
+	assert(mAllocator);
+
+	// a bundle owns its allocator : recording it again releases the memory of the previous recording.
+	// the caller guarantees the GPU is done with it, as for any list being reset.
+	if (mType == RhiQueueType::Bundle)
+	{
+		ThrowIfFailed(mAllocator->Reset());
+	}
+	ThrowIfFailed(mCmdList->Reset(mAllocator.Get(), Native<ID3D12PipelineState>(initialState)));
+}
+
+void D3D12RhiCommandList::End()
+{
+	ThrowIfFailed(mCmdList->Close());
+}
+
+void D3D12RhiCommandList::ResourceBarrier(std::uint32_t count, const RhiTransitionBarrier* barriers)
+{
+	D3D12_RESOURCE_BARRIER d3dBarriers[16];
+
+	// larger batches are split, the order of the barriers is kept.
+	while (count > 0)
+	{
+		std::uint32_t batch = count < _countof(d3dBarriers) ? count : (std::uint32_t)_countof(d3dBarriers);
+		for (std::uint32_t i = 0; i < batch; ++i)
+		{
+			D3D12_RESOURCE_BARRIER& b = d3dBarriers[i];
+			b.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+			b.Flags = (D3D12_RESOURCE_BARRIER_FLAGS)barriers[i].Flags;
+			b.Transition.pResource = Native<ID3D12Resource>(barriers[i].Resource);
+			b.Transition.Subresource = barriers[i].Subresource;
+			b.Transition.StateBefore = (D3D12_RESOURCE_STATES)barriers[i].Before;
+			b.Transition.StateAfter = (D3D12_RESOURCE_STATES)barriers[i].After;
+		}
+		mCmdList->ResourceBarrier(batch, d3dBarriers);
+
+		barriers += batch;
+		count -= batch;
+	}
+}
+
+void D3D12RhiCommandList::ClearRenderTargetView(RhiCpuDescriptor rtv, const float color[4])
+{
+	D3D12_CPU_DESCRIPTOR_HANDLE handle = { (SIZE_T)rtv.Ptr };
+	mCmdList->ClearRenderTargetView(handle, color, 0, nullptr);
+}
+
+void D3D12RhiCommandList::ClearDepthStencilView(RhiCpuDescriptor dsv, RhiClearFlags flags, float depth, std::uint8_t stencil)
+{
+	D3D12_CPU_DESCRIPTOR_HANDLE handle = { (SIZE_T)dsv.Ptr };
+	mCmdList->ClearDepthStencilView(handle, (D3D12_CLEAR_FLAGS)flags, depth, stencil, 0, nullptr);
+}
+
+void D3D12RhiCommandList::OMSetRenderTargets(std::uint32_t count, const RhiCpuDescriptor* rtvs, const RhiCpuDescriptor* dsv)
+{
+	D3D12_CPU_DESCRIPTOR_HANDLE rtvHandles[D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT];
+	assert(count <= D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT);
+
+	for (std::uint32_t i = 0; i < count; ++i)
+	{
+		rtvHandles[i].ptr = (SIZE_T)rtvs[i].Ptr;
+	}
+
+	D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle = {};
+	if (dsv)
+	{
+		dsvHandle.ptr = (SIZE_T)dsv->Ptr;
+	}
+	mCmdList->OMSetRenderTargets(count, rtvHandles, FALSE, dsv ? &dsvHandle : nullptr);
+}
+
+void D3D12RhiCommandList::RSSetViewports(std::uint32_t count, const RhiViewport* viewports)
+{
+	static_assert(sizeof(RhiViewport) == sizeof(D3D12_VIEWPORT), "RhiViewport must match D3D12_VIEWPORT");
+	mCmdList->RSSetViewports(count, reinterpret_cast<const D3D12_VIEWPORT*>(viewports));
+}
+
+void D3D12RhiCommandList::RSSetScissorRects(std::uint32_t count, const RhiRect* rects)
+{
+	static_assert(sizeof(RhiRect) == sizeof(D3D12_RECT), "RhiRect must match D3D12_RECT");
+	mCmdList->RSSetScissorRects(count, reinterpret_cast<const D3D12_RECT*>(rects));
+}
+
+void D3D12RhiCommandList::SetDescriptorHeaps(std::uint32_t count, RhiDescriptorHeap* const* heaps)
+{
+	ID3D12DescriptorHeap* d3dHeaps[2];
+	assert(count <= _countof(d3dHeaps));
+
+	for (std::uint32_t i = 0; i < count; ++i)
+	{
+		d3dHeaps[i] = Native<ID3D12DescriptorHeap>(heaps[i]);
+	}
+	mCmdList->SetDescriptorHeaps(count, d3dHeaps);
+}
+
+void D3D12RhiCommandList::SetPipelineState(RhiPipelineState* pso)
+{
+	mCmdList->SetPipelineState(Native<ID3D12PipelineState>(pso));
+}
+
+void D3D12RhiCommandList::SetGraphicsRootSignature(RhiRootSignature* rootSignature)
+{
+	mCmdList->SetGraphicsRootSignature(Native<ID3D12RootSignature>(rootSignature));
+}
+
+void D3D12RhiCommandList::SetGraphicsRootConstantBufferView(std::uint32_t rootIndex, RhiGpuAddress address)
+{
+	mCmdList->SetGraphicsRootConstantBufferView(rootIndex, address);
+}
+
+void D3D12RhiCommandList::SetGraphicsRootShaderResourceView(std::uint32_t rootIndex, RhiGpuAddress address)
+{
+	mCmdList->SetGraphicsRootShaderResourceView(rootIndex, address);
+}
+
+void D3D12RhiCommandList::SetGraphicsRootDescriptorTable(std::uint32_t rootIndex, RhiGpuDescriptor baseDescriptor)
+{
+	D3D12_GPU_DESCRIPTOR_HANDLE handle = { baseDescriptor.Ptr };
+	mCmdList->SetGraphicsRootDescriptorTable(rootIndex, handle);
+}
+
+void D3D12RhiCommandList::SetGraphicsRoot32BitConstants(std::uint32_t rootIndex, std::uint32_t num32BitValues, const void* data, std::uint32_t destOffset)
+{
+	mCmdList->SetGraphicsRoot32BitConstants(rootIndex, num32BitValues, data, destOffset);
+}
+
+void D3D12RhiCommandList::IASetVertexBuffers(std::uint32_t startSlot, std::uint32_t count, const RhiVertexBufferView* views)
+{
+	static_assert(sizeof(RhiVertexBufferView) == sizeof(D3D12_VERTEX_BUFFER_VIEW), "RhiVertexBufferView must match D3D12_VERTEX_BUFFER_VIEW");
+	mCmdList->IASetVertexBuffers(startSlot, count, reinterpret_cast<const D3D12_VERTEX_BUFFER_VIEW*>(views));
+}
+
+void D3D12RhiCommandList::IASetIndexBuffer(const RhiIndexBufferView* view)
+{
+	static_assert(sizeof(RhiIndexBufferView) == sizeof(D3D12_INDEX_BUFFER_VIEW), "RhiIndexBufferView must match D3D12_INDEX_BUFFER_VIEW");
+	mCmdList->IASetIndexBuffer(reinterpret_cast<const D3D12_INDEX_BUFFER_VIEW*>(view));
+}
+
+void D3D12RhiCommandList::IASetPrimitiveTopology(RhiPrimitiveTopology topology)
+{
+	mCmdList->IASetPrimitiveTopology((D3D12_PRIMITIVE_TOPOLOGY)topology);
+}
+
+void D3D12RhiCommandList::DrawInstanced(std::uint32_t vertexCountPerInstance, std::uint32_t instanceCount,
+	std::uint32_t startVertexLocation, std::uint32_t startInstanceLocation)
+{
+	mCmdList->DrawInstanced(vertexCountPerInstance, instanceCount, startVertexLocation, startInstanceLocation);
+}
+
+void D3D12RhiCommandList::DrawIndexedInstanced(std::uint32_t indexCountPerInstance, std::uint32_t instanceCount,
+	std::uint32_t startIndexLocation, std::int32_t baseVertexLocation, std::uint32_t startInstanceLocation)
+{
+	mCmdList->DrawIndexedInstanced(indexCountPerInstance, instanceCount, startIndexLocation, baseVertexLocation, startInstanceLocation);
+}
+
+void D3D12RhiCommandList::CopyBufferRegion(RhiBuffer* dst, std::uint64_t dstOffset, RhiBuffer* src, std::uint64_t srcOffset, std::uint64_t numBytes)
+{
+	mCmdList->CopyBufferRegion(Native<ID3D12Resource>(dst), dstOffset, Native<ID3D12Resource>(src), srcOffset, numBytes);
+}
+
+void D3D12RhiCommandList::ExecuteBundle(RhiCommandList* bundle)
+{
+	assert(bundle->Type() == RhiQueueType::Bundle);
+	mCmdList->ExecuteBundle(Native<ID3D12GraphicsCommandList>(bundle));
+}
+
+// ---------- device ----------
+
+D3D12RhiDevice::D3D12RhiDevice(ID3D12Device* device, ID3D12CommandQueue* directQueue)
+	: mDevice(device)
+{
+	mDirectQueue = std::make_unique<D3D12RhiCommandQueue>(device, directQueue, RhiQueueType::Direct);
+}
+
+std::unique_ptr<RhiBuffer> D3D12RhiDevice::CreateBuffer(const RhiBufferDesc& desc)
+{
+	ComPtr<ID3D12Resource> resource;
+	ThrowIfFailed(mDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES((D3D12_HEAP_TYPE)desc.Heap),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(desc.ByteSize),
+		(D3D12_RESOURCE_STATES)desc.InitialState,
+		nullptr,
+		IID_PPV_ARGS(&resource)));
+
+	return std::make_unique<D3D12RhiBuffer>(NextObjectId(), resource.Get());
+}
+
+std::unique_ptr<RhiTexture> D3D12RhiDevice::CreateTexture(const RhiTextureDesc& desc)
+{
+	D3D12_RESOURCE_DESC texDesc = CD3DX12_RESOURCE_DESC::Tex2D(
+		(DXGI_FORMAT)desc.Format, desc.Width, desc.Height, desc.ArraySize, desc.MipLevels);
+
+	ComPtr<ID3D12Resource> resource;
+	ThrowIfFailed(mDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&texDesc,
+		(D3D12_RESOURCE_STATES)desc.InitialState,
+		nullptr,
+		IID_PPV_ARGS(&resource)));
+
+	return std::make_unique<D3D12RhiTexture>(NextObjectId(), resource.Get());
+}
+
+std::unique_ptr<RhiDescriptorHeap> D3D12RhiDevice::CreateDescriptorHeap(RhiDescriptorHeapType type, std::uint32_t count, bool shaderVisible)
+{
+	D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+	heapDesc.Type = (D3D12_DESCRIPTOR_HEAP_TYPE)type;
+	heapDesc.NumDescriptors = count;
+	heapDesc.Flags = shaderVisible ? D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE : D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+
+	ComPtr<ID3D12DescriptorHeap> heap;
+	ThrowIfFailed(mDevice->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&heap)));
+
+	return std::make_unique<D3D12RhiDescriptorHeap>(NextObjectId(), mDevice.Get(), heap.Get());
+}
+
+std::unique_ptr<RhiCommandList> D3D12RhiDevice::CreateCommandList(RhiQueueType type)
+{
+	ComPtr<ID3D12CommandAllocator> allocator;
+	ThrowIfFailed(mDevice->CreateCommandAllocator((D3D12_COMMAND_LIST_TYPE)type, IID_PPV_ARGS(&allocator)));
+
+	ComPtr<ID3D12GraphicsCommandList> cmdList;
+	ThrowIfFailed(mDevice->CreateCommandList(0, (D3D12_COMMAND_LIST_TYPE)type, allocator.Get(), nullptr, IID_PPV_ARGS(&cmdList)));
+
+	// closed like D3DApp's list, the first Begin resets it.
+	ThrowIfFailed(cmdList->Close());
+
+	return std::make_unique<D3D12RhiCommandList>(NextObjectId(), cmdList.Get(), allocator.Get(), type);
+}
+
+void D3D12RhiDevice::CreateShaderResourceView(RhiResource* resource, RhiCpuDescriptor descriptor)
+{
+	D3D12_CPU_DESCRIPTOR_HANDLE handle = { (SIZE_T)descriptor.Ptr };
+	mDevice->CreateShaderResourceView(Native<ID3D12Resource>(resource), nullptr, handle);
+}
+
+RhiCommandQueue* D3D12RhiDevice::Queue(RhiQueueType type)
+{
+	if (type == RhiQueueType::Copy)
+	{
+		if (!mCopyQueue)
+		{
+			D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+			queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+			queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+
+			ComPtr<ID3D12CommandQueue> queue;
+			ThrowIfFailed(mDevice->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&queue)));
+			mCopyQueue = std::make_unique<D3D12RhiCommandQueue>(mDevice.Get(), queue.Get(), RhiQueueType::Copy);
+		}
+		return mCopyQueue.get();
+	}
+
+	assert(type == RhiQueueType::Direct);
+	return mDirectQueue.get();
+}
+
+std::unique_ptr<RhiBuffer> D3D12RhiDevice::WrapBuffer(ID3D12Resource* resource)
+{
+	return std::make_unique<D3D12RhiBuffer>(NextObjectId(), resource);
+}
+
+std::unique_ptr<RhiTexture> D3D12RhiDevice::WrapTexture(ID3D12Resource* resource)
+{
+	return std::make_unique<D3D12RhiTexture>(NextObjectId(), resource);
+}
+
+std::unique_ptr<RhiPipelineState> D3D12RhiDevice::WrapPipelineState(ID3D12PipelineState* pso)
+{
+	return std::make_unique<D3D12RhiPipelineState>(NextObjectId(), pso);
+}
+
+std::unique_ptr<RhiRootSignature> D3D12RhiDevice::WrapRootSignature(ID3D12RootSignature* rootSignature)
+{
+	return std::make_unique<D3D12RhiRootSignature>(NextObjectId(), rootSignature);
+}
+
+std::unique_ptr<RhiDescriptorHeap> D3D12RhiDevice::WrapDescriptorHeap(ID3D12DescriptorHeap* heap)
+{
+	return std::make_unique<D3D12RhiDescriptorHeap>(NextObjectId(), mDevice.Get(), heap);
+}
+
+std::unique_ptr<D3D12RhiCommandList> D3D12RhiDevice::WrapCommandList(ID3D12GraphicsCommandList* cmdList, RhiQueueType type)
+{
+	return std::make_unique<D3D12RhiCommandList>(NextObjectId(), cmdList, nullptr, type);
+}
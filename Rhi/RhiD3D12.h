@@ -0,0 +1,154 @@
+// RhiD3D12.h : D3D12 backend of the rendering hardware interface.
+//
+// The backend does not own the device or the direct queue, D3DApp keeps creating them as before.
+// Existing D3D12 objects (swap chain buffers, pipeline states, root signatures, descriptor heaps and
+// the application's command list) are wrapped so that they can be referenced through the RHI.
+
+#pragma once
+
+#include "Rhi.h"
+#include "../Helpers/d3dUtil.h"
+
+inline RhiCpuDescriptor ToRhi(D3D12_CPU_DESCRIPTOR_HANDLE handle) { RhiCpuDescriptor d; d.Ptr = handle.ptr; return d; }
+inline RhiGpuDescriptor ToRhi(D3D12_GPU_DESCRIPTOR_HANDLE handle) { RhiGpuDescriptor d; d.Ptr = handle.ptr; return d; }
+
+inline RhiVertexBufferView ToRhi(const D3D12_VERTEX_BUFFER_VIEW& view)
+{
+	RhiVertexBufferView v;
+	v.BufferLocation = view.BufferLocation;
+	v.SizeInBytes = view.SizeInBytes;
+	v.StrideInBytes = view.StrideInBytes;
+	return v;
+}
+
+inline RhiIndexBufferView ToRhi(const D3D12_INDEX_BUFFER_VIEW& view)
+{
+	RhiIndexBufferView v;
+	v.BufferLocation = view.BufferLocation;
+	v.SizeInBytes = view.SizeInBytes;
+	v.Format = (RhiFormat)view.Format;
+	return v;
+}
+
+inline RhiViewport ToRhi(const D3D12_VIEWPORT& viewport)
+{
+	RhiViewport v;
+	v.TopLeftX = viewport.TopLeftX;
+	v.TopLeftY = viewport.TopLeftY;
+	v.Width = viewport.Width;
+	v.Height = viewport.Height;
+	v.MinDepth = viewport.MinDepth;
+	v.MaxDepth = viewport.MaxDepth;
+	return v;
+}
+
+inline RhiRect ToRhi(const D3D12_RECT& rect)
+{
+	RhiRect r;
+	r.Left = rect.left;
+	r.Top = rect.top;
+	r.Right = rect.right;
+	r.Bottom = rect.bottom;
+	return r;
+}
+
+class D3D12RhiCommandQueue : public RhiCommandQueue
+{
+public:
+	D3D12RhiCommandQueue(ID3D12Device* device, ID3D12CommandQueue* queue, RhiQueueType type);
+	virtual ~D3D12RhiCommandQueue();
+
+	ID3D12CommandQueue* Native()const { return mQueue.Get(); }
+
+	virtual RhiQueueType Type()const override { return mType; }
+	virtual void ExecuteCommandLists(std::uint32_t count, RhiCommandList* const* lists) override;
+	virtual std::uint64_t Signal() override;
+	virtual std::uint64_t CompletedValue() override;
+	virtual void WaitForValue(std::uint64_t value) override;
+
+private:
+	Microsoft::WRL::ComPtr<ID3D12CommandQueue> mQueue;
+	Microsoft::WRL::ComPtr<ID3D12Fence> mFence;		// separate from D3DApp::mFence, which keeps pacing the frames
+	UINT64 mFenceValue = 0;
+	HANDLE mFenceEvent = nullptr;
+	RhiQueueType mType;
+};
+
+class D3D12RhiCommandList : public RhiCommandList
+{
+public:
+	// allocator may be null when the caller supplies one with SetAllocator before every Begin.
+	D3D12RhiCommandList(std::uint32_t id, ID3D12GraphicsCommandList* cmdList, ID3D12CommandAllocator* allocator, RhiQueueType type);
+
+	ID3D12GraphicsCommandList* Native()const { return mCmdList.Get(); }
+	virtual void* NativeHandle()const override { return mCmdList.Get(); }
+
+	// the allocator used by the next Begin, e.g. the one of the current frame buffer.
+	void SetAllocator(ID3D12CommandAllocator* allocator) { mAllocator = allocator; }
+
+	virtual RhiQueueType Type()const override { return mType; }
+
+	virtual void Begin(RhiPipelineState* initialState) override;
+	virtual void End() override;
+
+	virtual void ResourceBarrier(std::uint32_t count, const RhiTransitionBarrier* barriers) override;
+
+	virtual void ClearRenderTargetView(RhiCpuDescriptor rtv, const float color[4]) override;
+	virtual void ClearDepthStencilView(RhiCpuDescriptor dsv, RhiClearFlags flags, float depth, std::uint8_t stencil) override;
+	virtual void OMSetRenderTargets(std::uint32_t count, const RhiCpuDescriptor* rtvs, const RhiCpuDescriptor* dsv) override;
+	virtual void RSSetViewports(std::uint32_t count, const RhiViewport* viewports) override;
+	virtual void RSSetScissorRects(std::uint32_t count, const RhiRect* rects) override;
+
+	virtual void SetDescriptorHeaps(std::uint32_t count, RhiDescriptorHeap* const* heaps) override;
+	virtual void SetPipelineState(RhiPipelineState* pso) override;
+	virtual void SetGraphicsRootSignature(RhiRootSignature* rootSignature) override;
+	virtual void SetGraphicsRootConstantBufferView(std::uint32_t rootIndex, RhiGpuAddress address) override;
+	virtual void SetGraphicsRootShaderResourceView(std::uint32_t rootIndex, RhiGpuAddress address) override;
+	virtual void SetGraphicsRootDescriptorTable(std::uint32_t rootIndex, RhiGpuDescriptor baseDescriptor) override;
+	virtual void SetGraphicsRoot32BitConstants(std::uint32_t rootIndex, std::uint32_t num32BitValues, const void* data, std::uint32_t destOffset) override;
+
+	virtual void IASetVertexBuffers(std::uint32_t startSlot, std::uint32_t count, const RhiVertexBufferView* views) override;
+	virtual void IASetIndexBuffer(const RhiIndexBufferView* view) override;
+	virtual void IASetPrimitiveTopology(RhiPrimitiveTopology topology) override;
+
+	virtual void DrawInstanced(std::uint32_t vertexCountPerInstance, std::uint32_t instanceCount,
+		std::uint32_t startVertexLocation, std::uint32_t startInstanceLocation) override;
+	virtual void DrawIndexedInstanced(std::uint32_t indexCountPerInstance, std::uint32_t instanceCount,
+		std::uint32_t startIndexLocation, std::int32_t baseVertexLocation, std::uint32_t startInstanceLocation) override;
+
+	virtual void CopyBufferRegion(RhiBuffer* dst, std::uint64_t dstOffset, RhiBuffer* src, std::uint64_t srcOffset, std::uint64_t numBytes) override;
+	virtual void ExecuteBundle(RhiCommandList* bundle) override;
+
+private:
+	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> mCmdList;
+	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> mAllocator;
+	RhiQueueType mType;
+};
+
+class D3D12RhiDevice : public RhiDevice
+{
+public:
+	D3D12RhiDevice(ID3D12Device* device, ID3D12CommandQueue* directQueue);
+
+	ID3D12Device* Native()const { return mDevice.Get(); }
+
+	virtual std::unique_ptr<RhiBuffer> CreateBuffer(const RhiBufferDesc& desc) override;
+	virtual std::unique_ptr<RhiTexture> CreateTexture(const RhiTextureDesc& desc) override;
+	virtual std::unique_ptr<RhiDescriptorHeap> CreateDescriptorHeap(RhiDescriptorHeapType type, std::uint32_t count, bool shaderVisible) override;
+	virtual std::unique_ptr<RhiCommandList> CreateCommandList(RhiQueueType type) override;
+	virtual void CreateShaderResourceView(RhiResource* resource, RhiCpuDescriptor descriptor) override;
+	virtual RhiCommandQueue* Queue(RhiQueueType type) override;
+
+	// wrappers of objects created outside the RHI, each holds a reference to the D3D12 object.
+	std::unique_ptr<RhiBuffer> WrapBuffer(ID3D12Resource* resource);
+	std::unique_ptr<RhiTexture> WrapTexture(ID3D12Resource* resource);
+	std::unique_ptr<RhiPipelineState> WrapPipelineState(ID3D12PipelineState* pso);
+	std::unique_ptr<RhiRootSignature> WrapRootSignature(ID3D12RootSignature* rootSignature);
+	std::unique_ptr<RhiDescriptorHeap> WrapDescriptorHeap(ID3D12DescriptorHeap* heap);
+	std::unique_ptr<D3D12RhiCommandList> WrapCommandList(ID3D12GraphicsCommandList* cmdList, RhiQueueType type = RhiQueueType::Direct);
+
+private:
+	Microsoft::WRL::ComPtr<ID3D12Device> mDevice;
+	std::unique_ptr<D3D12RhiCommandQueue> mDirectQueue;
+	std::unique_ptr<D3D12RhiCommandQueue> mCopyQueue;		// created on first use
+};
@@ -0,0 +1,121 @@
+// RhiNull.cpp
+
+#include "RhiNull.h"
+
+class NullRhiBuffer : public RhiBuffer
+{
+public:
+	NullRhiBuffer(std::uint32_t id, const RhiBufferDesc& desc, RhiGpuAddress address)
+		: RhiBuffer(id), mByteSize(desc.ByteSize), mGpuAddress(address)
+	{
+		if (desc.Heap != RhiHeapType::Default)
+		{
+			mMemory.resize((std::size_t)desc.ByteSize);
+		}
+	}
+
+	virtual RhiGpuAddress GpuAddress()const override { return mGpuAddress; }
+	virtual std::uint64_t ByteSize()const override { return mByteSize; }
+	virtual void* Map() override { return mMemory.empty() ? nullptr : mMemory.data(); }
+	virtual void Unmap() override {}
+
+private:
+	std::uint64_t mByteSize = 0;
+	RhiGpuAddress mGpuAddress = 0;
+	std::vector<std::uint8_t> mMemory;
+};
+
+class NullRhiTexture : public RhiTexture
+{
+public:
+	NullRhiTexture(std::uint32_t id, const RhiTextureDesc& desc) : RhiTexture(id), mDesc(desc) {}
+
+	virtual const RhiTextureDesc& Desc()const override { return mDesc; }
+
+private:
+	RhiTextureDesc mDesc;
+};
+
+class NullRhiPipelineState : public RhiPipelineState
+{
+public:
+	explicit NullRhiPipelineState(std::uint32_t id) : RhiPipelineState(id) {}
+};
+
+class NullRhiRootSignature : public RhiRootSignature
+{
+public:
+	explicit NullRhiRootSignature(std::uint32_t id) : RhiRootSignature(id) {}
+};
+
+class NullRhiDescriptorHeap : public RhiDescriptorHeap
+{
+public:
+	static const std::uint32_t Size = 32;
+
+	NullRhiDescriptorHeap(std::uint32_t id, RhiDescriptorHeapType type, std::uint32_t count, std::uint64_t start, bool shaderVisible)
+		: RhiDescriptorHeap(id), mType(type), mCount(count)
+	{
+		mCpuStart.Ptr = start;
+		mGpuStart.Ptr = shaderVisible ? start : 0;
+	}
+
+	virtual RhiDescriptorHeapType Type()const override { return mType; }
+	virtual std::uint32_t Count()const override { return mCount; }
+	virtual std::uint32_t DescriptorSize()const override { return Size; }
+	virtual RhiCpuDescriptor CpuStart()const override { return mCpuStart; }
+	virtual RhiGpuDescriptor GpuStart()const override { return mGpuStart; }
+
+private:
+	RhiDescriptorHeapType mType;
+	std::uint32_t mCount = 0;
+	RhiCpuDescriptor mCpuStart;
+	RhiGpuDescriptor mGpuStart;
+};
+
+NullRhiDevice::NullRhiDevice()
+	: mDirectQueue(RhiQueueType::Direct), mCopyQueue(RhiQueueType::Copy)
+{
+}
+
+std::unique_ptr<RhiBuffer> NullRhiDevice::CreateBuffer(const RhiBufferDesc& desc)
+{
+	// 64KB placement alignment like committed resources.
+	RhiGpuAddress address = mNextGpuAddress;
+	mNextGpuAddress += (desc.ByteSize + 0xffff) & ~0xffffull;
+
+	return std::make_unique<NullRhiBuffer>(NextObjectId(), desc, address);
+}
+
+std::unique_ptr<RhiTexture> NullRhiDevice::CreateTexture(const RhiTextureDesc& desc)
+{
+	return std::make_unique<NullRhiTexture>(NextObjectId(), desc);
+}
+
+std::unique_ptr<RhiDescriptorHeap> NullRhiDevice::CreateDescriptorHeap(RhiDescriptorHeapType type, std::uint32_t count, bool shaderVisible)
+{
+	std::uint64_t start = mNextDescriptor;
+	mNextDescriptor += (std::uint64_t)count * NullRhiDescriptorHeap::Size;
+
+	return std::make_unique<NullRhiDescriptorHeap>(NextObjectId(), type, count, start, shaderVisible);
+}
+
+std::unique_ptr<RhiCommandList> NullRhiDevice::CreateCommandList(RhiQueueType type)
+{
+	return std::make_unique<NullRhiCommandList>(NextObjectId(), type);
+}
+
+RhiCommandQueue* NullRhiDevice::Queue(RhiQueueType type)
+{
+	return type == RhiQueueType::Copy ? &mCopyQueue : &mDirectQueue;
+}
+
+std::unique_ptr<RhiPipelineState> NullRhiDevice::CreatePipelineState()
+{
+	return std::make_unique<NullRhiPipelineState>(NextObjectId());
+}
+
+std::unique_ptr<RhiRootSignature> NullRhiDevice::CreateRootSignature()
+{
+	return std::make_unique<NullRhiRootSignature>(NextObjectId());
+}
@@ -0,0 +1,99 @@
+// RhiNull.h : null backend of the rendering hardware interface.
+//
+// Objects get plausible GPU addresses and descriptor handles but no GPU work is ever done:
+// command lists only count what they were asked to record and fences complete immediately.
+// Upload and readback buffers are backed by system memory so that code writing through Map still works.
+// Useful to run and time the CPU side of the renderer without a GPU or a window.
+
+#pragma once
+
+#include "Rhi.h"
+#include <vector>
+
+class NullRhiCommandList : public RhiCommandList
+{
+public:
+	NullRhiCommandList(std::uint32_t id, RhiQueueType type) : RhiCommandList(id), mType(type) {}
+
+	// commands recorded since the last Begin
+	std::uint64_t CommandCount()const { return mCommandCount; }
+	std::uint64_t DrawCount()const { return mDrawCount; }
+
+	virtual RhiQueueType Type()const override { return mType; }
+
+	virtual void Begin(RhiPipelineState* /*initialState*/) override { mCommandCount = 0; mDrawCount = 0; }
+	virtual void End() override {}
+
+	virtual void ResourceBarrier(std::uint32_t /*count*/, const RhiTransitionBarrier* /*barriers*/) override { mCommandCount++; }
+
+	virtual void ClearRenderTargetView(RhiCpuDescriptor /*rtv*/, const float /*color*/[4]) override { mCommandCount++; }
+	virtual void ClearDepthStencilView(RhiCpuDescriptor /*dsv*/, RhiClearFlags /*flags*/, float /*depth*/, std::uint8_t /*stencil*/) override { mCommandCount++; }
+	virtual void OMSetRenderTargets(std::uint32_t /*count*/, const RhiCpuDescriptor* /*rtvs*/, const RhiCpuDescriptor* /*dsv*/) override { mCommandCount++; }
+	virtual void RSSetViewports(std::uint32_t /*count*/, const RhiViewport* /*viewports*/) override { mCommandCount++; }
+	virtual void RSSetScissorRects(std::uint32_t /*count*/, const RhiRect* /*rects*/) override { mCommandCount++; }
+
+	virtual void SetDescriptorHeaps(std::uint32_t /*count*/, RhiDescriptorHeap* const* /*heaps*/) override { mCommandCount++; }
+	virtual void SetPipelineState(RhiPipelineState* /*pso*/) override { mCommandCount++; }
+	virtual void SetGraphicsRootSignature(RhiRootSignature* /*rootSignature*/) override { mCommandCount++; }
+	virtual void SetGraphicsRootConstantBufferView(std::uint32_t /*rootIndex*/, RhiGpuAddress /*address*/) override { mCommandCount++; }
+	virtual void SetGraphicsRootShaderResourceView(std::uint32_t /*rootIndex*/, RhiGpuAddress /*address*/) override { mCommandCount++; }
+	virtual void SetGraphicsRootDescriptorTable(std::uint32_t /*rootIndex*/, RhiGpuDescriptor /*baseDescriptor*/) override { mCommandCount++; }
+	virtual void SetGraphicsRoot32BitConstants(std::uint32_t /*rootIndex*/, std::uint32_t /*num32BitValues*/, const void* /*data*/, std::uint32_t /*destOffset*/) override { mCommandCount++; }
+
+	virtual void IASetVertexBuffers(std::uint32_t /*startSlot*/, std::uint32_t /*count*/, const RhiVertexBufferView* /*views*/) override { mCommandCount++; }
+	virtual void IASetIndexBuffer(const RhiIndexBufferView* /*view*/) override { mCommandCount++; }
+	virtual void IASetPrimitiveTopology(RhiPrimitiveTopology /*topology*/) override { mCommandCount++; }
+
+	virtual void DrawInstanced(std::uint32_t /*vertexCountPerInstance*/, std::uint32_t /*instanceCount*/,
+		std::uint32_t /*startVertexLocation*/, std::uint32_t /*startInstanceLocation*/) override { mCommandCount++; mDrawCount++; }
+	virtual void DrawIndexedInstanced(std::uint32_t /*indexCountPerInstance*/, std::uint32_t /*instanceCount*/,
+		std::uint32_t /*startIndexLocation*/, std::int32_t /*baseVertexLocation*/, std::uint32_t /*startInstanceLocation*/) override { mCommandCount++; mDrawCount++; }
+
+	virtual void CopyBufferRegion(RhiBuffer* /*dst*/, std::uint64_t /*dstOffset*/, RhiBuffer* /*src*/, std::uint64_t /*srcOffset*/, std::uint64_t /*numBytes*/) override { mCommandCount++; }
+	virtual void ExecuteBundle(RhiCommandList* /*bundle*/) override { mCommandCount++; }
+
+private:
+	RhiQueueType mType;
+	std::uint64_t mCommandCount = 0;
+	std::uint64_t mDrawCount = 0;
+};
+
+class NullRhiCommandQueue : public RhiCommandQueue
+{
+public:
+	explicit NullRhiCommandQueue(RhiQueueType type) : mType(type) {}
+
+	virtual RhiQueueType Type()const override { return mType; }
+	virtual void ExecuteCommandLists(std::uint32_t /*count*/, RhiCommandList* const* /*lists*/) override {}
+	virtual std::uint64_t Signal() override { return ++mFenceValue; }
+	virtual std::uint64_t CompletedValue() override { return mFenceValue; }
+	virtual void WaitForValue(std::uint64_t /*value*/) override {}
+
+private:
+	RhiQueueType mType;
+	std::uint64_t mFenceValue = 0;
+};
+
+class NullRhiDevice : public RhiDevice
+{
+public:
+	NullRhiDevice();
+
+	virtual std::unique_ptr<RhiBuffer> CreateBuffer(const RhiBufferDesc& desc) override;
+	virtual std::unique_ptr<RhiTexture> CreateTexture(const RhiTextureDesc& desc) override;
+	virtual std::unique_ptr<RhiDescriptorHeap> CreateDescriptorHeap(RhiDescriptorHeapType type, std::uint32_t count, bool shaderVisible) override;
+	virtual std::unique_ptr<RhiCommandList> CreateCommandList(RhiQueueType type) override;
+	virtual void CreateShaderResourceView(RhiResource* /*resource*/, RhiCpuDescriptor /*descriptor*/) override {}
+	virtual RhiCommandQueue* Queue(RhiQueueType type) override;
+
+	// stand-ins for pipeline objects, which the null backend cannot compile.
+	std::unique_ptr<RhiPipelineState> CreatePipelineState();
+	std::unique_ptr<RhiRootSignature> CreateRootSignature();
+
+private:
+	RhiGpuAddress mNextGpuAddress = 0x10000;
+	std::uint64_t mNextDescriptor = 0x1000;
+
+	NullRhiCommandQueue mDirectQueue;
+	NullRhiCommandQueue mCopyQueue;
+};
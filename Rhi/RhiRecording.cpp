@@ -0,0 +1,259 @@
+// RhiRecording.cpp
+
+#include "RhiRecording.h"
+#include <cassert>
+#include <cstring>
+
+RecordingRhiCommandList::RecordingRhiCommandList(RhiCommandList* target, RhiQueueType type)
+	: RhiCommandList(target ? target->Id() : 0), mTarget(target), mType(type)
+{
+}
+
+void RecordingRhiCommandList::Clear()
+{
+	mStream.clear();
+	mCommandCount = 0;
+}
+
+void RecordingRhiCommandList::Op(RhiCommandOp op)
+{
+	WriteU8((std::uint8_t)op);
+	mCommandCount++;
+}
+
+// values are written in host order, which is little endian on every target of this application.
+void RecordingRhiCommandList::Write(const void* data, std::size_t size)
+{
+	std::size_t offset = mStream.size();
+	mStream.resize(offset + size);
+	std::memcpy(mStream.data() + offset, data, size);
+}
+
+void RecordingRhiCommandList::Begin(RhiPipelineState* initialState)
+{
+	Op(RhiCommandOp::Begin);
+	WriteObject(initialState);
+
+	if (mTarget) mTarget->Begin(initialState);
+}
+
+void RecordingRhiCommandList::End()
+{
+	Op(RhiCommandOp::End);
+
+	if (mTarget) mTarget->End();
+}
+
+void RecordingRhiCommandList::ResourceBarrier(std::uint32_t count, const RhiTransitionBarrier* barriers)
+{
+	Op(RhiCommandOp::ResourceBarrier);
+	WriteU32(count);
+	for (std::uint32_t i = 0; i < count; ++i)
+	{
+		WriteObject(barriers[i].Resource);
+		WriteU32(barriers[i].Subresource);
+		WriteU32((std::uint32_t)barriers[i].Before);
+		WriteU32((std::uint32_t)barriers[i].After);
+		WriteU8((std::uint8_t)barriers[i].Flags);
+	}
+
+	if (mTarget) mTarget->ResourceBarrier(count, barriers);
+}
+
+void RecordingRhiCommandList::ClearRenderTargetView(RhiCpuDescriptor rtv, const float color[4])
+{
+	Op(RhiCommandOp::ClearRenderTargetView);
+	WriteU64(rtv.Ptr);
+	Write(color, 4 * sizeof(float));
+
+	if (mTarget) mTarget->ClearRenderTargetView(rtv, color);
+}
+
+void RecordingRhiCommandList::ClearDepthStencilView(RhiCpuDescriptor dsv, RhiClearFlags flags, float depth, std::uint8_t stencil)
+{
+	Op(RhiCommandOp::ClearDepthStencilView);
+	WriteU64(dsv.Ptr);
+	WriteU8((std::uint8_t)flags);
+	WriteF32(depth);
+	WriteU8(stencil);
+
+	if (mTarget) mTarget->ClearDepthStencilView(dsv, flags, depth, stencil);
+}
+
+void RecordingRhiCommandList::OMSetRenderTargets(std::uint32_t count, const RhiCpuDescriptor* rtvs, const RhiCpuDescriptor* dsv)
+{
+	Op(RhiCommandOp::OMSetRenderTargets);
+	WriteU8((std::uint8_t)count);
+	for (std::uint32_t i = 0; i < count; ++i)
+	{
+		WriteU64(rtvs[i].Ptr);
+	}
+	WriteU64(dsv ? dsv->Ptr : 0);
+
+	if (mTarget) mTarget->OMSetRenderTargets(count, rtvs, dsv);
+}
+
+void RecordingRhiCommandList::RSSetViewports(std::uint32_t count, const RhiViewport* viewports)
+{
+	Op(RhiCommandOp::RSSetViewports);
+	WriteU8((std::uint8_t)count);
+	Write(viewports, count * sizeof(RhiViewport));
+
+	if (mTarget) mTarget->RSSetViewports(count, viewports);
+}
+
+void RecordingRhiCommandList::RSSetScissorRects(std::uint32_t count, const RhiRect* rects)
+{
+	Op(RhiCommandOp::RSSetScissorRects);
+	WriteU8((std::uint8_t)count);
+	Write(rects, count * sizeof(RhiRect));
+
+	if (mTarget) mTarget->RSSetScissorRects(count, rects);
+}
+
+void RecordingRhiCommandList::SetDescriptorHeaps(std::uint32_t count, RhiDescriptorHeap* const* heaps)
+{
+	Op(RhiCommandOp::SetDescriptorHeaps);
+	WriteU8((std::uint8_t)count);
+	for (std::uint32_t i = 0; i < count; ++i)
+	{
+		WriteObject(heaps[i]);
+	}
+
+	if (mTarget) mTarget->SetDescriptorHeaps(count, heaps);
+}
+
+void RecordingRhiCommandList::SetPipelineState(RhiPipelineState* pso)
+{
+	Op(RhiCommandOp::SetPipelineState);
+	WriteObject(pso);
+
+	if (mTarget) mTarget->SetPipelineState(pso);
+}
+
+void RecordingRhiCommandList::SetGraphicsRootSignature(RhiRootSignature* rootSignature)
+{
+	Op(RhiCommandOp::SetGraphicsRootSignature);
+	WriteObject(rootSignature);
+
+	if (mTarget) mTarget->SetGraphicsRootSignature(rootSignature);
+}
+
+void RecordingRhiCommandList::SetGraphicsRootConstantBufferView(std::uint32_t rootIndex, RhiGpuAddress address)
+{
+	Op(RhiCommandOp::SetGraphicsRootConstantBufferView);
+	WriteU8((std::uint8_t)rootIndex);
+	WriteU64(address);
+
+	if (mTarget) mTarget->SetGraphicsRootConstantBufferView(rootIndex, address);
+}
+
+void RecordingRhiCommandList::SetGraphicsRootShaderResourceView(std::uint32_t rootIndex, RhiGpuAddress address)
+{
+	Op(RhiCommandOp::SetGraphicsRootShaderResourceView);
+	WriteU8((std::uint8_t)rootIndex);
+	WriteU64(address);
+
+	if (mTarget) mTarget->SetGraphicsRootShaderResourceView(rootIndex, address);
+}
+
+void RecordingRhiCommandList::SetGraphicsRootDescriptorTable(std::uint32_t rootIndex, RhiGpuDescriptor baseDescriptor)
+{
+	Op(RhiCommandOp::SetGraphicsRootDescriptorTable);
+	WriteU8((std::uint8_t)rootIndex);
+	WriteU64(baseDescriptor.Ptr);
+
+	if (mTarget) mTarget->SetGraphicsRootDescriptorTable(rootIndex, baseDescriptor);
+}
+
+void RecordingRhiCommandList::SetGraphicsRoot32BitConstants(std::uint32_t rootIndex, std::uint32_t num32BitValues, const void* data, std::uint32_t destOffset)
+{
+	// a root signature holds at most 64 DWORDs, so all three fit in a byte.
+	assert(rootIndex < 256 && num32BitValues <= 64 && destOffset < 64);
+
+	Op(RhiCommandOp::SetGraphicsRoot32BitConstants);
+	WriteU8((std::uint8_t)rootIndex);
+	WriteU8((std::uint8_t)num32BitValues);
+	WriteU8((std::uint8_t)destOffset);
+	Write(data, num32BitValues * sizeof(std::uint32_t));
+
+	if (mTarget) mTarget->SetGraphicsRoot32BitConstants(rootIndex, num32BitValues, data, destOffset);
+}
+
+void RecordingRhiCommandList::IASetVertexBuffers(std::uint32_t startSlot, std::uint32_t count, const RhiVertexBufferView* views)
+{
+	Op(RhiCommandOp::IASetVertexBuffers);
+	WriteU8((std::uint8_t)startSlot);
+	WriteU8((std::uint8_t)count);
+	for (std::uint32_t i = 0; i < count; ++i)
+	{
+		WriteU64(views[i].BufferLocation);
+		WriteU32(views[i].SizeInBytes);
+		WriteU32(views[i].StrideInBytes);
+	}
+
+	if (mTarget) mTarget->IASetVertexBuffers(startSlot, count, views);
+}
+
+void RecordingRhiCommandList::IASetIndexBuffer(const RhiIndexBufferView* view)
+{
+	Op(RhiCommandOp::IASetIndexBuffer);
+	WriteU64(view ? view->BufferLocation : 0);
+	WriteU32(view ? view->SizeInBytes : 0);
+	WriteU32(view ? (std::uint32_t)view->Format : 0);
+
+	if (mTarget) mTarget->IASetIndexBuffer(view);
+}
+
+void RecordingRhiCommandList::IASetPrimitiveTopology(RhiPrimitiveTopology topology)
+{
+	Op(RhiCommandOp::IASetPrimitiveTopology);
+	WriteU8((std::uint8_t)topology);
+
+	if (mTarget) mTarget->IASetPrimitiveTopology(topology);
+}
+
+void RecordingRhiCommandList::DrawInstanced(std::uint32_t vertexCountPerInstance, std::uint32_t instanceCount,
+	std::uint32_t startVertexLocation, std::uint32_t startInstanceLocation)
+{
+	Op(RhiCommandOp::DrawInstanced);
+	WriteU32(vertexCountPerInstance);
+	WriteU32(instanceCount);
+	WriteU32(startVertexLocation);
+	WriteU32(startInstanceLocation);
+
+	if (mTarget) mTarget->DrawInstanced(vertexCountPerInstance, instanceCount, startVertexLocation, startInstanceLocation);
+}
+
+void RecordingRhiCommandList::DrawIndexedInstanced(std::uint32_t indexCountPerInstance, std::uint32_t instanceCount,
+	std::uint32_t startIndexLocation, std::int32_t baseVertexLocation, std::uint32_t startInstanceLocation)
+{
+	Op(RhiCommandOp::DrawIndexedInstanced);
+	WriteU32(indexCountPerInstance);
+	WriteU32(instanceCount);
+	WriteU32(startIndexLocation);
+	WriteU32((std::uint32_t)baseVertexLocation);
+	WriteU32(startInstanceLocation);
+
+	if (mTarget) mTarget->DrawIndexedInstanced(indexCountPerInstance, instanceCount, startIndexLocation, baseVertexLocation, startInstanceLocation);
+}
+
+void RecordingRhiCommandList::CopyBufferRegion(RhiBuffer* dst, std::uint64_t dstOffset, RhiBuffer* src, std::uint64_t srcOffset, std::uint64_t numBytes)
+{
+	Op(RhiCommandOp::CopyBufferRegion);
+	WriteObject(dst);
+	WriteU64(dstOffset);
+	WriteObject(src);
+	WriteU64(srcOffset);
+	WriteU64(numBytes);
+
+	if (mTarget) mTarget->CopyBufferRegion(dst, dstOffset, src, srcOffset, numBytes);
+}
+
+void RecordingRhiCommandList::ExecuteBundle(RhiCommandList* bundle)
+{
+	Op(RhiCommandOp::ExecuteBundle);
+	WriteObject(bundle);
+
+	if (mTarget) mTarget->ExecuteBundle(bundle);
+}
@@ -0,0 +1,104 @@
+// RhiRecording.h : recording backend of the rendering hardware interface.
+//
+// RecordingRhiCommandList serializes every command into a compact byte stream and, when given a target,
+// forwards it to that command list as well, so a frame can be captured while it is being rendered.
+// Each command is a one byte RhiCommandOp followed by its arguments in little endian order.
+// Objects are written as their 32-bit RhiObject::Id (0 for null), GPU addresses and descriptors as 64-bit values.
+
+#pragma once
+
+#include "Rhi.h"
+#include <vector>
+
+enum class RhiCommandOp : std::uint8_t
+{
+	Begin = 1,
+	End,
+	ResourceBarrier,
+	ClearRenderTargetView,
+	ClearDepthStencilView,
+	OMSetRenderTargets,
+	RSSetViewports,
+	RSSetScissorRects,
+	SetDescriptorHeaps,
+	SetPipelineState,
+	SetGraphicsRootSignature,
+	SetGraphicsRootConstantBufferView,
+	SetGraphicsRootShaderResourceView,
+	SetGraphicsRootDescriptorTable,
+	SetGraphicsRoot32BitConstants,
+	IASetVertexBuffers,
+	IASetIndexBuffer,
+	IASetPrimitiveTopology,
+	DrawInstanced,
+	DrawIndexedInstanced,
+	CopyBufferRegion,
+	ExecuteBundle,
+
+	Count
+};
+
+class RecordingRhiCommandList : public RhiCommandList
+{
+public:
+	// target may be null, the commands are then only recorded.
+	explicit RecordingRhiCommandList(RhiCommandList* target = nullptr, RhiQueueType type = RhiQueueType::Direct);
+
+	void SetTarget(RhiCommandList* target) { mTarget = target; }
+	RhiCommandList* Target()const { return mTarget; }
+
+	// the stream keeps growing across Begin/End pairs until it is cleared.
+	const std::vector<std::uint8_t>& Stream()const { return mStream; }
+	std::uint64_t CommandCount()const { return mCommandCount; }
+	void Clear();
+
+	virtual void* NativeHandle()const override { return mTarget ? mTarget->NativeHandle() : nullptr; }
+	virtual RhiQueueType Type()const override { return mType; }
+
+	virtual void Begin(RhiPipelineState* initialState) override;
+	virtual void End() override;
+
+	virtual void ResourceBarrier(std::uint32_t count, const RhiTransitionBarrier* barriers) override;
+
+	virtual void ClearRenderTargetView(RhiCpuDescriptor rtv, const float color[4]) override;
+	virtual void ClearDepthStencilView(RhiCpuDescriptor dsv, RhiClearFlags flags, float depth, std::uint8_t stencil) override;
+	virtual void OMSetRenderTargets(std::uint32_t count, const RhiCpuDescriptor* rtvs, const RhiCpuDescriptor* dsv) override;
+	virtual void RSSetViewports(std::uint32_t count, const RhiViewport* viewports) override;
+	virtual void RSSetScissorRects(std::uint32_t count, const RhiRect* rects) override;
+
+	virtual void SetDescriptorHeaps(std::uint32_t count, RhiDescriptorHeap* const* heaps) override;
+	virtual void SetPipelineState(RhiPipelineState* pso) override;
+	virtual void SetGraphicsRootSignature(RhiRootSignature* rootSignature) override;
+	virtual void SetGraphicsRootConstantBufferView(std::uint32_t rootIndex, RhiGpuAddress address) override;
+	virtual void SetGraphicsRootShaderResourceView(std::uint32_t rootIndex, RhiGpuAddress address) override;
+	virtual void SetGraphicsRootDescriptorTable(std::uint32_t rootIndex, RhiGpuDescriptor baseDescriptor) override;
+	virtual void SetGraphicsRoot32BitConstants(std::uint32_t rootIndex, std::uint32_t num32BitValues, const void* data, std::uint32_t destOffset) override;
+
+	virtual void IASetVertexBuffers(std::uint32_t startSlot, std::uint32_t count, const RhiVertexBufferView* views) override;
+	virtual void IASetIndexBuffer(const RhiIndexBufferView* view) override;
+	virtual void IASetPrimitiveTopology(RhiPrimitiveTopology topology) override;
+
+	virtual void DrawInstanced(std::uint32_t vertexCountPerInstance, std::uint32_t instanceCount,
+		std::uint32_t startVertexLocation, std::uint32_t startInstanceLocation) override;
+	virtual void DrawIndexedInstanced(std::uint32_t indexCountPerInstance, std::uint32_t instanceCount,
+		std::uint32_t startIndexLocation, std::int32_t baseVertexLocation, std::uint32_t startInstanceLocation) override;
+
+	virtual void CopyBufferRegion(RhiBuffer* dst, std::uint64_t dstOffset, RhiBuffer* src, std::uint64_t srcOffset, std::uint64_t numBytes) override;
+	virtual void ExecuteBundle(RhiCommandList* bundle) override;
+
+private:
+	void Op(RhiCommandOp op);
+	void Write(const void* data, std::size_t size);
+	void WriteU8(std::uint8_t value) { Write(&value, 1); }
+	void WriteU32(std::uint32_t value) { Write(&value, 4); }
+	void WriteU64(std::uint64_t value) { Write(&value, 8); }
+	void WriteF32(float value) { Write(&value, 4); }
+	void WriteObject(const RhiObject* object) { WriteU32(object ? object->Id() : 0); }
+
+private:
+	RhiCommandList* mTarget = nullptr;
+	RhiQueueType mType;
+
+	std::vector<std::uint8_t> mStream;
+	std::uint64_t mCommandCount = 0;
+};
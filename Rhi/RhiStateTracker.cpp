@@ -0,0 +1,245 @@
+// RhiStateTracker.cpp
+
+#include "RhiStateTracker.h"
+#include <cassert>
+
+// ---------- registry ----------
+
+void RhiResourceStateRegistry::Register(RhiResource* resource, RhiResourceState state)
+{
+	RhiSubresourceStates states;
+	states.State = state;
+	mStates[resource] = states;
+}
+
+void RhiResourceStateRegistry::Unregister(RhiResource* resource)
+{
+	mStates.erase(resource);
+}
+
+RhiSubresourceStates RhiResourceStateRegistry::Find(RhiResource* resource)const
+{
+	auto it = mStates.find(resource);
+	return it != mStates.end() ? it->second : RhiSubresourceStates();
+}
+
+// ---------- tracker ----------
+
+void RhiResourceStateTracker::Begin(RhiCommandList* cmdList)
+{
+	mCmdList = cmdList;
+	mStates.clear();
+	mPending.clear();
+	mSplits.clear();
+	mStats = RhiStateTrackerStats();
+}
+
+void RhiResourceStateTracker::Transition(RhiResource* resource, RhiResourceState after, std::uint32_t subresource)
+{
+	EndSplits(resource, subresource);
+	SetState(resource, subresource, after, RhiBarrierFlags::None);
+}
+
+void RhiResourceStateTracker::BeginSplitTransition(RhiResource* resource, RhiResourceState after, std::uint32_t subresource)
+{
+	EndSplits(resource, subresource);
+	SetState(resource, subresource, after, RhiBarrierFlags::BeginOnly);
+}
+
+void RhiResourceStateTracker::Flush()
+{
+	if (mPending.empty())
+	{
+		return;
+	}
+
+	mCmdList->ResourceBarrier((std::uint32_t)mPending.size(), mPending.data());
+	mStats.Barriers += (std::uint32_t)mPending.size();
+	mStats.Batches++;
+	mPending.clear();
+
+	for (auto& split : mSplits)
+	{
+		split.Issued = true;
+	}
+}
+
+void RhiResourceStateTracker::End()
+{
+	while (!mSplits.empty())
+	{
+		EndSplits(mSplits.front().Resource, RhiAllSubresources);
+	}
+	Flush();
+
+	if (mRegistry)
+	{
+		for (const auto& states : mStates)
+		{
+			mRegistry->Store(states.first, states.second);
+		}
+	}
+	mCmdList = nullptr;
+}
+
+RhiSubresourceStates& RhiResourceStateTracker::States(RhiResource* resource)
+{
+	auto it = mStates.find(resource);
+	if (it == mStates.end())
+	{
+		// first use in this list : the resource is in the state the lists executed before left it in.
+		it = mStates.emplace(resource, mRegistry ? mRegistry->Find(resource) : RhiSubresourceStates()).first;
+	}
+	return it->second;
+}
+
+void RhiResourceStateTracker::Queue(RhiResource* resource, std::uint32_t subresource, RhiResourceState before, RhiResourceState after, RhiBarrierFlags flags)
+{
+	// fold into the last pending transition of the same resource when it covers the same subresources.
+	// looking further back could reorder it with a transition of other subresources in between.
+	if (flags == RhiBarrierFlags::None)
+	{
+		for (std::size_t i = mPending.size(); i-- > 0;)
+		{
+			RhiTransitionBarrier& pending = mPending[i];
+			if (pending.Resource != resource)
+			{
+				continue;
+			}
+
+			if (pending.Subresource == subresource && pending.Flags == RhiBarrierFlags::None)
+			{
+				assert(pending.After == before);
+				mStats.Merged++;
+				if (pending.Before == after)
+				{
+					mPending.erase(mPending.begin() + i);
+				}
+				else
+				{
+					pending.After = after;
+				}
+				return;
+			}
+			break;
+		}
+	}
+
+	RhiTransitionBarrier barrier;
+	barrier.Resource = resource;
+	barrier.Subresource = subresource;
+	barrier.Before = before;
+	barrier.After = after;
+	barrier.Flags = flags;
+	mPending.push_back(barrier);
+
+	if (flags == RhiBarrierFlags::BeginOnly)
+	{
+		Split split = { resource, subresource, before, after, false };
+		mSplits.push_back(split);
+	}
+}
+
+void RhiResourceStateTracker::SetState(RhiResource* resource, std::uint32_t subresource, RhiResourceState after, RhiBarrierFlags flags)
+{
+	RhiSubresourceStates& states = States(resource);
+
+	if (subresource == RhiAllSubresources)
+	{
+		if (states.PerSubresource.empty())
+		{
+			if (states.State != after)
+			{
+				Queue(resource, RhiAllSubresources, states.State, after, flags);
+			}
+		}
+		else
+		{
+			// the subresources disagree : one barrier per subresource not in the target state yet.
+			for (std::uint32_t i = 0; i < (std::uint32_t)states.PerSubresource.size(); ++i)
+			{
+				if (states.PerSubresource[i] != after)
+				{
+					Queue(resource, i, states.PerSubresource[i], after, flags);
+				}
+			}
+			states.PerSubresource.clear();
+		}
+		states.State = after;
+		return;
+	}
+
+	RhiResourceState before = states.Get(subresource);
+	if (before == after)
+	{
+		return;
+	}
+
+	Queue(resource, subresource, before, after, flags);
+
+	std::uint32_t count = resource->SubresourceCount();
+	if (count == 1)
+	{
+		states.State = after;
+		return;
+	}
+
+	if (states.PerSubresource.empty())
+	{
+		states.PerSubresource.assign(count, states.State);
+	}
+	states.PerSubresource[subresource] = after;
+
+	// back to a single state once every subresource agrees again.
+	for (std::uint32_t i = 1; i < count; ++i)
+	{
+		if (states.PerSubresource[i] != states.PerSubresource[0])
+		{
+			return;
+		}
+	}
+	states.State = after;
+	states.PerSubresource.clear();
+}
+
+void RhiResourceStateTracker::EndSplits(RhiResource* resource, std::uint32_t subresource)
+{
+	for (std::size_t i = 0; i < mSplits.size();)
+	{
+		const Split& split = mSplits[i];
+		bool overlaps = split.Resource == resource &&
+			(subresource == RhiAllSubresources || split.Subresource == RhiAllSubresources || split.Subresource == subresource);
+		if (!overlaps)
+		{
+			++i;
+			continue;
+		}
+
+		if (split.Issued)
+		{
+			RhiTransitionBarrier end;
+			end.Resource = split.Resource;
+			end.Subresource = split.Subresource;
+			end.Before = split.Before;
+			end.After = split.After;
+			end.Flags = RhiBarrierFlags::EndOnly;
+			mPending.push_back(end);
+			mStats.Splits++;
+		}
+		else
+		{
+			// both halves would go out in the same batch : a regular barrier does the same.
+			for (auto& pending : mPending)
+			{
+				if (pending.Resource == split.Resource && pending.Subresource == split.Subresource && pending.Flags == RhiBarrierFlags::BeginOnly)
+				{
+					pending.Flags = RhiBarrierFlags::None;
+					break;
+				}
+			}
+			mStats.CollapsedSplits++;
+		}
+
+		mSplits.erase(mSplits.begin() + i);
+	}
+}
@@ -0,0 +1,101 @@
+// RhiStateTracker.h : per command list tracking of resource states and batching of their transitions.
+//
+// Callers state the state a resource (or one subresource) has to be in and the tracker works out the
+// barriers.  Transitions requested between two pieces of work are merged, A->B->C becomes A->C and A->B->A
+// disappears, and go out as one ResourceBarrier call when Flush is called before the next draw, dispatch
+// or copy.  A transition whose result is needed only later can be split : BeginSplitTransition issues the
+// begin half at the next flush and the following Transition of that resource issues the end half, so the
+// GPU can overlap the transition with the work recorded in between.  When no work was recorded in between
+// the two halves are merged back into a regular barrier.
+//
+// The registry holds the state each resource is left in by the lists executed so far.  A tracker reads it
+// when a resource is first used by its list and writes the final states back in End, so lists have to be
+// executed in the order their trackers end, which holds for a renderer recording on one thread.
+
+#pragma once
+
+#include "Rhi.h"
+#include <unordered_map>
+#include <vector>
+
+// state of every subresource of one resource, stored once while they all agree.
+struct RhiSubresourceStates
+{
+	RhiResourceState State = RhiResourceState::Common;		// state of all the subresources when PerSubresource is empty
+	std::vector<RhiResourceState> PerSubresource;
+
+	RhiResourceState Get(std::uint32_t subresource)const { return PerSubresource.empty() ? State : PerSubresource[subresource]; }
+};
+
+class RhiResourceStateRegistry
+{
+public:
+	// resources never registered are assumed to be in the common state.
+	void Register(RhiResource* resource, RhiResourceState state);
+	void Unregister(RhiResource* resource);
+	void Clear() { mStates.clear(); }
+
+	RhiSubresourceStates Find(RhiResource* resource)const;
+	void Store(RhiResource* resource, const RhiSubresourceStates& states) { mStates[resource] = states; }
+
+private:
+	std::unordered_map<RhiResource*, RhiSubresourceStates> mStates;
+};
+
+struct RhiStateTrackerStats
+{
+	std::uint32_t Barriers = 0;			// barriers issued
+	std::uint32_t Batches = 0;			// ResourceBarrier calls they were issued in
+	std::uint32_t Merged = 0;			// transitions folded into an earlier pending one
+	std::uint32_t Splits = 0;			// transitions issued as begin/end pairs
+	std::uint32_t CollapsedSplits = 0;	// split transitions merged back for lack of work in between
+};
+
+class RhiResourceStateTracker
+{
+public:
+	explicit RhiResourceStateTracker(RhiResourceStateRegistry* registry) : mRegistry(registry) {}
+
+	// start tracking cmdList, which was just opened with Begin.
+	void Begin(RhiCommandList* cmdList);
+
+	// the resource has to be in state after for the next piece of work.
+	void Transition(RhiResource* resource, RhiResourceState after, std::uint32_t subresource = RhiAllSubresources);
+
+	// the resource has to be in state after for some later work : the end of the transition is
+	// issued by the next Transition of the same subresources.
+	void BeginSplitTransition(RhiResource* resource, RhiResourceState after, std::uint32_t subresource = RhiAllSubresources);
+
+	// issue the pending barriers in one call.  To be called before every draw, dispatch or copy.
+	void Flush();
+
+	// finish the open split transitions, flush and hand the final states over to the registry.
+	void End();
+
+	const RhiStateTrackerStats& Stats()const { return mStats; }
+
+private:
+	struct Split
+	{
+		RhiResource* Resource;
+		std::uint32_t Subresource;
+		RhiResourceState Before;
+		RhiResourceState After;
+		bool Issued;				// the begin half went out with a flush, work may follow it
+	};
+
+	RhiSubresourceStates& States(RhiResource* resource);
+	void Queue(RhiResource* resource, std::uint32_t subresource, RhiResourceState before, RhiResourceState after, RhiBarrierFlags flags);
+	void SetState(RhiResource* resource, std::uint32_t subresource, RhiResourceState after, RhiBarrierFlags flags);
+	void EndSplits(RhiResource* resource, std::uint32_t subresource);
+
+private:
+	RhiResourceStateRegistry* mRegistry = nullptr;
+	RhiCommandList* mCmdList = nullptr;
+
+	std::unordered_map<RhiResource*, RhiSubresourceStates> mStates;		// resources used by the list so far
+	std::vector<RhiTransitionBarrier> mPending;
+	std::vector<Split> mSplits;
+
+	RhiStateTrackerStats mStats;
+};
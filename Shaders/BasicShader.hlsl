@@ -27,10 +27,30 @@ struct MaterialParameter
     uint pad2;
 };
 
-// An global array of textures
-Texture2D gDiffuseMap[7] : register(t0);        // seven textures
+// per-object data : affine world matrix (4 rows x 3 columns, stored row by row) and material index. 52 bytes.
+struct InstanceData
+{
+    row_major float4x3 World;
+    uint MaterialIndex;
+};
+
+// texture transforms which differ from identity, entry 0 is the identity.
+struct TexTransformData
+{
+    row_major float4x3 TexTransform;
+};
+
+// An global array of textures, sized by the application from its texture list
+#ifndef DIFFUSE_MAP_COUNT
+    #define DIFFUSE_MAP_COUNT   7
+#endif
+
+Texture2D gDiffuseMap[DIFFUSE_MAP_COUNT] : register(t0);
 
 StructuredBuffer<MaterialParameter> gMaterialParameters : register(t0, space1); // use space1 to avoid memory overwriting
+StructuredBuffer<InstanceData> gInstances : register(t1, space1);
+StructuredBuffer<TexTransformData> gTexTransforms : register(t2, space1);
+StructuredBuffer<uint> gImpostors : register(t3, space1);       // gInstances index of every impostor drawn
 
 // global common sampler states
 SamplerState gsamPointWrap          :   register(s0);
@@ -40,15 +60,13 @@ SamplerState gsamLinearClamp        :   register(s3);
 SamplerState gsamAnisotropicWrap    :   register(s4);
 SamplerState gsamAnisotropicClamp   :   register(s5);
 
-// constnat buffer for object to be drawn
-cbuffer cbObject : register(b0)
+// root constants for the object to be drawn
+cbuffer cbDraw : register(b0)
 {
-    float4x4 gWorld;                // (global) world matrix of the given object
-    float4x4 gTexTransform;         // (global) texture transform matrix
-    uint gMaterialIndex;            // (global) material index for a material for which we wish to assign to this object.
-    uint gObjectPad0;               // (global) padding variable....
-    uint gObjectPad1;
-    uint gObjectPad2;
+    float3 gPositionCenter;         // (global) center of the bounds CompactVS's positions are quantized in
+    uint gInstanceIndex;            // (global) index of the object in gInstances
+    float3 gPositionExtent;         // (global) half size of those bounds
+    uint gTexTransformIndex;        // (global) index of the object's texture transform in gTexTransforms
 };
 
 // constant buffer for storing common parameters
@@ -86,45 +104,78 @@ struct VertexOutput
     float3 PosW     : POSITION;             // position of a vertex in world space
     float3 NormalW  : NORMAL;               // normal vector in world space
     float2 TexC     : TEXCOORD;             // texture coordinates
+    nointerpolation uint MatIndex : MATINDEX;   // material index of the object
 };
 
-VertexOutput VS(VertexInput vin)
+// the 16 byte CompactVertex of Helpers/VertexQuantization.h, the input assembler turns the SNORM and UNORM
+// values into floats.  Helpers/VertexQuantization.cpp encodes it, the two have to stay in step.
+struct CompactVertexInput
+{
+    float4 PosQ     :   POSITION;           // position in the mesh bounds in [-1, 1], w unused
+    float2 NormalQ  :   NORMAL;             // octahedral encoded normal
+    float2 TexC     :   TEXCOORD;           // texture coordinates
+};
+
+// the unit normal of an octahedral encoding : the lower half is folded back from the corners of the square.
+float3 OctahedralDecode(float2 e)
+{
+    float3 n = float3(e, 1.0f - abs(e.x) - abs(e.y));
+    if (n.z < 0.0f)
+    {
+        float2 signs = n.xy >= 0.0f ? 1.0f : -1.0f;
+        n.xy = (1.0f - abs(n.yx)) * signs;
+    }
+    return normalize(n);
+}
+
+VertexOutput TransformVertex(float3 posL, float3 normalL, float2 texCoord)
 {
     VertexOutput vout = (VertexOutput)0.0f;
 
-    // fetch the material data.
-    MaterialParameter matParam = gMaterialParameters[gMaterialIndex];
+    // fetch the object and material data.
+    InstanceData inst = gInstances[gInstanceIndex];
+    MaterialParameter matParam = gMaterialParameters[inst.MaterialIndex];
 
     // transform to world space.
-    float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
-    vout.PosW = posW.xyz;
+    float3 posW = mul(float4(posL, 1.0f), inst.World);
+    vout.PosW = posW;
 
-    vout.NormalW = mul(vin.NormalL, (float3x3)gWorld);
+    vout.NormalW = mul(normalL, (float3x3)inst.World);
 
     // transform to homogeneous clip space.
-    vout.PosH = mul(posW, gViewProj);
+    vout.PosH = mul(float4(posW, 1.0f), gViewProj);
 
-    float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), gTexTransform);
-    vout.TexC = mul(texC, matParam.MatTransform).xy;
+    float3 texC = mul(float4(texCoord, 0.0f, 1.0f), gTexTransforms[gTexTransformIndex].TexTransform);
+    vout.TexC = mul(float4(texC, 1.0f), matParam.MatTransform).xy;
+    vout.MatIndex = inst.MaterialIndex;
 
     return vout;
 }
 
-float4 PS(VertexOutput pin) : SV_Target
+VertexOutput VS(VertexInput vin)
+{
+    return TransformVertex(vin.PosL, vin.NormalL, vin.TexC);
+}
+
+VertexOutput CompactVS(CompactVertexInput vin)
+{
+    float3 posL = gPositionCenter + gPositionExtent * vin.PosQ.xyz;
+    return TransformVertex(posL, OctahedralDecode(vin.NormalQ), vin.TexC);
+}
+
+// lit color of a surface point, shared by the meshes and the impostors.  texColor is the diffuse map's sample.
+float4 ShadeSurface(uint matIndex, float4 texColor, float3 posW, float3 normalW)
 {
     // fetch the material parameters
-    MaterialParameter matParam = gMaterialParameters[gMaterialIndex];
+    MaterialParameter matParam = gMaterialParameters[matIndex];
     float4 diffuseAlbedo = matParam.DiffuseAlbedo;
     float3 fresnelR0 = matParam.FresnelR0;
     float roughness = matParam.Roughness;
-    uint diffuseTexIndex = matParam.DiffuseMapIndex;
 
-    diffuseAlbedo *= gDiffuseMap[diffuseTexIndex].Sample(gsamLinearWrap, pin.TexC);
-
-    pin.NormalW = normalize(pin.NormalW);
+    diffuseAlbedo *= texColor;
 
     // vectir from a point on the object's surface to the camera.
-    float3 toCameraW = normalize(gCameraPosW - pin.PosW);
+    float3 toCameraW = normalize(gCameraPosW - posW);
 
     float4 ambient = gAmbientLight*diffuseAlbedo;
 
@@ -132,7 +183,7 @@ float4 PS(VertexOutput pin) : SV_Target
 
     ObjectProperty objProp = {diffuseAlbedo, fresnelR0, shininess};
     float3 shadowFactor = 1.0f;
-    float4 directLight = ComputeLighting(gLights, objProp, pin.PosW, pin.NormalW, toCameraW, shadowFactor);
+    float4 directLight = ComputeLighting(gLights, objProp, posW, normalW, toCameraW, shadowFactor);
 
     float4 litColor = ambient + directLight;
 
@@ -141,6 +192,114 @@ float4 PS(VertexOutput pin) : SV_Target
     return litColor;
 }
 
+float4 PS(VertexOutput pin) : SV_Target
+{
+    MaterialParameter matParam = gMaterialParameters[pin.MatIndex];
+    float4 texColor = gDiffuseMap[matParam.DiffuseMapIndex].Sample(gsamLinearWrap, pin.TexC);
+
+    return ShadeSurface(pin.MatIndex, texColor, pin.PosW, normalize(pin.NormalW));
+}
+
+// ray traced impostors : every sphere is one screen aligned quad bounding its projection, the pixel shader
+// intersects the view ray of each pixel with the sphere and writes the depth of the hit.  The silhouette is
+// exact at any distance for four vertices per sphere.  Helpers/SphereImpostor.cpp does the same math on the
+// CPU (checked by Tools/ImpostorBench.cpp), the two have to stay in step.
+struct ImpostorOutput
+{
+    float4 PosH     : SV_POSITION;
+    float3 RayV     : RAY;                  // view space point at z = 1 under the pixel
+    nointerpolation uint InstanceIndex : INSTANCE;
+};
+
+struct ImpostorPixel
+{
+    float4 Color    : SV_Target;
+    float Depth     : SV_Depth;
+};
+
+// slopes (c / z) of the two lines through the eye tangent to the circle of the sphere on the (axis, z) plane.
+float2 TangentSlopes(float c, float z, float radius)
+{
+    float t = sqrt(max(c * c + z * z - radius * radius, 0.0f));
+    return float2(c * z - radius * t, c * z + radius * t) / (z * z - radius * radius);
+}
+
+ImpostorOutput ImpostorVS(uint vertexId : SV_VertexID, uint instanceId : SV_InstanceID)
+{
+    ImpostorOutput vout;
+
+    uint instanceIndex = gImpostors[instanceId];
+    InstanceData inst = gInstances[instanceIndex];
+    float3 centerV = mul(float4(inst.World[3], 1.0f), gView).xyz;
+    float radius = length(inst.World[0]);
+
+    // the rectangle bounding the projection at the depth of the nearest point, or the whole screen for a
+    // sphere reaching in front of the near plane.
+    float4 bounds = float4(-1.0f, -1.0f, 1.0f, 1.0f);
+    float depth = 0.0f;
+    if (centerV.z - radius > gNearZ)
+    {
+        bounds.xz = TangentSlopes(centerV.x, centerV.z, radius) * gProj[0][0];
+        bounds.yw = TangentSlopes(centerV.y, centerV.z, radius) * gProj[1][1];
+        depth = gProj[2][2] + gProj[3][2] / (centerV.z - radius);
+    }
+
+    // corners of a 4 vertex strip, clockwise on screen.  w is 1, so RayV interpolates linearly on screen.
+    float2 corner = float2((vertexId & 1) ? bounds.z : bounds.x, (vertexId & 2) ? bounds.y : bounds.w);
+    vout.PosH = float4(corner, depth, 1.0f);
+    vout.RayV = float3(corner.x / gProj[0][0], corner.y / gProj[1][1], 1.0f);
+    vout.InstanceIndex = instanceIndex;
+
+    return vout;
+}
+
+ImpostorPixel ImpostorPS(ImpostorOutput pin)
+{
+    InstanceData inst = gInstances[pin.InstanceIndex];
+    float3 centerV = mul(float4(inst.World[3], 1.0f), gView).xyz;
+    float radius = length(inst.World[0]);
+
+    // closest hit of the ray.  The distance to the ray comes from the perpendicular vector, the difference
+    // of squares cancels badly for small spheres far away.
+    float3 rayV = normalize(pin.RayV);
+    float tca = dot(rayV, centerV);
+    float3 perpendicular = centerV - tca * rayV;
+    float halfChord2 = radius * radius - dot(perpendicular, perpendicular);
+    float3 posV = (tca - sqrt(max(halfChord2, 0.0f))) * rayV;
+    bool hit = halfChord2 >= 0.0f && dot(centerV, centerV) > radius * radius && posV.z >= gNearZ;
+
+    // missed pixels carry on with the silhouette point, so their neighbours get sane derivatives.
+    float3 normalV = (posV - centerV) / radius;
+    float3 posW = mul(float4(posV, 1.0f), gInvView).xyz;
+    float3 normalW = normalize(mul(normalV, (float3x3)gInvView));
+
+    // CreateSphere's texture coordinates, from the object space normal.
+    const float pi = 3.14159265f;
+    float3 normalL = normalize(mul((float3x3)inst.World, normalW));
+    float theta = atan2(normalL.z, normalL.x);
+    theta = theta < 0.0f ? theta + 2.0f * pi : theta;
+    float2 texC = float2(theta / (2.0f * pi), acos(clamp(normalL.y, -1.0f, 1.0f)) / pi);
+
+    MaterialParameter matParam = gMaterialParameters[inst.MaterialIndex];
+    texC = mul(float4(texC, 0.0f, 1.0f), matParam.MatTransform).xy;
+
+    // u jumps from 1 back to 0 on the seam : derivatives from a copy wrapped half a turn away, whichever is
+    // continuous, so the seam doesn't sample the smallest mip.
+    float2 dx = ddx(texC);
+    float2 dy = ddy(texC);
+    float wrappedU = frac(texC.x + 0.5f);
+    dx.x = abs(ddx(wrappedU)) < abs(dx.x) ? ddx(wrappedU) : dx.x;
+    dy.x = abs(ddy(wrappedU)) < abs(dy.x) ? ddy(wrappedU) : dy.x;
+    float4 texColor = gDiffuseMap[matParam.DiffuseMapIndex].SampleGrad(gsamLinearWrap, texC, dx, dy);
+
+    clip(hit ? 1.0f : -1.0f);
+
+    ImpostorPixel pout;
+    pout.Color = ShadeSurface(inst.MaterialIndex, texColor, posW, normalW);
+    pout.Depth = gProj[2][2] + gProj[3][2] / posV.z;
+    return pout;
+}
+
 
 
 
@@ -12,8 +12,27 @@
 #include "./Helpers/UploadBuffer.h"
 #include "./Helpers/GeometryGenerator.h"
 #include "./Helpers/Camera.h"
+#include "./Helpers/VersionedSlots.h"
+#include "./Helpers/RenderQueue.h"
+#include "./Helpers/CommandStateCache.h"
+#include "./Helpers/UploadManager.h"
+#include "./Helpers/RootSignatureBuilder.h"
+#include "./Helpers/SphereBvh.h"
+#include "./Helpers/OcclusionCulling.h"
+#include "./Helpers/MeshOptimizer.h"
+#include "./Helpers/VertexQuantization.h"
+#include "./Helpers/IndexPacking.h"
+#include "./Helpers/MeshCache.h"
+#include "./Helpers/PlanetTerrain.h"
+#include "./Helpers/TripleBuffer.h"
+#include "./Rhi/RhiCapture.h"
+#include "./Rhi/RhiNull.h"
 #include "FrameBuffer.h"
 
+#include <atomic>
+#include <chrono>
+#include <thread>
+
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
 using namespace DirectX::PackedVector;
@@ -24,6 +43,28 @@ using namespace std;
 
 const int gNumFrameBuffers = 3; // the size of the circular array to store resources per frame
 
+// sphere tessellations from the finest to the coarsest, in slices (stacks are half of them).
+const UINT gSphereLodCount = 5;
+const UINT gSphereLodSlices[gSphereLodCount] = { 128, 64, 32, 16, 8 };
+const UINT gSphereStartLod = 2;		// level the moving items are drawn with until the first selection
+const float gLodPixelError = 0.75f;	// largest distance between a level and the true sphere on screen, in pixels
+const float gLodHysteresis = 0.6f;	// a coarser level has to be under this fraction of it, so levels don't flicker
+const float gImpostorPixelRadius = 3.0f;	// bodies with a smaller radius on screen, in pixels, are drawn as impostors
+const bool gCompactSphereVertices = true;	// the sphere levels are stored as 16 byte CompactVertex rather than Vertex
+const bool gPrefer16BitIndices = true;		// meshes of more than 65536 vertices are split into 16 bit chunks, not drawn with 32 bit indices
+const float gSpacePlaneSize = 300.0f;
+const UINT gSpacePlaneRows = 60;			// vertices along each side of the plane
+const char* const gMeshCacheFileName = "SolarSystem.meshcache";	// the generated geometry, ready for upload, see MeshCache.h
+const UINT gMeshCacheRevision = 1;			// bump when the generators or BuildGeometry change what they produce
+const char* const gTerrainFileName = "SolarSystem.terrain";	// the planets' heights, written on the first run, see TerrainHeights.h
+const UINT gTerrainLevels = 5;				// levels of height tiles in that file
+const UINT gTerrainGridSize = 33;			// vertices along a side of a terrain patch, and heights along a tile
+const float gTerrainHeightScale = 0.01f;	// relief of the planets, in radii
+const UINT gTerrainTriangleBudget = 200000;	// triangles of terrain patches per frame, shared by the planets close enough
+
+const UINT gCaptureFrameCount = 300;					// frames captured by the 'C' key
+const char* const gCaptureFileName = "SolarSystem.rhic";	// written by the 'C' key, replayed by the 'R' key
+
 class RenderItem
 {
 public:
@@ -33,22 +74,50 @@ public:
 	XMFLOAT4X4 World = MathHelper::Identity4x4();
 	XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
 
-	bool isItemStatic = true;
+	bool isItemStatic = true;		// static objects are uploaded once per frame buffer (see mObjectSlots)
 
-	int numFrameBufferFill = gNumFrameBuffers;		// for static objects
-
-	UINT ObjCBIndex = -1;			// object Constant Buffer Index
+	UINT InstanceIndex = -1;		// index of the object in the instance buffer
+	UINT TexTransformIndex = 0;		// index into the texture transform buffer, 0 when TexTransform is the identity
+	XMFLOAT3 Center = { 0.0f, 0.0f, 0.0f };	// world space origin of the object in the current frame, for the depth sort
+	BoundingBox Bounds;				// object space bounds of the submesh, for frustum culling
+	const OccluderMesh* Occluder = nullptr;	// coarse stand-in rasterized for occlusion culling, none for the plane
+	int SphereLod = -1;				// level of the sphere chain drawn, -1 for items with a fixed mesh
+	bool Impostor = false;			// drawn as a shaded square in the impostor batch this frame
+	TerrainQuadtree* Terrain = nullptr;	// the planet's surface patches, none for the sun and the plane
+	bool TerrainActive = false;		// drawn as terrain patches rather than a sphere level this frame
 
 	Material* Mat = nullptr;		// Material characteristics assigned to this render item.	
 	MeshGeometry* Geo = nullptr;	// Geometry data of this render item.
 	D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST; // how the rendering pipeline interprets the input geometry
 
+	// small ids of the pipeline state and geometry, packed into the draw sort key
+	UINT PsoSortId = 0;
+	UINT GeoSortId = 0;
+
 	// parameters of DrawIndexedInstanced method
 	UINT IndexCount = 0;
 	UINT StartIndexLocation = 0;
 	int BaseVertexLocation = 0;
 };
 
+// everything the render stage takes from the simulation for one frame, never modified once published.
+struct FramePacket
+{
+	UINT64 Index = 0;										// simulation step which produced the packet
+	chrono::high_resolution_clock::time_point SimStart;		// when that step began, for the end-to-end latency
+	double SimMicroseconds = 0.0;							// time the step took
+
+	CommonConstants Common;					// camera and lights, the render target size is filled by the render stage
+	XMFLOAT3 EyePosition = { 0.0f, 0.0f, 0.0f };
+	XMFLOAT3 Look = { 0.0f, 0.0f, 1.0f };
+	float FarZ = 1000.0f;
+	float FovY = 0.25f * XM_PI;
+	CullFrustum Frustum;					// world space frustum of the camera, for culling
+	XMFLOAT4X4 ViewProj;					// not transposed, for the occlusion buffer
+
+	vector<InstanceData> Instances;			// moving objects, in mOpaqueDynamicRenderItems order
+};
+
 struct CelestialBody
 {
 	string name;
@@ -77,11 +146,25 @@ private:
 	virtual void OnMouseDown(WPARAM btnState, int x, int y) override;
 	virtual void OnMouseUp(WPARAM btnState, int x, int y) override;
 	virtual void OnMouseMove(WPARAM btnState, int x, int y) override;
+	virtual void OnKeyUp(WPARAM key) override;
 
+	// simulation stage, on the simulation thread : input, camera and motion, published as a FramePacket.
+	virtual void Simulate(const GameTimer& gt) override;
+	virtual bool SimulationReady() override;
 	void OnKeyboardInput(const GameTimer& gt);
-	void UpdateObjectCBs(const GameTimer& gt);			
+	void SimulateObjects(const GameTimer& gt, FramePacket& packet);
+	void SimulateCommonConstants(const GameTimer& gt, FramePacket& packet);
+
+	// render stage, on the main thread : the newest packet goes into the current frame buffer.
+	void UpdateObjectCBs(const FramePacket& packet);			
 	void UpdateMaterialBuffer(const GameTimer& gt);		
-	void UpdateCommonCB(const GameTimer& gt);				
+	void UpdateCommonCB(const FramePacket& packet);				
+	void CullRenderItems(const FramePacket& packet);		// frustum and occlusion cull the opaque items into the visible lists drawn this frame
+	uint32_t OcclusionCull(const FramePacket& packet, uint32_t visibleCount);
+	void SelectLods(const FramePacket& packet);			// pick the sphere level or the impostor of every moving item from its size on screen
+	UINT SphereLodFor(float projectedRadius, UINT current)const;
+	void UpdateTerrain(const FramePacket& packet);		// select the patches of the planets drawn as terrain, build and upload the new ones
+	void ReplayCapture();					// replay the saved capture into the null backend and then against the device, timing both.
 
 
 	void PrepareTextures();
@@ -89,15 +172,28 @@ private:
 	void SetDescriptorHeaps();				// set descriptor heaps for texture resource descriptors.
 	void SetShadersAndInputLayout();		// compile shader source and set input to IA(Input Assembler) of the rendering pipeline.
 	void SetShapeGeometry();				// create and set vertex and index buffers for each object to be rendered.
+	void OptimizeShape(const wstring& name, GeometryGenerator::MeshData& mesh);
+											// reorder a generated mesh for the vertex cache, overdraw and vertex fetch.
+	MeshGeometry* BuildGeometry(const string& name, const vector<pair<string, GeometryGenerator::MeshData*>>& meshes, bool compact);
+											// put meshes into one vertex and index buffer, of Vertex or CompactVertex.
+	uint64_t MeshCacheKey()const;			// hash of every setting the generated geometry depends on
+	bool LoadCachedGeometry(uint64_t key, const vector<string>& names);
+											// upload the named geometries straight from the mapped cache file, false on a miss.
+	void WriteCachedGeometry(uint64_t key, const vector<string>& names);
 	void SetPSOs();							// set pipeline state object for various rendering purpose, this application only needs just one configuration of PSO.
 	void SetFrameBuffers();					// set frame buffers which carry several rendering resources.
 	void SetMaterials();					// set material properties each to-be-rendered object carries.
 	void SetRenderingItems();				// set rendering items to be drawn
-	void DrawRenderingItems(ID3D12GraphicsCommandList* cmdList, const vector<RenderItem*>& ritems);		
-											// draw rendering items using ID3D12GraphicsCommandList::DrawIndexedInstanced(...) method.
+	void SetTerrain();						// open the planets' height file, writing it first if needed, and make the terrain buffers.
+	void SetUploadTracking();				// build the CPU copies of object/material data and their version trackers.
+	void DrawRenderingItems(CommandStateCache& cmdState, const vector<RenderItem*>& ritems);		
+											// sort rendering items by state and depth, then record their draws through the RHI command list.
+	void RecordStaticBundle();				// record the static items into the current frame buffer's bundle.
 
 	std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> GetStaticSamplers();		// prepare static samplers
 
+	virtual wstring FrameStatsText()const override;
+
 private:		
 	
 	vector<unique_ptr<FrameBuffer>> mFrameBuffers;		// it stores resources required for rendering in a circular array.
@@ -107,24 +203,145 @@ private:
 	UINT mCbvSrvDescriptorSize = 0;
 
 	ComPtr<ID3D12RootSignature> mRootSignature = nullptr;
+	unique_ptr<RootSignatureCache> mRootSignatures;		// root signatures created so far, by layout
+
+	// layout of BasicShader.hlsl's bindings and the root parameter index of each of them.
+	RootSignatureBuilder mRootLayout;
+	struct
+	{
+		UINT Draw = 0;
+		UINT Common = 0;
+		UINT Materials = 0;
+		UINT DiffuseMaps = 0;
+		UINT Instances = 0;
+		UINT TexTransforms = 0;
+		UINT Impostors = 0;
+	} mRootParameters;
 	ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap = nullptr;
 
+	unique_ptr<UploadManager> mUploadManager;		// copies textures and geometry on its own copy queue
+
+	// the root signature, srv heap and PSOs as seen by the RHI command list.
+	unique_ptr<RhiRootSignature> mRhiRootSignature;
+	unique_ptr<RhiDescriptorHeap> mRhiSrvDescriptorHeap;
+	unordered_map<string, unique_ptr<RhiPipelineState>> mRhiPSOs;
+
 	unordered_map<string, unique_ptr<MeshGeometry>> mGeometries;		// mesh geometry categorized by name
 	unordered_map<string, unique_ptr<Material>> mMaterials;				// material characteristics categorized by name
 	unordered_map<string, unique_ptr<Texture>> mTextures;				// textures categorized by name
+	vector<Texture*> mDiffuseMaps;										// the textures of gDiffuseMap, in srv heap order
 	unordered_map<string, ComPtr<ID3DBlob>> mShaders;					// compiled shader memory blob
 	unordered_map<string, ComPtr<ID3D12PipelineState>> mPSOs;			// (rendering) pipeline state object
 
 	vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;						// format of data supplied to IA(Input Assembler)
+	vector<D3D12_INPUT_ELEMENT_DESC> mCompactInputLayout;				// the same for geometries of CompactVertex
+	vector<RhiPipelineState*> mItemPsos;								// the PSO of each PsoSortId
 
 	// List of all the rendering items.
 	vector<unique_ptr<RenderItem>> mAllRenderItems;
 
-	// Rendering items divided by PSO.
-	vector<RenderItem*> mOpaqueRenderItems;			// this application only deals with opaque objects
+	// Rendering items divided by PSO, then by motion : static items are drawn from a bundle, moving ones recorded every frame.
+	vector<RenderItem*> mOpaqueStaticRenderItems;		// this application only deals with opaque objects
+	vector<RenderItem*> mOpaqueDynamicRenderItems;
+
+	// version of everything the static bundles are recorded from (static items, their geometry, the PSO and root signature).
+	// whatever changes one of them bumps it, every frame buffer then records its bundle again once.
+	UINT64 mStaticBundleVersion = 1;
+	double mBundleRecordMicroseconds = 0.0;		// time spent recording the static bundle during the last frame
 
 	CommonConstants mCommonCB;
 
+	// CPU copies of the per-object, texture transform and per-material data, indexed by InstanceIndex, TexTransformIndex and MatCBIndex.
+	// Only the ranges a frame buffer holds an older version of are copied into its upload buffers.
+	vector<InstanceData> mInstances;
+	vector<TexTransformData> mTexTransforms;
+	vector<MaterialParameter> mMaterialParameters;
+	VersionedSlots mObjectSlots;
+	VersionedSlots mTexTransformSlots;
+	VersionedSlots mMaterialSlots;
+
+	UINT64 mUploadedBytes = 0;			// bytes written into upload heaps during the last update
+
+	RenderQueue mDrawQueue;				// draws of the current pass ordered by their sort keys
+	CommandStateCache mStateCache;		// drops redundant IA/root bindings while recording
+	CommandStateStats mDrawStats;		// state changes requested/issued during the last frame
+	RhiStateTrackerStats mBarrierStats;	// barriers and barrier batches of the last frame
+	double mSortMicroseconds = 0.0;		// time spent building and sorting the draw queue during the last frame
+
+	// world space bounding spheres of the opaque items, the static ones first then the moving ones in
+	// mOpaqueDynamicRenderItems order.  The static spheres are set once, the moving ones every frame.
+	// the hierarchy over them is refitted as the planets move and answers the frustum query.
+	SphereCullSet mCullSpheres;
+	unique_ptr<WorkerPool> mWorkers;	// worker threads for the hierarchy's large builds and refits
+	unique_ptr<SphereBvh> mSceneBvh;
+	vector<uint32_t> mVisibleIndices;
+	vector<RenderItem*> mVisibleDynamicRenderItems;
+	bool mStaticItemsVisible = true;	// the static bundle is drawn when any of its items is in view
+	UINT mCulledItems = 0;
+
+	// the planets close to the camera are rasterized into mOcclusion and hide what lies behind them.
+	OccluderMesh mSphereOccluder;
+	MaskedOcclusionBuffer mOcclusion;
+	vector<pair<float, uint32_t>> mOccluders;	// distance and cull index of this frame's occluders, nearest first
+	UINT mOccludedItems = 0;
+
+	// the sphere levels of detail, finest first, with the largest distance to the true surface of a unit sphere.
+	SubmeshGeometry mSphereLods[gSphereLodCount];
+	float mSphereLodErrors[gSphereLodCount];
+	UINT mLodTriangles = 0;		// drawn by the visible moving items
+	vector<UINT> mVisibleImpostors;	// gInstances index of the visible bodies drawn as impostors
+	bool mRayTracedSpheres = false;	// 'I' : every moving body is drawn as a ray traced impostor
+
+	// the planets up close : their quadtrees select patches around the eye, the workers build the new ones
+	// from the streamed heights into slots of one vertex buffer.  A slot is only rewritten once the frames
+	// which drew it have completed.
+	struct TerrainSlot
+	{
+		uint64_t Key = ~0ull;		// patch key, planet in bits 48 to 55
+		UINT64 Fence = 0;			// frame fence of the last frame drawing it
+	};
+	struct TerrainBuild
+	{
+		CubeQuadKey Key;
+		const TerrainHeightTile* Tile;
+		UINT Slot;
+	};
+	unique_ptr<TerrainHeightStreamer> mTerrainHeights;
+	TerrainSettings mTerrainSettings;
+	TerrainStitchIndices mTerrainStitch;
+	vector<unique_ptr<TerrainQuadtree>> mTerrainTrees;
+	vector<TerrainSlot> mTerrainSlots;
+	unordered_map<uint64_t, UINT> mTerrainSlotOf;		// slot holding a patch key
+	vector<TerrainBuild> mTerrainBuilds;				// patches built this frame
+	vector<TerrainVertex> mTerrainVertices;				// their vertices, before the upload
+	vector<unique_ptr<RenderItem>> mTerrainRenderItems;	// one per patch drawn, reused every frame
+	vector<RenderItem*> mVisibleTerrainItems;			// visible planets drawn as terrain
+	UINT mTerrainGeoSortId = 0;
+	UINT mTerrainPatches = 0;
+	UINT mTerrainTriangles = 0;
+	UINT mTerrainBuilt = 0;
+	double mCullMicroseconds = 0.0;
+
+	RecordingRhiCommandList mCaptureCommandList;	// records the frame while forwarding it to mRhiCommandList
+	RhiCapture mCapture;
+	UINT mCaptureFramesLeft = 0;
+	wstring mCaptureStatus;
+
+	// simulation to render handoff.  The camera and mSimulationSteps belong to the simulation stage;
+	// the window thread passes mouse motion and the aspect ratio through atomics.
+	TripleBuffer<FramePacket> mPackets;
+	UINT64 mSimulationSteps = 0;
+	atomic<int> mMouseDeltaX{ 0 };		// pixels dragged with the left button, not yet applied to the camera
+	atomic<int> mMouseDeltaY{ 0 };
+	atomic<float> mAspectRatio{ 1.0f };
+	float mCameraAspectRatio = 0.0f;	// aspect ratio of the camera's current lens
+
+	// per-stage CPU times and simulation-to-present latency, smoothed over the last frames
+	chrono::high_resolution_clock::time_point mRenderStart;
+	double mSimMicroseconds = 0.0;
+	double mRenderMicroseconds = 0.0;
+	double mLatencyMicroseconds = 0.0;
+
 	Camera mCamera;		// camera object to compute a view and projection matrix (Camera.h, cpp)
 
 	POINT mLastMousePosition;			// for tracking mouse pointer on the screen.
@@ -159,6 +376,9 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, in
 
 SolarSystem::SolarSystem(HINSTANCE hInstance) : D3DApp(hInstance), mPace(10.0f)
 {
+	// simulate frame N+1 on its own thread while frame N is recorded.
+	mSimulationThreadEnabled = true;
+
 	// Sun
 	solarFamily[0].name = "Sun";
 	solarFamily[0].radius = 10.0f;
@@ -218,7 +438,10 @@ bool SolarSystem::Initialize()
 		return false;
 	}
 	
-	ThrowIfFailed(mCommandList->Reset(D3DApp::mDirectCmdListAlloc.Get(), nullptr));
+	mUploadManager = make_unique<UploadManager>(md3dDevice.Get());
+	mRootSignatures = make_unique<RootSignatureCache>(md3dDevice.Get());
+	mWorkers = make_unique<WorkerPool>();
+	mSceneBvh = make_unique<SphereBvh>(mWorkers.get());
 
 	// Get a descriptor byte size in desciptor heap
 	mCbvSrvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
@@ -232,15 +455,14 @@ bool SolarSystem::Initialize()
 	SetShapeGeometry();
 	SetMaterials();
 	SetRenderingItems();
+	SetTerrain();
+	SetUploadTracking();
 	SetFrameBuffers();
 	SetPSOs();
 
-	// initialize the above settings.
-	ThrowIfFailed(mCommandList->Close());
-	ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
-	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
-
-	FlushCommandQueue();
+	// textures and geometry are copied on the upload manager's copy queue.
+	// the graphics queue waits for the batch on the GPU, the CPU goes on without flushing.
+	mUploadManager->WaitOnQueue(mCommandQueue.Get(), mUploadManager->Submit());
 
 	return true;			// initialization is done.
 }
@@ -251,13 +473,21 @@ void SolarSystem::OnResize()
 {
 	D3DApp::OnResize();
 
-	// reset the field of view upon resize of the window.
-	mCamera.SetLens(0.25f * XM_PI, AspectRatio(), 1.0f, 1000.0f);		// view angle : pi/4
+	// reset the field of view upon resize of the window, the simulation stage applies it to the camera.
+	mAspectRatio.store(AspectRatio());
 }
 
 void SolarSystem::Update(const GameTimer& gt)
 {
-	OnKeyboardInput(gt);
+	mRenderStart = chrono::high_resolution_clock::now();
+
+	// take the newest frame packet.  The simulation runs at most one step ahead, so this wait is short,
+	// and without a simulation thread D3DApp::Run has just produced the packet.
+	while (!mPackets.Acquire())
+	{
+		this_thread::yield();
+	}
+	const FramePacket& packet = mPackets.ReadBuffer();
 
 	// access the frame buffer in a circular way.
 	mCurrentFrameBufferIndex = (mCurrentFrameBufferIndex + 1) % gNumFrameBuffers;
@@ -272,9 +502,14 @@ void SolarSystem::Update(const GameTimer& gt)
 		CloseHandle(eventHandle);
 	}
 
-	UpdateObjectCBs(gt);
+	mUploadedBytes = 0;
+
+	UpdateObjectCBs(packet);
 	UpdateMaterialBuffer(gt);
-	UpdateCommonCB(gt);
+	UpdateCommonCB(packet);
+	CullRenderItems(packet);
+	SelectLods(packet);
+	UpdateTerrain(packet);
 }
 
 void SolarSystem::Draw(const GameTimer& gt)
@@ -283,50 +518,112 @@ void SolarSystem::Draw(const GameTimer& gt)
 
 	ThrowIfFailed(cmdListAlloc->Reset());
 
-	ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), mPSOs["opaque"].Get()));
-
-	mCommandList->RSSetViewports(1, &mScreenViewport);
-	mCommandList->RSSetScissorRects(1, &mScissorRect);
-
-	// Indicate a state transition on the resource usage.
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
-		D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
+	// commands are recorded through the RHI, the D3D12 backend resets mCommandList with the frame buffer's allocator.
+	RhiCommandList* cmdList = mRhiCommandList.get();
+	if (mCaptureFramesLeft > 0)
+	{
+		mCaptureCommandList.SetTarget(cmdList);
+		cmdList = &mCaptureCommandList;
+	}
+	RhiPipelineState* opaquePso = mRhiPSOs["opaque"].get();
+	mRhiCommandList->SetAllocator(cmdListAlloc.Get());
+
+	cmdList->Begin(opaquePso);
+	RhiResourceStateTracker& barriers = mRhiCommandListStates;
+	barriers.Begin(cmdList);
+	mStateCache.Begin(cmdList, opaquePso, &barriers);
+
+	RhiViewport viewport = ToRhi(mScreenViewport);
+	RhiRect scissorRect = ToRhi(mScissorRect);
+	cmdList->RSSetViewports(1, &viewport);
+	cmdList->RSSetScissorRects(1, &scissorRect);
+
+	// the tracker knows the state both buffers were left in, their transitions go out as one batch before the clears.
+	// none of the frame's transitions is split (BeginSplitTransition) : the clear needs the back buffer right away,
+	// the last draw writes it just before it goes to Present, and the depth buffer never leaves DepthWrite.
+	barriers.Transition(CurrentBackBufferRhi(), RhiResourceState::RenderTarget);
+	barriers.Transition(mRhiDepthStencilBuffer.get(), RhiResourceState::DepthWrite);
+	barriers.Flush();
 
 	// clear the back buffer and depth buffer.
-	mCommandList->ClearRenderTargetView(CurrentBackBufferView(), Colors::Black, 0, nullptr);
-	mCommandList->ClearDepthStencilView(DepthStencilView(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
+	RhiCpuDescriptor backBufferView = ToRhi(CurrentBackBufferView());
+	RhiCpuDescriptor depthStencilView = ToRhi(DepthStencilView());
+	cmdList->ClearRenderTargetView(backBufferView, Colors::Black);
+	cmdList->ClearDepthStencilView(depthStencilView, RhiClearFlags::DepthStencil, 1.0f, 0);
 
 	// specify the buffers we are going to render to.
-	mCommandList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, &DepthStencilView());
+	cmdList->OMSetRenderTargets(1, &backBufferView, &depthStencilView);
 
 	// combine shader resource descriptor heap to the command list.
-	ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvDescriptorHeap.Get() };
-	mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+	RhiDescriptorHeap* descriptorHeaps[] = { mRhiSrvDescriptorHeap.get() };
+	cmdList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
 
-	mCommandList->SetGraphicsRootSignature(mRootSignature.Get());
+	mStateCache.SetGraphicsRootSignature(mRhiRootSignature.get());
 
 	auto commonCB = mCurrentFrameBuffer->CommonCB->Resource();
-	mCommandList->SetGraphicsRootConstantBufferView(1, commonCB->GetGPUVirtualAddress());
+	mStateCache.SetGraphicsRootConstantBufferView(mRootParameters.Common, commonCB->GetGPUVirtualAddress());
 
 	// bind all the materials used in this application. (structured buffers in hlsl)
 	auto matBuffer = mCurrentFrameBuffer->MaterialBuffer->Resource();
-	mCommandList->SetGraphicsRootShaderResourceView(2, matBuffer->GetGPUVirtualAddress());  // slotRootParameters[2].InitAsShaderResourceView(0, 1)
+	mStateCache.SetGraphicsRootShaderResourceView(mRootParameters.Materials, matBuffer->GetGPUVirtualAddress());
+
+	// bind the per-object instance data and texture transforms. (structured buffers in hlsl)
+	auto instanceBuffer = mCurrentFrameBuffer->InstanceBuffer->Resource();
+	mStateCache.SetGraphicsRootShaderResourceView(mRootParameters.Instances, instanceBuffer->GetGPUVirtualAddress());
+	auto texTransformBuffer = mCurrentFrameBuffer->TexTransformBuffer->Resource();
+	mStateCache.SetGraphicsRootShaderResourceView(mRootParameters.TexTransforms, texTransformBuffer->GetGPUVirtualAddress());
 
 	// bind all the textures used in this scene.
-	mCommandList->SetGraphicsRootDescriptorTable(3, mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
+	mStateCache.SetGraphicsRootDescriptorTable(mRootParameters.DiffuseMaps, mRhiSrvDescriptorHeap->GpuStart());
+
+	// the static items are replayed with one call, the bundle is only recorded when its inputs changed.
+	mBundleRecordMicroseconds = 0.0;
+	if (mCurrentFrameBuffer->StaticBundleVersion != mStaticBundleVersion)
+	{
+		RecordStaticBundle();
+	}
+	if (mStaticItemsVisible)
+	{
+		mStateCache.ExecuteBundle(mCurrentFrameBuffer->StaticBundle.get());
+	}
+
+	DrawRenderingItems(mStateCache, mVisibleDynamicRenderItems);
+
+	// the impostors, all in one instanced draw of a 4 vertex strip.
+	if (!mVisibleImpostors.empty())
+	{
+		auto impostorBuffer = mCurrentFrameBuffer->ImpostorBuffer->Resource();
+		mStateCache.SetPipelineState(mRhiPSOs["impostor"].get());
+		mStateCache.SetGraphicsRootShaderResourceView(mRootParameters.Impostors, impostorBuffer->GetGPUVirtualAddress());
+		mStateCache.IASetPrimitiveTopology(RhiPrimitiveTopology::TriangleStrip);
+		mStateCache.DrawInstanced(4, (UINT)mVisibleImpostors.size(), 0, 0);
+	}
 
-	DrawRenderingItems(mCommandList.Get(), mOpaqueRenderItems);
+	mDrawStats = mStateCache.Stats();
 
-	// Indicate a state transition on the resource usage.
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
-		D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
+	barriers.Transition(CurrentBackBufferRhi(), RhiResourceState::Present);
+	barriers.End();
+	mBarrierStats = barriers.Stats();
 
 	// Done recording commands.
-	ThrowIfFailed(mCommandList->Close());
+	cmdList->End();
+
+	if (cmdList == &mCaptureCommandList)
+	{
+		mCapture.AddFrame(mCaptureCommandList.Stream().data(), mCaptureCommandList.Stream().size());
+		mCaptureCommandList.Clear();
+
+		if (--mCaptureFramesLeft == 0)
+		{
+			bool saved = mCapture.Save(gCaptureFileName);
+			mCaptureStatus = L"   capture: " + to_wstring(mCapture.FrameCount()) + L" frames, " +
+				to_wstring(mCapture.ByteSize()) + (saved ? L" B saved" : L" B, save failed");
+		}
+	}
 
 	// Add the command list to the queue for execution.
-	ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
-	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+	RhiCommandList* cmdsLists[] = { mRhiCommandList.get() };
+	mRhiDevice->Queue(RhiQueueType::Direct)->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
 
 	// Swap the back and front buffers
 	ThrowIfFailed(mSwapChain->Present(0, 0));
@@ -336,6 +633,14 @@ void SolarSystem::Draw(const GameTimer& gt)
 	mCurrentFrameBuffer->Fence = ++mCurrentFence;
 
 	mCommandQueue->Signal(mFence.Get(), mCurrentFence);
+
+	// stage times, and the latency from the start of the simulation step to the present of its frame.
+	const FramePacket& packet = mPackets.ReadBuffer();
+	auto presentTime = chrono::high_resolution_clock::now();
+	const double smoothing = 0.05;
+	mSimMicroseconds += (packet.SimMicroseconds - mSimMicroseconds) * smoothing;
+	mRenderMicroseconds += (chrono::duration<double, micro>(presentTime - mRenderStart).count() - mRenderMicroseconds) * smoothing;
+	mLatencyMicroseconds += (chrono::duration<double, micro>(presentTime - packet.SimStart).count() - mLatencyMicroseconds) * smoothing;
 }
 
 void SolarSystem::OnMouseDown(WPARAM btnState, int x, int y)
@@ -356,19 +661,71 @@ void SolarSystem::OnMouseMove(WPARAM btnState, int x, int y)
 {
 	if ((btnState & MK_LBUTTON) != 0)
 	{
-		// Make each pixel correspond to a quarter of a degree.
-		float dx = XMConvertToRadians(0.25f * static_cast<float>(x - mLastMousePosition.x));
-		float dy = XMConvertToRadians(0.25f * static_cast<float>(y - mLastMousePosition.y));
-
-		// rotate the camera in pitch, yaw direction
-		mCamera.Pitch(dy);	
-		mCamera.RotateY(dx);
+		// the camera belongs to the simulation stage, it applies the motion on its next step.
+		mMouseDeltaX.fetch_add(x - mLastMousePosition.x);
+		mMouseDeltaY.fetch_add(y - mLastMousePosition.y);
 	}
 	// update the mouse position with the new input
 	mLastMousePosition.x = x;
 	mLastMousePosition.y = y;
 }
 
+void SolarSystem::OnKeyUp(WPARAM key)
+{
+	if (key == 'C' && mCaptureFramesLeft == 0)
+	{
+		mCapture.Clear();
+		mCaptureFramesLeft = gCaptureFrameCount;
+		mCaptureStatus = L"   capturing...";
+	}
+	else if (key == 'R' && mCaptureFramesLeft == 0)
+	{
+		ReplayCapture();
+	}
+	else if (key == 'I')
+	{
+		mRayTracedSpheres = !mRayTracedSpheres;
+	}
+}
+
+// ---------- simulation stage ----------
+bool SolarSystem::SimulationReady()
+{
+	// one step ahead at most : the next packet is computed once the render stage took the previous one.
+	return !mPackets.Pending();
+}
+
+void SolarSystem::Simulate(const GameTimer& gt)
+{
+	auto simStart = chrono::high_resolution_clock::now();
+
+	float aspectRatio = mAspectRatio.load();
+	if (aspectRatio != mCameraAspectRatio)
+	{
+		mCamera.SetLens(0.25f * XM_PI, aspectRatio, 1.0f, 1000.0f);		// view angle : pi/4
+		mCameraAspectRatio = aspectRatio;
+	}
+
+	// Make each pixel correspond to a quarter of a degree.
+	float dx = XMConvertToRadians(0.25f * static_cast<float>(mMouseDeltaX.exchange(0)));
+	float dy = XMConvertToRadians(0.25f * static_cast<float>(mMouseDeltaY.exchange(0)));
+
+	// rotate the camera in pitch, yaw direction
+	mCamera.Pitch(dy);
+	mCamera.RotateY(dx);
+
+	OnKeyboardInput(gt);
+
+	FramePacket& packet = mPackets.WriteBuffer();
+	SimulateObjects(gt, packet);
+	SimulateCommonConstants(gt, packet);
+
+	packet.Index = ++mSimulationSteps;
+	packet.SimStart = simStart;
+	packet.SimMicroseconds = chrono::duration<double, micro>(chrono::high_resolution_clock::now() - simStart).count();
+	mPackets.Publish();
+}
+
 void SolarSystem::OnKeyboardInput(const GameTimer& gt)
 {
 	const float dt = gt.DeltaTime();
@@ -393,316 +750,719 @@ void SolarSystem::OnKeyboardInput(const GameTimer& gt)
 	mCamera.UpdateViewMatrix();
 }
 
-void SolarSystem::UpdateObjectCBs(const GameTimer& gt)
+void SolarSystem::SimulateObjects(const GameTimer& gt, FramePacket& packet)
 {
-	static float t_base = 0.0f;
-	t_base += gt.DeltaTime();
+	float t_base = gt.TotalTime();
 
-	auto currObjectCB = mCurrentFrameBuffer->ObjectCB.get();
-	size_t i = 0;
+	packet.Instances.resize(mOpaqueDynamicRenderItems.size());
+	for (size_t i = 0; i < mOpaqueDynamicRenderItems.size(); ++i)
+	{
+		const RenderItem* ri = mOpaqueDynamicRenderItems[i];
 
-	for (auto& elem : mAllRenderItems)
+		XMMATRIX world = XMLoadFloat4x4(&ri->World);
+		float spinRate = solarFamily[i].spinRate;
+		float orbitRate = solarFamily[i].orbitRate;
+		float orbitSize = solarFamily[i].orbitSize;
+
+		// world matrix of planetary motion
+		world = world * XMMatrixRotationY(spinRate * t_base) * XMMatrixTranslation(orbitSize, 10.0f, 0) * XMMatrixRotationY(orbitRate * t_base);
+
+		// the affine part is stored as it is (row_major float4x3 in hlsl), no transpose required.
+		InstanceData& inst = packet.Instances[i];
+		XMStoreFloat4x3(&inst.World, world);
+		inst.MaterialIndex = ri->Mat->MatCBIndex;
+	}
+}
+
+// ---------- render stage ----------
+void SolarSystem::UpdateObjectCBs(const FramePacket& packet)
+{
+	// static objects keep their data in mInstances from SetUploadTracking() and are copied only into the
+	// frame buffers holding an older version of them.  This runs first so it never overwrites the moving objects below.
+	auto currInstanceBuffer = mCurrentFrameBuffer->InstanceBuffer.get();
+	for (const auto& range : mObjectSlots.Sync(mCurrentFrameBufferIndex))
+	{
+		mUploadedBytes += currInstanceBuffer->CopyData(range.First, &mInstances[range.First], range.Count);
+	}
+
+	// moving objects change every frame, the packet's copy goes straight into the mapped instance buffer.
+	// whole structures are stored and never read back, the memory is write-combined.
+	MappedSpan<InstanceData> instances = currInstanceBuffer->Span(0, (UINT)mInstances.size());
+	for (size_t i = 0; i < mOpaqueDynamicRenderItems.size(); ++i)
+	{
+		RenderItem* ri = mOpaqueDynamicRenderItems[i];
+		const InstanceData& inst = packet.Instances[i];
+
+		instances[ri->InstanceIndex] = inst;
+		ri->Center = XMFLOAT3(inst.World._41, inst.World._42, inst.World._43);
+
+		// the world matrix is rebuilt from its affine part to move the bounding sphere along.
+		XMMATRIX world = XMMatrixSet(
+			inst.World._11, inst.World._12, inst.World._13, 0.0f,
+			inst.World._21, inst.World._22, inst.World._23, 0.0f,
+			inst.World._31, inst.World._32, inst.World._33, 0.0f,
+			inst.World._41, inst.World._42, inst.World._43, 1.0f);
+		BoundingSphere sphere;
+		BoundingSphere::CreateFromBoundingBox(sphere, ri->Bounds);
+		sphere.Transform(sphere, world);
+		mCullSpheres.Set(mOpaqueStaticRenderItems.size() + i, sphere.Center.x, sphere.Center.y, sphere.Center.z, sphere.Radius);
+	}
+	mUploadedBytes += sizeof(InstanceData) * packet.Instances.size();
+
+	auto currTexTransformBuffer = mCurrentFrameBuffer->TexTransformBuffer.get();
+	for (const auto& range : mTexTransformSlots.Sync(mCurrentFrameBufferIndex))
+	{
+		mUploadedBytes += currTexTransformBuffer->CopyData(range.First, &mTexTransforms[range.First], range.Count);
+	}
+}
+
+void SolarSystem::UpdateMaterialBuffer(const GameTimer& gt)
+{
+	auto currentMaterialBuffer = mCurrentFrameBuffer->MaterialBuffer.get();
+
+	for (const auto& range : mMaterialSlots.Sync(mCurrentFrameBufferIndex))
 	{
-		if (elem->isItemStatic == false)	// for non-static objects
+		mUploadedBytes += currentMaterialBuffer->CopyData(range.First, &mMaterialParameters[range.First], range.Count);
+	}
+}
+
+void SolarSystem::SimulateCommonConstants(const GameTimer& gt, FramePacket& packet)
+{
+	CommonConstants& common = packet.Common;
+
+	XMMATRIX view = mCamera.GetView();
+	XMMATRIX proj = mCamera.GetProj();
+
+	XMMATRIX viewProj = XMMatrixMultiply(view, proj);
+	XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
+	XMMATRIX invProj = XMMatrixInverse(&XMMatrixDeterminant(proj), proj);
+	XMMATRIX invViewProj = XMMatrixInverse(&XMMatrixDeterminant(viewProj), viewProj);
+
+	XMStoreFloat4x4(&common.View, XMMatrixTranspose(view));
+	XMStoreFloat4x4(&common.InvView, XMMatrixTranspose(invView));
+	XMStoreFloat4x4(&common.Proj, XMMatrixTranspose(proj));
+	XMStoreFloat4x4(&common.InvProj, XMMatrixTranspose(invProj));
+	XMStoreFloat4x4(&common.ViewProj, XMMatrixTranspose(viewProj));
+	XMStoreFloat4x4(&packet.ViewProj, viewProj);
+	XMStoreFloat4x4(&common.InvViewProj, XMMatrixTranspose(invViewProj));
+	common.CameraPosW = mCamera.GetPosition3f();
+	common.NearZ = 1.0f;
+	common.FarZ = 1000.0f;
+	common.TotalTime = gt.TotalTime();
+	common.DeltaTime = gt.DeltaTime();
+	common.AmbientLight = { 0.25f, 0.25f, 0.35f, 1.0f };
+
+	// three directional light sources illuminate the scene at which the camera is focused.
+	common.Lights[0].Direction = { 0.57735f, -0.57735f, 0.57735f };
+	common.Lights[0].Strength = { 0.8f, 0.8f, 0.8f };
+	common.Lights[1].Direction = { -0.57735f, -0.57735f, 0.57735f };
+	common.Lights[1].Strength = { 0.4f, 0.4f, 0.4f };
+	common.Lights[2].Direction = { 0.0f, -0.707f, -0.707f };
+	common.Lights[2].Strength = { 0.2f, 0.2f, 0.2f };
+
+	// what the render stage needs of the camera for the depth sort.
+	packet.EyePosition = mCamera.GetPosition3f();
+	packet.Look = mCamera.GetLook3f();
+	packet.FarZ = mCamera.GetFarZ();
+	packet.FovY = mCamera.GetFovY();
+	packet.Frustum = mCamera.GetFrustum();
+}
+
+void SolarSystem::CullRenderItems(const FramePacket& packet)
+{
+	auto cullStart = chrono::high_resolution_clock::now();
+
+	// refit to this frame's positions (built on the first call), then walk the hierarchy.
+	mSceneBvh->Update(mCullSpheres);
+
+	mVisibleIndices.resize(mCullSpheres.PaddedSize());
+	uint32_t visibleCount = mSceneBvh->QueryFrustum(packet.Frustum, mVisibleIndices.data());
+	uint32_t inFrustumCount = visibleCount;
+	visibleCount = OcclusionCull(packet, visibleCount);
+	mOccludedItems = inFrustumCount - visibleCount;
+
+	// indices below staticCount are static items, the others moving ones.
+	uint32_t staticCount = (uint32_t)mOpaqueStaticRenderItems.size();
+	mStaticItemsVisible = false;
+	mVisibleDynamicRenderItems.clear();
+	for (uint32_t i = 0; i < visibleCount; ++i)
+	{
+		uint32_t index = mVisibleIndices[i];
+		if (index < staticCount)
 		{
-			XMMATRIX world = XMLoadFloat4x4(&elem->World);
-			float spinRate = solarFamily[i].spinRate;
-			float orbitRate = solarFamily[i].orbitRate;
-			float orbitSize = solarFamily[i].orbitSize;
+			mStaticItemsVisible = true;
+		}
+		else
+		{
+			mVisibleDynamicRenderItems.push_back(mOpaqueDynamicRenderItems[index - staticCount]);
+		}
+	}
+	mCulledItems = (UINT)mCullSpheres.Size() - visibleCount;
+
+	mCullMicroseconds = chrono::duration<double, micro>(chrono::high_resolution_clock::now() - cullStart).count();
+}
 
-			i++;
+void SolarSystem::SelectLods(const FramePacket& packet)
+{
+	// pixels covered by one world unit at distance one.
+	float pixelsPerUnit = 0.5f * mClientHeight / tanf(0.5f * packet.FovY);
+	XMVECTOR eye = XMLoadFloat3(&packet.EyePosition);
 
-			// world matrix of planetary motion
-			world = world * XMMatrixRotationY(spinRate * t_base) * XMMatrixTranslation(orbitSize, 10.0f, 0) * XMMatrixRotationY(orbitRate * t_base);
-			XMMATRIX texTransform = XMLoadFloat4x4(&elem->TexTransform);
+	for (size_t i = 0; i < mOpaqueDynamicRenderItems.size(); ++i)
+	{
+		RenderItem* ri = mOpaqueDynamicRenderItems[i];
+		if (ri->SphereLod < 0)
+		{
+			continue;
+		}
 
-			ObjectConstants objConstants;
-			XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
-			XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(texTransform));
-			objConstants.MaterialIndex = elem->Mat->MatCBIndex;
+		// radius from the scale of the world matrix, distance to the nearest point of the surface.
+		const XMFLOAT4X3& world = packet.Instances[i].World;
+		float radius = XMVectorGetX(XMVector3Length(XMVectorSet(world._11, world._12, world._13, 0.0f)));
+		float distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&ri->Center) - eye)) - radius;
+		float projectedRadius = radius * pixelsPerUnit / MathHelper::Max(distance, 0.001f);
 
-			currObjectCB->CopyData(elem->ObjCBIndex, objConstants);
+		// tiny bodies become impostors, and go back to a mesh once clearly larger than that.  The impostors are
+		// ray traced, so mRayTracedSpheres can draw every body that way whatever its size.
+		float impostorRadius = ri->Impostor ? gImpostorPixelRadius / gLodHysteresis : gImpostorPixelRadius;
+		ri->Impostor = mRayTracedSpheres || projectedRadius < impostorRadius;
+
+		// past the finest level the planet's terrain takes over, and hands back once that level is well enough.
+		if (ri->Terrain)
+		{
+			float terrainError = ri->TerrainActive ? gLodPixelError * gLodHysteresis : gLodPixelError;
+			ri->TerrainActive = !ri->Impostor && mSphereLodErrors[0] * projectedRadius > terrainError;
 		}
-		else		// for static objects
+
+		UINT lod = SphereLodFor(projectedRadius, (UINT)ri->SphereLod);
+		if (lod != (UINT)ri->SphereLod)
 		{
-			if (elem->numFrameBufferFill > 0)
-			{
-				XMMATRIX world = XMLoadFloat4x4(&elem->World);
-				XMMATRIX texTransform = XMLoadFloat4x4(&elem->TexTransform);
-				ObjectConstants objConstants;
-				XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
-				XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(texTransform));
-				objConstants.MaterialIndex = elem->Mat->MatCBIndex;
-
-				currObjectCB->CopyData(elem->ObjCBIndex, objConstants);
-				elem->numFrameBufferFill--;
-			}
+			ri->SphereLod = (int)lod;
+			ri->IndexCount = mSphereLods[lod].IndexCount;
+			ri->StartIndexLocation = mSphereLods[lod].StartIndexLocation;
+			ri->BaseVertexLocation = mSphereLods[lod].BaseVertexLocation;
+			ri->Bounds = mSphereLods[lod].Bounds;
+		}
+	}
+
+	// the visible impostors leave the mesh list for the instanced draw, the planets drawn as terrain for UpdateTerrain.
+	mVisibleImpostors.clear();
+	mVisibleTerrainItems.clear();
+	mLodTriangles = 0;
+	size_t meshCount = 0;
+	for (RenderItem* ri : mVisibleDynamicRenderItems)
+	{
+		if (ri->Impostor)
+		{
+			mVisibleImpostors.push_back(ri->InstanceIndex);
 		}
+		else if (ri->TerrainActive)
+		{
+			mVisibleTerrainItems.push_back(ri);
+		}
+		else
+		{
+			mVisibleDynamicRenderItems[meshCount++] = ri;
+			mLodTriangles += ri->IndexCount / 3;
+		}
+	}
+	mVisibleDynamicRenderItems.resize(meshCount);
+
+	if (!mVisibleImpostors.empty())
+	{
+		auto impostorBuffer = mCurrentFrameBuffer->ImpostorBuffer.get();
+		mUploadedBytes += impostorBuffer->CopyData(0, mVisibleImpostors.data(), (UINT)mVisibleImpostors.size());
 	}
 }
 
-void SolarSystem::UpdateMaterialBuffer(const GameTimer& gt)
+void SolarSystem::UpdateTerrain(const FramePacket& packet)
 {
-	auto currentMaterialBuffer = mCurrentFrameBuffer->MaterialBuffer.get();
+	mTerrainPatches = 0;
+	mTerrainTriangles = 0;
+	mTerrainBuilt = 0;
+	if (mVisibleTerrainItems.empty())
+	{
+		if (mTerrainHeights)
+		{
+			mTerrainHeights->Update();
+		}
+		return;
+	}
 
-	for (auto& elem : mMaterials)
+	// a child patch can be drawn once the tile it takes its heights from is resident, until then its
+	// parent stays.  Asking also keeps the tile from being evicted.
+	auto dataReady = [this](const CubeQuadKey& key)
 	{
-		Material* mat = elem.second.get();
-		if (mat->NumFramesDirty > 0)
+		return mTerrainHeights->Request(key.Ancestor(min(key.Level, mTerrainHeights->LevelCount() - 1))) != nullptr;
+	};
+
+	// the slots no frame in flight draws any more, the longest unused first.
+	const UINT64 completedFence = mFence->GetCompletedValue();
+	const UINT64 frameFence = mCurrentFence + 1;		// signaled by Draw for this frame
+	vector<UINT> freeSlots;
+	for (UINT slot = 0; slot < (UINT)mTerrainSlots.size(); ++slot)
+	{
+		if (mTerrainSlots[slot].Fence <= completedFence)
 		{
-			XMMATRIX matTransform = XMLoadFloat4x4(&mat->MatTransform);
+			freeSlots.push_back(slot);
+		}
+	}
+	sort(freeSlots.begin(), freeSlots.end(), [this](UINT a, UINT b) { return mTerrainSlots[a].Fence > mTerrainSlots[b].Fence; });
 
-			MaterialParameter matParam;
-			matParam.DiffuseAlbedo = mat->DiffuseAlbedo;
-			matParam.FresnelR0 = mat->FresnelR0;
-			matParam.Roughness = mat->Roughness;
-			XMStoreFloat4x4(&matParam.MatTransform, XMMatrixTranspose(matTransform));
-			matParam.DiffuseMapIndex = mat->DiffuseSrvHeapIndex;
+	const UINT vertexCount = gTerrainGridSize * gTerrainGridSize;
+	const UINT planetBudget = gTerrainTriangleBudget / (UINT)mVisibleTerrainItems.size();
+	mTerrainBuilds.clear();
+	for (size_t i = 0; i < mOpaqueDynamicRenderItems.size(); ++i)
+	{
+		RenderItem* planet = mOpaqueDynamicRenderItems[i];
+		if (!planet->TerrainActive || find(mVisibleTerrainItems.begin(), mVisibleTerrainItems.end(), planet) == mVisibleTerrainItems.end())
+		{
+			continue;
+		}
+
+		// the eye in the planet's object space, where its surface is the unit sphere.
+		const XMFLOAT4X3& w = packet.Instances[i].World;
+		XMMATRIX world = XMMatrixSet(
+			w._11, w._12, w._13, 0.0f,
+			w._21, w._22, w._23, 0.0f,
+			w._31, w._32, w._33, 0.0f,
+			w._41, w._42, w._43, 1.0f);
+		XMVECTOR determinant;
+		XMFLOAT3 localEye;
+		XMStoreFloat3(&localEye, XMVector3TransformCoord(XMLoadFloat3(&packet.EyePosition), XMMatrixInverse(&determinant, world)));
+		float eye[3] = { localEye.x, localEye.y, localEye.z };
+		const vector<TerrainPatch>& patches = planet->Terrain->Select(eye, planetBudget, dataReady);
+
+		// without enough free slots for its new patches, which the pool is sized against, the planet keeps its sphere.
+		uint64_t planetBits = (uint64_t)i << 48;
+		size_t missing = 0;
+		for (const TerrainPatch& patch : patches)
+		{
+			missing += mTerrainSlotOf.count(patch.Key.Packed() | planetBits) == 0 ? 1 : 0;
+		}
+		if (missing > freeSlots.size())
+		{
+			mVisibleDynamicRenderItems.push_back(planet);
+			mLodTriangles += planet->IndexCount / 3;
+			continue;
+		}
+
+		for (const TerrainPatch& patch : patches)
+		{
+			uint64_t key = patch.Key.Packed() | planetBits;
+			auto it = mTerrainSlotOf.find(key);
+			UINT slot;
+			if (it != mTerrainSlotOf.end())
+			{
+				slot = it->second;
+				freeSlots.erase(remove(freeSlots.begin(), freeSlots.end(), slot), freeSlots.end());
+			}
+			else
+			{
+				slot = freeSlots.back();
+				freeSlots.pop_back();
+				mTerrainSlotOf.erase(mTerrainSlots[slot].Key);
+				mTerrainSlots[slot].Key = key;
+				mTerrainSlotOf[key] = slot;
+				mTerrainBuilds.push_back({ patch.Key, mTerrainHeights->Covering(patch.Key), slot });
+			}
+			mTerrainSlots[slot].Fence = frameFence;
+
+			// the patch is drawn like the planet, with the triangles stitching it to its coarser neighbours.
+			if (mTerrainPatches == mTerrainRenderItems.size())
+			{
+				mTerrainRenderItems.push_back(make_unique<RenderItem>());
+			}
+			RenderItem* ri = mTerrainRenderItems[mTerrainPatches++].get();
+			ri->isItemStatic = false;
+			ri->InstanceIndex = planet->InstanceIndex;
+			ri->TexTransformIndex = planet->TexTransformIndex;
+			ri->Center = planet->Center;
+			ri->Mat = planet->Mat;
+			ri->Geo = mGeometries["terrainGeo"].get();
+			ri->GeoSortId = mTerrainGeoSortId;
+			ri->PsoSortId = 0;
+			ri->IndexCount = mTerrainStitch.Count[patch.StitchMask];
+			ri->StartIndexLocation = mTerrainStitch.Start[patch.StitchMask];
+			ri->BaseVertexLocation = (int)(slot * vertexCount);
+			mVisibleDynamicRenderItems.push_back(ri);
+			mTerrainTriangles += ri->IndexCount / 3;
+		}
+	}
 
-			currentMaterialBuffer->CopyData(mat->MatCBIndex, matParam);
+	// the new patches are built in parallel and copied into their slots on the upload queue.
+	if (!mTerrainBuilds.empty())
+	{
+		mTerrainVertices.resize(mTerrainBuilds.size() * vertexCount);
+		mWorkers->Run((uint32_t)mTerrainBuilds.size(), [this, vertexCount](uint32_t b)
+		{
+			BuildTerrainPatch(mTerrainBuilds[b].Key, mTerrainSettings, *mTerrainBuilds[b].Tile, &mTerrainVertices[b * vertexCount]);
+		});
 
-			mat->NumFramesDirty--;
+		ID3D12Resource* vertexBuffer = mGeometries["terrainGeo"]->VertexBufferGPU.Get();
+		for (size_t b = 0; b < mTerrainBuilds.size(); ++b)
+		{
+			mUploadManager->UploadBuffer(vertexBuffer, (UINT64)mTerrainBuilds[b].Slot * vertexCount * sizeof(TerrainVertex),
+				&mTerrainVertices[b * vertexCount], vertexCount * sizeof(TerrainVertex));
 		}
+		mUploadManager->WaitOnQueue(mCommandQueue.Get(), mUploadManager->Submit());
+		mTerrainBuilt = (UINT)mTerrainBuilds.size();
 	}
+
+	mTerrainHeights->Update();
 }
 
-void SolarSystem::UpdateCommonCB(const GameTimer& gt)
+UINT SolarSystem::SphereLodFor(float projectedRadius, UINT current)const
 {
-	XMMATRIX view = mCamera.GetView();
-	XMMATRIX proj = mCamera.GetProj();
+	// finer levels as soon as the current one is over the error budget...
+	UINT lod = current;
+	while (lod > 0 && mSphereLodErrors[lod] * projectedRadius > gLodPixelError)
+	{
+		--lod;
+	}
 
-	XMMATRIX viewProj = XMMatrixMultiply(view, proj);
-	XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
-	XMMATRIX invProj = XMMatrixInverse(&XMMatrixDeterminant(proj), proj);
-	XMMATRIX invViewProj = XMMatrixInverse(&XMMatrixDeterminant(viewProj), viewProj);
+	// ...coarser ones only once they are well under it.
+	if (lod == current)
+	{
+		while (lod + 1 < gSphereLodCount && mSphereLodErrors[lod + 1] * projectedRadius <= gLodPixelError * gLodHysteresis)
+		{
+			++lod;
+		}
+	}
+	return lod;
+}
 
-	XMStoreFloat4x4(&mCommonCB.View, XMMatrixTranspose(view));
-	XMStoreFloat4x4(&mCommonCB.InvView, XMMatrixTranspose(invView));
-	XMStoreFloat4x4(&mCommonCB.Proj, XMMatrixTranspose(proj));
-	XMStoreFloat4x4(&mCommonCB.InvProj, XMMatrixTranspose(invProj));
-	XMStoreFloat4x4(&mCommonCB.ViewProj, XMMatrixTranspose(viewProj));
-	XMStoreFloat4x4(&mCommonCB.InvViewProj, XMMatrixTranspose(invViewProj));
-	mCommonCB.CameraPosW = mCamera.GetPosition3f();
+uint32_t SolarSystem::OcclusionCull(const FramePacket& packet, uint32_t visibleCount)
+{
+	// a low resolution buffer with the back buffer's aspect, 320 pixels wide.
+	uint32_t occlusionHeight = MathHelper::Max(4u, (uint32_t)(320.0f * mClientHeight / MathHelper::Max(1, mClientWidth)));
+	if (mOcclusion.Width() != 320 || mOcclusion.Height() != (occlusionHeight + 3) / 4 * 4)
+	{
+		mOcclusion.Resize(320, occlusionHeight);
+	}
+	mOcclusion.Clear();
+
+	// occluders : visible spheres covering a fair part of the view, rasterized front to back so the
+	// nearest ones fill the tiles first.
+	uint32_t staticCount = (uint32_t)mOpaqueStaticRenderItems.size();
+	XMVECTOR eye = XMLoadFloat3(&packet.EyePosition);
+	mOccluders.clear();
+	for (uint32_t i = 0; i < visibleCount; ++i)
+	{
+		uint32_t index = mVisibleIndices[i];
+		if (index < staticCount || mOpaqueDynamicRenderItems[index - staticCount]->Occluder == nullptr)
+		{
+			continue;
+		}
+
+		XMVECTOR center = XMVectorSet(mCullSpheres.X()[index], mCullSpheres.Y()[index], mCullSpheres.Z()[index], 1.0f);
+		float distance = XMVectorGetX(XMVector3Length(center - eye));
+		if (mCullSpheres.R()[index] > 0.05f * distance)
+		{
+			mOccluders.push_back(make_pair(distance, index));
+		}
+	}
+	if (mOccluders.empty())
+	{
+		return visibleCount;
+	}
+	sort(mOccluders.begin(), mOccluders.end());
+
+	XMMATRIX viewProj = XMLoadFloat4x4(&packet.ViewProj);
+	for (const auto& occluder : mOccluders)
+	{
+		uint32_t dynamicIndex = occluder.second - staticCount;
+		XMFLOAT4X4 worldViewProj;
+		XMStoreFloat4x4(&worldViewProj, XMMatrixMultiply(XMLoadFloat4x3(&packet.Instances[dynamicIndex].World), viewProj));
+		mOcclusion.RenderMesh(*mOpaqueDynamicRenderItems[dynamicIndex]->Occluder, worldViewProj.m);
+	}
+	mOcclusion.Finalize();
+
+	// what is not hidden, through the hierarchy again : a node hidden as a whole is not tested item by item.
+	SphereBvh::BoxTest boxVisible = [&](const float boxMin[3], const float boxMax[3])
+	{
+		return mOcclusion.TestAabb(boxMin, boxMax, packet.ViewProj.m);
+	};
+	return mSceneBvh->QueryFrustum(packet.Frustum, boxVisible, mVisibleIndices.data());
+}
+
+void SolarSystem::UpdateCommonCB(const FramePacket& packet)
+{
+	// the render target size belongs to the render stage, it may have changed since the packet was simulated.
+	mCommonCB = packet.Common;
 	mCommonCB.RenderTargetSize = XMFLOAT2((float)mClientWidth, (float)mClientHeight);
 	mCommonCB.InvRenderTargetSize = XMFLOAT2(1.0f / (float)mClientWidth, 1.0f / (float)mClientHeight);
-	mCommonCB.NearZ = 1.0f;
-	mCommonCB.FarZ = 1000.0f;
-	mCommonCB.TotalTime = gt.TotalTime();
-	mCommonCB.DeltaTime = gt.DeltaTime();
-	mCommonCB.AmbientLight = { 0.25f, 0.25f, 0.35f, 1.0f };
-
-	// three directional light sources illuminate the scene at which the camera is focused.
-	mCommonCB.Lights[0].Direction = { 0.57735f, -0.57735f, 0.57735f };
-	mCommonCB.Lights[0].Strength = { 0.8f, 0.8f, 0.8f };
-	mCommonCB.Lights[1].Direction = { -0.57735f, -0.57735f, 0.57735f };
-	mCommonCB.Lights[1].Strength = { 0.4f, 0.4f, 0.4f };
-	mCommonCB.Lights[2].Direction = { 0.0f, -0.707f, -0.707f };
-	mCommonCB.Lights[2].Strength = { 0.2f, 0.2f, 0.2f };
 
 	auto currentCommonCB = mCurrentFrameBuffer->CommonCB.get();
 	currentCommonCB->CopyData(0, mCommonCB);
+	mUploadedBytes += sizeof(CommonConstants);
 }
 
-void SolarSystem::DrawRenderingItems(ID3D12GraphicsCommandList* cmdList, const vector<RenderItem*>& ritems)
+void SolarSystem::DrawRenderingItems(CommandStateCache& cmdState, const vector<RenderItem*>& ritems)
 {
-	UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
+	auto sortStart = chrono::high_resolution_clock::now();
 
-	auto objectCB = mCurrentFrameBuffer->ObjectCB->Resource();
+	// build a sort key per item : pass | pso | geometry | material | depth (front to back).
+	const FramePacket& packet = mPackets.ReadBuffer();
+	XMVECTOR eyePos = XMLoadFloat3(&packet.EyePosition);
+	XMVECTOR look = XMLoadFloat3(&packet.Look);
+	float farZ = packet.FarZ;
 
-	// send draw commmand to command list for each render item
+	mDrawQueue.Clear();
+	mDrawQueue.Reserve(ritems.size());
 	for (size_t i = 0; i < ritems.size(); ++i)
 	{
 		RenderItem* ri = ritems[i];
 
-		cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
-		cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
-		cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+		XMVECTOR center = XMLoadFloat3(&ri->Center);
+		float viewDepth = XMVectorGetX(XMVector3Dot(center - eyePos, look));
 
-		D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + ri->ObjCBIndex * objCBByteSize;
+		mDrawQueue.Push(DrawSortKey::Make(0, ri->PsoSortId, ri->GeoSortId, ri->Mat->MatCBIndex,
+			DrawSortKey::QuantizeDepth(viewDepth, farZ)), (uint32_t)i);
+	}
+	mDrawQueue.Sort(mWorkers.get());
 
-		cmdList->SetGraphicsRootConstantBufferView(0, objCBAddress);
+	mSortMicroseconds = chrono::duration<double, micro>(chrono::high_resolution_clock::now() - sortStart).count();
+
+	// send draw commmand to command list for each render item, in key order.
+	// the state cache only records the bindings which differ from the previous draw.
+	for (size_t i = 0; i < mDrawQueue.Size(); ++i)
+	{
+		RenderItem* ri = ritems[mDrawQueue.Item(i)];
+
+		cmdState.SetPipelineState(mItemPsos[ri->PsoSortId]);
+		cmdState.IASetVertexBuffer(ToRhi(ri->Geo->VertexBufferView()));
+		cmdState.IASetIndexBuffer(ToRhi(ri->Geo->IndexBufferView()));
+		cmdState.IASetPrimitiveTopology((RhiPrimitiveTopology)ri->PrimitiveType);
+
+		// the object's data is fetched from the instance buffer by index.
+		DrawConstants drawConstants;
+		drawConstants.InstanceIndex = ri->InstanceIndex;
+		drawConstants.TexTransformIndex = ri->TexTransformIndex;
+
+		// compact positions are decoded in the bounds of the submesh they were quantized in.
+		if (ri->Geo->CompactVertices)
+		{
+			drawConstants.PositionCenter = ri->Bounds.Center;
+			drawConstants.PositionExtent = ri->Bounds.Extents;
+		}
+		cmdState.SetGraphicsRoot32BitConstants(mRootParameters.Draw, sizeof(DrawConstants) / 4, &drawConstants, 0);
 
-		cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+		// a submesh too large for 16 bit indices is drawn chunk by chunk, each with its own base vertex.
+		const vector<SubmeshGeometry>& chunks = ri->Geo->IndexChunks;
+		auto chunk = lower_bound(chunks.begin(), chunks.end(), ri->StartIndexLocation,
+			[](const SubmeshGeometry& c, UINT start) { return c.StartIndexLocation < start; });
+		if (chunk == chunks.end() || chunk->StartIndexLocation != ri->StartIndexLocation)
+		{
+			cmdState.DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+			continue;
+		}
+		for (; chunk != chunks.end() && chunk->StartIndexLocation < ri->StartIndexLocation + ri->IndexCount; ++chunk)
+		{
+			cmdState.DrawIndexedInstanced(chunk->IndexCount, 1, chunk->StartIndexLocation, chunk->BaseVertexLocation, 0);
+		}
 	}
 }
 
-
-// ---------- preparatory methods ----------
-void SolarSystem::PrepareTextures()
+void SolarSystem::RecordStaticBundle()
 {
-	// ----- space texture -----
-	auto spaceTex = make_unique<Texture>();
-	spaceTex->Name = "spaceTex";
-	spaceTex->Filename = L"Textures/space5.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(), mCommandList.Get(), spaceTex->Filename.c_str(),
-		spaceTex->Resource, spaceTex->UploadHeap));
-
-	// ----- Sun texture -----
-	auto sunTex = make_unique<Texture>();
-	sunTex->Name = "sunTex";
-	sunTex->Filename = L"Textures/sun1.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(), mCommandList.Get(), sunTex->Filename.c_str(),
-		sunTex->Resource, sunTex->UploadHeap));
-	
-	// ----- Mercury texture -----
-	auto mercuryTex = make_unique<Texture>();
-	mercuryTex->Name = "mercuryTex";
-	mercuryTex->Filename = L"Textures/mercury1.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(), mCommandList.Get(), mercuryTex->Filename.c_str(),
-		mercuryTex->Resource, mercuryTex->UploadHeap));
-
-	// ----- Venus texture -----
-	auto venusTex = make_unique<Texture>();
-	venusTex->Name = "venusTex";
-	venusTex->Filename = L"Textures/venus1.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(), mCommandList.Get(), venusTex->Filename.c_str(),
-		venusTex->Resource, venusTex->UploadHeap));
-
-	// ----- Earth texture -----
-	auto earthTex = make_unique<Texture>();
-	earthTex->Name = "earthTex";
-	earthTex->Filename = L"Textures/earth1.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(), mCommandList.Get(), earthTex->Filename.c_str(),
-		earthTex->Resource, earthTex->UploadHeap));
-
-	// ----- Mars texture -----
-	auto marsTex = make_unique<Texture>();
-	marsTex->Name = "marsTex";
-	marsTex->Filename = L"Textures/mars1.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(), mCommandList.Get(), marsTex->Filename.c_str(),
-		marsTex->Resource, marsTex->UploadHeap));
-
-	// ----- Jupiter texture -----
-	auto jupiterTex = make_unique<Texture>();
-	jupiterTex->Name = "jupiterTex";
-	jupiterTex->Filename = L"Textures/jupiter1.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(), mCommandList.Get(), jupiterTex->Filename.c_str(),
-		jupiterTex->Resource, jupiterTex->UploadHeap));
-
-	mTextures[spaceTex->Name] = move(spaceTex);
-	mTextures[sunTex->Name] = move(sunTex);
-	mTextures[mercuryTex->Name] = move(mercuryTex);
-	mTextures[venusTex->Name] = move(venusTex);
-	mTextures[earthTex->Name] = move(earthTex);
-	mTextures[marsTex->Name] = move(marsTex);
-	mTextures[jupiterTex->Name] = move(jupiterTex);
+	auto recordStart = chrono::high_resolution_clock::now();
+
+	RhiCommandList* bundle = mCurrentFrameBuffer->StaticBundle.get();
+	RhiPipelineState* opaquePso = mRhiPSOs["opaque"].get();
+
+	bundle->Begin(opaquePso);
+	CommandStateCache bundleState;
+	bundleState.Begin(bundle, opaquePso);
+
+	// a bundle inherits the root arguments and descriptor heaps of the calling list only when it sets the same
+	// root signature, so the per-frame buffers bound in Draw stay visible to it.
+	bundleState.SetGraphicsRootSignature(mRhiRootSignature.get());
+	DrawRenderingItems(bundleState, mOpaqueStaticRenderItems);
+
+	bundle->End();
+	mCurrentFrameBuffer->StaticBundleVersion = mStaticBundleVersion;
+
+	mBundleRecordMicroseconds = chrono::duration<double, micro>(chrono::high_resolution_clock::now() - recordStart).count();
 }
 
-void SolarSystem::SetRootSignature()
+void SolarSystem::ReplayCapture()
 {
-	CD3DX12_DESCRIPTOR_RANGE texTable;
-	texTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 7, 0, 0);
+	RhiCapture capture;
+	if (!capture.Load(gCaptureFileName) || capture.FrameCount() == 0)
+	{
+		mCaptureStatus = L"   replay: no capture";
+		return;
+	}
 
-	CD3DX12_ROOT_PARAMETER slotRootParameters[4];
-	slotRootParameters[0].InitAsConstantBufferView(0);					// cbuffer cbObject : register(b0) in BasicShader.hlsl
-	slotRootParameters[1].InitAsConstantBufferView(1);					// cbuffer cbCommon : register(b1) in BasicShader.hlsl
-	slotRootParameters[2].InitAsShaderResourceView(0, 1);				// StructuredBuffer<MaterialParameter> gMaterialParameters : register(t0, space1) in BasicShader.hlsl
-	slotRootParameters[3].InitAsDescriptorTable(1, &texTable, D3D12_SHADER_VISIBILITY_PIXEL);	// Texture2D gDiffuseMap[7] : register(t0)	in BasicShader.hlsl
+	// every object a captured frame can refer to.
+	RhiObjectTable objects;
+	objects.Register(mRhiRootSignature.get());
+	objects.Register(mRhiSrvDescriptorHeap.get());
+	for (auto& pso : mRhiPSOs)
+	{
+		objects.Register(pso.second.get());
+	}
+	for (auto& buffer : mRhiSwapChainBuffer)
+	{
+		objects.Register(buffer.get());
+	}
+	objects.Register(mRhiDepthStencilBuffer.get());
+	for (auto& frameBuffer : mFrameBuffers)
+	{
+		objects.Register(frameBuffer->StaticBundle.get());
+	}
 
-	// static sampler object
-	auto staticSamplers = GetStaticSamplers();
+	// decode into the null backend first : measures the decode cost alone and validates the capture,
+	// so the device is never left with a half recorded command list.
+	NullRhiDevice nullDevice;
+	unique_ptr<RhiCommandList> nullCommandList = nullDevice.CreateCommandList(RhiQueueType::Direct);
+	RhiReplayer replayer;
+
+	auto decodeStart = chrono::high_resolution_clock::now();
+	for (UINT i = 0; i < capture.FrameCount(); ++i)
+	{
+		if (!replayer.Replay(capture.FrameData(i), capture.FrameSize(i), nullCommandList.get(), &objects))
+		{
+			mCaptureStatus = L"   replay: capture does not match this session";
+			return;
+		}
+	}
+	double decodeUs = chrono::duration<double, micro>(chrono::high_resolution_clock::now() - decodeStart).count();
 
-	// set a root signature description struct
-	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(4, slotRootParameters, (UINT)staticSamplers.size(), staticSamplers.data(),
-		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+	// then against the device as fast as possible : every frame is re-recorded into mCommandList and submitted.
+	// lists may be reset on an allocator whose earlier lists are still executing, only the allocator reset has to wait.
+	FlushCommandQueue();
+	ThrowIfFailed(mDirectCmdListAlloc->Reset());
+	mRhiCommandList->SetAllocator(mDirectCmdListAlloc.Get());
 
-	// create a root signature and store them in ComPtr<ID3DBlob>
-	ComPtr<ID3DBlob> serializedRootSig = nullptr;
-	ComPtr<ID3DBlob> errorBlob = nullptr;		// for error-checking
-	HRESULT hr = D3D12SerializeRootSignature(&rootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1,
-		serializedRootSig.GetAddressOf(), errorBlob.GetAddressOf());
+	RhiCommandQueue* queue = mRhiDevice->Queue(RhiQueueType::Direct);
+	RhiCommandList* cmdsLists[] = { mRhiCommandList.get() };
 
-	// show error message if any of them has come up.
-	if (errorBlob != nullptr)
+	auto replayStart = chrono::high_resolution_clock::now();
+	for (UINT i = 0; i < capture.FrameCount(); ++i)
 	{
-		::OutputDebugStringA((char*)errorBlob->GetBufferPointer());
+		replayer.Replay(capture.FrameData(i), capture.FrameSize(i), mRhiCommandList.get(), &objects);
+		queue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
 	}
-	ThrowIfFailed(hr);
+	double recordUs = chrono::duration<double, micro>(chrono::high_resolution_clock::now() - replayStart).count();
 
-	// transfer root signature object to mRootSignature.
-	ThrowIfFailed(md3dDevice->CreateRootSignature(
-		0,
-		serializedRootSig->GetBufferPointer(),
-		serializedRootSig->GetBufferSize(),
-		IID_PPV_ARGS(mRootSignature.GetAddressOf())));
+	FlushCommandQueue();
+	double totalUs = chrono::duration<double, micro>(chrono::high_resolution_clock::now() - replayStart).count();
+
+	double frames = (double)capture.FrameCount();
+	mCaptureStatus = L"   replay " + to_wstring(capture.FrameCount()) + L" frames: decode " + to_wstring((int)(decodeUs / frames)) +
+		L" us/frame, record+submit " + to_wstring((int)(recordUs / frames)) + L" us/frame, with GPU " + to_wstring((int)(totalUs / frames)) + L" us/frame";
+}
+
+
+// ---------- preparatory methods ----------
+void SolarSystem::PrepareTextures()
+{
+	// the diffuse maps, in the order of their descriptors in the srv heap (Material::DiffuseSrvHeapIndex).
+	// the srv heap, the root signature's texture table and gDiffuseMap in BasicShader.hlsl are all sized from this list.
+	const pair<const char*, const wchar_t*> diffuseMaps[] =
+	{
+		{ "spaceTex", L"Textures/space5.dds" },
+		{ "sunTex", L"Textures/sun1.dds" },
+		{ "mercuryTex", L"Textures/mercury1.dds" },
+		{ "venusTex", L"Textures/venus1.dds" },
+		{ "earthTex", L"Textures/earth1.dds" },
+		{ "marsTex", L"Textures/mars1.dds" },
+		{ "jupiterTex", L"Textures/jupiter1.dds" },
+	};
+
+	for (const auto& diffuseMap : diffuseMaps)
+	{
+		auto tex = make_unique<Texture>();
+		tex->Name = diffuseMap.first;
+		tex->Filename = diffuseMap.second;
+		ThrowIfFailed(mUploadManager->CreateDDSTexture(tex->Filename.c_str(), tex->Resource));
+
+		mDiffuseMaps.push_back(tex.get());
+		mTextures[tex->Name] = move(tex);
+	}
+}
+
+void SolarSystem::SetRootSignature()
+{
+	// the bindings of BasicShader.hlsl, one root parameter each in this order.
+	// the per-frame buffers are written before Draw binds them and left alone until their frame buffer's fence
+	// has passed, so their data is static.  The textures may still be copied on the upload queue while the first
+	// frames are recorded, the graphics queue only waits for them at execution.
+	auto staticSamplers = GetStaticSamplers();
+	mRootLayout = RootSignatureBuilder();
+	mRootLayout
+		.Constants("cbDraw", sizeof(DrawConstants) / 4, 0)							// cbuffer cbDraw : register(b0)
+		.ConstantBuffer("cbCommon", 1, 0, RootDataUsage::Static)					// cbuffer cbCommon : register(b1)
+		.ShaderResource("gMaterialParameters", 0, 1, RootDataUsage::Static)			// StructuredBuffer<MaterialParameter> gMaterialParameters : register(t0, space1)
+		.Table("gDiffuseMap", D3D12_DESCRIPTOR_RANGE_TYPE_SRV, (UINT)mDiffuseMaps.size(), 0, 0,
+			RootDataUsage::StaticAtExecute, D3D12_SHADER_VISIBILITY_PIXEL)		// Texture2D gDiffuseMap[DIFFUSE_MAP_COUNT] : register(t0)
+		.ShaderResource("gInstances", 1, 1, RootDataUsage::Static)					// StructuredBuffer<InstanceData> gInstances : register(t1, space1)
+		.ShaderResource("gTexTransforms", 2, 1, RootDataUsage::Static)				// StructuredBuffer<TexTransformData> gTexTransforms : register(t2, space1)
+		.ShaderResource("gImpostors", 3, 1, RootDataUsage::Static)					// StructuredBuffer<uint> gImpostors : register(t3, space1)
+		.StaticSamplers(staticSamplers.data(), (UINT)staticSamplers.size())
+		.Flags(D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+
+	mRootParameters.Draw = mRootLayout.Index("cbDraw");
+	mRootParameters.Common = mRootLayout.Index("cbCommon");
+	mRootParameters.Materials = mRootLayout.Index("gMaterialParameters");
+	mRootParameters.DiffuseMaps = mRootLayout.Index("gDiffuseMap");
+	mRootParameters.Instances = mRootLayout.Index("gInstances");
+	mRootParameters.TexTransforms = mRootLayout.Index("gTexTransforms");
+	mRootParameters.Impostors = mRootLayout.Index("gImpostors");
+
+	// serialized and created once per distinct layout.
+	mRootSignature = mRootSignatures->Get(mRootLayout);
+	mRhiRootSignature = mRhiDevice->WrapRootSignature(mRootSignature.Get());
 }
 
 void SolarSystem::SetDescriptorHeaps()
 {
-	// create the shader resource view heap.
+	// create the shader resource view heap, one descriptor per entry of the texture table.
 	D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-	srvHeapDesc.NumDescriptors = 7;
+	srvHeapDesc.NumDescriptors = mRootLayout.Count("gDiffuseMap");
 	srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
 	srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
 	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSrvDescriptorHeap)));
+	mRhiSrvDescriptorHeap = mRhiDevice->WrapDescriptorHeap(mSrvDescriptorHeap.Get());
 
 	// fill out the srv heap with actual texture resource descriptors.
 
 	// create a descriptor handle
 	CD3DX12_CPU_DESCRIPTOR_HANDLE hDescriptor(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
 
-	auto spaceTex = mTextures["spaceTex"]->Resource;
-	auto sunTex = mTextures["sunTex"]->Resource;
-	auto mercuryTex = mTextures["mercuryTex"]->Resource;
-	auto venusTex = mTextures["venusTex"]->Resource;
-	auto earthTex = mTextures["earthTex"]->Resource;
-	auto marsTex = mTextures["marsTex"]->Resource;
-	auto jupiterTex = mTextures["jupiterTex"]->Resource;
-
 	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = spaceTex->GetDesc().Format;
 	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
 	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.MipLevels = spaceTex->GetDesc().MipLevels;
 	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
 
-	// descriptor for space texture resource
-	md3dDevice->CreateShaderResourceView(spaceTex.Get(), &srvDesc, hDescriptor);
-
-	// descriptor for sun texture resource
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-	srvDesc.Format = sunTex->GetDesc().Format;
-	srvDesc.Texture2D.MipLevels = sunTex->GetDesc().MipLevels;
-	md3dDevice->CreateShaderResourceView(sunTex.Get(), &srvDesc, hDescriptor);
-
-	// descriptor for mercury texture resource
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-	srvDesc.Format = mercuryTex->GetDesc().Format;
-	srvDesc.Texture2D.MipLevels = mercuryTex->GetDesc().MipLevels;
-	md3dDevice->CreateShaderResourceView(mercuryTex.Get(), &srvDesc, hDescriptor);
-
-	// descriptor for venus texture resource
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-	srvDesc.Format = venusTex->GetDesc().Format;
-	srvDesc.Texture2D.MipLevels = venusTex->GetDesc().MipLevels;
-	md3dDevice->CreateShaderResourceView(venusTex.Get(), &srvDesc, hDescriptor);
-
-	// descriptor for earth texture resource
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-	srvDesc.Format = earthTex->GetDesc().Format;
-	srvDesc.Texture2D.MipLevels = earthTex->GetDesc().MipLevels;
-	md3dDevice->CreateShaderResourceView(earthTex.Get(), &srvDesc, hDescriptor);
-
-	// descriptor for mars texture resource
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-	srvDesc.Format = marsTex->GetDesc().Format;
-	srvDesc.Texture2D.MipLevels = marsTex->GetDesc().MipLevels;
-	md3dDevice->CreateShaderResourceView(marsTex.Get(), &srvDesc, hDescriptor);
-
-	// descriptor for jupiter texture resource
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-	srvDesc.Format = jupiterTex->GetDesc().Format;
-	srvDesc.Texture2D.MipLevels = jupiterTex->GetDesc().MipLevels;
-	md3dDevice->CreateShaderResourceView(jupiterTex.Get(), &srvDesc, hDescriptor);
+	for (Texture* tex : mDiffuseMaps)
+	{
+		srvDesc.Format = tex->Resource->GetDesc().Format;
+		srvDesc.Texture2D.MipLevels = tex->Resource->GetDesc().MipLevels;
+		md3dDevice->CreateShaderResourceView(tex->Resource.Get(), &srvDesc, hDescriptor);
+
+		hDescriptor.Offset(1, mCbvSrvDescriptorSize);
+	}
 }
 
 void SolarSystem::SetShadersAndInputLayout()
 {
-	//const D3D_SHADER_MACRO RenderingOpaque;
+	// the size of the texture array comes from the root signature's texture table.
+	string diffuseMapCount = to_string(mRootLayout.Count("gDiffuseMap"));
+	const D3D_SHADER_MACRO defines[] =
+	{
+		{ "DIFFUSE_MAP_COUNT", diffuseMapCount.c_str() },
+		{ nullptr, nullptr }
+	};
 
-	mShaders["standardVS"] = d3dUtil::CompileShader(L"Shaders\\BasicShader.hlsl", nullptr, "VS", "vs_5_1");
-	mShaders["opaquePS"] = d3dUtil::CompileShader(L"Shaders\\BasicShader.hlsl", nullptr, "PS", "ps_5_1");
+	mShaders["standardVS"] = d3dUtil::CompileShader(L"Shaders\\BasicShader.hlsl", defines, "VS", "vs_5_1");
+	mShaders["opaquePS"] = d3dUtil::CompileShader(L"Shaders\\BasicShader.hlsl", defines, "PS", "ps_5_1");
+	mShaders["compactVS"] = d3dUtil::CompileShader(L"Shaders\\BasicShader.hlsl", defines, "CompactVS", "vs_5_1");
+	mShaders["impostorVS"] = d3dUtil::CompileShader(L"Shaders\\BasicShader.hlsl", defines, "ImpostorVS", "vs_5_1");
+	mShaders["impostorPS"] = d3dUtil::CompileShader(L"Shaders\\BasicShader.hlsl", defines, "ImpostorPS", "ps_5_1");
 
 	mInputLayout =
 	{
@@ -710,89 +1470,309 @@ void SolarSystem::SetShadersAndInputLayout()
 		{"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},		// XMFLOAT3 Normal from struct Vertex in FrameBuffer.h
 		{"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},		// XMFLOAT2 TexCoord from struct Vertex in FrameBuffer.h
 	};
+
+	mCompactInputLayout =
+	{
+		{"POSITION", 0, DXGI_FORMAT_R16G16B16A16_SNORM, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},	// Position from struct CompactVertex in VertexQuantization.h
+		{"NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 8, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},			// Normal from struct CompactVertex in VertexQuantization.h
+		{"TEXCOORD", 0, DXGI_FORMAT_R16G16_UNORM, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},		// TexC from struct CompactVertex in VertexQuantization.h
+	};
 }
 
 void SolarSystem::SetShapeGeometry()
 {
 	// use GeometryGenerator class defined in GeometryGenerator.h to generate mesh data of sphere shape and large plane .
 	GeometryGenerator geoGen;
-	GeometryGenerator::MeshData spacePlane = geoGen.CreateGrid(300.0f, 300.0f, 60, 60);
-	GeometryGenerator::MeshData celestialSphere = geoGen.CreateSphere(1.0f, 20, 20);
 
-	// put MeshData of these two geometries into one vertex buffer and one index buffer.
-	
-	// mark the vertex offsets to each object in the unified vertex buffer.
-	UINT planeVertexStart = 0;
-	UINT sphereVertexStart = (UINT)spacePlane.Vertices.size();
+	// the error of each level of the celestial spheres.  A lat-long sphere is farthest from the true surface
+	// in the middle of its quads, half a slice and half a stack away from their corners.
+	for (UINT lod = 0; lod < gSphereLodCount; ++lod)
+	{
+		float halfAngle = XM_PI / gSphereLodSlices[lod];
+		mSphereLodErrors[lod] = 1.0f - cosf(halfAngle) * cosf(halfAngle);
+	}
 
-	// mark the starging index for each object in the unified index buffer.
-	UINT planeIndexStart = 0;
-	UINT sphereIndexStart = (UINT)spacePlane.Indices32.size();
+	// the occluder for every sphere, a coarse copy shrunk to fit inside every level but the coarsest, which is
+	// only drawn while its error is below a pixel.
+	float occluderRadius = 1.0f - mSphereLodErrors[gSphereLodCount - 2];
+	GeometryGenerator::MeshData occluderSphere = geoGen.CreateSphere(occluderRadius, 10, 8);
+	for (const auto& vertex : occluderSphere.Vertices)
+	{
+		mSphereOccluder.Positions.push_back(vertex.Position.x);
+		mSphereOccluder.Positions.push_back(vertex.Position.y);
+		mSphereOccluder.Positions.push_back(vertex.Position.z);
+	}
+	mSphereOccluder.Indices = occluderSphere.Indices32;
+
+	// the buffers come from the cache file when it was written with the same settings, generating and
+	// optimizing them is most of the startup.
+	const vector<string> geometryNames = { "shapesGeo", "spheresGeo" };
+	const uint64_t cacheKey = MeshCacheKey();
+	auto start = chrono::high_resolution_clock::now();
+	bool cached = LoadCachedGeometry(cacheKey, geometryNames);
+	if (!cached)
+	{
+		GeometryGenerator::MeshData spacePlane = geoGen.CreateGrid(gSpacePlaneSize, gSpacePlaneSize, gSpacePlaneRows, gSpacePlaneRows);
 
-	SubmeshGeometry planeSubmesh;
-	planeSubmesh.IndexCount = (UINT)spacePlane.Indices32.size();
-	planeSubmesh.StartIndexLocation = planeIndexStart;
-	planeSubmesh.BaseVertexLocation = planeVertexStart;
+		vector<GeometryGenerator::MeshData> celestialSpheres;
+		for (UINT lod = 0; lod < gSphereLodCount; ++lod)
+		{
+			celestialSpheres.push_back(geoGen.CreateSphere(1.0f, gSphereLodSlices[lod], gSphereLodSlices[lod] / 2));
+		}
 
-	SubmeshGeometry sphereSubmesh;
-	sphereSubmesh.IndexCount = (UINT)celestialSphere.Indices32.size();
-	sphereSubmesh.StartIndexLocation = sphereIndexStart;
-	sphereSubmesh.BaseVertexLocation = sphereVertexStart;
+		// the generators emit rows and rings in order, reorder them before they are copied.
+		OptimizeShape(L"plane", spacePlane);
+		for (UINT lod = 0; lod < gSphereLodCount; ++lod)
+		{
+			OptimizeShape(L"sphereLod" + to_wstring(lod), celestialSpheres[lod]);
+		}
 
-	auto totalVertexNumber = spacePlane.Vertices.size() + celestialSphere.Vertices.size();
-	vector<Vertex> vertices(totalVertexNumber);
+		// one buffer for the plane and one for the sphere levels, which hold most of the vertices.
+		BuildGeometry(geometryNames[0], { { "plane", &spacePlane } }, false);
 
-	// fill up vertices
-	size_t k = 0;
-	for (size_t i = 0; i < spacePlane.Vertices.size(); ++i, ++k)
+		vector<pair<string, GeometryGenerator::MeshData*>> sphereMeshes;
+		for (UINT lod = 0; lod < gSphereLodCount; ++lod)
+		{
+			sphereMeshes.push_back({ "sphereLod" + to_string(lod), &celestialSpheres[lod] });
+		}
+		BuildGeometry(geometryNames[1], sphereMeshes, gCompactSphereVertices);
+
+		WriteCachedGeometry(cacheKey, geometryNames);
+	}
+
+	wchar_t text[256];
+	swprintf_s(text, L"***Mesh cache %S: %s, geometry ready in %.2f ms\n", gMeshCacheFileName, cached ? L"hit" : L"miss",
+		chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count());
+	OutputDebugString(text);
+
+	MeshGeometry* spheres = mGeometries[geometryNames[1]].get();
+	for (UINT lod = 0; lod < gSphereLodCount; ++lod)
 	{
-		vertices[k].Position = spacePlane.Vertices[i].Position;
-		vertices[k].Normal = spacePlane.Vertices[i].Normal;
-		vertices[k].TexC = spacePlane.Vertices[i].TexC;
+		mSphereLods[lod] = spheres->DrawArgs["sphereLod" + to_string(lod)];
 	}
-	for (size_t i = 0; i < celestialSphere.Vertices.size(); ++i, ++k)
+	spheres->DrawArgs["sphere"] = mSphereLods[gSphereStartLod];
+}
+
+MeshGeometry* SolarSystem::BuildGeometry(const string& name, const vector<pair<string, GeometryGenerator::MeshData*>>& meshes, bool compact)
+{
+	auto geo = make_unique<MeshGeometry>();
+	geo->Name = name;
+	geo->CompactVertices = compact;
+
+	// the meshes one after the other in one vertex buffer and one index buffer.  Compact vertices are quantized
+	// in the bounds of their own submesh, the draws pass those bounds to CompactVS.  The indices are 16 bit
+	// unless a mesh needs more and gPrefer16BitIndices doesn't let it be split.
+	vector<const vector<uint32_t>*> meshIndices;
+	vector<uint32_t> meshVertexCounts;
+	for (const auto& mesh : meshes)
 	{
-		vertices[k].Position = celestialSphere.Vertices[i].Position;
-		vertices[k].Normal = celestialSphere.Vertices[i].Normal;
-		vertices[k].TexC = celestialSphere.Vertices[i].TexC;
+		meshIndices.push_back(&mesh.second->Indices32);
+		meshVertexCounts.push_back((uint32_t)mesh.second->Vertices.size());
 	}
+	PackedIndices indices = PackIndices(meshIndices, meshVertexCounts, gPrefer16BitIndices);
 
-	// fill up indices
-	vector<uint16_t> indices;
-	indices.insert(indices.end(), spacePlane.GetIndices16().begin(), spacePlane.GetIndices16().end());
-	indices.insert(indices.end(), celestialSphere.GetIndices16().begin(), celestialSphere.GetIndices16().end());
+	vector<Vertex> vertices;
+	vector<CompactVertex> compactVertices;
+	for (size_t m = 0; m < meshes.size(); ++m)
+	{
+		const auto& mesh = meshes[m];
+		GeometryGenerator::MeshData& data = *mesh.second;
+
+		// object space bounds of each submesh, for frustum culling.
+		SubmeshGeometry submesh;
+		submesh.IndexCount = indices.Meshes[m].IndexCount;
+		submesh.StartIndexLocation = indices.Meshes[m].StartIndex;
+		submesh.BaseVertexLocation = indices.Meshes[m].BaseVertex;
+		BoundingBox::CreateFromPoints(submesh.Bounds, data.Vertices.size(), &data.Vertices[0].Position, sizeof(GeometryGenerator::Vertex));
+
+		QuantizationBounds bounds;
+		memcpy(bounds.Center, &submesh.Bounds.Center, sizeof(bounds.Center));
+		memcpy(bounds.Extent, &submesh.Bounds.Extents, sizeof(bounds.Extent));
+		for (const auto& vertex : data.Vertices)
+		{
+			if (compact)
+			{
+				compactVertices.push_back(EncodeVertex(&vertex.Position.x, &vertex.Normal.x, &vertex.TexC.x, bounds));
+			}
+			else
+			{
+				vertices.push_back({ vertex.Position, vertex.Normal, vertex.TexC });
+			}
+		}
+
+		geo->DrawArgs[mesh.first] = submesh;
+	}
+	for (const IndexRange& chunk : indices.Chunks)
+	{
+		SubmeshGeometry submesh;
+		submesh.IndexCount = chunk.IndexCount;
+		submesh.StartIndexLocation = chunk.StartIndex;
+		submesh.BaseVertexLocation = chunk.BaseVertex;
+		geo->IndexChunks.push_back(submesh);
+	}
 
-	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
-	const UINT ibByteSize = (UINT)indices.size() * sizeof(uint16_t);
+	const void* vertexData = compact ? (const void*)compactVertices.data() : (const void*)vertices.data();
+	const UINT vertexCount = (UINT)(compact ? compactVertices.size() : vertices.size());
+	geo->VertexByteStride = compact ? sizeof(CompactVertex) : sizeof(Vertex);
 
-	auto geo = make_unique<MeshGeometry>();
-	geo->Name = "shapesGeo";
+	const UINT vbByteSize = vertexCount * geo->VertexByteStride;
+	const UINT ibByteSize = (UINT)indices.ByteSize();
 
 	// fill up the vertex buffer with the unified vertices in the system memory.
 	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertexData, vbByteSize);
 
 	// fill up the index buffer with the unified indices in the system memory.
 	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.Data(), ibByteSize);
 
-	// fill up vertex buffer with the unified vertices in the gpu memory.
-	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(), mCommandList.Get(),
-		vertices.data(), vbByteSize, geo->VertexBufferUploader);
+	// fill up vertex buffer with the unified vertices in the gpu memory. (queued on the upload manager)
+	geo->VertexBufferGPU = mUploadManager->CreateBuffer(vertexData, vbByteSize);
 
 	// fill up index buffer with the unified indices in the gpu memory.
-	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(), mCommandList.Get(),
-		indices.data(), ibByteSize, geo->IndexBufferUploader);
+	geo->IndexBufferGPU = mUploadManager->CreateBuffer(indices.Data(), ibByteSize);
 
-	geo->VertexByteStride = sizeof(Vertex);
 	geo->VertexBufferByteSize = vbByteSize;
-	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
+	geo->IndexFormat = indices.Wide ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
 	geo->IndexBufferByteSize = ibByteSize;
 
-	geo->DrawArgs["plane"] = planeSubmesh;
-	geo->DrawArgs["sphere"] = sphereSubmesh;
+	wchar_t text[256];
+	swprintf_s(text, L"***Geometry %S: %u vertices in %u bytes (%u as Vertex), %u bit indices in %u bytes, %u chunks\n", name.c_str(),
+		vertexCount, vbByteSize, vertexCount * (UINT)sizeof(Vertex), indices.Wide ? 32 : 16, ibByteSize, (UINT)indices.Chunks.size());
+	OutputDebugString(text);
 
+	MeshGeometry* result = geo.get();
 	mGeometries[geo->Name] = move(geo);
+	return result;
+}
+
+uint64_t SolarSystem::MeshCacheKey()const
+{
+	struct
+	{
+		UINT Revision = gMeshCacheRevision;
+		UINT LodSlices[gSphereLodCount];
+		UINT CompactSpheres = gCompactSphereVertices;
+		UINT Prefer16BitIndices = gPrefer16BitIndices;
+		float PlaneSize = gSpacePlaneSize;
+		UINT PlaneRows = gSpacePlaneRows;
+		UINT VertexSize = sizeof(Vertex);
+		UINT CompactVertexSize = sizeof(CompactVertex);
+	} settings;
+	memcpy(settings.LodSlices, gSphereLodSlices, sizeof(settings.LodSlices));
+	return MeshCacheHash(&settings, sizeof(settings));
+}
+
+bool SolarSystem::LoadCachedGeometry(uint64_t key, const vector<string>& names)
+{
+	MeshCacheFile cache;
+	if (!cache.Open(gMeshCacheFileName, key))
+	{
+		return false;
+	}
+	for (const string& name : names)
+	{
+		if (!cache.FindGeometry(name))
+		{
+			return false;
+		}
+	}
+
+	for (const string& name : names)
+	{
+		const MeshCacheGeometry& cached = *cache.FindGeometry(name);
+		auto geo = make_unique<MeshGeometry>();
+		geo->Name = name;
+		geo->CompactVertices = (cached.Flags & MeshCacheCompactVertices) != 0;
+		geo->VertexByteStride = cached.VertexByteStride;
+		geo->VertexBufferByteSize = (UINT)cached.VertexByteSize;
+		geo->IndexFormat = cached.IndexBits == 32 ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
+		geo->IndexBufferByteSize = (UINT)cached.IndexByteSize;
+
+		// from the mapped file straight into the staging ring, no system memory copy is kept.
+		geo->VertexBufferGPU = mUploadManager->CreateBuffer(cache.Vertices(cached), cached.VertexByteSize);
+		geo->IndexBufferGPU = mUploadManager->CreateBuffer(cache.Indices(cached), cached.IndexByteSize);
+
+		const MeshCacheSubmesh* submeshes = cache.Submeshes(cached);
+		for (uint32_t s = 0; s < cached.SubmeshCount; ++s)
+		{
+			SubmeshGeometry submesh;
+			submesh.IndexCount = submeshes[s].IndexCount;
+			submesh.StartIndexLocation = submeshes[s].StartIndex;
+			submesh.BaseVertexLocation = submeshes[s].BaseVertex;
+			submesh.Bounds = BoundingBox(XMFLOAT3(submeshes[s].Center), XMFLOAT3(submeshes[s].Extents));
+			geo->DrawArgs[submeshes[s].Name] = submesh;
+		}
+		const MeshCacheChunk* chunks = cache.Chunks(cached);
+		for (uint32_t c = 0; c < cached.ChunkCount; ++c)
+		{
+			SubmeshGeometry chunk;
+			chunk.IndexCount = chunks[c].IndexCount;
+			chunk.StartIndexLocation = chunks[c].StartIndex;
+			chunk.BaseVertexLocation = chunks[c].BaseVertex;
+			geo->IndexChunks.push_back(chunk);
+		}
+
+		mGeometries[name] = move(geo);
+	}
+	return true;
+}
+
+void SolarSystem::WriteCachedGeometry(uint64_t key, const vector<string>& names)
+{
+	vector<MeshCacheEntry> entries;
+	for (const string& name : names)
+	{
+		const MeshGeometry& geo = *mGeometries[name];
+		MeshCacheEntry entry;
+		strncpy_s(entry.Geometry.Name, name.c_str(), _TRUNCATE);
+		entry.Geometry.VertexByteStride = geo.VertexByteStride;
+		entry.Geometry.IndexBits = geo.IndexFormat == DXGI_FORMAT_R32_UINT ? 32 : 16;
+		entry.Geometry.Flags = geo.CompactVertices ? MeshCacheCompactVertices : 0;
+		entry.Geometry.VertexByteSize = geo.VertexBufferByteSize;
+		entry.Geometry.IndexByteSize = geo.IndexBufferByteSize;
+		entry.Vertices = geo.VertexBufferCPU->GetBufferPointer();
+		entry.Indices = geo.IndexBufferCPU->GetBufferPointer();
+
+		for (const auto& drawArg : geo.DrawArgs)
+		{
+			MeshCacheSubmesh submesh = {};
+			strncpy_s(submesh.Name, drawArg.first.c_str(), _TRUNCATE);
+			submesh.IndexCount = drawArg.second.IndexCount;
+			submesh.StartIndex = drawArg.second.StartIndexLocation;
+			submesh.BaseVertex = drawArg.second.BaseVertexLocation;
+			memcpy(submesh.Center, &drawArg.second.Bounds.Center, sizeof(submesh.Center));
+			memcpy(submesh.Extents, &drawArg.second.Bounds.Extents, sizeof(submesh.Extents));
+			entry.Submeshes.push_back(submesh);
+		}
+		for (const SubmeshGeometry& chunk : geo.IndexChunks)
+		{
+			entry.Chunks.push_back({ chunk.IndexCount, chunk.StartIndexLocation, chunk.BaseVertexLocation });
+		}
+		entries.push_back(move(entry));
+	}
+
+	// a failed write only costs the next launch the generation again.
+	if (!WriteMeshCache(gMeshCacheFileName, key, entries))
+	{
+		wchar_t text[256];
+		swprintf_s(text, L"***Mesh cache %S could not be written\n", gMeshCacheFileName);
+		OutputDebugString(text);
+	}
+}
+
+void SolarSystem::OptimizeShape(const wstring& name, GeometryGenerator::MeshData& mesh)
+{
+	vector<uint32_t> remap;
+	MeshOptimizeStats stats = OptimizeMesh(mesh.Indices32, &mesh.Vertices[0].Position.x, sizeof(GeometryGenerator::Vertex),
+		mesh.Vertices.size(), remap);
+	RemapVertices(mesh.Vertices, remap);
+
+	// vertex shader runs per triangle and per vertex, before and after, in the debugger's output.
+	wchar_t text[256];
+	swprintf_s(text, L"***Mesh %s: %zu triangles, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", name.c_str(), mesh.Indices32.size() / 3,
+		stats.Before.Acmr, stats.After.Acmr, stats.Before.Atvr, stats.After.Atvr);
+	OutputDebugString(text);
 }
 
 void SolarSystem::SetPSOs()
@@ -825,6 +1805,38 @@ void SolarSystem::SetPSOs()
 	opaquePsoDesc.DSVFormat = mDepthStencilFormat;
 
 	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaquePsoDesc, IID_PPV_ARGS(&mPSOs["opaque"])));
+	mRhiPSOs["opaque"] = mRhiDevice->WrapPipelineState(mPSOs["opaque"].Get());
+
+	// PSO for the geometries of CompactVertex : the same pipeline, decoding its vertices first.
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC compactPsoDesc = opaquePsoDesc;
+	compactPsoDesc.InputLayout = { mCompactInputLayout.data(), (UINT)mCompactInputLayout.size() };
+	compactPsoDesc.VS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["compactVS"]->GetBufferPointer()),
+		mShaders["compactVS"]->GetBufferSize()
+	};
+
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&compactPsoDesc, IID_PPV_ARGS(&mPSOs["opaqueCompact"])));
+	mRhiPSOs["opaqueCompact"] = mRhiDevice->WrapPipelineState(mPSOs["opaqueCompact"].Get());
+
+	// PSO for the impostors : no vertex input, the corners come from SV_VertexID.
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC impostorPsoDesc = opaquePsoDesc;
+	impostorPsoDesc.InputLayout = { nullptr, 0 };
+	impostorPsoDesc.VS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["impostorVS"]->GetBufferPointer()),
+		mShaders["impostorVS"]->GetBufferSize()
+	};
+	impostorPsoDesc.PS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["impostorPS"]->GetBufferPointer()),
+		mShaders["impostorPS"]->GetBufferSize()
+	};
+
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&impostorPsoDesc, IID_PPV_ARGS(&mPSOs["impostor"])));
+	mRhiPSOs["impostor"] = mRhiDevice->WrapPipelineState(mPSOs["impostor"].Get());
+
+	mItemPsos = { mRhiPSOs["opaque"].get(), mRhiPSOs["opaqueCompact"].get() };
 }
 
 void SolarSystem::SetFrameBuffers()
@@ -832,7 +1844,9 @@ void SolarSystem::SetFrameBuffers()
 	for (size_t i = 0; i < gNumFrameBuffers; ++i)
 	{
 		mFrameBuffers.push_back(make_unique<FrameBuffer>(md3dDevice.Get(), 1,
-			(UINT)mAllRenderItems.size(), (UINT)mMaterials.size()));
+			(UINT)mInstances.size(), (UINT)mTexTransforms.size(), (UINT)mMaterials.size(),
+			MathHelper::Max(1u, (UINT)mOpaqueDynamicRenderItems.size())));
+		mFrameBuffers.back()->StaticBundle = mRhiDevice->CreateCommandList(RhiQueueType::Bundle);
 	}
 }
 
@@ -910,13 +1924,14 @@ void SolarSystem::SetRenderingItems()	// combine rendering object data required
 	auto planeRenderItem = make_unique<RenderItem>();
 	planeRenderItem->World = MathHelper::Identity4x4();	
 	XMStoreFloat4x4(&planeRenderItem->TexTransform, XMMatrixScaling(4.0f, 4.0f, 1.0f));
-	planeRenderItem->ObjCBIndex = 0;	
+	planeRenderItem->InstanceIndex = 0;	
 	planeRenderItem->Mat = mMaterials["plane"].get();
 	planeRenderItem->Geo = mGeometries["shapesGeo"].get();
 	planeRenderItem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 	planeRenderItem->IndexCount = planeRenderItem->Geo->DrawArgs["plane"].IndexCount;
 	planeRenderItem->StartIndexLocation = planeRenderItem->Geo->DrawArgs["plane"].StartIndexLocation;
 	planeRenderItem->BaseVertexLocation = planeRenderItem->Geo->DrawArgs["plane"].BaseVertexLocation;
+	planeRenderItem->Bounds = planeRenderItem->Geo->DrawArgs["plane"].Bounds;
 	planeRenderItem->isItemStatic = true;			// static object
 	mAllRenderItems.push_back(move(planeRenderItem));
 
@@ -927,14 +1942,17 @@ void SolarSystem::SetRenderingItems()	// combine rendering object data required
 	auto sunRenderItem = make_unique<RenderItem>();
 	XMStoreFloat4x4(&sunRenderItem->World, XMMatrixScaling(scaleFactor, scaleFactor, scaleFactor));
 	XMStoreFloat4x4(&sunRenderItem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-	sunRenderItem->ObjCBIndex = 1;
+	sunRenderItem->InstanceIndex = 1;
 	sunRenderItem->Mat = mMaterials["star"].get();
-	sunRenderItem->Geo = mGeometries["shapesGeo"].get();
+	sunRenderItem->Geo = mGeometries["spheresGeo"].get();
 	sunRenderItem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 	sunRenderItem->IndexCount = sunRenderItem->Geo->DrawArgs["sphere"].IndexCount;
 	sunRenderItem->StartIndexLocation = sunRenderItem->Geo->DrawArgs["sphere"].StartIndexLocation;
 	sunRenderItem->BaseVertexLocation = sunRenderItem->Geo->DrawArgs["sphere"].BaseVertexLocation;
+	sunRenderItem->Bounds = sunRenderItem->Geo->DrawArgs["sphere"].Bounds;
 	sunRenderItem->isItemStatic = false;		// moving object
+	sunRenderItem->Occluder = &mSphereOccluder;
+	sunRenderItem->SphereLod = gSphereStartLod;
 	mAllRenderItems.push_back(move(sunRenderItem));
 
 	// 2. mercury
@@ -942,14 +1960,17 @@ void SolarSystem::SetRenderingItems()	// combine rendering object data required
 	auto mercuryRenderItem = make_unique<RenderItem>();
 	XMStoreFloat4x4(&mercuryRenderItem->World, XMMatrixScaling(scaleFactor, scaleFactor, scaleFactor));
 	XMStoreFloat4x4(&mercuryRenderItem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-	mercuryRenderItem->ObjCBIndex = 2;
+	mercuryRenderItem->InstanceIndex = 2;
 	mercuryRenderItem->Mat = mMaterials["mercury"].get();
-	mercuryRenderItem->Geo = mGeometries["shapesGeo"].get();
+	mercuryRenderItem->Geo = mGeometries["spheresGeo"].get();
 	mercuryRenderItem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 	mercuryRenderItem->IndexCount = mercuryRenderItem->Geo->DrawArgs["sphere"].IndexCount;
 	mercuryRenderItem->StartIndexLocation = mercuryRenderItem->Geo->DrawArgs["sphere"].StartIndexLocation;
 	mercuryRenderItem->BaseVertexLocation = mercuryRenderItem->Geo->DrawArgs["sphere"].BaseVertexLocation;
+	mercuryRenderItem->Bounds = mercuryRenderItem->Geo->DrawArgs["sphere"].Bounds;
 	mercuryRenderItem->isItemStatic = false;	// moving object
+	mercuryRenderItem->Occluder = &mSphereOccluder;
+	mercuryRenderItem->SphereLod = gSphereStartLod;
 	mAllRenderItems.push_back(move(mercuryRenderItem));
 
 	// 3. venus
@@ -957,14 +1978,17 @@ void SolarSystem::SetRenderingItems()	// combine rendering object data required
 	auto venusRenderItem = make_unique<RenderItem>();
 	XMStoreFloat4x4(&venusRenderItem->World, XMMatrixScaling(scaleFactor, scaleFactor, scaleFactor));
 	XMStoreFloat4x4(&venusRenderItem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-	venusRenderItem->ObjCBIndex = 3;
+	venusRenderItem->InstanceIndex = 3;
 	venusRenderItem->Mat = mMaterials["venus"].get();
-	venusRenderItem->Geo = mGeometries["shapesGeo"].get();
+	venusRenderItem->Geo = mGeometries["spheresGeo"].get();
 	venusRenderItem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 	venusRenderItem->IndexCount = venusRenderItem->Geo->DrawArgs["sphere"].IndexCount;
 	venusRenderItem->StartIndexLocation = venusRenderItem->Geo->DrawArgs["sphere"].StartIndexLocation;
 	venusRenderItem->BaseVertexLocation = venusRenderItem->Geo->DrawArgs["sphere"].BaseVertexLocation;
+	venusRenderItem->Bounds = venusRenderItem->Geo->DrawArgs["sphere"].Bounds;
 	venusRenderItem->isItemStatic = false;		// moving object
+	venusRenderItem->Occluder = &mSphereOccluder;
+	venusRenderItem->SphereLod = gSphereStartLod;
 	mAllRenderItems.push_back(move(venusRenderItem));
 
 	// 4. earth
@@ -972,14 +1996,17 @@ void SolarSystem::SetRenderingItems()	// combine rendering object data required
 	auto earthRenderItem = make_unique<RenderItem>();
 	XMStoreFloat4x4(&earthRenderItem->World, XMMatrixScaling(scaleFactor, scaleFactor, scaleFactor));
 	XMStoreFloat4x4(&earthRenderItem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-	earthRenderItem->ObjCBIndex = 4;
+	earthRenderItem->InstanceIndex = 4;
 	earthRenderItem->Mat = mMaterials["earth"].get();
-	earthRenderItem->Geo = mGeometries["shapesGeo"].get();
+	earthRenderItem->Geo = mGeometries["spheresGeo"].get();
 	earthRenderItem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 	earthRenderItem->IndexCount = earthRenderItem->Geo->DrawArgs["sphere"].IndexCount;
 	earthRenderItem->StartIndexLocation = earthRenderItem->Geo->DrawArgs["sphere"].StartIndexLocation;
 	earthRenderItem->BaseVertexLocation = earthRenderItem->Geo->DrawArgs["sphere"].BaseVertexLocation;
+	earthRenderItem->Bounds = earthRenderItem->Geo->DrawArgs["sphere"].Bounds;
 	earthRenderItem->isItemStatic = false;		// moving object
+	earthRenderItem->Occluder = &mSphereOccluder;
+	earthRenderItem->SphereLod = gSphereStartLod;
 	mAllRenderItems.push_back(move(earthRenderItem));
 
 	// 5. mars
@@ -987,14 +2014,17 @@ void SolarSystem::SetRenderingItems()	// combine rendering object data required
 	auto marsRenderItem = make_unique<RenderItem>();
 	XMStoreFloat4x4(&marsRenderItem->World, XMMatrixScaling(scaleFactor, scaleFactor, scaleFactor));
 	XMStoreFloat4x4(&marsRenderItem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-	marsRenderItem->ObjCBIndex = 5;
+	marsRenderItem->InstanceIndex = 5;
 	marsRenderItem->Mat = mMaterials["mars"].get();
-	marsRenderItem->Geo = mGeometries["shapesGeo"].get();
+	marsRenderItem->Geo = mGeometries["spheresGeo"].get();
 	marsRenderItem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 	marsRenderItem->IndexCount = marsRenderItem->Geo->DrawArgs["sphere"].IndexCount;
 	marsRenderItem->StartIndexLocation = marsRenderItem->Geo->DrawArgs["sphere"].StartIndexLocation;
 	marsRenderItem->BaseVertexLocation = marsRenderItem->Geo->DrawArgs["sphere"].BaseVertexLocation;
+	marsRenderItem->Bounds = marsRenderItem->Geo->DrawArgs["sphere"].Bounds;
 	marsRenderItem->isItemStatic = false;	// moving object
+	marsRenderItem->Occluder = &mSphereOccluder;
+	marsRenderItem->SphereLod = gSphereStartLod;
 	mAllRenderItems.push_back(move(marsRenderItem));
 
 	// 6. jupiter
@@ -1002,21 +2032,181 @@ void SolarSystem::SetRenderingItems()	// combine rendering object data required
 	auto jupiterRenderItem = make_unique<RenderItem>();
 	XMStoreFloat4x4(&jupiterRenderItem->World, XMMatrixScaling(scaleFactor, scaleFactor, scaleFactor));
 	XMStoreFloat4x4(&jupiterRenderItem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-	jupiterRenderItem->ObjCBIndex = 6;
+	jupiterRenderItem->InstanceIndex = 6;
 	jupiterRenderItem->Mat = mMaterials["gasGiant"].get();
-	jupiterRenderItem->Geo = mGeometries["shapesGeo"].get();
+	jupiterRenderItem->Geo = mGeometries["spheresGeo"].get();
 	jupiterRenderItem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 	jupiterRenderItem->IndexCount = jupiterRenderItem->Geo->DrawArgs["sphere"].IndexCount;
 	jupiterRenderItem->StartIndexLocation = jupiterRenderItem->Geo->DrawArgs["sphere"].StartIndexLocation;
 	jupiterRenderItem->BaseVertexLocation = jupiterRenderItem->Geo->DrawArgs["sphere"].BaseVertexLocation;
+	jupiterRenderItem->Bounds = jupiterRenderItem->Geo->DrawArgs["sphere"].Bounds;
 	jupiterRenderItem->isItemStatic = false;	// moving object
+	jupiterRenderItem->Occluder = &mSphereOccluder;
+	jupiterRenderItem->SphereLod = gSphereStartLod;
 	mAllRenderItems.push_back(move(jupiterRenderItem));
 
 	// all the rendering items are opaque object : 
 	for (auto& elem : mAllRenderItems)
 	{
-		mOpaqueRenderItems.push_back(elem.get());		// store them the relevant container in a primitive pointer type.
+		// store them the relevant container in a primitive pointer type.
+		if (elem->isItemStatic)
+		{
+			mOpaqueStaticRenderItems.push_back(elem.get());
+		}
+		else
+		{
+			mOpaqueDynamicRenderItems.push_back(elem.get());
+		}
+	}
+	mStaticBundleVersion++;
+
+	// give every geometry a small id for the draw sort key, items sharing buffers end up next to each other.
+	unordered_map<MeshGeometry*, UINT> geoSortIds;
+	for (auto& elem : mAllRenderItems)
+	{
+		auto it = geoSortIds.emplace(elem->Geo, (UINT)geoSortIds.size()).first;
+		elem->GeoSortId = it->second;
+		elem->PsoSortId = elem->Geo->CompactVertices ? 1 : 0;		// "opaque" or "opaqueCompact", see mItemPsos
+	}
+}
+
+void SolarSystem::SetTerrain()
+{
+	// the heights are written once, with the workers, then streamed by the loader threads.
+	mTerrainHeights = make_unique<TerrainHeightStreamer>(2, 1024);
+	if (!mTerrainHeights->Open(gTerrainFileName) || mTerrainHeights->TileSize() != gTerrainGridSize ||
+		mTerrainHeights->LevelCount() != gTerrainLevels)
+	{
+		mTerrainHeights = make_unique<TerrainHeightStreamer>(2, 1024);
+		auto start = chrono::high_resolution_clock::now();
+		bool written = WriteTerrainHeights(gTerrainFileName, gTerrainGridSize, gTerrainLevels, TerrainNoiseHeight, mWorkers.get());
+
+		wchar_t text[256];
+		swprintf_s(text, L"***Terrain %S: %s in %.2f ms\n", gTerrainFileName, written ? L"written" : L"could not be written",
+			chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count());
+		OutputDebugString(text);
+
+		if (!written || !mTerrainHeights->Open(gTerrainFileName))
+		{
+			mTerrainHeights.reset();
+			return;			// the planets keep their spheres
+		}
+	}
+
+	mTerrainSettings.GridSize = gTerrainGridSize;
+	mTerrainSettings.HeightScale = gTerrainHeightScale;
+	mTerrainStitch = BuildTerrainStitchIndices(gTerrainGridSize);
+
+	// every planet but the sun has a surface, its patches sort after the geometries of SetRenderingItems.
+	UINT planetCount = 0;
+	for (RenderItem* ri : mOpaqueDynamicRenderItems)
+	{
+		if (ri->Mat != mMaterials["star"].get())
+		{
+			mTerrainTrees.push_back(make_unique<TerrainQuadtree>(mTerrainSettings));
+			ri->Terrain = mTerrainTrees.back().get();
+			planetCount++;
+		}
 	}
+	for (auto& elem : mAllRenderItems)
+	{
+		mTerrainGeoSortId = max(mTerrainGeoSortId, elem->GeoSortId + 1);
+	}
+
+	// enough slots for the patches of every frame in flight and the one being built, each planet drawing at
+	// least its six faces.
+	static_assert(sizeof(TerrainVertex) == sizeof(Vertex), "terrain patches are drawn with the Vertex input layout");
+	const UINT vertexCount = gTerrainGridSize * gTerrainGridSize;
+	const UINT framePatches = gTerrainTriangleBudget / mTerrainTrees[0]->PatchTriangles() + 6 * planetCount;
+	mTerrainSlots.assign((gNumFrameBuffers + 1) * framePatches, TerrainSlot());
+
+	auto geo = make_unique<MeshGeometry>();
+	geo->Name = "terrainGeo";
+	geo->VertexByteStride = sizeof(TerrainVertex);
+	geo->VertexBufferByteSize = (UINT)mTerrainSlots.size() * vertexCount * sizeof(TerrainVertex);
+	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
+	geo->IndexBufferByteSize = (UINT)(mTerrainStitch.Indices.size() * sizeof(uint16_t));
+
+	vector<TerrainVertex> emptySlots(mTerrainSlots.size() * vertexCount, TerrainVertex());
+	geo->VertexBufferGPU = mUploadManager->CreateBuffer(emptySlots.data(), geo->VertexBufferByteSize);
+	geo->IndexBufferGPU = mUploadManager->CreateBuffer(mTerrainStitch.Indices.data(), geo->IndexBufferByteSize);
+	mGeometries[geo->Name] = move(geo);
+}
+
+void SolarSystem::SetUploadTracking()
+{
+	// instance data : static objects are filled here once and never recomputed.
+	// texture transforms are only stored when they differ from identity, entry 0 is shared by all the others.
+	mInstances.assign(mAllRenderItems.size(), InstanceData());
+	mTexTransforms.assign(1, TexTransformData());
+	for (auto& elem : mAllRenderItems)
+	{
+		XMMATRIX world = XMLoadFloat4x4(&elem->World);
+		XMMATRIX texTransform = XMLoadFloat4x4(&elem->TexTransform);
+
+		InstanceData& inst = mInstances[elem->InstanceIndex];
+		XMStoreFloat4x3(&inst.World, world);
+		inst.MaterialIndex = elem->Mat->MatCBIndex;
+		XMStoreFloat3(&elem->Center, world.r[3]);
+
+		elem->TexTransformIndex = 0;
+		if (!XMMatrixIsIdentity(texTransform))
+		{
+			TexTransformData texData;
+			XMStoreFloat4x3(&texData.TexTransform, texTransform);
+			elem->TexTransformIndex = (UINT)mTexTransforms.size();
+			mTexTransforms.push_back(texData);
+		}
+	}
+
+	// material parameters, laid out by MatCBIndex so that the per-frame update never walks mMaterials.
+	mMaterialParameters.assign(mMaterials.size(), MaterialParameter());
+	for (auto& elem : mMaterials)
+	{
+		Material* mat = elem.second.get();
+		XMMATRIX matTransform = XMLoadFloat4x4(&mat->MatTransform);
+
+		MaterialParameter& matParam = mMaterialParameters[mat->MatCBIndex];
+		matParam.DiffuseAlbedo = mat->DiffuseAlbedo;
+		matParam.FresnelR0 = mat->FresnelR0;
+		matParam.Roughness = mat->Roughness;
+		XMStoreFloat4x4(&matParam.MatTransform, XMMatrixTranspose(matTransform));
+		matParam.DiffuseMapIndex = mat->DiffuseSrvHeapIndex;
+	}
+
+	// culling spheres : the static items' are final, the moving items' are replaced every frame.
+	mCullSpheres.Resize(mOpaqueStaticRenderItems.size() + mOpaqueDynamicRenderItems.size());
+	for (size_t i = 0; i < mOpaqueStaticRenderItems.size(); ++i)
+	{
+		const RenderItem* ri = mOpaqueStaticRenderItems[i];
+		BoundingSphere sphere;
+		BoundingSphere::CreateFromBoundingBox(sphere, ri->Bounds);
+		sphere.Transform(sphere, XMLoadFloat4x4(&ri->World));
+		mCullSpheres.Set(i, sphere.Center.x, sphere.Center.y, sphere.Center.z, sphere.Radius);
+	}
+	mVisibleDynamicRenderItems.reserve(mOpaqueDynamicRenderItems.size());
+
+	// everything starts out dirty for every frame buffer.
+	mObjectSlots.Reset((UINT)mInstances.size(), gNumFrameBuffers);
+	mTexTransformSlots.Reset((UINT)mTexTransforms.size(), gNumFrameBuffers);
+	mMaterialSlots.Reset((UINT)mMaterialParameters.size(), gNumFrameBuffers);
+}
+
+wstring SolarSystem::FrameStatsText()const
+{
+	return L"   upload: " + to_wstring(mUploadedBytes) + L" B/frame" +
+		L"   state changes: " + to_wstring(mDrawStats.Issued) + L"/" + to_wstring(mDrawStats.Requested) +
+		L"   barriers: " + to_wstring(mBarrierStats.Barriers) + L" in " + to_wstring(mBarrierStats.Batches) + L" batches" +
+		L"   sort: " + to_wstring((int)mSortMicroseconds) + L" us" +
+		L"   culled: " + to_wstring(mCulledItems) + L"/" + to_wstring(mCullSpheres.Size()) + L" in " + to_wstring((int)mCullMicroseconds) + L" us" +
+		L" (bvh " + to_wstring(mSceneBvh->Stats().Nodes) + L" nodes, " + to_wstring(mSceneBvh->Stats().Rebuilds) + L" rebuilds)" +
+		L"   lod tris: " + to_wstring(mLodTriangles) + L", impostors: " + to_wstring(mVisibleImpostors.size()) + (mRayTracedSpheres ? L" (all ray traced)" : L"") +
+		L"   terrain: " + to_wstring(mTerrainTriangles) + L" tris in " + to_wstring(mTerrainPatches) + L" patches, " + to_wstring(mTerrainBuilt) + L" built" +
+		L"   occluded: " + to_wstring(mOccludedItems) + L" by " + to_wstring(mOccluders.size()) + L" (" + to_wstring(mOcclusion.Stats().Rasterized) + L" tris)" +
+		L"   sim/render: " + to_wstring((int)mSimMicroseconds) + L"/" + to_wstring((int)mRenderMicroseconds) + L" us" +
+		L"   latency: " + to_wstring((int)(mLatencyMicroseconds / 1000.0)) + L"." + to_wstring((int)(mLatencyMicroseconds / 100.0) % 10) + L" ms" +
+		L"   bundle: " + to_wstring(mOpaqueStaticRenderItems.size()) + L" draws, record " + to_wstring((int)mBundleRecordMicroseconds) + L" us" +
+		mCaptureStatus;
 }
 
 // get static samplers for texture mapping
@@ -0,0 +1,126 @@
+// BenchMeshes.h : the meshes of GeometryGenerator rebuilt for the headless tools, which can't include it
+// (it pulls in DirectXMath), in the same vertex and index order as CreateSphere, CreateGrid and
+// CreateGeosphere.  Positions only, plus texture coordinates for the sphere and the grid; a tool needing
+// another vertex layout builds it from these.
+
+#pragma once
+
+#include "../Helpers/MeshSubdivision.h"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+struct BenchMesh
+{
+	const char* Name;
+	std::vector<float> Positions;		// x, y, z per vertex
+	std::vector<float> TexCoords;		// u, v per vertex, when the generator makes them
+	std::vector<std::uint32_t> Indices;
+
+	std::uint32_t VertexCount()const { return (std::uint32_t)(Positions.size() / 3); }
+};
+
+static const float BenchPi = 3.14159265f;
+
+// CreateSphere's order : the top pole, the rings from the top with a seam vertex closing each, the bottom pole.
+inline BenchMesh MakeSphere(std::uint32_t slices, std::uint32_t stacks)
+{
+	BenchMesh mesh;
+	mesh.Name = "sphere";
+	mesh.Positions.insert(mesh.Positions.end(), { 0.0f, 1.0f, 0.0f });
+	mesh.TexCoords.insert(mesh.TexCoords.end(), { 0.0f, 0.0f });
+	for (std::uint32_t i = 1; i < stacks; ++i)
+	{
+		float phi = i * BenchPi / stacks;
+		for (std::uint32_t j = 0; j <= slices; ++j)
+		{
+			float theta = j * 2.0f * BenchPi / slices;
+			mesh.Positions.insert(mesh.Positions.end(), { std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta) });
+			mesh.TexCoords.insert(mesh.TexCoords.end(), { theta / (2.0f * BenchPi), phi / BenchPi });
+		}
+	}
+	mesh.Positions.insert(mesh.Positions.end(), { 0.0f, -1.0f, 0.0f });
+	mesh.TexCoords.insert(mesh.TexCoords.end(), { 0.0f, 1.0f });
+
+	for (std::uint32_t i = 1; i <= slices; ++i)
+	{
+		mesh.Indices.insert(mesh.Indices.end(), { 0, i + 1, i });
+	}
+	std::uint32_t ring = slices + 1;
+	for (std::uint32_t i = 0; i < stacks - 2; ++i)
+	{
+		for (std::uint32_t j = 0; j < slices; ++j)
+		{
+			std::uint32_t a = 1 + i * ring + j, c = a + ring;
+			mesh.Indices.insert(mesh.Indices.end(), { a, a + 1, c, c, a + 1, c + 1 });
+		}
+	}
+	std::uint32_t southPole = mesh.VertexCount() - 1;
+	std::uint32_t base = southPole - ring;
+	for (std::uint32_t i = 0; i < slices; ++i)
+	{
+		mesh.Indices.insert(mesh.Indices.end(), { southPole, base + i, base + i + 1 });
+	}
+	return mesh;
+}
+
+// CreateGrid's order : m rows of n vertices over the unit square facing up, two triangles per quad row by row.
+inline BenchMesh MakeGrid(std::uint32_t m, std::uint32_t n)
+{
+	BenchMesh mesh;
+	mesh.Name = "grid";
+	for (std::uint32_t i = 0; i < m; ++i)
+	{
+		for (std::uint32_t j = 0; j < n; ++j)
+		{
+			mesh.Positions.insert(mesh.Positions.end(), { -0.5f + j / float(n - 1), 0.0f, 0.5f - i / float(m - 1) });
+			mesh.TexCoords.insert(mesh.TexCoords.end(), { j / float(n - 1), i / float(m - 1) });
+		}
+	}
+	for (std::uint32_t i = 0; i < m - 1; ++i)
+	{
+		for (std::uint32_t j = 0; j < n - 1; ++j)
+		{
+			std::uint32_t a = i * n + j, c = a + n;
+			mesh.Indices.insert(mesh.Indices.end(), { a, a + 1, c, c, a + 1, c + 1 });
+		}
+	}
+	return mesh;
+}
+
+// CreateGeosphere's order : an icosahedron subdivided by SubdivideTriangles, the midpoints after the vertices
+// they split.  Tools using it also build Helpers\MeshSubdivision.cpp and Helpers\WorkerPool.cpp.
+inline BenchMesh MakeGeosphere(std::uint32_t subdivisions)
+{
+	const float X = 0.525731f, Z = 0.850651f;
+	BenchMesh mesh;
+	mesh.Name = "geosphere";
+	mesh.Positions = { -X, 0, Z,  X, 0, Z,  -X, 0, -Z,  X, 0, -Z,  0, Z, X,  0, Z, -X,
+		0, -Z, X,  0, -Z, -X,  Z, X, 0,  -Z, X, 0,  Z, -X, 0,  -Z, -X, 0 };
+	mesh.Indices = { 1,4,0, 4,9,0, 4,5,9, 8,5,4, 1,8,4, 1,10,8, 10,3,8, 8,3,5, 3,2,5, 3,7,2,
+		3,10,7, 10,6,7, 6,11,7, 6,0,11, 6,1,0, 10,1,6, 11,0,9, 2,11,9, 5,2,9, 11,2,7 };
+
+	std::vector<std::uint32_t> midpoints;
+	for (std::uint32_t s = 0; s < subdivisions; ++s)
+	{
+		std::uint32_t vertexCount = mesh.VertexCount();
+		SubdivideTriangles(mesh.Indices, vertexCount, midpoints);
+		mesh.Positions.resize(mesh.Positions.size() + midpoints.size() / 2 * 3);
+		for (std::size_t i = 0; i < midpoints.size() / 2; ++i)
+		{
+			for (int k = 0; k < 3; ++k)
+				mesh.Positions[(vertexCount + i) * 3 + k] = 0.5f * (mesh.Positions[midpoints[i * 2] * 3 + k] + mesh.Positions[midpoints[i * 2 + 1] * 3 + k]);
+		}
+	}
+
+	// projected onto the unit sphere like CreateGeosphere does.
+	for (std::size_t i = 0; i < mesh.Positions.size(); i += 3)
+	{
+		float* p = &mesh.Positions[i];
+		float length = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+		for (int k = 0; k < 3; ++k)
+			p[k] /= length;
+	}
+	return mesh;
+}
@@ -0,0 +1,249 @@
+// BvhBench.cpp : SphereBvh (Helpers/SphereBvh.h) against brute force culling on moving objects.
+//
+// 1k to 1M spheres orbit a point in front of a camera with a 45 degree field of view.  Every frame moves
+// them along their orbits, updates the tree (refit, or rebuild once it has become too loose) and culls
+// them against the frustum, with the tree and with the brute force SIMD kernel.  Reports the build, refit
+// and median query times, the rays cast per microsecond, and checks every query against a brute force
+// answer.  The tree is built at every count, under SphereBvh::DefaultBruteForceMax too : the sweep gives
+// the object count from which its frustum query beats the brute force kernel, where that default belongs.
+//   cl /O2 /EHsc Tools\BvhBench.cpp Helpers\SphereBvh.cpp Helpers\FrustumCulling.cpp Helpers\WorkerPool.cpp
+//
+// usage : BvhBench [frame count]
+
+#include "../Helpers/SphereBvh.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+struct Orbit
+{
+	float Radius;
+	float Height;
+	float Rate;
+	float Phase;
+	float Size;
+};
+
+static CullFrustum BenchFrustum(float fovY, float aspect, float nearZ, float farZ)
+{
+	float yScale = 1.0f / std::tan(0.5f * fovY);
+	float xScale = yScale / aspect;
+	float range = farZ / (farZ - nearZ);
+
+	float viewProj[4][4] =
+	{
+		{ xScale, 0.0f, 0.0f, 0.0f },
+		{ 0.0f, yScale, 0.0f, 0.0f },
+		{ 0.0f, 0.0f, range, 1.0f },
+		{ 0.0f, 0.0f, -range * nearZ, 0.0f },
+	};
+	return CullFrustum::FromViewProj(viewProj);
+}
+
+static void MoveSpheres(const std::vector<Orbit>& orbits, float time, SphereCullSet& spheres)
+{
+	for (std::size_t i = 0; i < orbits.size(); ++i)
+	{
+		const Orbit& orbit = orbits[i];
+		float angle = orbit.Phase + orbit.Rate * time;
+		spheres.Set(i, orbit.Radius * std::cos(angle), orbit.Height, 600.0f + orbit.Radius * std::sin(angle), orbit.Size);
+	}
+}
+
+static double Since(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static bool SameSet(std::vector<std::uint32_t> a, std::uint32_t aCount, std::vector<std::uint32_t> b, std::uint32_t bCount)
+{
+	if (aCount != bCount)
+	{
+		return false;
+	}
+	std::sort(a.begin(), a.begin() + aCount);
+	std::sort(b.begin(), b.begin() + bCount);
+	return std::equal(a.begin(), a.begin() + aCount, b.begin());
+}
+
+int main(int argc, char* argv[])
+{
+	int frames = argc > 1 ? std::atoi(argv[1]) : 60;
+	if (frames < 1)
+	{
+		frames = 1;
+	}
+
+	WorkerPool workers;
+	CullFrustum frustum = BenchFrustum(0.25f * 3.14159265f, 16.0f / 9.0f, 1.0f, 1000.0f);
+	const std::uint32_t counts[] = { 1000, 2000, 4000, 8000, 16000, 32000, 64000, 100000, 1000000 };
+
+	std::uint32_t crossover = 0;		// the smallest count from which the tree wins at every count measured
+
+	std::printf("threads : %u\n", workers.ThreadCount());
+	std::printf("%9s %9s %8s %9s %9s %9s %9s %9s %8s %9s\n", "objects", "visible", "depth", "build us", "refit us", "rebuilds",
+		"bvh us", "brute us", "cost", "rays/us");
+
+	for (std::uint32_t count : counts)
+	{
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> radius(10.0f, 2000.0f);
+		std::uniform_real_distribution<float> height(-600.0f, 600.0f);
+		std::uniform_real_distribution<float> rate(0.05f, 0.5f);
+		std::uniform_real_distribution<float> phase(0.0f, 6.2831853f);
+		std::uniform_real_distribution<float> size(0.5f, 5.0f);
+
+		std::vector<Orbit> orbits(count);
+		for (Orbit& orbit : orbits)
+		{
+			orbit = { radius(random), height(random), rate(random), phase(random), size(random) };
+		}
+
+		SphereCullSet spheres;
+		spheres.Resize(count);
+		MoveSpheres(orbits, 0.0f, spheres);
+
+		// a tree at every count, even under the brute force threshold, to find where it starts to pay.
+		SphereBvh bvh(&workers);
+		bvh.SetBruteForceMax(0);
+		bvh.Build(spheres);
+		double buildUs = bvh.Stats().BuildMicroseconds;
+
+		std::vector<std::uint32_t> bvhVisible(spheres.PaddedSize());
+		std::vector<std::uint32_t> bruteVisible(spheres.PaddedSize());
+		double refitUs = 0.0;
+		std::vector<double> bvhUs, bruteUs;
+		std::uint32_t rebuilds = 0, visible = 0;
+
+		for (int frame = 1; frame <= frames; ++frame)
+		{
+			MoveSpheres(orbits, frame * (1.0f / 60.0f), spheres);
+
+			if (bvh.Update(spheres))
+			{
+				rebuilds++;
+				buildUs = bvh.Stats().BuildMicroseconds;
+			}
+			else
+			{
+				refitUs += bvh.Stats().RefitMicroseconds;
+			}
+
+			auto start = std::chrono::high_resolution_clock::now();
+			std::uint32_t bvhCount = bvh.QueryFrustum(frustum, bvhVisible.data());
+			bvhUs.push_back(Since(start));
+
+			start = std::chrono::high_resolution_clock::now();
+			std::uint32_t bruteCount = CullSpheres(frustum, spheres, bruteVisible.data());
+			bruteUs.push_back(Since(start));
+
+			if (!SameSet(bvhVisible, bvhCount, bruteVisible, bruteCount))
+			{
+				std::printf("frustum query differs from brute force : %u objects, frame %d\n", count, frame);
+				return 1;
+			}
+			visible = bvhCount;
+		}
+
+		// sphere queries and rays, checked against brute force on a few of them.
+		std::uniform_real_distribution<float> spread(-1.0f, 1.0f);
+		for (int q = 0; q < 8; ++q)
+		{
+			float x = 1000.0f * spread(random), y = 300.0f * spread(random), z = 600.0f + 1000.0f * spread(random), r = 50.0f;
+			std::uint32_t bvhCount = bvh.QuerySphere(x, y, z, r, bvhVisible.data());
+			std::uint32_t bruteCount = 0;
+			for (std::uint32_t i = 0; i < count; ++i)
+			{
+				float dx = spheres.X()[i] - x, dy = spheres.Y()[i] - y, dz = spheres.Z()[i] - z, reach = spheres.R()[i] + r;
+				if (dx * dx + dy * dy + dz * dz <= reach * reach)
+					bruteVisible[bruteCount++] = i;
+			}
+			if (!SameSet(bvhVisible, bvhCount, bruteVisible, bruteCount))
+			{
+				std::printf("sphere query differs from brute force : %u objects\n", count);
+				return 1;
+			}
+		}
+
+		const int rayCount = 10000;
+		std::vector<float> directions(rayCount * 3);
+		for (int i = 0; i < rayCount; ++i)
+		{
+			float d[3] = { spread(random), 0.3f * spread(random), 1.0f };
+			float length = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+			for (int k = 0; k < 3; ++k)
+				directions[i * 3 + k] = d[k] / length;
+		}
+
+		const float origin[3] = { 0.0f, 0.0f, 0.0f };
+		std::uint32_t hits = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < rayCount; ++i)
+		{
+			std::uint32_t object;
+			float t;
+			hits += bvh.Raycast(origin, &directions[i * 3], 5000.0f, object, t) ? 1 : 0;
+		}
+		double rayUs = Since(start);
+
+		for (int i = 0; i < 4; ++i)
+		{
+			const float* d = &directions[i * 3];
+			float bestT = 5000.0f;
+			bool bruteHit = false;
+			for (std::uint32_t s = 0; s < count; ++s)
+			{
+				float oc[3] = { -spheres.X()[s], -spheres.Y()[s], -spheres.Z()[s] };
+				float b = oc[0] * d[0] + oc[1] * d[1] + oc[2] * d[2];
+				float c = oc[0] * oc[0] + oc[1] * oc[1] + oc[2] * oc[2] - spheres.R()[s] * spheres.R()[s];
+				float disc = b * b - c;
+				if (disc < 0.0f)
+					continue;
+				float t = -b - std::sqrt(disc);
+				if (t >= 0.0f && t <= bestT)
+				{
+					bestT = t;
+					bruteHit = true;
+				}
+			}
+
+			std::uint32_t object;
+			float t = 0.0f;
+			bool bvhHit = bvh.Raycast(origin, d, 5000.0f, object, t);
+			if (bvhHit != bruteHit || (bvhHit && std::fabs(t - bestT) > 1e-3f * bestT))
+			{
+				std::printf("ray differs from brute force : %u objects\n", count);
+				return 1;
+			}
+		}
+
+		// medians, a background rebuild sharing the core only slows down a few frames.
+		std::nth_element(bvhUs.begin(), bvhUs.begin() + frames / 2, bvhUs.end());
+		std::nth_element(bruteUs.begin(), bruteUs.begin() + frames / 2, bruteUs.end());
+		double bvhMedian = bvhUs[frames / 2], bruteMedian = bruteUs[frames / 2];
+		if (bvhMedian >= bruteMedian)
+		{
+			crossover = 0;
+		}
+		else if (crossover == 0)
+		{
+			crossover = count;
+		}
+
+		std::printf("%9u %9u %8u %9.0f %9.0f %9u %9.1f %9.1f %8.1f %9.2f\n", count, visible, bvh.Stats().Depth, buildUs,
+			refitUs / std::max(1u, frames - rebuilds), rebuilds, bvhMedian, bruteMedian, bvh.Stats().Cost, rayCount / rayUs);
+		(void)hits;
+	}
+
+	if (crossover != 0)
+		std::printf("the tree's frustum query is faster from %u objects on, SphereBvh::DefaultBruteForceMax is %u\n", crossover,
+			SphereBvh::DefaultBruteForceMax);
+	else
+		std::printf("the tree's frustum query is slower than brute force at every count\n");
+	return 0;
+}
@@ -0,0 +1,107 @@
+// FrustumCullBench.cpp : throughput of the sphere frustum culling kernel (Helpers/FrustumCulling.h).
+//
+// Scatters 1k to 1M spheres around a camera looking down +z with a 45 degree field of view, about one in
+// twenty of them in view, and reports how many objects per microsecond the SIMD kernel and the scalar
+// reference get through.  Both visible lists are compared, a mismatch fails the run.
+//   cl /O2 /EHsc Tools\FrustumCullBench.cpp Helpers\FrustumCulling.cpp
+//   cl /O2 /EHsc /arch:AVX Tools\FrustumCullBench.cpp Helpers\FrustumCulling.cpp
+//
+// usage : FrustumCullBench [repeat count]
+
+#include "../Helpers/FrustumCulling.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// row vector perspective projection (XMMatrixPerspectiveFovLH) of a camera at the origin looking down +z,
+// the view matrix being the identity.
+static CullFrustum BenchFrustum(float fovY, float aspect, float nearZ, float farZ)
+{
+	float yScale = 1.0f / std::tan(0.5f * fovY);
+	float xScale = yScale / aspect;
+	float range = farZ / (farZ - nearZ);
+
+	float viewProj[4][4] =
+	{
+		{ xScale, 0.0f, 0.0f, 0.0f },
+		{ 0.0f, yScale, 0.0f, 0.0f },
+		{ 0.0f, 0.0f, range, 1.0f },
+		{ 0.0f, 0.0f, -range * nearZ, 0.0f },
+	};
+	return CullFrustum::FromViewProj(viewProj);
+}
+
+template<typename Fn>
+static double MeasureMicroseconds(int repeat, Fn fn)
+{
+	fn();		// warm up
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < repeat; ++r)
+	{
+		fn();
+	}
+	return std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count() / repeat;
+}
+
+int main(int argc, char* argv[])
+{
+	int repeat = argc > 1 ? std::atoi(argv[1]) : 50;
+	if (repeat < 1)
+	{
+		repeat = 1;
+	}
+
+#if FRUSTUM_CULL_AVX
+	const char* kernel = "AVX";
+#elif FRUSTUM_CULL_SSE
+	const char* kernel = "SSE";
+#else
+	const char* kernel = "scalar";
+#endif
+
+	CullFrustum frustum = BenchFrustum(0.25f * 3.14159265f, 16.0f / 9.0f, 1.0f, 1000.0f);
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+	std::uniform_real_distribution<float> radius(0.5f, 20.0f);
+
+	const std::uint32_t counts[] = { 1000, 10000, 100000, 1000000 };
+
+	std::printf("kernel : %s\n", kernel);
+	std::printf("%10s %10s %14s %14s  (objects/us)\n", "objects", "visible", "simd", "scalar");
+	for (std::uint32_t count : counts)
+	{
+		SphereCullSet spheres;
+		spheres.Resize(count);
+		for (std::uint32_t i = 0; i < count; ++i)
+		{
+			spheres.Set(i, position(random), position(random), position(random), radius(random));
+		}
+
+		std::vector<std::uint32_t> simdVisible(spheres.PaddedSize());
+		std::vector<std::uint32_t> scalarVisible(spheres.PaddedSize());
+		std::uint32_t simdCount = 0;
+		std::uint32_t scalarCount = 0;
+
+		double simdUs = MeasureMicroseconds(repeat, [&]() { simdCount = CullSpheres(frustum, spheres, simdVisible.data()); });
+		double scalarUs = MeasureMicroseconds(repeat, [&]() { scalarCount = CullSpheresScalar(frustum, spheres, scalarVisible.data()); });
+
+		bool same = simdCount == scalarCount;
+		for (std::uint32_t i = 0; same && i < simdCount; ++i)
+		{
+			same = simdVisible[i] == scalarVisible[i];
+		}
+		if (!same)
+		{
+			std::printf("visible lists differ for %u objects\n", count);
+			return 1;
+		}
+
+		std::printf("%10u %10u %14.1f %14.1f\n", count, simdCount, count / simdUs, count / scalarUs);
+	}
+
+	return 0;
+}
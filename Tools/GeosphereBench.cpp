@@ -0,0 +1,186 @@
+// GeosphereBench.cpp : CreateGeosphere's subdivision, the indexed one of Helpers/MeshSubdivision.h against
+// the one it replaced, which gave every input triangle six vertices of its own.
+//
+// Subdivides the icosahedron up to 8 levels and checks every level :
+//   - the mesh is watertight : every edge is used by exactly two triangles, once in each direction, and
+//     V - E + F = 2,
+//   - no two vertices share a position, and there are 10 * 4^level + 2 of them,
+//   - once projected on the sphere, its vertices are the same points the old subdivision gave,
+//   - the threaded subdivision gives the same mesh, index for index, as the single threaded one.
+// Reports the vertex counts and the time of both subdivisions, single threaded and on a WorkerPool.
+//   cl /O2 /EHsc Tools\GeosphereBench.cpp Helpers\MeshSubdivision.cpp Helpers\WorkerPool.cpp
+//
+// usage : GeosphereBench [levels]
+
+#include "../Helpers/MeshSubdivision.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+struct Mesh
+{
+	std::vector<float> Positions;		// x, y, z per vertex
+	std::vector<std::uint32_t> Indices;
+};
+
+static Mesh Icosahedron()
+{
+	const float X = 0.525731f, Z = 0.850651f;
+	Mesh mesh;
+	mesh.Positions = { -X, 0, Z,  X, 0, Z,  -X, 0, -Z,  X, 0, -Z,  0, Z, X,  0, Z, -X,
+		0, -Z, X,  0, -Z, -X,  Z, X, 0,  -Z, X, 0,  Z, -X, 0,  -Z, -X, 0 };
+	mesh.Indices = { 1,4,0, 4,9,0, 4,5,9, 8,5,4, 1,8,4, 1,10,8, 10,3,8, 8,3,5, 3,2,5, 3,7,2,
+		3,10,7, 10,6,7, 6,11,7, 6,0,11, 6,1,0, 10,1,6, 11,0,9, 2,11,9, 5,2,9, 11,2,7 };
+	return mesh;
+}
+
+// the old GeometryGenerator::Subdivide, positions only.
+static void SubdivideCopying(Mesh& mesh)
+{
+	Mesh input = mesh;
+	mesh.Positions.clear();
+	mesh.Indices.clear();
+	for (std::uint32_t i = 0; i < input.Indices.size() / 3; ++i)
+	{
+		const float* v[3] = { &input.Positions[input.Indices[i * 3] * 3], &input.Positions[input.Indices[i * 3 + 1] * 3], &input.Positions[input.Indices[i * 3 + 2] * 3] };
+		for (int k = 0; k < 3; ++k)
+			mesh.Positions.insert(mesh.Positions.end(), v[k], v[k] + 3);
+		const int mids[3][2] = { { 0, 1 }, { 1, 2 }, { 0, 2 } };
+		for (const auto& mid : mids)
+			for (int k = 0; k < 3; ++k)
+				mesh.Positions.push_back(0.5f * (v[mid[0]][k] + v[mid[1]][k]));
+
+		std::uint32_t b = i * 6;
+		mesh.Indices.insert(mesh.Indices.end(), { b, b + 3, b + 5, b + 3, b + 4, b + 5, b + 5, b + 4, b + 2, b + 3, b + 1, b + 4 });
+	}
+}
+
+// the new one, with the midpoints appended the way GeometryGenerator::Subdivide does.
+static void SubdivideIndexed(Mesh& mesh, WorkerPool* workers)
+{
+	std::vector<std::uint32_t> midpoints;
+	std::uint32_t vertexCount = (std::uint32_t)(mesh.Positions.size() / 3);
+	SubdivideTriangles(mesh.Indices, vertexCount, midpoints, workers);
+	mesh.Positions.resize(mesh.Positions.size() + midpoints.size() / 2 * 3);
+	for (std::size_t i = 0; i < midpoints.size() / 2; ++i)
+	{
+		for (int k = 0; k < 3; ++k)
+			mesh.Positions[(vertexCount + i) * 3 + k] = 0.5f * (mesh.Positions[midpoints[i * 2] * 3 + k] + mesh.Positions[midpoints[i * 2 + 1] * 3 + k]);
+	}
+}
+
+// the vertices projected on the unit sphere, sorted, without duplicates.
+static std::vector<std::array<float, 3>> SpherePoints(const Mesh& mesh)
+{
+	std::vector<std::array<float, 3>> points;
+	for (std::size_t i = 0; i < mesh.Positions.size(); i += 3)
+	{
+		const float* p = &mesh.Positions[i];
+		float length = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+		points.push_back({ { p[0] / length, p[1] / length, p[2] / length } });
+	}
+	std::sort(points.begin(), points.end());
+	points.erase(std::unique(points.begin(), points.end()), points.end());
+	return points;
+}
+
+static bool Watertight(const Mesh& mesh, const char** problem)
+{
+	// directed edges, sorted : each one has to appear once, and its reverse as well.
+	std::vector<std::uint64_t> edges;
+	for (std::size_t t = 0; t < mesh.Indices.size(); t += 3)
+	{
+		for (int e = 0; e < 3; ++e)
+			edges.push_back((std::uint64_t)mesh.Indices[t + e] << 32 | mesh.Indices[t + (e + 1) % 3]);
+	}
+	std::sort(edges.begin(), edges.end());
+	if (std::adjacent_find(edges.begin(), edges.end()) != edges.end())
+	{
+		*problem = "an edge is used twice in the same direction";
+		return false;
+	}
+	for (std::uint64_t edge : edges)
+	{
+		if (!std::binary_search(edges.begin(), edges.end(), edge << 32 | edge >> 32))
+		{
+			*problem = "an edge is used by one triangle only";
+			return false;
+		}
+	}
+
+	std::int64_t vertices = (std::int64_t)(mesh.Positions.size() / 3), faces = (std::int64_t)(mesh.Indices.size() / 3);
+	if (vertices - (std::int64_t)edges.size() / 2 + faces != 2)
+	{
+		*problem = "V - E + F isn't 2";
+		return false;
+	}
+	return true;
+}
+
+static double Since(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+	std::uint32_t levels = argc > 1 ? (std::uint32_t)std::atoi(argv[1]) : 8;
+	levels = std::min(levels, 9u);
+
+	// a few workers even on small machines, so the determinism check sees the chunks race.
+	WorkerPool workers(std::max(3u, WorkerPool::DefaultWorkerCount()));
+	Mesh copying = Icosahedron(), single = Icosahedron(), threaded = Icosahedron();
+	for (std::uint32_t level = 1; level <= levels; ++level)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		SubdivideCopying(copying);
+		double copyingMs = Since(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		SubdivideIndexed(single, nullptr);
+		double singleMs = Since(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		SubdivideIndexed(threaded, &workers);
+		double threadedMs = Since(start);
+
+		const char* problem = nullptr;
+		if (!Watertight(single, &problem))
+		{
+			std::printf("level %u : %s\n", level, problem);
+			return 1;
+		}
+
+		std::size_t vertexCount = single.Positions.size() / 3;
+		std::size_t expected = 10 * ((std::size_t)1 << (2 * level)) + 2;
+		std::vector<std::array<float, 3>> points = SpherePoints(single);
+		if (vertexCount != expected || points.size() != vertexCount)
+		{
+			std::printf("level %u : %zu vertices at %zu points, expected %zu\n", level, vertexCount, points.size(), expected);
+			return 1;
+		}
+
+		// both subdivisions average the same parents in the same order, so the points match exactly.
+		if (points != SpherePoints(copying))
+		{
+			std::printf("level %u : the vertices differ from the copying subdivision's\n", level);
+			return 1;
+		}
+
+		if (threaded.Indices != single.Indices || threaded.Positions != single.Positions)
+		{
+			std::printf("level %u : the threaded subdivision differs from the single threaded one\n", level);
+			return 1;
+		}
+
+		std::printf("level %u : %8zu tris  %8zu vertices, copying %8zu (%4.1fx)   copying %8.2f ms  indexed %8.2f ms  on %u threads %8.2f ms\n",
+			level, single.Indices.size() / 3, vertexCount, copying.Positions.size() / 3, (copying.Positions.size() / 3) / double(vertexCount),
+			copyingMs, singleMs, workers.ThreadCount(), threadedMs);
+	}
+	return 0;
+}
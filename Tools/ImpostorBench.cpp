@@ -0,0 +1,181 @@
+// ImpostorBench.cpp : checks the ray traced sphere impostor math (Helpers/SphereImpostor.h) that
+// ImpostorVS / ImpostorPS in Shaders/BasicShader.hlsl implement, and times the per pixel intersection.
+//
+// For spheres from close ups to far away and off axis :
+//   - points spread over each sphere have to project inside its quad, and the quad may not be looser
+//     than their bounds by more than a fraction of a pixel,
+//   - the ray through the projection of a front facing surface point has to hit that very point, with
+//     the depth of its view z, and rays through the quad have to hit the surface or miss it,
+//   - the texture coordinates of the surface have to match GeometryGenerator::CreateSphere's vertices.
+//   cl /O2 /EHsc Tools\ImpostorBench.cpp Helpers\SphereImpostor.cpp
+//
+// usage : ImpostorBench [sphere count]
+
+#include "../Helpers/SphereImpostor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+static const float Pi = 3.14159265f;
+
+static bool Fail(const char* what, int sphere)
+{
+	std::printf("%s, sphere %d\n", what, sphere);
+	return false;
+}
+
+static bool CheckSphere(int index, const float center[3], float radius, const ImpostorProjection& projection, float pixel,
+	std::mt19937& random)
+{
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	ImpostorQuad quad = SphereImpostorQuad(center, radius, projection);
+	bool fullScreen = center[2] - radius <= projection.NearZ;
+
+	// bounds of points spread over the sphere.
+	float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+	for (int i = 0; i < 20000; ++i)
+	{
+		float n[3] = { unit(random), unit(random), unit(random) };
+		float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length < 1e-3f)
+			continue;
+		float p[3] = { center[0] + radius * n[0] / length, center[1] + radius * n[1] / length, center[2] + radius * n[2] / length };
+		if (p[2] <= projection.NearZ)
+			continue;
+
+		float x = p[0] * projection.P00 / p[2], y = p[1] * projection.P11 / p[2];
+		minX = std::min(minX, x); maxX = std::max(maxX, x);
+		minY = std::min(minY, y); maxY = std::max(maxY, y);
+
+		// front facing points are what the ray through their pixel has to find.
+		float toEye = -(n[0] * p[0] + n[1] * p[1] + n[2] * p[2]);
+		if (toEye > 1e-2f * length * std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]))
+		{
+			ImpostorHit hit;
+			if (!SphereImpostorHit(x, y, center, radius, projection, hit))
+				return Fail("the ray through a front facing point misses", index);
+			for (int k = 0; k < 3; ++k)
+				if (std::fabs(hit.PositionV[k] - p[k]) > 1e-3f * (radius + p[2]))
+					return Fail("the ray through a front facing point hits elsewhere", index);
+			if (std::fabs(hit.Depth - projection.Depth(p[2])) > 1e-4f)
+				return Fail("hit depth differs from the depth of the point", index);
+		}
+	}
+
+	if (fullScreen)
+	{
+		if (quad.MinX != -1.0f || quad.MaxX != 1.0f || quad.MinY != -1.0f || quad.MaxY != 1.0f || quad.Depth != 0.0f)
+			return Fail("a sphere reaching in front of the near plane does not get the whole screen", index);
+	}
+	else
+	{
+		float slack = 1e-4f * std::max(1.0f, std::max(std::fabs(minX), std::fabs(maxX)));
+		if (minX < quad.MinX - slack || maxX > quad.MaxX + slack || minY < quad.MinY - slack || maxY > quad.MaxY + slack)
+			return Fail("the quad does not cover the sphere", index);
+		if (quad.MinX < minX - pixel || quad.MaxX > maxX + pixel || quad.MinY < minY - pixel || quad.MaxY > maxY + pixel)
+			return Fail("the quad is more than a pixel larger than the sphere", index);
+		if (std::fabs(quad.Depth - projection.Depth(center[2] - radius)) > 1e-6f)
+			return Fail("the quad is not at the depth of the nearest point", index);
+	}
+
+	// rays through the quad : hits are on the surface, in front of the center, and facing the eye.
+	for (int i = 0; i < 2000; ++i)
+	{
+		float x = quad.MinX + (quad.MaxX - quad.MinX) * (0.5f + 0.5f * unit(random));
+		float y = quad.MinY + (quad.MaxY - quad.MinY) * (0.5f + 0.5f * unit(random));
+		ImpostorHit hit;
+		if (!SphereImpostorHit(x, y, center, radius, projection, hit))
+			continue;
+
+		float distance = 0.0f, facing = 0.0f;
+		for (int k = 0; k < 3; ++k)
+		{
+			float d = hit.PositionV[k] - center[k];
+			distance += d * d;
+			facing += hit.NormalV[k] * hit.PositionV[k];
+		}
+		if (std::fabs(std::sqrt(distance) - radius) > 1e-3f * radius)
+			return Fail("a hit is off the surface", index);
+		if (facing > 1e-3f * radius)
+			return Fail("a hit faces away from the eye", index);
+	}
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	int sphereCount = argc > 1 ? std::atoi(argv[1]) : 200;
+	if (sphereCount < 1)
+	{
+		sphereCount = 1;
+	}
+
+	// the camera of the sample : 45 degrees vertical field of view, 16:9, near 1, far 1000, 1080 pixels high.
+	const float nearZ = 1.0f, farZ = 1000.0f;
+	ImpostorProjection projection;
+	projection.P11 = 1.0f / std::tan(0.125f * Pi);
+	projection.P00 = projection.P11 * 9.0f / 16.0f;
+	projection.P22 = farZ / (farZ - nearZ);
+	projection.P32 = -nearZ * farZ / (farZ - nearZ);
+	projection.NearZ = nearZ;
+	const float pixel = 2.0f / 1080.0f;
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> logDistance(0.0f, 6.0f);
+
+	for (int i = 0; i < sphereCount; ++i)
+	{
+		// from a few radii away to the far plane, the close ones partly through the near plane.
+		float radius = 0.2f + 9.8f * (0.5f + 0.5f * unit(random));
+		float distance = radius * (0.9f + std::exp(logDistance(random)));
+		float center[3] = { 0.6f * distance * unit(random), 0.4f * distance * unit(random), distance };
+		if (!CheckSphere(i, center, radius, projection, pixel, random))
+			return 1;
+	}
+
+	// texture coordinates against CreateSphere's vertices, away from the seam and the poles.
+	const int slices = 40, stacks = 20;
+	for (int stack = 1; stack < stacks; ++stack)
+	{
+		float phi = stack * Pi / stacks;
+		for (int slice = 1; slice < slices; ++slice)
+		{
+			float theta = slice * 2.0f * Pi / slices;
+			float n[3] = { std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta) };
+			float u, v;
+			SphereTexCoord(n, u, v);
+			if (std::fabs(u - theta / (2.0f * Pi)) > 1e-5f || std::fabs(v - phi / Pi) > 1e-5f)
+			{
+				std::printf("texture coordinates differ from CreateSphere's at slice %d, stack %d\n", slice, stack);
+				return 1;
+			}
+		}
+	}
+
+	// intersection rate : every pixel of a sphere covering a quarter of the screen height.
+	const float center[3] = { 0.0f, 0.0f, 20.0f };
+	const float radius = 2.0f;
+	ImpostorQuad quad = SphereImpostorQuad(center, radius, projection);
+	int columns = (int)((quad.MaxX - quad.MinX) / pixel), rows = (int)((quad.MaxY - quad.MinY) / pixel);
+	int hits = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int row = 0; row < rows; ++row)
+	{
+		for (int column = 0; column < columns; ++column)
+		{
+			ImpostorHit hit;
+			hits += SphereImpostorHit(quad.MinX + (column + 0.5f) * pixel, quad.MinY + (row + 0.5f) * pixel, center, radius, projection, hit) ? 1 : 0;
+		}
+	}
+	double us = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+
+	std::printf("%d spheres checked\n", sphereCount);
+	std::printf("quad %dx%d pixels, %d hits (%.1f%% of the quad, a disc covers %.1f%%), %.1f rays/us\n", columns, rows, hits,
+		100.0 * hits / (columns * rows), 25.0 * Pi, columns * rows / us);
+	return 0;
+}
@@ -0,0 +1,188 @@
+// IndexPackingBench.cpp : the index buffer packing of BuildGeometry (Helpers/IndexPacking.h) around the
+// 16 bit boundary.
+//
+// Packs sets of meshes sharing one vertex buffer and checks, for each :
+//   - the buffer is 16 bit when every mesh has 65536 vertices or less, without chunks,
+//   - a mesh past that is split, or the buffer is 32 bit when 32 bits are preferred or a triangle spans
+//     more than 65536 vertices,
+//   - the chunks of a split mesh are sorted, cover its indices exactly and whole triangles,
+//   - every triangle still reaches the same vertices of the shared buffer, drawn the way DrawRenderingItems
+//     does : the whole mesh with its base vertex, or chunk by chunk with theirs.
+// The cases are meshes of 65535, 65536 and 65537 vertices, the 256 x 256 sphere, a 300 x 300 grid next to a
+// dense sphere, a triangle joining the first and the last vertex, and empty meshes.  Reports the index
+// bytes and the chunks of each case.
+//   cl /O2 /EHsc Tools\IndexPackingBench.cpp Helpers\IndexPacking.cpp
+//
+// usage : IndexPackingBench
+
+#include "../Helpers/IndexPacking.h"
+#include "BenchMeshes.h"
+
+#include <chrono>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+struct Mesh
+{
+	std::uint32_t VertexCount;
+	std::vector<std::uint32_t> Indices;
+};
+
+// the indices of CreateSphere and CreateGrid, and their vertex counts.
+static Mesh Sphere(std::uint32_t slices, std::uint32_t stacks)
+{
+	BenchMesh mesh = MakeSphere(slices, stacks);
+	return { mesh.VertexCount(), std::move(mesh.Indices) };
+}
+
+static Mesh Grid(std::uint32_t m, std::uint32_t n)
+{
+	BenchMesh mesh = MakeGrid(m, n);
+	return { mesh.VertexCount(), std::move(mesh.Indices) };
+}
+
+// a strip of vertexCount vertices, triangle t using vertices t, t + 1 and t + 2.
+static Mesh MakeStrip(std::uint32_t vertexCount)
+{
+	Mesh mesh;
+	mesh.VertexCount = vertexCount;
+	for (std::uint32_t t = 0; t + 2 < vertexCount; ++t)
+	{
+		mesh.Indices.insert(mesh.Indices.end(), { t, t + 1, t + 2 });
+	}
+	return mesh;
+}
+
+enum class Expect { Narrow, Split, Wide };
+
+static bool Check(const char* name, const std::vector<Mesh>& meshes, bool prefer16Bit, Expect expect)
+{
+	std::vector<const std::vector<std::uint32_t>*> indices;
+	std::vector<std::uint32_t> vertexCounts;
+	for (const Mesh& mesh : meshes)
+	{
+		indices.push_back(&mesh.Indices);
+		vertexCounts.push_back(mesh.VertexCount);
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	PackedIndices packed = PackIndices(indices, vertexCounts, prefer16Bit);
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	Expect got = packed.Wide ? Expect::Wide : (packed.Chunks.empty() ? Expect::Narrow : Expect::Split);
+	if (got != expect)
+	{
+		std::printf("%s : packed %s\n", name, got == Expect::Wide ? "32 bit" : (got == Expect::Split ? "16 bit split" : "16 bit"));
+		return false;
+	}
+
+	std::size_t indexCount = 0;
+	for (const Mesh& mesh : meshes)
+		indexCount += mesh.Indices.size();
+	if ((packed.Wide ? packed.Indices32.size() : packed.Indices16.size()) != indexCount || packed.Meshes.size() != meshes.size() ||
+		packed.ByteSize() != indexCount * (packed.Wide ? 4 : 2))
+	{
+		std::printf("%s : %zu indices expected\n", name, indexCount);
+		return false;
+	}
+	for (std::size_t c = 1; c < packed.Chunks.size(); ++c)
+	{
+		if (packed.Chunks[c].StartIndex < packed.Chunks[c - 1].StartIndex + packed.Chunks[c - 1].IndexCount)
+		{
+			std::printf("%s : the chunks aren't sorted\n", name);
+			return false;
+		}
+	}
+
+	// every draw as DrawRenderingItems issues it, against the original indices moved by the mesh's first vertex.
+	std::int64_t baseVertex = 0;
+	std::size_t c = 0;
+	for (std::size_t m = 0; m < meshes.size(); ++m)
+	{
+		const IndexRange& range = packed.Meshes[m];
+		std::vector<IndexRange> draws;
+		while (c < packed.Chunks.size() && packed.Chunks[c].StartIndex < range.StartIndex)
+			++c;
+		if (c < packed.Chunks.size() && packed.Chunks[c].StartIndex == range.StartIndex)
+		{
+			for (; c < packed.Chunks.size() && packed.Chunks[c].StartIndex < range.StartIndex + range.IndexCount; ++c)
+				draws.push_back(packed.Chunks[c]);
+		}
+		else
+		{
+			draws.push_back(range);
+		}
+
+		if (range.BaseVertex != baseVertex)
+		{
+			std::printf("%s : mesh %zu starts at vertex %d instead of %lld\n", name, m, range.BaseVertex, (long long)baseVertex);
+			return false;
+		}
+
+		std::size_t next = range.StartIndex;
+		for (const IndexRange& draw : draws)
+		{
+			if (draw.StartIndex != next || draw.IndexCount % 3 != 0)
+			{
+				std::printf("%s : mesh %zu's chunks don't cover it in whole triangles\n", name, m);
+				return false;
+			}
+			for (std::uint32_t i = draw.StartIndex; i < draw.StartIndex + draw.IndexCount; ++i)
+			{
+				std::int64_t vertex = draw.BaseVertex + (std::int64_t)(packed.Wide ? packed.Indices32[i] : packed.Indices16[i]);
+				std::int64_t expected = baseVertex + meshes[m].Indices[i - range.StartIndex];
+				if (vertex != expected)
+				{
+					std::printf("%s : index %u of mesh %zu reaches vertex %lld instead of %lld\n", name, i, m, (long long)vertex, (long long)expected);
+					return false;
+				}
+			}
+			next += draw.IndexCount;
+		}
+		if (next != range.StartIndex + range.IndexCount)
+		{
+			std::printf("%s : mesh %zu's chunks end at index %zu instead of %u\n", name, m, next, range.StartIndex + range.IndexCount);
+			return false;
+		}
+		baseVertex += meshes[m].VertexCount;
+	}
+
+	std::printf("%-34s %8zu indices, %2u bit in %8zu bytes, %3zu chunks  %6.2f ms\n", name, indexCount, packed.Wide ? 32 : 16, packed.ByteSize(),
+		packed.Chunks.size(), ms);
+	return true;
+}
+
+int main()
+{
+	Mesh grid = Grid(60, 60), sphere = Sphere(128, 64);
+
+	// a triangle from the first to the last vertex can't be addressed by any 16 bit chunk.
+	Mesh spanning = MakeStrip(70000);
+	spanning.Indices.insert(spanning.Indices.end(), { 0, 1, 69999 });
+
+	struct Case { const char* Name; std::vector<Mesh> Meshes; bool Prefer16Bit; Expect Result; };
+	const Case cases[] =
+	{
+		{ "the sample's plane and spheres", { grid, sphere, Sphere(64, 32), Sphere(8, 4) }, true, Expect::Narrow },
+		{ "65535 vertices", { MakeStrip(65535) }, true, Expect::Narrow },
+		{ "65536 vertices", { MakeStrip(65536) }, true, Expect::Narrow },
+		{ "65537 vertices", { MakeStrip(65537) }, true, Expect::Split },
+		{ "65537 vertices, 32 bit preferred", { MakeStrip(65537) }, false, Expect::Wide },
+		{ "65536 vertices after 70000 more", { MakeStrip(70000), MakeStrip(65536) }, true, Expect::Split },
+		{ "256 x 256 sphere", { Sphere(256, 256) }, true, Expect::Split },
+		{ "300 x 300 grid and 512 x 256 sphere", { Grid(300, 300), Sphere(512, 256) }, true, Expect::Split },
+		{ "300 x 300 grid and 512 x 256 sphere", { Grid(300, 300), Sphere(512, 256) }, false, Expect::Wide },
+		{ "a triangle spanning 70000 vertices", { grid, spanning }, true, Expect::Wide },
+		{ "empty meshes", { Mesh{ 0, {} }, grid, Mesh{ 0, {} } }, true, Expect::Narrow },
+		{ "no mesh", {}, true, Expect::Narrow },
+	};
+
+	for (const Case& c : cases)
+	{
+		if (!Check(c.Name, c.Meshes, c.Prefer16Bit, c.Result))
+			return 1;
+	}
+	std::printf("%zu cases checked\n", sizeof(cases) / sizeof(cases[0]));
+	return 0;
+}
@@ -0,0 +1,200 @@
+// InstanceLayoutBench.cpp : the per object upload of N moving objects, in the former padded constant buffer
+// layout against the InstanceData layout of FrameBuffer.h.
+//
+//   padded   : ObjectConstants, world and texture transform as transposed 4x4 matrices and a material index,
+//              144 bytes in a 256 byte constant buffer slot, copied element by element as UploadBuffer::CopyData
+//              did for constant buffers.
+//   instance : InstanceData, the 4x3 affine world matrix as stored by XMStoreFloat4x3 and a material index,
+//              52 bytes, copied as one run.  Texture transforms live in their own sparse buffer and are not
+//              written for objects keeping the identity.
+// Both build their objects in a CPU mirror first and copy with memcpy, so the difference is the layout alone.
+// Checks that every object's world matrix, read the way BasicShader.hlsl reads each layout, places points at
+// the same spot.
+//   cl /O2 /EHsc Tools\InstanceLayoutBench.cpp
+//
+// usage : InstanceLayoutBench [repeat count]
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// same layout as the former ObjectConstants (cbuffer cbObject), without DirectXMath.
+struct BenchObjectConstants
+{
+	float World[4][4];
+	float TexTransform[4][4];
+	std::uint32_t MaterialIndex;
+	std::uint32_t ObjPad0;
+	std::uint32_t ObjPad1;
+	std::uint32_t ObjPad2;
+};
+static_assert(sizeof(BenchObjectConstants) == 144, "BenchObjectConstants must match the former ObjectConstants");
+
+// same layout as InstanceData in FrameBuffer.h.
+struct BenchInstance
+{
+	float World[4][3];
+	std::uint32_t MaterialIndex;
+};
+static_assert(sizeof(BenchInstance) == 52, "BenchInstance must match InstanceData");
+
+// constant buffer views are placed on 256 bytes, see d3dUtil::CalcConstantBufferByteSize.
+static const std::size_t ConstantBufferStride = (sizeof(BenchObjectConstants) + 255) & ~(std::size_t)255;
+
+// row vector 4x4 matrices, as DirectXMath.
+struct Matrix
+{
+	float m[4][4];
+};
+
+static Matrix Multiply(const Matrix& a, const Matrix& b)
+{
+	Matrix r;
+	for (int i = 0; i < 4; ++i)
+		for (int j = 0; j < 4; ++j)
+			r.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] + a.m[i][2] * b.m[2][j] + a.m[i][3] * b.m[3][j];
+	return r;
+}
+
+static Matrix RotationY(float angle)
+{
+	float c = std::cos(angle), s = std::sin(angle);
+	return Matrix{ { { c, 0.0f, -s, 0.0f }, { 0.0f, 1.0f, 0.0f, 0.0f }, { s, 0.0f, c, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f } } };
+}
+
+static Matrix Translation(float x, float y, float z)
+{
+	return Matrix{ { { 1.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f, 0.0f }, { x, y, z, 1.0f } } };
+}
+
+static Matrix Scaling(float s)
+{
+	return Matrix{ { { s, 0.0f, 0.0f, 0.0f }, { 0.0f, s, 0.0f, 0.0f }, { 0.0f, 0.0f, s, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f } } };
+}
+
+// the planetary motion of UpdateInstances, with rates depending on the object.
+static Matrix ObjectWorld(std::uint32_t i, float t)
+{
+	float spinRate = 0.1f + (float)(i % 97) * 0.01f;
+	float orbitRate = 0.05f + (float)(i % 89) * 0.002f;
+	float orbitSize = 5.0f + (float)(i % 1000);
+	return Multiply(Multiply(Multiply(Scaling(1.0f + (float)(i % 7)), RotationY(spinRate * t)),
+		Translation(orbitSize, 10.0f, 0.0f)), RotationY(orbitRate * t));
+}
+
+static void StorePadded(BenchObjectConstants& obj, const Matrix& world, std::uint32_t materialIndex)
+{
+	// XMStoreFloat4x4(XMMatrixTranspose(world)) : cbuffer matrices are column major by default.
+	for (int i = 0; i < 4; ++i)
+		for (int j = 0; j < 4; ++j)
+		{
+			obj.World[i][j] = world.m[j][i];
+			obj.TexTransform[i][j] = i == j ? 1.0f : 0.0f;
+		}
+	obj.MaterialIndex = materialIndex;
+}
+
+static void StoreInstance(BenchInstance& inst, const Matrix& world, std::uint32_t materialIndex)
+{
+	// XMStoreFloat4x3 : the first three columns of every row, read as row_major float4x3.
+	for (int i = 0; i < 4; ++i)
+		for (int j = 0; j < 3; ++j)
+			inst.World[i][j] = world.m[i][j];
+	inst.MaterialIndex = materialIndex;
+}
+
+template<typename Fn>
+static double MeasureMs(int repeat, Fn fn)
+{
+	fn(0);		// warm up, touches every page once
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < repeat; ++r)
+	{
+		fn(r + 1);
+	}
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / repeat;
+}
+
+int main(int argc, char* argv[])
+{
+	int repeat = argc > 1 ? std::atoi(argv[1]) : 20;
+	if (repeat < 1)
+	{
+		repeat = 1;
+	}
+
+	// mul(float4(p, 1), gWorld) of each layout, as the vertex shader sees it.
+	for (std::uint32_t i = 0; i < 1000; ++i)
+	{
+		Matrix world = ObjectWorld(i, 3.7f);
+		BenchObjectConstants obj;
+		BenchInstance inst;
+		StorePadded(obj, world, i);
+		StoreInstance(inst, world, i);
+
+		const float p[4] = { 0.3f, -1.2f, 2.5f, 1.0f };
+		for (int j = 0; j < 3; ++j)
+		{
+			// column major cbuffer : the stored row j of the transposed matrix is the column j of world.
+			float padded = obj.World[j][0] * p[0] + obj.World[j][1] * p[1] + obj.World[j][2] * p[2] + obj.World[j][3] * p[3];
+			float instance = inst.World[0][j] * p[0] + inst.World[1][j] * p[1] + inst.World[2][j] * p[2] + inst.World[3][j] * p[3];
+			if (std::fabs(padded - instance) > 1e-3f * (1.0f + std::fabs(padded)))
+			{
+				printf("FAILED : object %u places a point at %f on axis %d in the padded layout, %f as an instance\n", i, padded, j, instance);
+				return 1;
+			}
+		}
+		if (obj.World[3][0] != 0.0f || obj.World[3][1] != 0.0f || obj.World[3][2] != 0.0f || obj.World[3][3] != 1.0f)
+		{
+			printf("FAILED : object %u is not affine, the 4x3 layout would drop its last column\n", i);
+			return 1;
+		}
+	}
+
+	const std::uint32_t counts[] = { 1000, 10000, 100000, 1000000 };
+
+	printf("%10s %12s %12s %12s %12s %12s %12s\n", "objects", "padded B", "instance B", "padded ms", "instance ms", "speed-up", "copy speed-up");
+	for (std::uint32_t count : counts)
+	{
+		std::vector<BenchObjectConstants> paddedMirror(count);
+		std::vector<BenchInstance> instanceMirror(count);
+		std::vector<std::uint8_t> paddedHeap(ConstantBufferStride * count);
+		std::vector<std::uint8_t> instanceHeap(sizeof(BenchInstance) * count);
+
+		// the whole frame : objects computed into the mirror, then copied into the upload heap.
+		double padded = MeasureMs(repeat, [&](int frame)
+		{
+			for (std::uint32_t i = 0; i < count; ++i)
+				StorePadded(paddedMirror[i], ObjectWorld(i, (float)frame), i & 7);
+			for (std::uint32_t i = 0; i < count; ++i)
+				std::memcpy(&paddedHeap[i * ConstantBufferStride], &paddedMirror[i], sizeof(BenchObjectConstants));
+		});
+		double instance = MeasureMs(repeat, [&](int frame)
+		{
+			for (std::uint32_t i = 0; i < count; ++i)
+				StoreInstance(instanceMirror[i], ObjectWorld(i, (float)frame), i & 7);
+			std::memcpy(instanceHeap.data(), instanceMirror.data(), sizeof(BenchInstance) * count);
+		});
+
+		// the copies alone, the motion taken out.
+		double paddedCopy = MeasureMs(repeat, [&](int)
+		{
+			for (std::uint32_t i = 0; i < count; ++i)
+				std::memcpy(&paddedHeap[i * ConstantBufferStride], &paddedMirror[i], sizeof(BenchObjectConstants));
+		});
+		double instanceCopy = MeasureMs(repeat, [&](int)
+		{
+			std::memcpy(instanceHeap.data(), instanceMirror.data(), sizeof(BenchInstance) * count);
+		});
+
+		printf("%10u %12zu %12zu %12.3f %12.3f %11.2fx %12.2fx\n", count, ConstantBufferStride * count, sizeof(BenchInstance) * count,
+			padded, instance, padded / instance, paddedCopy / instanceCopy);
+	}
+
+	printf("all checks passed\n");
+	return 0;
+}
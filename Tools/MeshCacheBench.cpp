@@ -0,0 +1,315 @@
+// MeshCacheBench.cpp : startup with and without the mesh cache file of SetShapeGeometry (Helpers/MeshCache.h).
+//
+// Cold : generates the plane and the sphere levels the way SetShapeGeometry does, optimizes them, quantizes
+// the spheres to CompactVertex, packs the indices and copies the buffers into an upload ring.  Then writes
+// them to a cache file.
+// Warm : maps that file and copies the payloads straight into the upload ring.
+// Checks, besides timing both :
+//   - the warm upload ring is byte for byte the cold one,
+//   - the geometry, submesh and chunk tables read back as written, and every payload is aligned,
+//   - a file with another key, a truncated file, and a file with a damaged magic are all misses.
+//   cl /O2 /EHsc Tools\MeshCacheBench.cpp Helpers\MeshCache.cpp Helpers\MeshOptimizer.cpp Helpers\VertexQuantization.cpp Helpers\IndexPacking.cpp
+//
+// usage : MeshCacheBench [finest slices]
+
+#include "../Helpers/MeshCache.h"
+#include "../Helpers/MeshOptimizer.h"
+#include "../Helpers/VertexQuantization.h"
+#include "../Helpers/IndexPacking.h"
+#include "BenchMeshes.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+static const char* const CacheFileName = "MeshCacheBench.meshcache";
+static const char* const DamagedFileName = "MeshCacheBench.damaged.meshcache";
+
+// the Vertex of SolarSystem.cpp.
+struct Vertex
+{
+	float Position[3];
+	float Normal[3];
+	float TexC[2];
+};
+
+struct Mesh
+{
+	std::string Name;
+	std::vector<Vertex> Vertices;
+	std::vector<std::uint32_t> Indices;
+};
+
+// CreateSphere and CreateGrid in the Vertex layout : sphere normals are the positions, the grid faces up.
+static Mesh MakeVertexSphere(const std::string& name, std::uint32_t slices, std::uint32_t stacks)
+{
+	BenchMesh sphere = MakeSphere(slices, stacks);
+	Mesh mesh;
+	mesh.Name = name;
+	for (std::uint32_t v = 0; v < sphere.VertexCount(); ++v)
+	{
+		const float* p = &sphere.Positions[v * 3];
+		mesh.Vertices.push_back({ { p[0], p[1], p[2] }, { p[0], p[1], p[2] }, { sphere.TexCoords[v * 2], sphere.TexCoords[v * 2 + 1] } });
+	}
+	mesh.Indices = std::move(sphere.Indices);
+	return mesh;
+}
+
+// n x n vertices over a square of the given size.
+static Mesh MakeVertexGrid(const std::string& name, float size, std::uint32_t n)
+{
+	BenchMesh grid = MakeGrid(n, n);
+	Mesh mesh;
+	mesh.Name = name;
+	for (std::uint32_t v = 0; v < grid.VertexCount(); ++v)
+	{
+		const float* p = &grid.Positions[v * 3];
+		mesh.Vertices.push_back({ { p[0] * size, p[1] * size, p[2] * size }, { 0, 1, 0 }, { grid.TexCoords[v * 2], grid.TexCoords[v * 2 + 1] } });
+	}
+	mesh.Indices = std::move(grid.Indices);
+	return mesh;
+}
+
+// one buffer pair as BuildGeometry makes it, and the cache entry pointing at it.
+struct Geometry
+{
+	std::vector<std::uint8_t> Vertices;
+	PackedIndices Indices;
+	MeshCacheEntry Entry;
+};
+
+static Geometry Build(const char* name, std::vector<Mesh>& meshes, bool compact)
+{
+	Geometry geometry;
+	std::vector<const std::vector<std::uint32_t>*> meshIndices;
+	std::vector<std::uint32_t> vertexCounts;
+	for (Mesh& mesh : meshes)
+	{
+		std::vector<std::uint32_t> remap;
+		OptimizeMesh(mesh.Indices, mesh.Vertices[0].Position, sizeof(Vertex), mesh.Vertices.size(), remap);
+		RemapVertices(mesh.Vertices, remap);
+		meshIndices.push_back(&mesh.Indices);
+		vertexCounts.push_back((std::uint32_t)mesh.Vertices.size());
+	}
+	geometry.Indices = PackIndices(meshIndices, vertexCounts);
+
+	for (std::size_t m = 0; m < meshes.size(); ++m)
+	{
+		float low[3] = { 1e30f, 1e30f, 1e30f }, high[3] = { -1e30f, -1e30f, -1e30f };
+		for (const Vertex& vertex : meshes[m].Vertices)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				low[k] = std::min(low[k], vertex.Position[k]);
+				high[k] = std::max(high[k], vertex.Position[k]);
+			}
+		}
+
+		MeshCacheSubmesh submesh = {};
+		std::strncpy(submesh.Name, meshes[m].Name.c_str(), sizeof(submesh.Name) - 1);
+		submesh.IndexCount = geometry.Indices.Meshes[m].IndexCount;
+		submesh.StartIndex = geometry.Indices.Meshes[m].StartIndex;
+		submesh.BaseVertex = geometry.Indices.Meshes[m].BaseVertex;
+		QuantizationBounds bounds;
+		for (int k = 0; k < 3; ++k)
+		{
+			submesh.Center[k] = bounds.Center[k] = 0.5f * (low[k] + high[k]);
+			submesh.Extents[k] = bounds.Extent[k] = 0.5f * (high[k] - low[k]);
+		}
+		geometry.Entry.Submeshes.push_back(submesh);
+
+		for (const Vertex& vertex : meshes[m].Vertices)
+		{
+			const std::uint8_t* bytes = (const std::uint8_t*)&vertex;
+			std::size_t size = sizeof(Vertex);
+			CompactVertex encoded;
+			if (compact)
+			{
+				encoded = EncodeVertex(vertex.Position, vertex.Normal, vertex.TexC, bounds);
+				bytes = (const std::uint8_t*)&encoded;
+				size = sizeof(CompactVertex);
+			}
+			geometry.Vertices.insert(geometry.Vertices.end(), bytes, bytes + size);
+		}
+	}
+	for (const IndexRange& chunk : geometry.Indices.Chunks)
+	{
+		geometry.Entry.Chunks.push_back({ chunk.IndexCount, chunk.StartIndex, chunk.BaseVertex });
+	}
+
+	MeshCacheGeometry& table = geometry.Entry.Geometry;
+	std::strncpy(table.Name, name, sizeof(table.Name) - 1);
+	table.VertexByteStride = compact ? sizeof(CompactVertex) : sizeof(Vertex);
+	table.IndexBits = geometry.Indices.Wide ? 32 : 16;
+	table.Flags = compact ? MeshCacheCompactVertices : 0;
+	table.VertexByteSize = geometry.Vertices.size();
+	table.IndexByteSize = geometry.Indices.ByteSize();
+	geometry.Entry.Vertices = geometry.Vertices.data();
+	geometry.Entry.Indices = geometry.Indices.Data();
+	return geometry;
+}
+
+// the staging ring of UploadManager, 16 byte aligned allocations one after the other.
+static void Upload(std::vector<std::uint8_t>& ring, const void* data, std::size_t size)
+{
+	std::size_t offset = (ring.size() + 15) & ~(std::size_t)15;
+	ring.resize(offset + size);
+	std::memcpy(ring.data() + offset, data, size);
+}
+
+static bool SameTables(const MeshCacheFile& cache, const std::vector<MeshCacheEntry>& entries)
+{
+	if (cache.GeometryCount() != entries.size())
+	{
+		std::printf("%u geometries read back instead of %zu\n", cache.GeometryCount(), entries.size());
+		return false;
+	}
+	for (const MeshCacheEntry& entry : entries)
+	{
+		const MeshCacheGeometry* geometry = cache.FindGeometry(entry.Geometry.Name);
+		if (!geometry || geometry->VertexByteStride != entry.Geometry.VertexByteStride || geometry->IndexBits != entry.Geometry.IndexBits ||
+			geometry->Flags != entry.Geometry.Flags || geometry->SubmeshCount != entry.Submeshes.size() ||
+			geometry->ChunkCount != entry.Chunks.size() || geometry->VertexOffset % MeshCacheAlignment != 0 ||
+			geometry->IndexOffset % MeshCacheAlignment != 0)
+		{
+			std::printf("%s : its table doesn't read back as written\n", entry.Geometry.Name);
+			return false;
+		}
+		if ((!entry.Submeshes.empty() &&
+			std::memcmp(cache.Submeshes(*geometry), entry.Submeshes.data(), entry.Submeshes.size() * sizeof(MeshCacheSubmesh)) != 0) ||
+			(!entry.Chunks.empty() && std::memcmp(cache.Chunks(*geometry), entry.Chunks.data(), entry.Chunks.size() * sizeof(MeshCacheChunk)) != 0))
+		{
+			std::printf("%s : its submeshes or chunks don't read back as written\n", entry.Geometry.Name);
+			return false;
+		}
+	}
+	return true;
+}
+
+// a copy of the cache file, cut to size bytes and with the byte at flip xor'ed.
+static void Damage(std::size_t size, std::size_t flip)
+{
+	std::ifstream fin(CacheFileName, std::ios::binary);
+	std::vector<char> bytes((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+	bytes.resize(std::min(size, bytes.size()));
+	if (flip < bytes.size())
+	{
+		bytes[flip] ^= 0x5a;
+	}
+	std::ofstream fout(DamagedFileName, std::ios::binary | std::ios::trunc);
+	fout.write(bytes.data(), (std::streamsize)bytes.size());
+}
+
+int main(int argc, char* argv[])
+{
+	std::uint32_t finestSlices = argc > 1 ? (std::uint32_t)std::atoi(argv[1]) : 128;
+	finestSlices = std::max(finestSlices, 8u);
+	const std::uint64_t key = MeshCacheHash(&finestSlices, sizeof(finestSlices));
+
+	// cold : everything SetShapeGeometry does on a miss.
+	auto start = std::chrono::high_resolution_clock::now();
+	std::vector<Mesh> plane = { MakeVertexGrid("plane", 300.0f, 60) };
+	std::vector<Mesh> spheres;
+	for (std::uint32_t slices = finestSlices; slices >= 8; slices /= 2)
+	{
+		spheres.push_back(MakeVertexSphere("sphereLod" + std::to_string(spheres.size()), slices, slices / 2));
+	}
+	std::vector<Geometry> geometries;
+	geometries.push_back(Build("shapesGeo", plane, false));
+	geometries.push_back(Build("spheresGeo", spheres, true));
+
+	std::vector<std::uint8_t> coldRing;
+	for (const Geometry& geometry : geometries)
+	{
+		Upload(coldRing, geometry.Vertices.data(), geometry.Vertices.size());
+		Upload(coldRing, geometry.Indices.Data(), geometry.Indices.ByteSize());
+	}
+	double coldMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	std::vector<MeshCacheEntry> entries;
+	for (const Geometry& geometry : geometries)
+	{
+		entries.push_back(geometry.Entry);
+	}
+	start = std::chrono::high_resolution_clock::now();
+	if (!WriteMeshCache(CacheFileName, key, entries))
+	{
+		std::printf("%s could not be written\n", CacheFileName);
+		return 1;
+	}
+	double writeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	// warm : what a hit costs, the mapping and one copy of every payload.
+	start = std::chrono::high_resolution_clock::now();
+	MeshCacheFile cache;
+	if (!cache.Open(CacheFileName, key))
+	{
+		std::printf("%s is a miss right after it was written\n", CacheFileName);
+		return 1;
+	}
+	std::vector<std::uint8_t> warmRing;
+	for (const MeshCacheEntry& entry : entries)
+	{
+		const MeshCacheGeometry& geometry = *cache.FindGeometry(entry.Geometry.Name);
+		Upload(warmRing, cache.Vertices(geometry), (std::size_t)geometry.VertexByteSize);
+		Upload(warmRing, cache.Indices(geometry), (std::size_t)geometry.IndexByteSize);
+	}
+	double warmMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	if (warmRing != coldRing)
+	{
+		std::printf("the warm upload differs from the cold one\n");
+		return 1;
+	}
+	if (!SameTables(cache, entries))
+	{
+		return 1;
+	}
+	cache.Close();
+
+	// every kind of stale or broken file is a miss, never a crash.
+	std::ifstream size(CacheFileName, std::ios::binary | std::ios::ate);
+	std::size_t fileSize = (std::size_t)size.tellg();
+	size.close();
+	struct Miss { const char* Name; const char* File; std::uint64_t Key; std::size_t Size; std::size_t Flip; };
+	const Miss misses[] =
+	{
+		{ "another key", CacheFileName, key + 1, fileSize, fileSize },
+		{ "truncated", DamagedFileName, key, fileSize - 1, fileSize },
+		{ "header only", DamagedFileName, key, sizeof(MeshCacheHeader), fileSize },
+		{ "damaged magic", DamagedFileName, key, fileSize, 0 },
+		{ "missing", "MeshCacheBench.missing.meshcache", key, fileSize, fileSize },
+	};
+	for (const Miss& miss : misses)
+	{
+		if (miss.File == DamagedFileName)
+		{
+			Damage(miss.Size, miss.Flip);
+		}
+		if (cache.Open(miss.File, miss.Key))
+		{
+			std::printf("%s : the file is a hit\n", miss.Name);
+			return 1;
+		}
+	}
+	std::remove(DamagedFileName);
+	std::remove(CacheFileName);
+
+	std::size_t chunks = 0;
+	for (const MeshCacheEntry& entry : entries)
+	{
+		chunks += entry.Chunks.size();
+	}
+	std::printf("%zu sphere levels from %u slices, %u bit indices, %zu chunks : %zu bytes uploaded, %zu byte file\n", spheres.size(),
+		finestSlices, entries.back().Geometry.IndexBits, chunks, coldRing.size(), fileSize);
+	std::printf("cold generation %8.2f ms, cache write %6.2f ms, warm mapped load %6.2f ms (%.0fx)\n", coldMs, writeMs, warmMs,
+		coldMs / std::max(warmMs, 1e-3));
+	std::printf("%zu misses checked\n", sizeof(misses) / sizeof(misses[0]));
+	return 0;
+}
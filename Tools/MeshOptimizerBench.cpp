@@ -0,0 +1,134 @@
+// MeshOptimizerBench.cpp : the mesh optimization stage (Helpers/MeshOptimizer.h) on the meshes
+// GeometryGenerator builds, in the same vertex and index order as CreateSphere, CreateGrid and CreateGeosphere.
+//
+// Reports ACMR and ATVR before and after every stage, and checks each optimized mesh against its original :
+//   - the remap table is a permutation and the vertices come in the order the indices first use them,
+//   - every triangle of the original is still there exactly once, with the same winding, once its vertices
+//     are mapped back,
+//   - the optimized mesh never transforms more vertices than the generator's order, and sorting for overdraw
+//     costs the cache order no more than its threshold.
+//   cl /O2 /EHsc Tools\MeshOptimizerBench.cpp Helpers\MeshOptimizer.cpp Helpers\MeshSubdivision.cpp Helpers\WorkerPool.cpp
+//
+// usage : MeshOptimizerBench [sphere slices]
+
+#include "../Helpers/MeshOptimizer.h"
+#include "BenchMeshes.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// triangles as original vertex indices, rotated so the smallest comes first, which keeps the winding.
+static std::vector<std::array<std::uint32_t, 3>> CanonicalTriangles(const std::vector<std::uint32_t>& indices, const std::vector<std::uint32_t>& original)
+{
+	std::vector<std::array<std::uint32_t, 3>> triangles;
+	for (std::size_t t = 0; t < indices.size(); t += 3)
+	{
+		std::array<std::uint32_t, 3> tri = { original[indices[t]], original[indices[t + 1]], original[indices[t + 2]] };
+		std::rotate(tri.begin(), std::min_element(tri.begin(), tri.end()), tri.end());
+		triangles.push_back(tri);
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+static double Since(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static bool Check(const BenchMesh& mesh)
+{
+	std::size_t vertexCount = mesh.Positions.size() / 3;
+
+	// every stage on its own, for the report.
+	std::vector<std::uint32_t> indices = mesh.Indices;
+	VertexCacheStats before = AnalyzeVertexCache(indices, vertexCount);
+	OptimizeVertexCache(indices, vertexCount);
+	VertexCacheStats cacheOptimized = AnalyzeVertexCache(indices, vertexCount);
+	OptimizeOverdraw(indices, mesh.Positions.data(), 3 * sizeof(float), vertexCount);
+	VertexCacheStats overdrawOptimized = AnalyzeVertexCache(indices, vertexCount);
+
+	// the whole stage, as SetShapeGeometry runs it.
+	indices = mesh.Indices;
+	std::vector<std::uint32_t> remap;
+	auto start = std::chrono::high_resolution_clock::now();
+	MeshOptimizeStats stats = OptimizeMesh(indices, mesh.Positions.data(), 3 * sizeof(float), vertexCount, remap);
+	double ms = Since(start);
+
+	// the remap table has to be a permutation, whose inverse maps the new vertices back.
+	std::vector<std::uint32_t> original(vertexCount, ~0u);
+	for (std::size_t v = 0; v < vertexCount; ++v)
+	{
+		if (remap[v] >= vertexCount || original[remap[v]] != ~0u)
+		{
+			std::printf("%s : the remap table is not a permutation\n", mesh.Name);
+			return false;
+		}
+		original[remap[v]] = (std::uint32_t)v;
+	}
+
+	std::uint32_t nextNew = 0;
+	for (std::uint32_t index : indices)
+	{
+		if (index > nextNew)
+		{
+			std::printf("%s : vertex %u is used before vertex %u\n", mesh.Name, index, nextNew);
+			return false;
+		}
+		nextNew = std::max(nextNew, index + 1);
+	}
+
+	std::vector<std::uint32_t> identity(vertexCount);
+	for (std::size_t v = 0; v < vertexCount; ++v)
+		identity[v] = (std::uint32_t)v;
+	if (CanonicalTriangles(indices, original) != CanonicalTriangles(mesh.Indices, identity))
+	{
+		std::printf("%s : the optimized triangles differ from the original ones\n", mesh.Name);
+		return false;
+	}
+
+	if (stats.After.Transforms > stats.Before.Transforms)
+	{
+		std::printf("%s : the optimized mesh transforms %u vertices, the generator's %u\n", mesh.Name, stats.After.Transforms, stats.Before.Transforms);
+		return false;
+	}
+	if (overdrawOptimized.Transforms > 1.05f * cacheOptimized.Transforms + 3)
+	{
+		std::printf("%s : the overdraw order lost more than its threshold of the cache order\n", mesh.Name);
+		return false;
+	}
+
+	std::printf("%-10s %6zu tris  ACMR %.3f -> %.3f (cache) -> %.3f (overdraw), kept %.3f   ATVR %.3f -> %.3f   %7.3f ms\n", mesh.Name,
+		indices.size() / 3, before.Acmr, cacheOptimized.Acmr, overdrawOptimized.Acmr, stats.After.Acmr, stats.Before.Atvr, stats.After.Atvr, ms);
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	std::uint32_t slices = argc > 1 ? (std::uint32_t)std::atoi(argv[1]) : 128;
+	if (slices < 4)
+	{
+		slices = 4;
+	}
+
+	// the sphere levels, plane and geospheres the sample could generate.
+	std::vector<BenchMesh> meshes;
+	for (std::uint32_t s = slices; s >= 8; s /= 2)
+		meshes.push_back(MakeSphere(s, s / 2));
+	meshes.push_back(MakeGrid(60, 60));
+	for (std::uint32_t subdivisions = 1; subdivisions <= 5; ++subdivisions)
+		meshes.push_back(MakeGeosphere(subdivisions));
+
+	for (const BenchMesh& mesh : meshes)
+	{
+		if (!Check(mesh))
+			return 1;
+	}
+	std::printf("%zu meshes checked\n", meshes.size());
+	return 0;
+}
@@ -0,0 +1,274 @@
+// MeshSimplifierBench.cpp : the quadric error simplifier (Helpers/MeshSimplifier.h) on million triangle meshes,
+// a CreateSphere order sphere, whose texture seam and poles must hold, and a bumpy grid, whose borders must.
+//
+// Reports the triangles removed per second for one level of 1/16 of the triangles, and the time of a chain of
+// 1/2, 1/4, 1/8 and 1/16 of them, which comes out of one run and so costs about that one level.  Checks every
+// level :
+//   - indices are in range, no triangle is degenerate and there are at most as many as asked for,
+//   - every vertex on an open edge (a border or a seam) was on one in the original, nothing tore open,
+//   - welded by position, every edge of the sphere still has exactly two triangles in opposite directions,
+//     and its triangles stay close to the unit sphere,
+//   - the grid's triangles all face up and still cover its square exactly,
+//   - the chain's last level is the one level of 1/16, triangle for triangle,
+//   - the chains of both meshes built together on the workers are the ones built one after the other,
+// and that a level built with an error budget keeps to it.
+//   cl /O2 /EHsc Tools\MeshSimplifierBench.cpp Helpers\MeshSimplifier.cpp Helpers\WorkerPool.cpp
+//
+// usage : MeshSimplifierBench [sphere slices]
+
+#include "../Helpers/MeshSimplifier.h"
+#include "../Helpers/WorkerPool.h"
+#include "BenchMeshes.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <tuple>
+#include <vector>
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// CreateSphere's sphere with the seam vertex at exactly the position of the first, as CreateSphere's cos and
+// sin of 2 pi aren't.
+static BenchMesh MakeWeldedSphere(std::uint32_t slices, std::uint32_t stacks)
+{
+	BenchMesh mesh = MakeSphere(slices, stacks);
+	for (std::uint32_t i = 1; i < stacks; ++i)
+	{
+		float* ring = &mesh.Positions[(1 + (i - 1) * (slices + 1)) * 3];
+		std::copy(ring, ring + 3, ring + slices * 3);
+	}
+	return mesh;
+}
+
+// CreateGrid's grid with hills on it.
+static BenchMesh MakeHillyGrid(std::uint32_t m, std::uint32_t n)
+{
+	BenchMesh mesh = MakeGrid(m, n);
+	for (std::size_t v = 0; v < mesh.Positions.size(); v += 3)
+	{
+		float x = mesh.Positions[v], z = mesh.Positions[v + 2];
+		mesh.Positions[v + 1] = 0.03f * std::sin(9.0f * x) * std::cos(7.0f * z) + 0.01f * std::sin(31.0f * x + 17.0f * z);
+	}
+	return mesh;
+}
+
+// the vertices of indices on an edge no triangle has the other way round.
+static std::vector<bool> OpenVertices(const std::vector<std::uint32_t>& indices, std::size_t vertexCount)
+{
+	std::map<std::pair<std::uint32_t, std::uint32_t>, int> directed;
+	for (std::size_t t = 0; t < indices.size(); t += 3)
+	{
+		for (int e = 0; e < 3; ++e)
+		{
+			directed[{ indices[t + e], indices[t + (e + 1) % 3] }]++;
+		}
+	}
+	std::vector<bool> open(vertexCount, false);
+	for (const auto& edge : directed)
+	{
+		if (directed.find({ edge.first.second, edge.first.first }) == directed.end())
+		{
+			open[edge.first.first] = open[edge.first.second] = true;
+		}
+	}
+	return open;
+}
+
+static bool CheckLevel(const BenchMesh& mesh, const std::vector<bool>& openBefore, const std::vector<std::uint32_t>& indices, std::size_t target)
+{
+	const std::size_t vertexCount = mesh.Positions.size() / 3;
+	if (indices.size() % 3 != 0 || indices.size() / 3 > target)
+	{
+		printf("FAILED : %s has %zu triangles for a target of %zu\n", mesh.Name, indices.size() / 3, target);
+		return false;
+	}
+	for (std::size_t t = 0; t < indices.size(); t += 3)
+	{
+		std::uint32_t a = indices[t], b = indices[t + 1], c = indices[t + 2];
+		if (a >= vertexCount || b >= vertexCount || c >= vertexCount || a == b || b == c || c == a)
+		{
+			printf("FAILED : %s triangle %zu is %u %u %u\n", mesh.Name, t / 3, a, b, c);
+			return false;
+		}
+	}
+
+	std::vector<bool> open = OpenVertices(indices, vertexCount);
+	for (std::size_t v = 0; v < vertexCount; ++v)
+	{
+		if (open[v] && !openBefore[v])
+		{
+			printf("FAILED : %s vertex %zu is on a new border or seam\n", mesh.Name, v);
+			return false;
+		}
+	}
+
+	auto position = [&](std::uint32_t v) { return &mesh.Positions[v * 3]; };
+	if (mesh.Name[0] == 's')
+	{
+		std::map<std::tuple<float, float, float>, std::uint32_t> welded;
+		std::map<std::pair<std::uint32_t, std::uint32_t>, int> directed;
+		for (std::size_t t = 0; t < indices.size(); t += 3)
+		{
+			std::uint32_t ids[3];
+			float centroid[3] = { 0.0f, 0.0f, 0.0f };
+			for (int k = 0; k < 3; ++k)
+			{
+				const float* p = position(indices[t + k]);
+				ids[k] = welded.insert({ std::make_tuple(p[0], p[1], p[2]), (std::uint32_t)welded.size() }).first->second;
+				for (int i = 0; i < 3; ++i)
+					centroid[i] += p[i] / 3.0f;
+			}
+			for (int e = 0; e < 3; ++e)
+			{
+				directed[{ ids[e], ids[(e + 1) % 3] }]++;
+			}
+			float radius = std::sqrt(centroid[0] * centroid[0] + centroid[1] * centroid[1] + centroid[2] * centroid[2]);
+			if (radius < 0.9f || radius > 1.0001f)
+			{
+				printf("FAILED : a triangle of the sphere is %g from its centre\n", radius);
+				return false;
+			}
+		}
+		for (const auto& edge : directed)
+		{
+			auto reverse = directed.find({ edge.first.second, edge.first.first });
+			if (edge.second != 1 || reverse == directed.end() || reverse->second != 1)
+			{
+				printf("FAILED : sphere edge %u-%u is used %d times, its reverse %d times\n", edge.first.first, edge.first.second,
+					edge.second, reverse == directed.end() ? 0 : reverse->second);
+				return false;
+			}
+		}
+	}
+	else
+	{
+		double area = 0.0;
+		for (std::size_t t = 0; t < indices.size(); t += 3)
+		{
+			const float* a = position(indices[t]);
+			const float* b = position(indices[t + 1]);
+			const float* c = position(indices[t + 2]);
+			double up = ((double)c[0] - a[0]) * ((double)b[2] - a[2]) - ((double)b[0] - a[0]) * ((double)c[2] - a[2]);
+			if (up < 0.0)
+			{
+				printf("FAILED : grid triangle %zu faces down\n", t / 3);
+				return false;
+			}
+			area += 0.5 * up;
+		}
+		if (std::fabs(area - 1.0) > 1e-4)
+		{
+			printf("FAILED : the grid's triangles cover %.6f\n", area);
+			return false;
+		}
+	}
+	return true;
+}
+
+// 1/2, 1/4, 1/8 and 1/16 of the triangles, the last one the one level's.
+static std::vector<std::size_t> ChainTriangles(const BenchMesh& mesh)
+{
+	std::vector<std::size_t> targets;
+	for (std::size_t divisor = 2; divisor <= 16; divisor *= 2)
+	{
+		targets.push_back(mesh.Indices.size() / 3 / divisor);
+	}
+	return targets;
+}
+
+static bool RunMesh(const BenchMesh& mesh, std::vector<MeshLod>& chain)
+{
+	const std::size_t vertexCount = mesh.Positions.size() / 3;
+	const std::size_t triangles = mesh.Indices.size() / 3;
+	const std::vector<bool> openBefore = OpenVertices(mesh.Indices, vertexCount);
+	printf("%s : %zu triangles, %zu vertices\n", mesh.Name, triangles, vertexCount);
+
+	MeshSimplifyStats stats;
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::uint32_t> single = SimplifyMesh(mesh.Indices, mesh.Positions.data(), 12, vertexCount, triangles / 16, 1.0f, &stats);
+	double seconds = Seconds(start);
+	if (!CheckLevel(mesh, openBefore, single, triangles / 16))
+	{
+		return false;
+	}
+	printf("  one level   : %zu -> %zu triangles, %zu collapses, error %.2e, %.1f ms, %.2f M triangles removed/s\n", stats.TrianglesBefore,
+		stats.TrianglesAfter, stats.Collapses, stats.Error, seconds * 1000.0, (stats.TrianglesBefore - stats.TrianglesAfter) / seconds * 1e-6);
+
+	const std::vector<std::size_t> targets = ChainTriangles(mesh);
+	start = std::chrono::steady_clock::now();
+	chain = BuildMeshLods(mesh.Indices, mesh.Positions.data(), 12, vertexCount, targets, 1.0f);
+	double chainSeconds = Seconds(start);
+	for (std::size_t level = 0; level < targets.size(); ++level)
+	{
+		if (!CheckLevel(mesh, openBefore, chain[level].Indices, targets[level]))
+		{
+			return false;
+		}
+		printf("  level %zu     : %zu triangles, error %.2e\n", level + 1, chain[level].Stats.TrianglesAfter, chain[level].Stats.Error);
+	}
+	if (chain.back().Indices != single)
+	{
+		printf("FAILED : %s the chain's last level isn't the one level\n", mesh.Name);
+		return false;
+	}
+	printf("  chain       : %.1f ms, %.2f times the one level\n", chainSeconds * 1000.0, chainSeconds / seconds);
+
+	// an error budget instead of a triangle count.
+	const float budget = 1e-3f;
+	std::vector<std::uint32_t> bounded = SimplifyMesh(mesh.Indices, mesh.Positions.data(), 12, vertexCount, 0, budget, &stats);
+	if (!CheckLevel(mesh, openBefore, bounded, triangles) || stats.Error > budget || stats.TrianglesAfter >= triangles)
+	{
+		printf("FAILED : %s with an error budget of %g : error %g, %zu triangles\n", mesh.Name, budget, stats.Error, stats.TrianglesAfter);
+		return false;
+	}
+	printf("  error %.0e  : %zu triangles, error %.2e\n", budget, stats.TrianglesAfter, stats.Error);
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	std::uint32_t slices = argc > 1 ? (std::uint32_t)atoi(argv[1]) : 1024;
+	std::uint32_t side = (std::uint32_t)(slices * 0.7071f) + 1;
+
+	const BenchMesh meshes[] = { MakeWeldedSphere(slices, slices / 2), MakeHillyGrid(side, side) };
+	std::vector<MeshLod> chains[2];
+	for (int m = 0; m < 2; ++m)
+	{
+		if (!RunMesh(meshes[m], chains[m]))
+		{
+			return 1;
+		}
+	}
+
+	// both chains at once, a mesh per worker, on two of them at least so that they do run side by side.
+	WorkerPool workers(std::max(2u, WorkerPool::DefaultWorkerCount()));
+	std::vector<MeshLodSource> sources;
+	for (const BenchMesh& mesh : meshes)
+	{
+		sources.push_back({ &mesh.Indices, mesh.Positions.data(), 12, mesh.Positions.size() / 3, ChainTriangles(mesh) });
+	}
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::vector<MeshLod>> batch = BuildMeshLods(sources, 1.0f, &workers);
+	double seconds = Seconds(start);
+	for (int m = 0; m < 2; ++m)
+	{
+		for (std::size_t level = 0; level < chains[m].size(); ++level)
+		{
+			if (batch[m][level].Indices != chains[m][level].Indices)
+			{
+				printf("FAILED : %s level %zu differs on the workers\n", meshes[m].Name, level + 1);
+				return 1;
+			}
+		}
+	}
+	printf("both chains : %.1f ms on %u threads\n", seconds * 1000.0, workers.ThreadCount());
+	printf("all checks passed\n");
+	return 0;
+}
@@ -0,0 +1,215 @@
+// MeshletBench.cpp : the meshlet builder (Helpers/MeshletBuilder.h) on the meshes GeometryGenerator builds,
+// after the vertex cache order SetShapeGeometry gives them.
+//
+// Checks every build :
+//   - meshlets keep to MeshletMaxVertices and MeshletMaxTriangles, and their triangles only use their own
+//     vertices,
+//   - every triangle of the mesh is in exactly one meshlet, with the same winding,
+//   - every bounding sphere holds the vertices of its meshlet,
+//   - the normal cones never cull a meshlet that has a triangle facing the camera : for random cameras
+//     around and inside each mesh, every meshlet the cone test culls is checked triangle by triangle,
+//   - PackMeshlets' buffer holds the same arrays at the offsets of its header.
+// Reports the build rate, how full the meshlets are and how many of the meshlets facing away the cones find.
+//   cl /O2 /EHsc Tools\MeshletBench.cpp Helpers\MeshletBuilder.cpp Helpers\MeshOptimizer.cpp Helpers\MeshSubdivision.cpp Helpers\WorkerPool.cpp
+//
+// usage : MeshletBench [cameras]
+
+#include "../Helpers/MeshletBuilder.h"
+#include "../Helpers/MeshOptimizer.h"
+#include "BenchMeshes.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// triangles rotated so the smallest index comes first, which keeps the winding.
+static std::vector<std::array<std::uint32_t, 3>> CanonicalTriangles(const std::vector<std::uint32_t>& indices)
+{
+	std::vector<std::array<std::uint32_t, 3>> triangles;
+	for (std::size_t t = 0; t < indices.size(); t += 3)
+	{
+		std::array<std::uint32_t, 3> tri = { indices[t], indices[t + 1], indices[t + 2] };
+		std::rotate(tri.begin(), std::min_element(tri.begin(), tri.end()), tri.end());
+		triangles.push_back(tri);
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+// brute force : does the triangle show its front to a camera at c, in double precision and with a margin for
+// triangles seen edge on.
+static bool FrontFacing(const float* p0, const float* p1, const float* p2, const double c[3])
+{
+	double e1[3], e2[3], toCamera[3];
+	for (int k = 0; k < 3; ++k)
+	{
+		e1[k] = (double)p1[k] - p0[k];
+		e2[k] = (double)p2[k] - p0[k];
+		toCamera[k] = c[k] - p0[k];
+	}
+	double n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+	double dot = n[0] * toCamera[0] + n[1] * toCamera[1] + n[2] * toCamera[2];
+	double scale = std::sqrt((n[0] * n[0] + n[1] * n[1] + n[2] * n[2]) * (toCamera[0] * toCamera[0] + toCamera[1] * toCamera[1] + toCamera[2] * toCamera[2]));
+	return dot > 1e-6 * scale;
+}
+
+static double Since(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static bool Check(const BenchMesh& mesh, int cameras)
+{
+	std::size_t vertexCount = mesh.Positions.size() / 3;
+	std::vector<std::uint32_t> indices = mesh.Indices;
+	OptimizeVertexCache(indices, vertexCount);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	MeshletData meshlets = BuildMeshlets(indices, mesh.Positions.data(), 3 * sizeof(float), vertexCount);
+	double ms = Since(start);
+	MeshletStats stats = AnalyzeMeshlets(meshlets);
+
+	// limits, and the triangles back as mesh indices.
+	std::vector<std::uint32_t> rebuilt;
+	for (const Meshlet& meshlet : meshlets.Meshlets)
+	{
+		if (meshlet.VertexCount == 0 || meshlet.VertexCount > MeshletMaxVertices || meshlet.TriangleCount == 0 || meshlet.TriangleCount > MeshletMaxTriangles)
+		{
+			std::printf("%s : a meshlet of %u vertices and %u triangles\n", mesh.Name, meshlet.VertexCount, meshlet.TriangleCount);
+			return false;
+		}
+		for (std::uint32_t t = 0; t < meshlet.TriangleCount; ++t)
+		{
+			std::uint32_t triangle = meshlets.Triangles[meshlet.TriangleOffset + t];
+			for (int k = 0; k < 3; ++k)
+			{
+				std::uint32_t corner = MeshletData::Corner(triangle, k);
+				if (corner >= meshlet.VertexCount)
+				{
+					std::printf("%s : a triangle uses vertex %u of a meshlet of %u\n", mesh.Name, corner, meshlet.VertexCount);
+					return false;
+				}
+				rebuilt.push_back(meshlets.Vertices[meshlet.VertexOffset + corner]);
+			}
+		}
+	}
+	if (CanonicalTriangles(rebuilt) != CanonicalTriangles(mesh.Indices))
+	{
+		std::printf("%s : the meshlet triangles differ from the mesh's\n", mesh.Name);
+		return false;
+	}
+
+	// bounding spheres.
+	for (std::size_t m = 0; m < meshlets.Meshlets.size(); ++m)
+	{
+		const Meshlet& meshlet = meshlets.Meshlets[m];
+		const MeshletBounds& bounds = meshlets.Bounds[m];
+		for (std::uint32_t i = 0; i < meshlet.VertexCount; ++i)
+		{
+			const float* p = &mesh.Positions[meshlets.Vertices[meshlet.VertexOffset + i] * 3];
+			float dx = p[0] - bounds.Center[0], dy = p[1] - bounds.Center[1], dz = p[2] - bounds.Center[2];
+			if (std::sqrt(dx * dx + dy * dy + dz * dz) > bounds.Radius * (1.0f + 1e-5f) + 1e-6f)
+			{
+				std::printf("%s : meshlet %zu's sphere misses one of its vertices\n", mesh.Name, m);
+				return false;
+			}
+		}
+	}
+
+	// cone culling against the triangles, cameras from inside the mesh out to 20 times its size.
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> distance(0.0f, 20.0f);
+	std::size_t facingAway = 0, coneCulled = 0, tests = 0;
+	for (int c = 0; c < cameras; ++c)
+	{
+		float direction[3], length = 0.0f;
+		do
+		{
+			for (int k = 0; k < 3; ++k)
+				direction[k] = unit(random);
+			length = std::sqrt(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+		} while (length < 1e-3f || length > 1.0f);
+		float r = distance(random);
+		float camera[3] = { direction[0] / length * r, direction[1] / length * r, direction[2] / length * r };
+		double cameraD[3] = { camera[0], camera[1], camera[2] };
+
+		for (std::size_t m = 0; m < meshlets.Meshlets.size(); ++m)
+		{
+			const Meshlet& meshlet = meshlets.Meshlets[m];
+			bool anyFront = false;
+			for (std::uint32_t t = 0; t < meshlet.TriangleCount && !anyFront; ++t)
+			{
+				std::uint32_t triangle = meshlets.Triangles[meshlet.TriangleOffset + t];
+				const float* p[3];
+				for (int k = 0; k < 3; ++k)
+					p[k] = &mesh.Positions[meshlets.Vertices[meshlet.VertexOffset + MeshletData::Corner(triangle, k)] * 3];
+				anyFront = FrontFacing(p[0], p[1], p[2], cameraD);
+			}
+
+			bool culled = MeshletBackfacing(meshlets.Bounds[m], camera);
+			if (culled && anyFront)
+			{
+				std::printf("%s : meshlet %zu is culled by its cone with a triangle facing the camera at (%g, %g, %g)\n", mesh.Name, m,
+					camera[0], camera[1], camera[2]);
+				return false;
+			}
+			facingAway += anyFront ? 0 : 1;
+			coneCulled += culled ? 1 : 0;
+			++tests;
+		}
+	}
+
+	// the packed buffer.
+	std::vector<std::uint8_t> blob = PackMeshlets(meshlets);
+	MeshletBlobHeader header;
+	std::memcpy(&header, blob.data(), sizeof(header));
+	bool packed = header.ByteSize == blob.size() && header.MeshletCount == meshlets.Meshlets.size() &&
+		header.VertexCount == meshlets.Vertices.size() && header.TriangleCount == meshlets.Triangles.size() &&
+		header.MeshletsOffset % 16 == 0 && header.BoundsOffset % 16 == 0 && header.VerticesOffset % 16 == 0 && header.TrianglesOffset % 16 == 0 &&
+		std::memcmp(&blob[header.MeshletsOffset], meshlets.Meshlets.data(), header.MeshletCount * sizeof(Meshlet)) == 0 &&
+		std::memcmp(&blob[header.BoundsOffset], meshlets.Bounds.data(), header.MeshletCount * sizeof(MeshletBounds)) == 0 &&
+		std::memcmp(&blob[header.VerticesOffset], meshlets.Vertices.data(), header.VertexCount * 4) == 0 &&
+		std::memcmp(&blob[header.TrianglesOffset], meshlets.Triangles.data(), header.TriangleCount * 4) == 0;
+	if (!packed)
+	{
+		std::printf("%s : the packed buffer doesn't match the meshlets\n", mesh.Name);
+		return false;
+	}
+
+	std::printf("%-10s %6zu tris  %4u meshlets  fill %4.1f%% vertices %4.1f%% triangles  cones %4u  culled %5.1f%% of %5.1f%% facing away"
+		"  %6.0f tris/ms  %7zu bytes\n", mesh.Name, indices.size() / 3, stats.Meshlets, 100.0f * stats.VertexFill, 100.0f * stats.TriangleFill,
+		stats.ConeCullable, 100.0 * coneCulled / tests, 100.0 * facingAway / tests, indices.size() / 3 / ms, blob.size());
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	int cameras = argc > 1 ? std::atoi(argv[1]) : 200;
+	if (cameras < 1)
+	{
+		cameras = 1;
+	}
+
+	// the sphere levels, plane and geospheres the sample could generate.
+	std::vector<BenchMesh> meshes;
+	for (std::uint32_t s = 128; s >= 8; s /= 2)
+		meshes.push_back(MakeSphere(s, s / 2));
+	meshes.push_back(MakeGrid(60, 60));
+	for (std::uint32_t subdivisions = 1; subdivisions <= 5; ++subdivisions)
+		meshes.push_back(MakeGeosphere(subdivisions));
+
+	for (const BenchMesh& mesh : meshes)
+	{
+		if (!Check(mesh, cameras))
+			return 1;
+	}
+	std::printf("%zu meshes checked\n", meshes.size());
+	return 0;
+}
@@ -0,0 +1,340 @@
+// OcclusionBench.cpp : MaskedOcclusionBuffer (Helpers/OcclusionCulling.h) on a field of spheres hidden
+// behind a few large ones.
+//
+// Renders low poly occluder spheres close to a camera into the buffer, then tests many small spheres
+// further away against it : every one of them, then through a SphereBvh over them, the frustum query
+// alone, the query with every object found tested, and the query that tests every node's box before what
+// is below it.  Reports the triangles rasterized, the objects rejected per millisecond and the median time of
+// each way per object of the field, and checks the results against a brute force depth buffer with one
+// exact depth per pixel :
+//   - every tile's depth has to lie behind all the pixels it stands for,
+//   - points sampled on every sphere reported occluded have to be behind the brute force depth,
+// and that the query testing nodes first finds the objects the one testing every object does.
+//   cl /O2 /EHsc Tools\OcclusionBench.cpp Helpers\OcclusionCulling.cpp Helpers\SphereBvh.cpp Helpers\FrustumCulling.cpp Helpers\WorkerPool.cpp
+//
+// usage : OcclusionBench [occludee count]
+
+#include "../Helpers/OcclusionCulling.h"
+#include "../Helpers/SphereBvh.h"
+#include "BenchMeshes.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <utility>
+#include <vector>
+
+struct Sphere
+{
+	float X;
+	float Y;
+	float Z;
+	float R;
+};
+
+// CreateSphere's unit sphere as an occluder, front faces clockwise seen from outside.
+static OccluderMesh MakeOccluderSphere(std::uint32_t slices, std::uint32_t stacks)
+{
+	BenchMesh sphere = MakeSphere(slices, stacks);
+	OccluderMesh mesh;
+	mesh.Positions = std::move(sphere.Positions);
+	mesh.Indices = std::move(sphere.Indices);
+	return mesh;
+}
+
+static void Multiply(const float a[4][4], const float b[4][4], float out[4][4])
+{
+	for (int r = 0; r < 4; ++r)
+		for (int c = 0; c < 4; ++c)
+			out[r][c] = a[r][0] * b[0][c] + a[r][1] * b[1][c] + a[r][2] * b[2][c] + a[r][3] * b[3][c];
+}
+
+static void ModelViewProj(const Sphere& s, const float viewProj[4][4], float out[4][4])
+{
+	float model[4][4] =
+	{
+		{ s.R, 0.0f, 0.0f, 0.0f },
+		{ 0.0f, s.R, 0.0f, 0.0f },
+		{ 0.0f, 0.0f, s.R, 0.0f },
+		{ s.X, s.Y, s.Z, 1.0f },
+	};
+	Multiply(model, viewProj, out);
+}
+
+// screen x, y and depth of a world space point, false when it is not in front of the near plane.
+static bool Project(const float m[4][4], float px, float py, float pz, float width, float height, float out[3])
+{
+	float x = px * m[0][0] + py * m[1][0] + pz * m[2][0] + m[3][0];
+	float y = px * m[0][1] + py * m[1][1] + pz * m[2][1] + m[3][1];
+	float z = px * m[0][2] + py * m[1][2] + pz * m[2][2] + m[3][2];
+	float w = px * m[0][3] + py * m[1][3] + pz * m[2][3] + m[3][3];
+	if (z < 0.0f || w <= 0.0f)
+		return false;
+	out[0] = (x / w * 0.5f + 0.5f) * width;
+	out[1] = (0.5f - y / w * 0.5f) * height;
+	out[2] = z / w;
+	return true;
+}
+
+// one exact depth per pixel, the same coverage rule as the buffer : pixel centers inside all three edges.
+static void ReferenceRender(const OccluderMesh& mesh, const float m[4][4], int width, int height, std::vector<float>& depth)
+{
+	std::size_t vertexCount = mesh.Positions.size() / 3;
+	std::vector<float> screen(vertexCount * 3);
+	std::vector<char> valid(vertexCount);
+	for (std::size_t i = 0; i < vertexCount; ++i)
+		valid[i] = Project(m, mesh.Positions[i * 3], mesh.Positions[i * 3 + 1], mesh.Positions[i * 3 + 2], (float)width, (float)height, &screen[i * 3]);
+
+	for (std::size_t t = 0; t < mesh.Indices.size(); t += 3)
+	{
+		std::uint32_t i0 = mesh.Indices[t], i1 = mesh.Indices[t + 1], i2 = mesh.Indices[t + 2];
+		if (!valid[i0] || !valid[i1] || !valid[i2])
+			continue;
+		const float* v[3] = { &screen[i0 * 3], &screen[i1 * 3], &screen[i2 * 3] };
+
+		float area = (v[1][0] - v[0][0]) * (v[2][1] - v[0][1]) - (v[1][1] - v[0][1]) * (v[2][0] - v[0][0]);
+		if (!(area > 0.0f))
+			continue;
+
+		for (int y = 0; y < height; ++y)
+		{
+			for (int x = 0; x < width; ++x)
+			{
+				float px = x + 0.5f, py = y + 0.5f;
+				bool inside = true;
+				for (int k = 0; k < 3; ++k)
+				{
+					const float* from = v[k];
+					const float* to = v[(k + 1) % 3];
+					float a = from[1] - to[1], b = to[0] - from[0], c = -(a * from[0] + b * from[1]);
+					inside = inside && a * px + (b * py + c) >= 0.0f;
+				}
+				if (!inside)
+					continue;
+
+				// barycentric depth at the pixel center.
+				float w1 = ((px - v[0][0]) * (v[2][1] - v[0][1]) - (py - v[0][1]) * (v[2][0] - v[0][0])) / area;
+				float w2 = ((v[1][0] - v[0][0]) * (py - v[0][1]) - (v[1][1] - v[0][1]) * (px - v[0][0])) / area;
+				float z = v[0][2] + w1 * (v[1][2] - v[0][2]) + w2 * (v[2][2] - v[0][2]);
+				depth[y * width + x] = std::min(depth[y * width + x], z);
+			}
+		}
+	}
+}
+
+static double Since(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// the median time of runs of fn, in milliseconds.
+template<typename Fn>
+static double MedianMs(int runs, Fn fn)
+{
+	std::vector<double> times;
+	for (int run = 0; run < runs; ++run)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		fn();
+		times.push_back(Since(start));
+	}
+	std::nth_element(times.begin(), times.begin() + runs / 2, times.end());
+	return times[runs / 2];
+}
+
+int main(int argc, char* argv[])
+{
+	int occludeeCount = argc > 1 ? std::atoi(argv[1]) : 200000;
+	if (occludeeCount < 1)
+	{
+		occludeeCount = 1;
+	}
+
+	const int width = 320, height = 176;
+	const float nearZ = 1.0f, farZ = 2000.0f;
+	float yScale = 1.0f / std::tan(0.5f * 0.25f * 3.14159265f);
+	float xScale = yScale * height / width;
+	float range = farZ / (farZ - nearZ);
+	float viewProj[4][4] =
+	{
+		{ xScale, 0.0f, 0.0f, 0.0f },
+		{ 0.0f, yScale, 0.0f, 0.0f },
+		{ 0.0f, 0.0f, range, 1.0f },
+		{ 0.0f, 0.0f, -range * nearZ, 0.0f },
+	};
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	// large spheres close to the camera, and small ones spread through the view behind them.
+	std::vector<Sphere> occluders;
+	for (int i = 0; i < 24; ++i)
+	{
+		float z = 40.0f + 80.0f * (0.5f + 0.5f * unit(random));
+		occluders.push_back({ 0.3f * z * unit(random), 0.15f * z * unit(random), z, 8.0f + 6.0f * unit(random) });
+	}
+	std::vector<Sphere> occludees;
+	for (int i = 0; i < occludeeCount; ++i)
+	{
+		float z = 150.0f + 750.0f * (0.5f + 0.5f * unit(random));
+		occludees.push_back({ 0.4f * z * unit(random), 0.22f * z * unit(random), z, 1.75f + 1.25f * unit(random) });
+	}
+
+	const OccluderMesh mesh = MakeOccluderSphere(16, 12);
+	MaskedOcclusionBuffer buffer;
+	buffer.Resize(width, height);
+
+	// rasterization rate.
+	const int renderRuns = 200;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int run = 0; run < renderRuns; ++run)
+	{
+		buffer.Clear();
+		for (const Sphere& s : occluders)
+		{
+			float m[4][4];
+			ModelViewProj(s, viewProj, m);
+			buffer.RenderMesh(mesh, m);
+		}
+		buffer.Finalize();
+	}
+	double renderMs = Since(start) / renderRuns;
+	OcclusionStats stats = buffer.Stats();
+
+	// test rate, every object on its own.
+	const int testRuns = 9;
+	std::vector<char> visible(occludees.size());
+	double testMs = MedianMs(testRuns, [&]()
+	{
+		for (std::size_t i = 0; i < occludees.size(); ++i)
+		{
+			const Sphere& s = occludees[i];
+			float boxMin[3] = { s.X - s.R, s.Y - s.R, s.Z - s.R };
+			float boxMax[3] = { s.X + s.R, s.Y + s.R, s.Z + s.R };
+			visible[i] = buffer.TestAabb(boxMin, boxMax, viewProj);
+		}
+	});
+	std::size_t rejected = std::count(visible.begin(), visible.end(), 0);
+
+	// through a tree over the objects : the frustum query, then every object it finds tested, or every node
+	// tested before what is below it.
+	SphereCullSet spheres;
+	spheres.Resize(occludees.size());
+	for (std::size_t i = 0; i < occludees.size(); ++i)
+	{
+		spheres.Set(i, occludees[i].X, occludees[i].Y, occludees[i].Z, occludees[i].R);
+	}
+	SphereBvh bvh;
+	bvh.Build(spheres);
+	const CullFrustum frustum = CullFrustum::FromViewProj(viewProj);
+	std::uint32_t boxTests = 0;
+	const SphereBvh::BoxTest boxVisible = [&](const float boxMin[3], const float boxMax[3])
+	{
+		boxTests++;
+		return buffer.TestAabb(boxMin, boxMax, viewProj);
+	};
+
+	std::vector<std::uint32_t> found(spheres.PaddedSize()), eachKept(spheres.PaddedSize()), leavesKept(spheres.PaddedSize());
+	std::uint32_t foundCount = 0, eachCount = 0, leavesCount = 0;
+	double queryMs = MedianMs(testRuns, [&]() { foundCount = bvh.QueryFrustum(frustum, found.data()); });
+	double eachMs = MedianMs(testRuns, [&]()
+	{
+		std::uint32_t count = bvh.QueryFrustum(frustum, found.data());
+		eachCount = 0;
+		for (std::uint32_t i = 0; i < count; ++i)
+		{
+			const Sphere& s = occludees[found[i]];
+			float boxMin[3] = { s.X - s.R, s.Y - s.R, s.Z - s.R };
+			float boxMax[3] = { s.X + s.R, s.Y + s.R, s.Z + s.R };
+			if (buffer.TestAabb(boxMin, boxMax, viewProj))
+				eachKept[eachCount++] = found[i];
+		}
+	});
+	double leavesMs = MedianMs(testRuns, [&]() { leavesCount = bvh.QueryFrustum(frustum, boxVisible, leavesKept.data()); });
+	boxTests /= testRuns;
+
+	std::sort(eachKept.begin(), eachKept.begin() + eachCount);
+	std::sort(leavesKept.begin(), leavesKept.begin() + leavesCount);
+	if (leavesCount != eachCount || !std::equal(eachKept.begin(), eachKept.begin() + eachCount, leavesKept.begin()))
+	{
+		std::printf("testing nodes first keeps %u objects, testing every object %u\n", leavesCount, eachCount);
+		return 1;
+	}
+	for (std::uint32_t i = 0; i < eachCount; ++i)
+	{
+		if (!visible[eachKept[i]])
+		{
+			std::printf("occludee %u is kept through the tree but hidden on its own\n", eachKept[i]);
+			return 1;
+		}
+	}
+
+	// brute force depth buffer.
+	std::vector<float> reference(width * height, 1.0f);
+	for (const Sphere& s : occluders)
+	{
+		float m[4][4];
+		ModelViewProj(s, viewProj, m);
+		ReferenceRender(mesh, m, width, height, reference);
+	}
+
+	for (std::uint32_t tileY = 0; tileY < buffer.Height() / MaskedOcclusionBuffer::TileHeight; ++tileY)
+	{
+		for (std::uint32_t tileX = 0; tileX < buffer.Width() / MaskedOcclusionBuffer::TileWidth; ++tileX)
+		{
+			float farthest = 0.0f;
+			for (std::uint32_t y = 0; y < MaskedOcclusionBuffer::TileHeight; ++y)
+				for (std::uint32_t x = 0; x < MaskedOcclusionBuffer::TileWidth; ++x)
+					farthest = std::max(farthest, reference[(tileY * MaskedOcclusionBuffer::TileHeight + y) * width + tileX * MaskedOcclusionBuffer::TileWidth + x]);
+
+			if (buffer.TileDepth(tileX, tileY) < farthest - 1e-5f)
+			{
+				std::printf("tile (%u, %u) is in front of its pixels : %f < %f\n", tileX, tileY, buffer.TileDepth(tileX, tileY), farthest);
+				return 1;
+			}
+		}
+	}
+
+	for (std::size_t i = 0; i < occludees.size(); ++i)
+	{
+		if (visible[i])
+			continue;
+
+		const Sphere& s = occludees[i];
+		for (int sample = 0; sample < 32; ++sample)
+		{
+			float d[3] = { unit(random), unit(random), unit(random) };
+			float length = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]) + 1e-6f;
+			float p[3];
+			if (!Project(viewProj, s.X + s.R * d[0] / length, s.Y + s.R * d[1] / length, s.Z + s.R * d[2] / length, (float)width, (float)height, p))
+				continue;
+
+			int x = (int)p[0], y = (int)p[1];
+			if (x < 0 || y < 0 || x >= width || y >= height)
+				continue;
+			if (p[2] <= reference[y * width + x])
+			{
+				std::printf("occludee %zu reported hidden but its point at (%d, %d) is in front\n", i, x, y);
+				return 1;
+			}
+		}
+	}
+
+	std::printf("buffer %ux%u, %zu occluders, %u triangles, %u rasterized, %u tile updates\n", buffer.Width(), buffer.Height(),
+		occluders.size(), stats.Triangles, stats.Rasterized, stats.TileUpdates);
+	std::printf("render   : %8.3f ms  %10.0f triangles/ms\n", renderMs, stats.Rasterized / renderMs);
+	std::printf("test     : %8.3f ms  %10.0f objects/ms, %zu of %zu rejected (%.1f%%), %10.0f rejected/ms\n", testMs,
+		occludees.size() / testMs, rejected, occludees.size(), 100.0 * rejected / occludees.size(), rejected / testMs);
+
+	// per object of the field, so that the ways compare.
+	const double toNs = 1e6 / occludees.size();
+	std::printf("every object tested                 : %8.3f ms  %6.1f ns/object\n", testMs, testMs * toNs);
+	std::printf("bvh frustum query                   : %8.3f ms  %6.1f ns/object, %u found\n", queryMs, queryMs * toNs, foundCount);
+	std::printf("bvh query, every object found tested : %8.3f ms  %6.1f ns/object, %u kept\n", eachMs, eachMs * toNs, eachCount);
+	std::printf("bvh query, nodes tested first       : %8.3f ms  %6.1f ns/object, %u kept, %u box tests\n", leavesMs, leavesMs * toNs,
+		leavesCount, boxTests);
+	return 0;
+}
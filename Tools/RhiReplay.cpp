@@ -0,0 +1,65 @@
+// RhiReplay.cpp : headless replay of a command stream capture (Rhi/RhiCapture.h) into the null backend.
+//
+// Measures the CPU cost of decoding and issuing the captured commands without a GPU, a window,
+// the simulation or any input.  It only depends on the portable part of the RHI, e.g.
+//   cl /O2 /EHsc Tools\RhiReplay.cpp Rhi\RhiCapture.cpp Rhi\RhiRecording.cpp Rhi\RhiNull.cpp
+//
+// usage : RhiReplay <capture file> [repeat count]
+
+#include "../Rhi/RhiCapture.h"
+#include "../Rhi/RhiNull.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		std::printf("usage : RhiReplay <capture file> [repeat count]\n");
+		return 1;
+	}
+
+	RhiCapture capture;
+	if (!capture.Load(argv[1]))
+	{
+		std::printf("cannot load the capture %s\n", argv[1]);
+		return 1;
+	}
+
+	int repeat = argc > 2 ? std::atoi(argv[2]) : 10;
+	if (repeat < 1)
+	{
+		repeat = 1;
+	}
+
+	NullRhiDevice device;
+	std::unique_ptr<RhiCommandList> sink = device.CreateCommandList(RhiQueueType::Direct);
+	RhiReplayer replayer;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < repeat; ++r)
+	{
+		for (std::uint32_t i = 0; i < capture.FrameCount(); ++i)
+		{
+			if (!replayer.Replay(capture.FrameData(i), capture.FrameSize(i), sink.get()))
+			{
+				std::printf("frame %u of the capture is malformed\n", i);
+				return 1;
+			}
+		}
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+	const RhiReplayStats& stats = replayer.Stats();
+	double frames = (double)capture.FrameCount() * repeat;
+
+	std::printf("%u frames, %zu bytes (%.1f bytes/frame)\n", capture.FrameCount(), capture.ByteSize(),
+		capture.FrameCount() ? (double)capture.ByteSize() / capture.FrameCount() : 0.0);
+	std::printf("replayed %d times : %.3f ms total, %.2f us/frame, %.1f ns/command, %.0f MB/s\n", repeat,
+		seconds * 1000.0, seconds * 1e6 / frames, seconds * 1e9 / (double)stats.Commands, (double)stats.Bytes / seconds / 1e6);
+	std::printf("%llu commands, %llu draws\n", (unsigned long long)stats.Commands, (unsigned long long)stats.Draws);
+
+	return 0;
+}
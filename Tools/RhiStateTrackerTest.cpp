@@ -0,0 +1,256 @@
+// RhiStateTrackerTest.cpp : the barrier batches RhiResourceStateTracker (Rhi/RhiStateTracker.h) issues, recorded
+// by a null backend command list.
+//
+// Checks :
+//   A->B->C between two pieces of work goes out as one A->C barrier
+//   A->B->A between two pieces of work goes out as nothing at all
+//   a frame of draws and copies gets at most one ResourceBarrier call before each of them
+//   a split transition issues its begin half with one flush and its end half with a later one, work in between
+//   a split transition with no work in between is merged back into one regular barrier
+//   subresource transitions, and the states a list leaves in the registry for the next one
+// The RHI has no dispatch, copies stand for the work that is not a draw.
+//   cl /O2 /EHsc Tools\RhiStateTrackerTest.cpp Rhi\RhiStateTracker.cpp Rhi\RhiNull.cpp
+//
+// usage : RhiStateTrackerTest
+
+#include "../Rhi/RhiNull.h"
+#include "../Rhi/RhiStateTracker.h"
+
+#include <cstdio>
+#include <vector>
+
+// null command list keeping every ResourceBarrier call, and the number of calls since the last piece of work.
+class BarrierRecordingCommandList : public NullRhiCommandList
+{
+public:
+	BarrierRecordingCommandList() : NullRhiCommandList(1, RhiQueueType::Direct) {}
+
+	std::vector<std::vector<RhiTransitionBarrier>> Batches;
+	std::uint32_t WorkCount = 0;
+	std::uint32_t MaxBatchesBeforeWork = 0;
+
+	virtual void Begin(RhiPipelineState* initialState) override
+	{
+		NullRhiCommandList::Begin(initialState);
+		Batches.clear();
+		WorkCount = 0;
+		MaxBatchesBeforeWork = 0;
+		mBatchesSinceWork = 0;
+	}
+
+	virtual void ResourceBarrier(std::uint32_t count, const RhiTransitionBarrier* barriers) override
+	{
+		NullRhiCommandList::ResourceBarrier(count, barriers);
+		Batches.emplace_back(barriers, barriers + count);
+		mBatchesSinceWork++;
+	}
+
+	virtual void DrawIndexedInstanced(std::uint32_t indexCountPerInstance, std::uint32_t instanceCount,
+		std::uint32_t startIndexLocation, std::int32_t baseVertexLocation, std::uint32_t startInstanceLocation) override
+	{
+		NullRhiCommandList::DrawIndexedInstanced(indexCountPerInstance, instanceCount, startIndexLocation, baseVertexLocation, startInstanceLocation);
+		Work();
+	}
+
+	virtual void CopyBufferRegion(RhiBuffer* dst, std::uint64_t dstOffset, RhiBuffer* src, std::uint64_t srcOffset, std::uint64_t numBytes) override
+	{
+		NullRhiCommandList::CopyBufferRegion(dst, dstOffset, src, srcOffset, numBytes);
+		Work();
+	}
+
+private:
+	void Work()
+	{
+		WorkCount++;
+		MaxBatchesBeforeWork = mBatchesSinceWork > MaxBatchesBeforeWork ? mBatchesSinceWork : MaxBatchesBeforeWork;
+		mBatchesSinceWork = 0;
+	}
+
+	std::uint32_t mBatchesSinceWork = 0;
+};
+
+static bool Check(bool condition, const char* what)
+{
+	if (!condition)
+	{
+		printf("FAILED : %s\n", what);
+	}
+	return condition;
+}
+
+static bool IsBarrier(const RhiTransitionBarrier& barrier, RhiResource* resource, std::uint32_t subresource,
+	RhiResourceState before, RhiResourceState after, RhiBarrierFlags flags)
+{
+	return barrier.Resource == resource && barrier.Subresource == subresource && barrier.Before == before &&
+		barrier.After == after && barrier.Flags == flags;
+}
+
+int main()
+{
+	NullRhiDevice device;
+	BarrierRecordingCommandList cmdList;
+	RhiResourceStateRegistry registry;
+	RhiResourceStateTracker tracker(&registry);
+
+	RhiBufferDesc bufferDesc;
+	bufferDesc.ByteSize = 1 << 16;
+	std::unique_ptr<RhiBuffer> buffer = device.CreateBuffer(bufferDesc);
+	std::unique_ptr<RhiBuffer> upload = device.CreateBuffer(bufferDesc);
+	RhiTextureDesc textureDesc;
+	textureDesc.Width = 256;
+	textureDesc.Height = 256;
+	textureDesc.MipLevels = 4;
+	textureDesc.Format = RhiFormat::R8G8B8A8Unorm;
+	std::unique_ptr<RhiTexture> texture = device.CreateTexture(textureDesc);
+	std::unique_ptr<RhiTexture> target = device.CreateTexture(textureDesc);
+
+	registry.Register(buffer.get(), RhiResourceState::Common);
+	registry.Register(upload.get(), RhiResourceState::GenericRead);
+	registry.Register(texture.get(), RhiResourceState::PixelShaderResource);
+	registry.Register(target.get(), RhiResourceState::RenderTarget);
+
+	auto begin = [&]()
+	{
+		cmdList.Begin(nullptr);
+		tracker.Begin(&cmdList);
+	};
+	auto draw = [&]()
+	{
+		tracker.Flush();
+		cmdList.DrawIndexedInstanced(3, 1, 0, 0, 0);
+	};
+	auto copy = [&]()
+	{
+		tracker.Flush();
+		cmdList.CopyBufferRegion(buffer.get(), 0, upload.get(), 0, 256);
+	};
+
+	// A->B->C
+	begin();
+	tracker.Transition(buffer.get(), RhiResourceState::CopyDest);
+	tracker.Transition(buffer.get(), RhiResourceState::PixelShaderResource);
+	draw();
+	tracker.End();
+	if (!Check(cmdList.Batches.size() == 1 && cmdList.Batches[0].size() == 1, "A->B->C is one batch of one barrier") ||
+		!Check(IsBarrier(cmdList.Batches[0][0], buffer.get(), RhiAllSubresources, RhiResourceState::Common,
+			RhiResourceState::PixelShaderResource, RhiBarrierFlags::None), "A->B->C goes out as A->C") ||
+		!Check(tracker.Stats().Merged == 1, "A->B->C counts one merge"))
+	{
+		return 1;
+	}
+
+	// A->B->A, starting from the state the last list left in the registry.
+	begin();
+	tracker.Transition(buffer.get(), RhiResourceState::CopyDest);
+	tracker.Transition(buffer.get(), RhiResourceState::PixelShaderResource);
+	draw();
+	tracker.End();
+	if (!Check(cmdList.Batches.empty(), "A->B->A issues no barrier") ||
+		!Check(tracker.Stats().Merged == 1 && tracker.Stats().Barriers == 0, "A->B->A counts one merge and no barrier") ||
+		!Check(registry.Find(buffer.get()).Get(0) == RhiResourceState::PixelShaderResource, "the registry keeps the state of the list"))
+	{
+		return 1;
+	}
+
+	// a frame : uploads, then draws ping-ponging between the texture and the render target.
+	begin();
+	tracker.Transition(buffer.get(), RhiResourceState::CopyDest);
+	copy();
+	copy();
+	tracker.Transition(buffer.get(), RhiResourceState::VertexAndConstantBuffer);
+	draw();
+	const int passes = 10;
+	for (int pass = 0; pass < passes; ++pass)
+	{
+		RhiTexture* read = pass % 2 ? texture.get() : target.get();
+		RhiTexture* written = pass % 2 ? target.get() : texture.get();
+		tracker.Transition(read, RhiResourceState::PixelShaderResource);
+		tracker.Transition(written, RhiResourceState::RenderTarget);
+		tracker.Transition(buffer.get(), RhiResourceState::VertexAndConstantBuffer);
+		draw();
+		draw();
+	}
+	tracker.End();
+	std::size_t barriers = 0;
+	for (const auto& batch : cmdList.Batches)
+	{
+		barriers += batch.size();
+	}
+	if (!Check(cmdList.MaxBatchesBeforeWork == 1, "at most one batch before each draw or copy") ||
+		!Check(cmdList.WorkCount == 3 + 2 * passes, "every draw and copy recorded") ||
+		!Check(cmdList.Batches.size() == 2 + passes, "one batch before the copies, the first draw and every pass") ||
+		!Check(cmdList.Batches[0].size() == 1 && barriers == 2 + 2 * passes, "the buffer twice, two textures swapping per pass") ||
+		!Check(tracker.Stats().Batches == cmdList.Batches.size() && tracker.Stats().Barriers == barriers, "the stats count the calls"))
+	{
+		return 1;
+	}
+
+	// split : begin half, a flush, work, end half.
+	begin();
+	tracker.BeginSplitTransition(texture.get(), RhiResourceState::CopyDest);
+	tracker.Transition(target.get(), RhiResourceState::PixelShaderResource);
+	draw();
+	draw();
+	tracker.Transition(texture.get(), RhiResourceState::CopyDest);
+	draw();
+	tracker.End();
+	if (!Check(cmdList.Batches.size() == 2 && cmdList.Batches[0].size() == 2 && cmdList.Batches[1].size() == 1, "split halves in two batches") ||
+		!Check(IsBarrier(cmdList.Batches[0][0], texture.get(), RhiAllSubresources, RhiResourceState::PixelShaderResource,
+			RhiResourceState::CopyDest, RhiBarrierFlags::BeginOnly), "the begin half goes out with the first flush") ||
+		!Check(IsBarrier(cmdList.Batches[1][0], texture.get(), RhiAllSubresources, RhiResourceState::PixelShaderResource,
+			RhiResourceState::CopyDest, RhiBarrierFlags::EndOnly), "the end half goes out after the work") ||
+		!Check(tracker.Stats().Splits == 1 && tracker.Stats().CollapsedSplits == 0, "one split kept"))
+	{
+		return 1;
+	}
+
+	// a split left open is ended by End.
+	begin();
+	tracker.BeginSplitTransition(texture.get(), RhiResourceState::PixelShaderResource);
+	draw();
+	tracker.End();
+	if (!Check(cmdList.Batches.size() == 2 && cmdList.Batches[1].size() == 1 &&
+			cmdList.Batches[1][0].Flags == RhiBarrierFlags::EndOnly, "End issues the end half of an open split") ||
+		!Check(registry.Find(texture.get()).Get(0) == RhiResourceState::PixelShaderResource, "the split's state reaches the registry"))
+	{
+		return 1;
+	}
+
+	// split with nothing in between : one regular barrier, also when followed by another state.
+	begin();
+	tracker.BeginSplitTransition(texture.get(), RhiResourceState::CopyDest);
+	tracker.Transition(texture.get(), RhiResourceState::CopyDest);
+	tracker.BeginSplitTransition(target.get(), RhiResourceState::CopyDest);
+	tracker.Transition(target.get(), RhiResourceState::RenderTarget);
+	draw();
+	tracker.End();
+	if (!Check(cmdList.Batches.size() == 1 && cmdList.Batches[0].size() == 2, "collapsed splits are one batch of two barriers") ||
+		!Check(IsBarrier(cmdList.Batches[0][0], texture.get(), RhiAllSubresources, RhiResourceState::PixelShaderResource,
+			RhiResourceState::CopyDest, RhiBarrierFlags::None), "a split ended at once is a regular barrier") ||
+		!Check(IsBarrier(cmdList.Batches[0][1], target.get(), RhiAllSubresources, RhiResourceState::PixelShaderResource,
+			RhiResourceState::RenderTarget, RhiBarrierFlags::None), "a split ended at once merges with the next transition") ||
+		!Check(tracker.Stats().Splits == 0 && tracker.Stats().CollapsedSplits == 2, "two splits collapsed"))
+	{
+		return 1;
+	}
+
+	// subresources : one mip out and back in with the others.
+	begin();
+	tracker.Transition(texture.get(), RhiResourceState::RenderTarget, 2);
+	draw();
+	tracker.Transition(texture.get(), RhiResourceState::PixelShaderResource);
+	draw();
+	tracker.End();
+	if (!Check(cmdList.Batches.size() == 2 && cmdList.Batches[0].size() == 1 && cmdList.Batches[1].size() == 4, "one barrier per subresource") ||
+		!Check(IsBarrier(cmdList.Batches[0][0], texture.get(), 2, RhiResourceState::CopyDest,
+			RhiResourceState::RenderTarget, RhiBarrierFlags::None), "the mip leaves on its own") ||
+		!Check(IsBarrier(cmdList.Batches[1][2], texture.get(), 2, RhiResourceState::RenderTarget,
+			RhiResourceState::PixelShaderResource, RhiBarrierFlags::None), "the mip comes back from its own state") ||
+		!Check(registry.Find(texture.get()).PerSubresource.empty(), "agreeing subresources are stored as one state"))
+	{
+		return 1;
+	}
+
+	printf("all checks passed\n");
+	return 0;
+}
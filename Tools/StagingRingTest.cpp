@@ -0,0 +1,233 @@
+// StagingRingTest.cpp : the staging ring of UploadManager (Helpers/StagingRing.h), driven the way
+// UploadManager::AllocateStaging drives it, with batches that complete as soon as they are waited for.
+//
+// Checks :
+//   an upload that fits the ring but not before its end, larger than what precedes it, on a ring whose
+//     batches have all completed (13 MB then 20 MB in 32 MB) : it goes at the start of the next lap
+//   the same with the earlier upload still in the open batch : that batch is submitted and waited for
+//   a full ring waits for its oldest batch only
+//   random uploads up to the whole ring : every allocation is found after a bounded number of waits,
+//     stays inside the ring and never overlaps the space of a batch that has not completed
+//   cl /O2 /EHsc Tools\StagingRingTest.cpp Helpers\StagingRing.cpp
+//
+// usage : StagingRingTest
+
+#include "../Helpers/StagingRing.h"
+
+#include <cstdio>
+#include <deque>
+#include <random>
+#include <vector>
+
+static const std::uint64_t MB = 1024 * 1024;
+
+// the batches of UploadManager : the open one, and those submitted but not waited for.
+class FakeUploads
+{
+public:
+	explicit FakeUploads(std::uint64_t ringSize) : mRing(ringSize) {}
+
+	struct Allocation
+	{
+		std::uint64_t RingOffset;
+		std::uint64_t Size;
+	};
+
+	// AllocateStaging's loop, counting the waits it took.  Fails instead of spinning past maxWaits.
+	bool Allocate(std::uint64_t size, std::uint64_t alignment, std::uint64_t& ringOffset, std::uint32_t maxWaits, std::uint32_t* waits = nullptr)
+	{
+		std::uint32_t count = 0;
+		while (!mRing.Allocate(size, alignment, ringOffset))
+		{
+			if (mRing.Empty() || ++count > maxWaits)
+			{
+				return false;
+			}
+			if (!InFlight.empty())
+			{
+				WaitOldest();
+			}
+			else
+			{
+				Submit();
+				WaitOldest();
+			}
+		}
+		OpenBatch.push_back({ ringOffset, size });
+		if (waits)
+		{
+			*waits = count;
+		}
+		return true;
+	}
+
+	void Submit()
+	{
+		if (!OpenBatch.empty())
+		{
+			InFlight.push_back({ mRing.Head(), OpenBatch });
+			OpenBatch.clear();
+		}
+	}
+
+	void WaitOldest()
+	{
+		mRing.Retire(InFlight.front().StagingEnd);
+		InFlight.pop_front();
+	}
+
+	void WaitAll()
+	{
+		Submit();
+		while (!InFlight.empty())
+		{
+			WaitOldest();
+		}
+	}
+
+	const StagingRing& Ring()const { return mRing; }
+
+	struct Batch
+	{
+		std::uint64_t StagingEnd;
+		std::vector<Allocation> Allocations;
+	};
+	std::vector<Allocation> OpenBatch;
+	std::deque<Batch> InFlight;
+
+private:
+	StagingRing mRing;
+};
+
+static bool Overlap(const FakeUploads::Allocation& a, const FakeUploads::Allocation& b)
+{
+	return a.RingOffset < b.RingOffset + b.Size && b.RingOffset < a.RingOffset + a.Size;
+}
+
+int main()
+{
+	const std::uint64_t ringSize = 32 * MB;
+	const std::uint64_t textureAlignment = 512;
+
+	// 13 MB uploaded and completed, then 20 MB : 13 + 20 passes the end of the ring, and 20 > 13.
+	{
+		FakeUploads uploads(ringSize);
+		std::uint64_t offset = 0;
+		uploads.Allocate(13 * MB, 16, offset, 0);
+		uploads.WaitAll();
+		std::uint32_t waits = 0;
+		if (!uploads.Allocate(20 * MB, textureAlignment, offset, 4, &waits) || offset != 0 || waits != 0)
+		{
+			printf("FAILED : 20 MB after 13 MB completed, offset %llu after %u waits\n", (unsigned long long)offset, waits);
+			return 1;
+		}
+	}
+
+	// the same with the 13 MB still in the open batch, and with an odd head before the wrap.
+	for (std::uint64_t first : { 13 * MB, 13 * MB + 7, 31 * MB + 1 })
+	{
+		FakeUploads uploads(ringSize);
+		std::uint64_t offset = 0;
+		uploads.Allocate(first, 1, offset, 0);
+		std::uint32_t waits = 0;
+		if (!uploads.Allocate(20 * MB, textureAlignment, offset, 4, &waits) || offset != 0 || waits != 1 ||
+			!uploads.InFlight.empty())
+		{
+			printf("FAILED : 20 MB after %llu bytes in the open batch, offset %llu after %u waits\n",
+				(unsigned long long)first, (unsigned long long)offset, waits);
+			return 1;
+		}
+	}
+
+	// the whole ring, after an allocation that left the head anywhere.
+	{
+		FakeUploads uploads(ringSize);
+		std::uint64_t offset = 0;
+		uploads.Allocate(5, 1, offset, 0);
+		uploads.Submit();
+		if (!uploads.Allocate(ringSize, textureAlignment, offset, 4) || offset != 0)
+		{
+			printf("FAILED : the whole ring after 5 bytes\n");
+			return 1;
+		}
+	}
+
+	// three batches of 10 MB in flight, 8 MB more only waits for the first.
+	{
+		FakeUploads uploads(ringSize);
+		std::uint64_t offset = 0;
+		for (int i = 0; i < 3; ++i)
+		{
+			uploads.Allocate(10 * MB, 16, offset, 0);
+			uploads.Submit();
+		}
+		std::uint32_t waits = 0;
+		if (!uploads.Allocate(8 * MB, 16, offset, 4, &waits) || waits != 1 || uploads.InFlight.size() != 2 || offset != 0)
+		{
+			printf("FAILED : 8 MB with a full ring took %u waits, %zu batches left\n", waits, uploads.InFlight.size());
+			return 1;
+		}
+	}
+
+	// random uploads and submits against the space of the batches still alive.
+	{
+		std::mt19937_64 rng(31);
+		FakeUploads uploads(ringSize);
+		std::uint64_t totalWaits = 0;
+		for (int i = 0; i < 200000; ++i)
+		{
+			std::uint64_t size;
+			switch (rng() % 4)
+			{
+			case 0: size = 1 + rng() % 4096; break;
+			case 1: size = 1 + rng() % MB; break;
+			case 2: size = 1 + rng() % (16 * MB); break;
+			default: size = ringSize - rng() % (ringSize / 2); break;
+			}
+			std::uint64_t alignment = rng() % 2 ? 16 : textureAlignment;
+
+			std::uint64_t offset = 0;
+			std::uint32_t waits = 0;
+			std::uint32_t maxWaits = (std::uint32_t)uploads.InFlight.size() + 1;
+			if (!uploads.Allocate(size, alignment, offset, maxWaits, &waits))
+			{
+				printf("FAILED : upload %d of %llu bytes found no space after %u waits\n", i, (unsigned long long)size, maxWaits);
+				return 1;
+			}
+			totalWaits += waits;
+
+			FakeUploads::Allocation allocation = uploads.OpenBatch.back();
+			bool overlaps = offset % alignment != 0 || offset + size > ringSize;
+			for (std::size_t a = 0; a + 1 < uploads.OpenBatch.size(); ++a)
+			{
+				overlaps = overlaps || Overlap(allocation, uploads.OpenBatch[a]);
+			}
+			for (const FakeUploads::Batch& batch : uploads.InFlight)
+			{
+				for (const FakeUploads::Allocation& other : batch.Allocations)
+				{
+					overlaps = overlaps || Overlap(allocation, other);
+				}
+			}
+			if (overlaps)
+			{
+				printf("FAILED : upload %d of %llu bytes at %llu overlaps live space or leaves the ring\n", i,
+					(unsigned long long)size, (unsigned long long)offset);
+				return 1;
+			}
+
+			if (rng() % 3 == 0)
+			{
+				uploads.Submit();
+			}
+			if (rng() % 7 == 0 && !uploads.InFlight.empty())
+			{
+				uploads.WaitOldest();
+			}
+		}
+		printf("200000 random uploads, %llu waits\n", (unsigned long long)totalWaits);
+	}
+
+	printf("all checks passed\n");
+	return 0;
+}
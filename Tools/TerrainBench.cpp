@@ -0,0 +1,253 @@
+// TerrainBench.cpp : the terrain of a planet (Helpers/PlanetTerrain.h, Helpers/TerrainHeights.h) from orbit
+// down to the ground, without a device.
+//
+// Writes a small height file, then flies the eye from far away down to just above the surface, towards a
+// face centre and towards a cube corner where three faces meet.  At every altitude it selects patches
+// until the streamer has every tile they wait for, then checks :
+//   - the selection fits the triangle budget,
+//   - the levels of two patches sharing an edge differ by one at most, and StitchMask marks the coarser ones,
+//   - welded by position, every edge of the stitched patches has exactly two triangles, in opposite
+//     directions : no cracks, no T-junctions, nothing flipped,
+//   - every triangle faces outward, and the enclosed volume is the sphere's,
+//   - a second quadtree flying the same path selects the same patches,
+// and a tiny budget still gets the six faces and reports it is limited.
+//   cl /O2 /EHsc Tools\TerrainBench.cpp Helpers\PlanetTerrain.cpp Helpers\TerrainHeights.cpp Helpers\WorkerPool.cpp
+//
+// usage : TerrainBench [triangle budget]
+
+#include "../Helpers/PlanetTerrain.h"
+#include "../Helpers/WorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+static const char* const HeightFileName = "TerrainBench.terrain";
+static const std::uint32_t TileSize = 33;
+static const std::uint32_t LevelCount = 4;
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// the same level limits and edge bits everywhere, false with a message otherwise.
+static bool CheckBalance(const TerrainQuadtree& tree)
+{
+	for (const TerrainPatch& patch : tree.Patches())
+	{
+		for (std::uint32_t edge = TerrainEdgeU0; edge <= TerrainEdgeV1; edge <<= 1)
+		{
+			CubeQuadKey neighbour = tree.Neighbour(patch.Key, edge);
+			if (neighbour.Level + 1 < patch.Key.Level)
+			{
+				printf("FAILED : patch %u/%u/%u/%u has a neighbour at level %u\n", patch.Key.Face, patch.Key.Level, patch.Key.X, patch.Key.Y, neighbour.Level);
+				return false;
+			}
+			if (((patch.StitchMask & edge) != 0) != (neighbour.Level < patch.Key.Level))
+			{
+				printf("FAILED : patch %u/%u/%u/%u stitch mask %x\n", patch.Key.Face, patch.Key.Level, patch.Key.X, patch.Key.Y, patch.StitchMask);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// welds the stitched patches by position and checks the mesh is closed, consistently wound and outward.
+static bool CheckSurface(const TerrainQuadtree& tree, TerrainHeightStreamer& streamer, const TerrainStitchIndices& stitch, double& buildSeconds)
+{
+	const TerrainSettings& settings = tree.Settings();
+	const std::uint32_t vertexCount = settings.GridSize * settings.GridSize;
+	std::vector<TerrainVertex> vertices(vertexCount);
+	std::map<std::tuple<float, float, float>, std::uint32_t> welded;
+	std::map<std::pair<std::uint32_t, std::uint32_t>, int> directed;
+	std::vector<std::uint32_t> ids(vertexCount);
+	double volume = 0.0;
+	buildSeconds = 0.0;
+
+	for (const TerrainPatch& patch : tree.Patches())
+	{
+		auto start = std::chrono::steady_clock::now();
+		BuildTerrainPatch(patch.Key, settings, *streamer.Covering(patch.Key), vertices.data());
+		buildSeconds += Seconds(start);
+
+		for (std::uint32_t i = 0; i < vertexCount; ++i)
+		{
+			const float* p = vertices[i].Position;
+			auto inserted = welded.insert({ std::make_tuple(p[0], p[1], p[2]), (std::uint32_t)welded.size() });
+			ids[i] = inserted.first->second;
+		}
+
+		const std::uint16_t* indices = &stitch.Indices[stitch.Start[patch.StitchMask]];
+		for (std::uint32_t t = 0; t < stitch.Count[patch.StitchMask]; t += 3)
+		{
+			const float* a = vertices[indices[t]].Position;
+			const float* b = vertices[indices[t + 1]].Position;
+			const float* c = vertices[indices[t + 2]].Position;
+			double ab[3] = { (double)b[0] - a[0], (double)b[1] - a[1], (double)b[2] - a[2] };
+			double ac[3] = { (double)c[0] - a[0], (double)c[1] - a[1], (double)c[2] - a[2] };
+			double n[3] = { ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0] };
+			double centroid[3] = { ((double)a[0] + b[0] + c[0]) / 3.0, ((double)a[1] + b[1] + c[1]) / 3.0, ((double)a[2] + b[2] + c[2]) / 3.0 };
+			if (n[0] * centroid[0] + n[1] * centroid[1] + n[2] * centroid[2] <= 0.0)
+			{
+				printf("FAILED : a triangle of patch %u/%u/%u/%u faces inward\n", patch.Key.Face, patch.Key.Level, patch.Key.X, patch.Key.Y);
+				return false;
+			}
+			volume += (a[0] * ((double)b[1] * c[2] - (double)b[2] * c[1]) - a[1] * ((double)b[0] * c[2] - (double)b[2] * c[0]) +
+				a[2] * ((double)b[0] * c[1] - (double)b[1] * c[0])) / 6.0;
+
+			std::uint32_t corner[3] = { ids[indices[t]], ids[indices[t + 1]], ids[indices[t + 2]] };
+			for (int e = 0; e < 3; ++e)
+			{
+				directed[{ corner[e], corner[(e + 1) % 3] }]++;
+			}
+		}
+	}
+
+	for (const auto& edge : directed)
+	{
+		auto reverse = directed.find({ edge.first.second, edge.first.first });
+		if (edge.second != 1 || reverse == directed.end() || reverse->second != 1)
+		{
+			printf("FAILED : edge %u-%u is used %d times, its reverse %d times\n", edge.first.first, edge.first.second,
+				edge.second, reverse == directed.end() ? 0 : reverse->second);
+			return false;
+		}
+	}
+
+	double sphere = 4.0 / 3.0 * 3.14159265358979 * std::pow(1.0 - settings.HeightScale, 3.0);
+	double sphereMax = 4.0 / 3.0 * 3.14159265358979 * std::pow(1.0 + settings.HeightScale, 3.0);
+	if (volume < sphere * 0.97 || volume > sphereMax)
+	{
+		printf("FAILED : the surface encloses %.4f, not about a unit sphere\n", volume);
+		return false;
+	}
+	return true;
+}
+
+// selects until the patches wait for no tile, at most a frame per level.
+static bool Converge(TerrainQuadtree& tree, TerrainHeightStreamer& streamer, const float eye[3], std::uint32_t budget, int& frames)
+{
+	auto dataReady = [&](const CubeQuadKey& key)
+	{
+		return streamer.Request(key.Ancestor(std::min(key.Level, streamer.LevelCount() - 1))) != nullptr;
+	};
+	for (frames = 1; frames <= (int)tree.Settings().MaxLevel + 2; ++frames)
+	{
+		tree.Select(eye, budget, dataReady);
+		streamer.Update();
+		if (tree.Stats().WaitingForData == 0)
+		{
+			return true;
+		}
+		streamer.WaitIdle();
+	}
+	printf("FAILED : still waiting for %u splits after %d frames\n", tree.Stats().WaitingForData, frames - 1);
+	return false;
+}
+
+int main(int argc, char** argv)
+{
+	std::uint32_t budget = argc > 1 ? (std::uint32_t)atoi(argv[1]) : 200000;
+
+	WorkerPool workers;
+	auto start = std::chrono::steady_clock::now();
+	if (!WriteTerrainHeights(HeightFileName, TileSize, LevelCount, TerrainNoiseHeight, &workers))
+	{
+		printf("FAILED : could not write %s\n", HeightFileName);
+		return 1;
+	}
+	printf("height file : %u levels of %ux%u tiles written in %.1f ms (%u threads)\n", LevelCount, TileSize, TileSize,
+		Seconds(start) * 1000.0, workers.ThreadCount());
+
+	TerrainHeightStreamer streamer(2, 4096);
+	if (!streamer.Open(HeightFileName))
+	{
+		printf("FAILED : could not open %s\n", HeightFileName);
+		return 1;
+	}
+
+	TerrainSettings settings;
+	settings.GridSize = TileSize;
+	settings.MaxLevel = 12;
+	TerrainQuadtree tree(settings), replay(settings);
+	const TerrainStitchIndices stitch = BuildTerrainStitchIndices(settings.GridSize);
+	if (stitch.Count[0] != tree.PatchTriangles() * 3)
+	{
+		printf("FAILED : an unstitched patch has %u indices\n", stitch.Count[0]);
+		return 1;
+	}
+
+	const float targets[2][3] = { { 0.0f, 0.0f, 1.0f }, { 0.577350f, 0.577350f, 0.577350f } };
+	const float altitudes[] = { 20.0f, 3.0f, 1.0f, 0.3f, 0.1f, 0.03f, 0.01f, 0.003f, 0.001f };
+	printf("%10s %8s %8s %9s %6s %8s %7s %10s %10s\n", "altitude", "target", "patches", "triangles", "level", "forced", "frames", "select ms", "build ms");
+	for (const auto& target : targets)
+	{
+		for (float altitude : altitudes)
+		{
+			float radius = 1.0f + settings.HeightScale + altitude;
+			float eye[3] = { target[0] * radius, target[1] * radius, target[2] * radius };
+
+			int frames;
+			if (!Converge(tree, streamer, eye, budget, frames))
+			{
+				return 1;
+			}
+			auto selectStart = std::chrono::steady_clock::now();
+			tree.Select(eye, budget, [&](const CubeQuadKey& key)
+			{
+				return streamer.Request(key.Ancestor(std::min(key.Level, streamer.LevelCount() - 1))) != nullptr;
+			});
+			double selectSeconds = Seconds(selectStart);
+
+			const TerrainSelectStats& stats = tree.Stats();
+			if (stats.Triangles > budget)
+			{
+				printf("FAILED : %u triangles over a budget of %u\n", stats.Triangles, budget);
+				return 1;
+			}
+			double buildSeconds;
+			if (!CheckBalance(tree) || !CheckSurface(tree, streamer, stitch, buildSeconds))
+			{
+				return 1;
+			}
+
+			// the same path, everything resident : the same patches.
+			int replayFrames;
+			if (!Converge(replay, streamer, eye, budget, replayFrames) || replay.Patches().size() != tree.Patches().size() ||
+				memcmp(replay.Patches().data(), tree.Patches().data(), tree.Patches().size() * sizeof(TerrainPatch)) != 0)
+			{
+				printf("FAILED : a second quadtree selected other patches at altitude %g\n", altitude);
+				return 1;
+			}
+
+			printf("%10g %8s %8u %9u %6u %8u %7d %10.3f %10.2f\n", altitude, target[0] == 0.0f ? "face" : "corner", stats.Patches,
+				stats.Triangles, stats.DeepestLevel, stats.ForcedSplits, frames, selectSeconds * 1000.0, buildSeconds * 1000.0);
+		}
+	}
+
+	// a budget below the six faces.
+	float ground[3] = { 0.0f, 0.0f, 1.0f + settings.HeightScale + 0.001f };
+	TerrainQuadtree small(settings);
+	small.Select(ground, tree.PatchTriangles() * 3);
+	if (small.Stats().Patches != 6 || !small.Stats().BudgetLimited)
+	{
+		printf("FAILED : a tiny budget selected %u patches\n", small.Stats().Patches);
+		return 1;
+	}
+
+	TerrainStreamStats streamStats = streamer.Stats();
+	printf("streamer : %u tiles resident, %llu loaded, %llu evicted\n", streamStats.Resident,
+		(unsigned long long)streamStats.Loaded, (unsigned long long)streamStats.Evicted);
+	std::remove(HeightFileName);
+	printf("all checks passed\n");
+	return 0;
+}
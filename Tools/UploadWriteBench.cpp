@@ -0,0 +1,128 @@
+// UploadWriteBench.cpp : throughput of the ways instance data can be written into an upload buffer.
+//
+// Compares, for 10k to 1M elements of the 52 byte InstanceData layout :
+//   per element : one memcpy per element from a temporary built on the stack (the former UploadBuffer::CopyData)
+//   bulk memcpy : one memcpy of the whole run from a CPU side mirror
+//   streaming   : StreamingCopy of the same run (Helpers/StreamingWrite.h)
+//   in place    : the kernel stores its results straight into the destination through a MappedSpan
+// The destination is ordinary write-back memory here, so it understates the gap on a real write-combined
+// upload heap, where the per element path also pays for the partial lines it leaves behind.
+//   cl /O2 /EHsc Tools\UploadWriteBench.cpp
+//
+// usage : UploadWriteBench [repeat count]
+
+#include "../Helpers/StreamingWrite.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// same layout as InstanceData in FrameBuffer.h, without DirectXMath.
+struct BenchInstance
+{
+	float World[4][3];
+	std::uint32_t MaterialIndex;
+};
+static_assert(sizeof(BenchInstance) == 52, "BenchInstance must match InstanceData");
+
+// stand-in for the per object kernel : an affine transform depending on the element and the frame.
+static inline void ComputeInstance(BenchInstance& inst, std::uint32_t i, float t)
+{
+	float s = t + (float)i * 0.001f;
+	inst.World[0][0] = s;    inst.World[0][1] = 0.0f; inst.World[0][2] = -s;
+	inst.World[1][0] = 0.0f; inst.World[1][1] = 1.0f; inst.World[1][2] = 0.0f;
+	inst.World[2][0] = s;    inst.World[2][1] = 0.0f; inst.World[2][2] = s;
+	inst.World[3][0] = (float)i; inst.World[3][1] = 10.0f; inst.World[3][2] = t;
+	inst.MaterialIndex = i & 7;
+}
+
+template<typename Fn>
+static double MeasureGBs(std::size_t bytesPerRun, int repeat, Fn fn)
+{
+	fn(0);		// warm up, touches every page once
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < repeat; ++r)
+	{
+		fn(r + 1);
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	return (double)bytesPerRun * repeat / seconds / 1e9;
+}
+
+int main(int argc, char* argv[])
+{
+	int repeat = argc > 1 ? std::atoi(argv[1]) : 20;
+	if (repeat < 1)
+	{
+		repeat = 1;
+	}
+
+	const std::uint32_t counts[] = { 10000, 100000, 1000000 };
+
+	std::printf("%10s %14s %14s %14s %14s  (GB/s)\n", "elements", "per element", "bulk memcpy", "streaming", "in place");
+	for (std::uint32_t count : counts)
+	{
+		std::size_t bytes = sizeof(BenchInstance) * count;
+		std::vector<BenchInstance> mirror(count);
+		std::vector<std::uint8_t> storage(bytes + 64);
+		std::uint8_t* mapped = storage.data() + ((64 - ((std::uintptr_t)storage.data() & 63)) & 63);
+		MappedSpan<BenchInstance> span(mapped, count, sizeof(BenchInstance));
+
+		double perElement = MeasureGBs(bytes, repeat, [&](int frame)
+		{
+			for (std::uint32_t i = 0; i < count; ++i)
+			{
+				BenchInstance inst;
+				ComputeInstance(inst, i, (float)frame);
+				std::memcpy(mapped + (std::size_t)i * sizeof(BenchInstance), &inst, sizeof(inst));
+			}
+		});
+
+		double bulk = MeasureGBs(bytes, repeat, [&](int frame)
+		{
+			for (std::uint32_t i = 0; i < count; ++i)
+				ComputeInstance(mirror[i], i, (float)frame);
+			std::memcpy(mapped, mirror.data(), bytes);
+		});
+
+		double streaming = MeasureGBs(bytes, repeat, [&](int frame)
+		{
+			for (std::uint32_t i = 0; i < count; ++i)
+				ComputeInstance(mirror[i], i, (float)frame);
+			span.Write(0, mirror.data(), count);
+		});
+
+		double inPlace = MeasureGBs(bytes, repeat, [&](int frame)
+		{
+			for (std::uint32_t i = 0; i < count; ++i)
+				ComputeInstance(span[i], i, (float)frame);
+		});
+
+		std::printf("%10u %14.2f %14.2f %14.2f %14.2f\n", count, perElement, bulk, streaming, inPlace);
+	}
+
+	// copy cost alone, the kernel taken out of the loop
+	std::printf("\ncopy only, 1M elements :\n");
+	{
+		std::uint32_t count = 1000000;
+		std::size_t bytes = sizeof(BenchInstance) * count;
+		std::vector<BenchInstance> mirror(count);
+		for (std::uint32_t i = 0; i < count; ++i)
+			ComputeInstance(mirror[i], i, 1.0f);
+		std::vector<std::uint8_t> storage(bytes + 64);
+		std::uint8_t* mapped = storage.data() + ((64 - ((std::uintptr_t)storage.data() & 63)) & 63);
+
+		double perElement = MeasureGBs(bytes, repeat, [&](int)
+		{
+			for (std::uint32_t i = 0; i < count; ++i)
+				std::memcpy(mapped + (std::size_t)i * sizeof(BenchInstance), &mirror[i], sizeof(BenchInstance));
+		});
+		double bulk = MeasureGBs(bytes, repeat, [&](int) { std::memcpy(mapped, mirror.data(), bytes); });
+		double streaming = MeasureGBs(bytes, repeat, [&](int) { StreamingCopy(mapped, mirror.data(), bytes); });
+
+		std::printf("%10s %14.2f %14.2f %14.2f\n", "", perElement, bulk, streaming);
+	}
+
+	return 0;
+}
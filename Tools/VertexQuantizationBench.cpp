@@ -0,0 +1,167 @@
+// VertexQuantizationBench.cpp : round trip of the 16 byte CompactVertex (Helpers/VertexQuantization.h)
+// that CompactVS in Shaders/BasicShader.hlsl decodes.
+//
+// Encodes random vertices and the vertices of CreateSphere's finest sphere level, decodes them again and
+// checks the quantization error against its bounds :
+//   - positions within half a step of extent / 32767 of the original on every axis,
+//   - normals within MaxNormalDegrees of the original, and still unit length,
+//   - texture coordinates within half a step of 1 / 65535.
+// Reports the largest errors, the memory of the sphere in both formats and the encode rate.
+//   cl /O2 /EHsc Tools\VertexQuantizationBench.cpp Helpers\VertexQuantization.cpp
+//
+// usage : VertexQuantizationBench [vertex count]
+
+#include "../Helpers/VertexQuantization.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+static const float Pi = 3.14159265f;
+static const double MaxNormalDegrees = 0.01;		// 2 x 16 bit octahedral normals are off by 0.0075 degrees at most
+static volatile std::uint32_t EncodeSink;
+
+struct Errors
+{
+	double Position = 0.0;		// in quantization steps
+	double NormalDegrees = 0.0;
+	double NormalLength = 0.0;
+	double TexC = 0.0;			// in quantization steps
+};
+
+static bool RoundTrip(const float position[3], const float normal[3], const float texC[2], const QuantizationBounds& bounds, Errors& errors)
+{
+	CompactVertex vertex = EncodeVertex(position, normal, texC, bounds);
+	float p[3], n[3], t[2];
+	DecodeVertex(vertex, bounds, p, n, t);
+
+	for (int k = 0; k < 3; ++k)
+	{
+		double step = bounds.Extent[k] / 32767.0;
+		errors.Position = std::max(errors.Position, std::fabs(p[k] - position[k]) / step);
+	}
+
+	double dot = (double)n[0] * normal[0] + (double)n[1] * normal[1] + (double)n[2] * normal[2];
+	double cross[3] = { (double)n[1] * normal[2] - (double)n[2] * normal[1], (double)n[2] * normal[0] - (double)n[0] * normal[2],
+		(double)n[0] * normal[1] - (double)n[1] * normal[0] };
+	double angle = std::atan2(std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]), dot) * 180.0 / Pi;
+	errors.NormalDegrees = std::max(errors.NormalDegrees, angle);
+	errors.NormalLength = std::max(errors.NormalLength, std::fabs(std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]) - 1.0));
+
+	for (int k = 0; k < 2; ++k)
+		errors.TexC = std::max(errors.TexC, std::fabs(t[k] - texC[k]) * 65535.0);
+
+	// half a step, and what float rounding adds to it.
+	return errors.Position <= 0.5 + 1e-2 && errors.NormalDegrees <= MaxNormalDegrees && errors.NormalLength <= 1e-5 && errors.TexC <= 0.5 + 1e-2;
+}
+
+static void Print(const char* what, const Errors& errors)
+{
+	std::printf("%-8s position %.3f steps, normal %.5f degrees (length off by %.1e), texcoord %.3f steps\n", what, errors.Position,
+		errors.NormalDegrees, errors.NormalLength, errors.TexC);
+}
+
+int main(int argc, char* argv[])
+{
+	int vertexCount = argc > 1 ? std::atoi(argv[1]) : 1000000;
+	if (vertexCount < 1)
+	{
+		vertexCount = 1;
+	}
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	// random vertices in an off center box, normals everywhere including the folded lower half.
+	QuantizationBounds bounds;
+	bounds.Center[0] = 3.0f; bounds.Center[1] = -1.0f; bounds.Center[2] = 0.5f;
+	bounds.Extent[0] = 150.0f; bounds.Extent[1] = 0.25f; bounds.Extent[2] = 2.0f;
+	Errors randomErrors;
+	for (int i = 0; i < vertexCount; ++i)
+	{
+		float position[3], normal[3], texC[2];
+		for (int k = 0; k < 3; ++k)
+			position[k] = bounds.Center[k] + bounds.Extent[k] * unit(random);
+
+		float length = 0.0f;
+		do
+		{
+			for (int k = 0; k < 3; ++k)
+				normal[k] = unit(random);
+			length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		} while (length < 1e-3f || length > 1.0f);
+		for (int k = 0; k < 3; ++k)
+			normal[k] /= length;
+
+		texC[0] = 0.5f + 0.5f * unit(random);
+		texC[1] = 0.5f + 0.5f * unit(random);
+		if (!RoundTrip(position, normal, texC, bounds, randomErrors))
+		{
+			Print("random", randomErrors);
+			std::printf("random vertex %d is out of the error bounds\n", i);
+			return 1;
+		}
+	}
+
+	// the axes and the octahedron's edges and corners, where the fold is.
+	const float edges[][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+		{ 0.7071068f, 0.7071068f, 0 }, { -0.7071068f, 0, -0.7071068f }, { 0, -0.7071068f, -0.7071068f }, { 0.5773503f, -0.5773503f, -0.5773503f } };
+	for (const auto& normal : edges)
+	{
+		const float position[3] = { 3.0f, -1.0f, 0.5f }, texC[2] = { 0.0f, 1.0f };
+		if (!RoundTrip(position, normal, texC, bounds, randomErrors))
+		{
+			Print("edges", randomErrors);
+			std::printf("normal (%g, %g, %g) is out of the error bounds\n", normal[0], normal[1], normal[2]);
+			return 1;
+		}
+	}
+
+	// CreateSphere(1, 128, 64), the finest sphere level, quantized in its own bounds.
+	const int slices = 128, stacks = 64;
+	QuantizationBounds sphereBounds;
+	Errors sphereErrors;
+	std::size_t sphereVertices = 0;
+	for (int i = 0; i <= stacks; ++i)
+	{
+		float phi = i * Pi / stacks;
+		for (int j = 0; j <= slices; ++j)
+		{
+			float theta = j * 2.0f * Pi / slices;
+			float normal[3] = { std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta) };
+			float texC[2] = { theta / (2.0f * Pi), phi / Pi };
+			if (!RoundTrip(normal, normal, texC, sphereBounds, sphereErrors))
+			{
+				Print("sphere", sphereErrors);
+				std::printf("sphere vertex (%d, %d) is out of the error bounds\n", i, j);
+				return 1;
+			}
+			++sphereVertices;
+		}
+	}
+
+	// encode rate.  Every encoded vertex goes into a checksum kept in EncodeSink, so the loop can't be dropped.
+	const float position[3] = { 0.1f, 0.2f, 0.3f }, texC[2] = { 0.25f, 0.75f };
+	std::uint32_t checksum = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < vertexCount; ++i)
+	{
+		float angle = i * 1e-3f;
+		float normal[3] = { std::cos(angle) * 0.6f, std::sin(angle) * 0.6f, (i & 1) ? 0.8f : -0.8f };
+		CompactVertex vertex = EncodeVertex(position, normal, texC, bounds);
+		checksum = checksum * 31 + (std::uint16_t)vertex.Position[0] + (std::uint16_t)vertex.Normal[0] + (std::uint16_t)vertex.Normal[1] + vertex.TexC[0];
+	}
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	EncodeSink = checksum;
+
+	Print("random", randomErrors);
+	Print("sphere", sphereErrors);
+	std::printf("sphere of %zu vertices : %zu bytes as Vertex, %zu as CompactVertex\n", sphereVertices, sphereVertices * 32,
+		sphereVertices * sizeof(CompactVertex));
+	std::printf("encode : %.0f vertices/ms\n", vertexCount / ms);
+	return 0;
+}